@@ -50,6 +50,8 @@ extern char* optarg;
 #include "lm32_cpu.h"
 #include "lm32_get_config.h"
 #include "lm32_gdb.h"
+#include "lm32_fuzz.h"
+#include "lm32_fault.h"
 
 // -------------------------------------------------------------------------
 // DEFINES
@@ -69,12 +71,72 @@ extern char* optarg;
 #define COMMS_RESET_OFFSET        0x00000028
 #define COMMS_INSTR_LO_OFFSET     0x0000002c
 #define COMMS_INSTR_HI_OFFSET     0x00000030
+#define COMMS_SNAP_OFFSET         0x00000038
+#define COMMS_REPLAY_OFFSET       0x0000003c
+#define COMMS_DIVERGED_OFFSET     0x00000040
+#define COMMS_LOOKUP_OFFSET       0x00000044
+#define COMMS_LINE_OFFSET         0x00000048
+#define COMMS_MAIN_OFFSET         0x0000004c
+#define COMMS_PROBE_OFFSET        0x00000050
+#define COMMS_REGIONS_OFFSET      0x00000054
+#define COMMS_REGION_OFFSET       0x00000058
+#define COMMS_WAIT_OFFSET         0x0000005c
+#define COMMS_PAGE_MISS_OFFSET    0x00000060
+#define COMMS_CKPT_OFFSET         0x00000064
+#define COMMS_RELOAD_OFFSET       0x00000068
 #define MAX_INT_TIME              0x7fffffffffffffffULL
 
+// Values written to COMMS_SNAP_OFFSET, COMMS_REPLAY_OFFSET and COMMS_CKPT_OFFSET
+#define COMMS_SNAP_TAKE           1
+#define COMMS_SNAP_RESTORE        2
+#define COMMS_SNAP_RESTORE_COPY   3
+#define COMMS_SNAP_SAVE           4
+#define COMMS_SNAP_LOAD           5
+#define COMMS_SNAP_DELETE         6
+#define COMMS_REPLAY_STOP         0
+#define COMMS_REPLAY_RECORD       1
+#define COMMS_REPLAY_PLAY         2
+#define COMMS_CKPT_DELETE         0
+#define COMMS_CKPT_WRITE          1
+#define COMMS_CKPT_RESTORE        2
+#define COMMS_CKPT_RESTORE_FIRST  3
+
+// API test requests, actioned at the next instruction boundary
+#define API_REQ_NONE              0
+#define API_REQ_SNAP_TAKE         1
+#define API_REQ_SNAP_RESTORE      2
+#define API_REQ_SNAP_RESTORE_COPY 3
+#define API_REQ_RECORD            4
+#define API_REQ_RECORD_OPEN       5
+#define API_REQ_PLAY              6
+#define API_REQ_PLAY_OPEN         7
+#define API_REQ_CKPT_WRITE        8
+#define API_REQ_CKPT_RESTORE      9
+#define API_REQ_CKPT_FIRST        10
+#define API_REQ_SNAP_SAVE         11
+#define API_REQ_SNAP_LOAD         12
+#define API_REQ_RELOAD            13
+
+#define API_REPLAY_FNAME          "test.replay"
+#define API_SNAP_FNAME            "test.snap"
+#define API_CKPT_BASE_FNAME       "test"
+#define API_CKPT_KEEP             4
+#define API_NO_SYMBOL             0xffffffff
+
+// Internal memory range watched by the probe memory callback, for data writes only
+#define API_PROBE_START_ADDR      0x00008000
+#define API_PROBE_END_ADDR        0x000080ff
+
+#define API_NUM_MEM_REGIONS       2
+
 #define PERIPH_PAGE_SIZE          4096
 #define PERIPH_OFFSET_MASK        (PERIPH_PAGE_SIZE-1)
 #define PERIPH_PAGE_MASK          (~PERIPH_OFFSET_MASK)
 
+#define FORK_SERVER_MAX_JOB_LINE  1024
+#define FORK_SERVER_JOB_END_STR   "#END"
+#define FORK_SERVER_DELIMITERS    " \t\r\n"
+
 // -------------------------------------------------------------------------
 // LOCAL PROTOTYPES
 // -------------------------------------------------------------------------
@@ -82,8 +144,11 @@ extern char* optarg;
 // Prototypes for callback functions
 uint32_t ext_interrupt  (lm32_time_t time, lm32_time_t *wakeup_time);
 int      ext_mem_access (uint32_t byte_addr, uint32_t *data, int type, int cache_hit, lm32_time_t time);
+int      ext_mem_probe  (uint32_t byte_addr, uint32_t *data, int type, int cache_hit, lm32_time_t time);
 void     jtag_access    (uint32_t *data, int type, lm32_time_t time);
 
+static void api_test_request (void);
+
 // -------------------------------------------------------------------------
 // LOCAL STATICS
 // -------------------------------------------------------------------------
@@ -100,6 +165,350 @@ static int exec_type                   = LM32_RUN_FROM_RESET;
 static lm32_time_t next_interrupt_time = MAX_INT_TIME;
 static uint32_t interrupt_pattern      = 0;
 
+// API test state: the pending request, the snapshot taken (and its serialised
+// copy), the number of snapshot and checkpoint restores, the number of
+// checkpoints written, the replay divergences counted when last stopped, the
+// address to look up symbols and source lines for, the number of accesses
+// seen by the probe memory callback, and the program to reload
+static int              api_request     = API_REQ_NONE;
+static lm32_snapshot_t* api_snap        = NULL;
+static FILE*            api_snap_fp     = NULL;
+static uint32_t         api_restores    = 0;
+static int              api_ckpts       = 0;
+static uint32_t         api_diverged    = 0;
+static uint32_t         api_lookup_addr = 0;
+static uint32_t         api_probe_count = 0;
+static const char*      api_elf_fname   = NULL;
+
+// API test memory latency map: a static RAM-like region and an SDRAM-like
+// region, with 256 byte pages, and the region whose statistics are read
+static const lm32_mem_region_cfg_t api_mem_regions[API_NUM_MEM_REGIONS] = {
+    {0x00008000, 0x000080ff, 3, 5, 1, 0,     0},
+    {0x00009000, 0x00009fff, 1, 2, 1, 0x100, 10}
+};
+static int              api_mem_region  = 0;
+
+// -------------------------------------------------------------------------
+// run_program()
+//
+// Run the program in the specified file (or what is already in memory, if
+// fname is NULL) on the ISS. Re-enter if the returned status was for a
+// watch- or breakpoint or single stepping, as this is a test program exit.
+//
+// -------------------------------------------------------------------------
+
+static void run_program (const lm32_config_t* p_cfg, const char* fname)
+{
+    int rtn_status;
+    bool load_code = true;
+    do
+    {
+
+        rtn_status = cpu->lm32_run_program(fname, p_cfg->num_run_instructions, p_cfg->user_break_addr, exec_type, load_code);
+        load_code = false;
+        exec_type = LM32_RUN_CONTINUE;
+    }
+    while (rtn_status != LM32_USER_BREAK && rtn_status != LM32_LOCK_BREAK && rtn_status != LM32_DISASSEMBLE_BREAK);
+}
+
+// -------------------------------------------------------------------------
+// dump_results()
+//
+// Dump the statistics, registers and RAM values after completion, as
+// specified in the configuration.
+//
+// -------------------------------------------------------------------------
+
+static void dump_results (const lm32_config_t* p_cfg, FILE* lfp)
+{
+#ifndef LM32_FAST_COMPILE
+    // Dump opcode stats after completion, if specified to do so
+    if (p_cfg->op_stats_dump)
+    {
+        cpu->lm32_dump_op_stats();
+    }
+
+    // Dump memory latency map statistics, if a map was configured
+    if (p_cfg->num_mem_regions)
+    {
+        cpu->lm32_dump_mem_region_stats();
+    }
+#endif
+
+    // Dump registers after completion, if specified to do so
+    if (p_cfg->dump_registers)
+    {
+        cpu->lm32_dump_registers();
+    }
+
+    // Dump the number of executed instructions
+    if (p_cfg->dump_num_exec_instr)
+    {
+        fprintf(lfp, "\nNumber of executed instructions = %lld\n",  cpu->lm32_get_num_instructions());
+    }
+
+    // Dump RAM, if specified to do so and within range
+    if (p_cfg->ram_dump_addr >= 0 && p_cfg->ram_dump_addr < (int)p_cfg->mem_size)
+    {
+        // If a single word (or less), dump a whole word
+        if (p_cfg->ram_dump_bytes <= 4)
+        {
+           fprintf(lfp, "\nRAM 0x%04x = 0x%08x\n", p_cfg->ram_dump_addr, cpu->lm32_read_mem(p_cfg->ram_dump_addr, LM32_MEM_RD_ACCESS_WORD));
+
+        // Dump multiple address locations, formatted over several lines
+        }
+        else
+        {
+            fprintf(lfp, "\nRAM 0x%04x = \n", p_cfg->ram_dump_addr);
+
+            for (int idx = 0; idx < p_cfg->ram_dump_bytes; idx += 4)
+            {
+                if ((p_cfg->ram_dump_addr+idx) < (int)p_cfg->mem_size)
+                {
+                    fprintf(lfp, "0x%08x ", cpu->lm32_read_mem(p_cfg->ram_dump_addr+idx, LM32_MEM_RD_ACCESS_WORD));
+                }
+                // Ran off the end of memory
+                else
+                {
+                    fprintf(lfp, "0x???????? ");
+                }
+
+                if ((idx%16) == 12)
+                {
+                    fprintf(lfp, "\n");
+                }
+            }
+        }
+    } 
+    else 
+    {
+        if (p_cfg->ram_dump_addr != -1)
+        {
+            fprintf(lfp, "RAM 0x%04x = ????\n", p_cfg->ram_dump_addr);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// write_profiles()
+//
+// Write the cycle sampling profile, if enabled, in callgrind format (to
+// <prefix>.cycles.callgrind) and as folded stacks (to <prefix>.cycles.folded),
+// the call graph profile, if enabled, in callgrind format (to
+// <prefix>.calls.callgrind), and the host sampling profile, if enabled, in
+// callgrind format (to <prefix>.host.callgrind) and as folded stacks (to
+// <prefix>.host.folded)
+//
+// -------------------------------------------------------------------------
+
+static void write_profiles (const lm32_config_t* p_cfg)
+{
+    char fname[FILENAME_MAX];
+
+    if (p_cfg->prof_cycle_interval)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.cycles.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_profile(fname, LM32_PROF_FMT_CALLGRIND))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+
+        snprintf(fname, FILENAME_MAX, "%s.cycles.folded", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_profile(fname, LM32_PROF_FMT_FOLDED))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+    }
+
+    if (p_cfg->prof_call_graph)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.calls.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_call_graph(fname))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+    }
+
+    if (p_cfg->prof_host_usecs)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.host.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_host_profile(fname, LM32_PROF_FMT_CALLGRIND))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+
+        snprintf(fname, FILENAME_MAX, "%s.host.folded", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_host_profile(fname, LM32_PROF_FMT_FOLDED))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// run_job()
+//
+// Run a fork server job in the forked child. The job line has options
+// overriding the server's configuration, in the same form as on the command
+// line: -f <file> loads an ELF program over the server's memory, -W <addr>=<val>
+// patches a memory word (after any program is loaded), -c <val> sets the
+// configuration word, and -n, -b, -r, -R, -D and -I are as for the command
+// line. Returns an exit status.
+//
+// -------------------------------------------------------------------------
+
+static int run_job (char* job, const lm32_config_t* p_cfg, const char* fname, FILE* lfp)
+{
+    lm32_config_t job_cfg = *p_cfg;
+    char*         opt;
+    char*         arg;
+    char*         patches[FORK_SERVER_MAX_JOB_LINE/2];
+    int           num_patches = 0;
+
+    for (opt = strtok(job, FORK_SERVER_DELIMITERS); opt != NULL; opt = strtok(NULL, FORK_SERVER_DELIMITERS))
+    {
+        // Options with no argument
+        if (!strcmp(opt, "-D"))
+        {
+            job_cfg.dump_registers = 1;
+            continue;
+        }
+        else if (!strcmp(opt, "-I"))
+        {
+            job_cfg.dump_num_exec_instr = 1;
+            continue;
+        }
+
+        // The argument may be attached to the option, as with getopt
+        if (opt[0] != '-' || opt[1] == '\0' || (arg = (opt[2] != '\0') ? &opt[2] : strtok(NULL, FORK_SERVER_DELIMITERS)) == NULL)
+        {
+            fprintf(stderr, "***ERROR: bad fork server job option %s\n", opt);
+            return LM32_USER_ERROR;
+        }
+
+        switch(opt[1])
+        {
+        case 'f':
+            fname = arg;
+            break;
+        case 'n':
+            job_cfg.num_run_instructions = strtol(arg, NULL, 0);
+            if (job_cfg.num_run_instructions < LM32_FOREVER)
+                job_cfg.num_run_instructions = LM32_FOREVER;
+            break;
+        case 'b':
+            job_cfg.user_break_addr = (uint32_t)strtol(arg, NULL, 0);
+            break;
+        case 'r':
+            job_cfg.ram_dump_addr = (uint32_t)strtol(arg, NULL, 0) & 0xfffffffc;
+            break;
+        case 'R':
+            job_cfg.ram_dump_bytes = ((uint32_t)strtol(arg, NULL, 0) + 3) & 0xfffffffc;
+            break;
+        case 'c':
+            cpu->lm32_set_configuration((uint32_t)strtol(arg, NULL, 0));
+            break;
+        case 'W':
+            patches[num_patches++] = arg;
+            break;
+        default:
+            fprintf(stderr, "***ERROR: bad fork server job option %s\n", opt);
+            return LM32_USER_ERROR;
+        }
+    }
+
+    // Load any program first, so that the patches are applied over it
+    if (fname != NULL)
+    {
+        cpu->lm32_load_elf(fname);
+    }
+
+    for (int pdx = 0; pdx < num_patches; pdx++)
+    {
+        char*    val;
+        uint32_t addr = (uint32_t)strtoul(patches[pdx], &val, 0);
+
+        if (*val++ != '=')
+        {
+            fprintf(stderr, "***ERROR: bad fork server job memory patch %s\n", patches[pdx]);
+            return LM32_USER_ERROR;
+        }
+        cpu->lm32_write_mem(addr, (uint32_t)strtoul(val, NULL, 0), LM32_MEM_WR_ACCESS_WORD, true);
+    }
+
+    run_program(&job_cfg, NULL);
+
+    dump_results(&job_cfg, lfp);
+
+    return LM32_NO_ERROR;
+}
+
+// -------------------------------------------------------------------------
+// fork_server()
+//
+// Run as a fork server for batches of test programs. The model is set up
+// once, with the program loaded (and, if a start address is configured, run
+// to there), and then a clone of it is forked to run each job line read from
+// stdin (see run_job()), so that a job only costs a fork and its own execution.
+// Each job's results are followed by a "#END <job> <exit status>" line. An
+// empty line or end of input ends the server.
+//
+// -------------------------------------------------------------------------
+
+static void fork_server (const lm32_config_t* p_cfg, FILE* lfp)
+{
+    char        job[FORK_SERVER_MAX_JOB_LINE];
+    const char* fname  = p_cfg->filename;
+    int         status = LM32_NO_ERROR;
+    int         inst;
+
+#ifndef LM32_FAST_COMPILE
+    // If a start address is configured, load the program and run it to there
+    // now, with jobs continuing from that point, rather than from reset
+    if (p_cfg->fork_server_start_addr != -1)
+    {
+        if (cpu->lm32_run_program(fname, LM32_FOREVER, p_cfg->fork_server_start_addr, exec_type, true) != LM32_USER_BREAK)
+        {
+            fprintf(stderr, "***ERROR: fork server program did not reach start address 0x%08x\n", p_cfg->fork_server_start_addr);
+            exit(LM32_USER_ERROR);
+        }
+        exec_type = LM32_RUN_CONTINUE;
+        fname     = NULL;
+    }
+#endif
+
+    // Otherwise load the program now, with jobs running it from reset
+    if (fname != NULL)
+    {
+        cpu->lm32_load_elf(fname);
+        fname = NULL;
+    }
+
+    for (int job_num = 1; fgets(job, FORK_SERVER_MAX_JOB_LINE, stdin) != NULL && strspn(job, FORK_SERVER_DELIMITERS) != strlen(job); job_num++)
+    {
+        if ((inst = cpu->lm32_clone_instances(1)) > 0)
+        {
+            status = run_job(job, p_cfg, fname, lfp);
+            fflush(NULL);
+            _exit(status);
+        }
+        else if (inst < 0)
+        {
+            fprintf(stderr, "***ERROR: fork server unable to fork job %d\n", job_num);
+            exit(LM32_INTERNAL_ERROR);
+        }
+
+        while (cpu->lm32_wait_instance(&inst) > 0)
+        {
+            status = inst;
+        }
+
+        fprintf(lfp, FORK_SERVER_JOB_END_STR " %d %d\n", job_num, status);
+        fflush(lfp);
+    }
+}
+
+
 // -------------------------------------------------------------------------
 // main()
 //
@@ -111,9 +520,11 @@ int main (int argc, char** argv)
 {
     FILE     *lfp             = stdout;
     lm32_config_t* p_cfg;
+    double         start_usecs    = lm32_cpu::lm32_host_usecs();
 
     // Process command line and .ini file options
     p_cfg = lm32_get_config(argc, argv);
+    double config_usecs = lm32_cpu::lm32_host_usecs() - start_usecs;
 
     // Open the logfile, if "stdout" not specified as the filename
     if (strcmp(p_cfg->log_fname, (char *)"stdout"))
@@ -141,9 +552,46 @@ int main (int argc, char** argv)
                        &p_cfg->dcache_cfg,
                        &p_cfg->icache_cfg);
 
+    // Time the startup from program entry, including the configuration processing
+    cpu->lm32_set_startup_origin(start_usecs);
+    cpu->lm32_add_startup_usecs(LM32_STARTUP_CONFIG, config_usecs);
+    cpu->lm32_set_startup_stats(p_cfg->startup_stats);
+
     // Set the verbosity level
     cpu->lm32_set_verbosity_level(p_cfg->verbose);
 
+    // Select huge page backed memory, if configured
+    cpu->lm32_set_huge_pages(p_cfg->huge_pages);
+
+    // Cache source line tables, if configured
+    cpu->lm32_set_line_cache(p_cfg->line_cache_dir);
+
+#ifndef LM32_FAST_COMPILE
+    // Configure any memory latency map
+    cpu->lm32_set_mem_regions(p_cfg->mem_regions, p_cfg->num_mem_regions);
+#endif
+
+    // Start any cycle sampling profile
+    if (p_cfg->prof_cycle_interval && !cpu->lm32_set_profile(p_cfg->prof_cycle_interval))
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    // Start any call graph profile
+    if (p_cfg->prof_call_graph && !cpu->lm32_set_call_graph(true))
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    // Start any host sampling profile
+    if (p_cfg->prof_host_usecs && !cpu->lm32_set_host_profile(p_cfg->prof_host_usecs, p_cfg->prof_host_ra))
+    {
+        fprintf(stderr, "***ERROR: host profile not supported on this platform\n");
+        exit(LM32_USER_ERROR);
+    }
+
     // By convention, r0 is always 0. Use lm32_set_gp_reg() to ensure this
     // for coverage.
     cpu->lm32_set_gp_reg(0, 0);
@@ -153,9 +601,11 @@ int main (int argc, char** argv)
     if (p_cfg->test_mode)
     {
         cpu->lm32_register_int_callback(ext_interrupt);
-        cpu->lm32_register_ext_mem_callback(ext_mem_access);
+        cpu->lm32_register_ext_mem_callback(ext_mem_access, COMMS_BASE_ADDRESS, COMMS_BASE_ADDRESS + PERIPH_OFFSET_MASK, LM32_MEM_CB_DATA);
         cpu->lm32_register_jtag_callback(jtag_access);
 
+        api_elf_fname = p_cfg->filename;
+
         // Do a quick test of the BP register access functions
         for (int idx = 0; idx < 4; idx++)
         {
@@ -191,91 +641,42 @@ int main (int argc, char** argv)
         }
     }
 
-    if (!p_cfg->gdb_run)
+    if (p_cfg->fork_server)
     {
-        // Run the program in the specified file on the ISS. Re-enter if the returned status
-        // was for a watch- or breakpoint or single stepping, as this is a test program exit.
-        int rtn_status;
-        bool load_code = true;
-        do
-        {
-    
-            rtn_status = cpu->lm32_run_program(p_cfg->filename, p_cfg->num_run_instructions, p_cfg->user_break_addr, exec_type, load_code);
-            load_code = false;
-            exec_type = LM32_RUN_CONTINUE;
-        }
-        while (rtn_status != LM32_USER_BREAK && rtn_status != LM32_LOCK_BREAK && rtn_status != LM32_DISASSEMBLE_BREAK);
-    }
-    else
-    {
-        // Start procssing commands from GDB
-        if (lm32gdb_process_gdb(cpu, p_cfg->com_port_num, p_cfg->use_tcp_skt))
-        {
-            fprintf(stderr, "***ERROR in opening PTY\n");
-            return -1;
-        }
+        // Serve jobs until the end of input, when there is nothing left to dump
+        fork_server(p_cfg, lfp);
+        return 0;
     }
-
 #ifndef LM32_FAST_COMPILE
-    // Dump opcode stats after completion, if specified to do so
-    if (p_cfg->op_stats_dump)
+    else if (p_cfg->fuzz_seed_fname != NULL)
     {
-        cpu->lm32_dump_op_stats();
+        // Fuzz the program until the configured number of executions
+        return lm32fuzz_run(cpu, p_cfg, lfp);
     }
-#endif
-
-    // Dump registers after completion, if specified to do so
-    if (p_cfg->dump_registers)
+    else if (p_cfg->fault_runs > 0)
     {
-        cpu->lm32_dump_registers();
+        // Run the configured fault injection campaign
+        return lm32fault_run(cpu, p_cfg, lfp);
     }
-
-    // Dump the number of executed instructions
-    if (p_cfg->dump_num_exec_instr)
+#endif
+    else if (!p_cfg->gdb_run)
     {
-        fprintf(lfp, "\nNumber of executed instructions = %lld\n",  cpu->lm32_get_num_instructions());
+        // Run the program in the specified file on the ISS
+        run_program(p_cfg, p_cfg->filename);
     }
-
-    // Dump RAM, if specified to do so and within range
-    if (p_cfg->ram_dump_addr >= 0 && p_cfg->ram_dump_addr < (int)p_cfg->mem_size)
+    else
     {
-        // If a single word (or less), dump a whole word
-        if (p_cfg->ram_dump_bytes <= 4)
+        // Start procssing commands from GDB
+        if (lm32gdb_process_gdb(cpu, p_cfg->com_port_num, p_cfg->use_tcp_skt))
         {
-           fprintf(lfp, "\nRAM 0x%04x = 0x%08x\n", p_cfg->ram_dump_addr, cpu->lm32_read_mem(p_cfg->ram_dump_addr, LM32_MEM_RD_ACCESS_WORD));
-
-        // Dump multiple address locations, formatted over several lines
+            fprintf(stderr, "***ERROR in opening PTY\n");
+            return -1;
         }
-        else
-        {
-            fprintf(lfp, "\nRAM 0x%04x = \n", p_cfg->ram_dump_addr);
+    }
 
-            for (int idx = 0; idx < p_cfg->ram_dump_bytes; idx += 4)
-            {
-                if ((p_cfg->ram_dump_addr+idx) < (int)p_cfg->mem_size)
-                {
-                    fprintf(lfp, "0x%08x ", cpu->lm32_read_mem(p_cfg->ram_dump_addr+idx, LM32_MEM_RD_ACCESS_WORD));
-                }
-                // Ran off the end of memory
-                else
-                {
-                    fprintf(lfp, "0x???????? ");
-                }
+    dump_results(p_cfg, lfp);
 
-                if ((idx%16) == 12)
-                {
-                    fprintf(lfp, "\n");
-                }
-            }
-        }
-    } 
-    else 
-    {
-        if (p_cfg->ram_dump_addr != -1)
-        {
-            fprintf(lfp, "RAM 0x%04x = ????\n", p_cfg->ram_dump_addr);
-        }
-    }
+    write_profiles(p_cfg);
 
     // Disable the caches, to exercise their deletion
     cpu->lm32_set_configuration(p_cfg->cfg_word & ~((uint32_t)(LM32_DCACHE_ENABLE | LM32_ICACHE_ENABLE)));
@@ -350,6 +751,79 @@ int ext_mem_access (uint32_t byte_addr, uint32_t *data, int type, int cache_hit,
                 // After a reset, switch to defined type, as set by the test program
                 exec_type = *data & 0x3;
                 return 0;
+            case COMMS_SNAP_OFFSET:
+                if (*data == COMMS_SNAP_DELETE)
+                {
+                    remove(API_SNAP_FNAME);
+                }
+                else
+                {
+                    api_request = (*data == COMMS_SNAP_TAKE)    ? API_REQ_SNAP_TAKE    :
+                                  (*data == COMMS_SNAP_RESTORE) ? API_REQ_SNAP_RESTORE :
+                                  (*data == COMMS_SNAP_SAVE)    ? API_REQ_SNAP_SAVE    :
+                                  (*data == COMMS_SNAP_LOAD)    ? API_REQ_SNAP_LOAD    : API_REQ_SNAP_RESTORE_COPY;
+                }
+                return 0;
+            case COMMS_REPLAY_OFFSET:
+                if (*data == COMMS_REPLAY_STOP)
+                {
+                    api_diverged = (uint32_t)cpu->lm32_close_replay();
+                    remove(API_REPLAY_FNAME);
+                }
+                else
+                {
+                    api_request = (*data == COMMS_REPLAY_RECORD) ? API_REQ_RECORD : API_REQ_PLAY;
+                }
+                return 0;
+            case COMMS_LOOKUP_OFFSET:
+                api_lookup_addr = *data;
+                return 0;
+            case COMMS_RELOAD_OFFSET:
+                api_request = API_REQ_RELOAD;
+                return 0;
+            case COMMS_CKPT_OFFSET:
+                if (*data == COMMS_CKPT_DELETE)
+                {
+                    char fname[FILENAME_MAX];
+
+                    // Remove the index and every checkpoint written (as numbers never exceed the count)
+                    snprintf(fname, FILENAME_MAX, "%s.ckpt", API_CKPT_BASE_FNAME);
+                    remove(fname);
+
+                    for (int num = 0; num < api_ckpts; num++)
+                    {
+                        snprintf(fname, FILENAME_MAX, "%s.%06d.ckpt", API_CKPT_BASE_FNAME, num);
+                        remove(fname);
+                    }
+                }
+                else
+                {
+                    api_request = (*data == COMMS_CKPT_WRITE)   ? API_REQ_CKPT_WRITE :
+                                  (*data == COMMS_CKPT_RESTORE) ? API_REQ_CKPT_RESTORE : API_REQ_CKPT_FIRST;
+                }
+                return 0;
+            case COMMS_PROBE_OFFSET:
+                // Add the probe alongside this callback (restarting its count), or remove it
+                if (*data)
+                {
+                    cpu->lm32_remove_ext_mem_callback(ext_mem_probe);
+                    cpu->lm32_add_ext_mem_callback(ext_mem_probe, API_PROBE_START_ADDR, API_PROBE_END_ADDR, LM32_MEM_CB_WR_DATA);
+                    api_probe_count = 0;
+                }
+                else
+                {
+                    cpu->lm32_remove_ext_mem_callback(ext_mem_probe);
+                }
+                return 0;
+#ifndef LM32_FAST_COMPILE
+            case COMMS_REGIONS_OFFSET:
+                // Configure the first regions of the test latency map (clearing the statistics)
+                cpu->lm32_set_mem_regions(api_mem_regions, (*data < API_NUM_MEM_REGIONS) ? *data : API_NUM_MEM_REGIONS);
+                return 0;
+            case COMMS_REGION_OFFSET:
+                api_mem_region = *data % LM32_NUM_MEM_REGION_STATS;
+                return 0;
+#endif
             default:
                 return LM32_EXT_MEM_NOT_PROCESSED;
             }
@@ -365,6 +839,51 @@ int ext_mem_access (uint32_t byte_addr, uint32_t *data, int type, int cache_hit,
             case COMMS_INSTR_HI_OFFSET:
                 *data = (uint32_t)((cpu->lm32_get_num_instructions() >> 32ULL) & 0xffffffffULL);
                 break;
+            case COMMS_SNAP_OFFSET:
+            case COMMS_CKPT_OFFSET:
+                *data = api_restores;
+                break;
+            case COMMS_REPLAY_OFFSET:
+                *data = (uint32_t)cpu->lm32_get_replay_mode();
+                break;
+            case COMMS_DIVERGED_OFFSET:
+                *data = api_diverged;
+                break;
+            case COMMS_LOOKUP_OFFSET:
+            {
+                uint32_t offset;
+                *data = (cpu->lm32_lookup_symbol(api_lookup_addr, &offset) != NULL) ? api_lookup_addr - offset : API_NO_SYMBOL;
+                break;
+            }
+            case COMMS_LINE_OFFSET:
+            {
+                const char* file;
+                if (!cpu->lm32_lookup_line(api_lookup_addr, &file, data))
+                {
+                    *data = 0;
+                }
+                break;
+            }
+            case COMMS_MAIN_OFFSET:
+                if (!cpu->lm32_find_symbol("main", data))
+                {
+                    *data = API_NO_SYMBOL;
+                }
+                break;
+            case COMMS_PROBE_OFFSET:
+                *data = api_probe_count;
+                break;
+#ifndef LM32_FAST_COMPILE
+            case COMMS_REGION_OFFSET:
+                *data = (uint32_t)cpu->lm32_get_mem_region_stats(api_mem_region).writes;
+                break;
+            case COMMS_WAIT_OFFSET:
+                *data = (uint32_t)cpu->lm32_get_mem_region_stats(api_mem_region).wait_cycles;
+                break;
+            case COMMS_PAGE_MISS_OFFSET:
+                *data = (uint32_t)cpu->lm32_get_mem_region_stats(api_mem_region).page_misses;
+                break;
+#endif
             // For all the configuration offsets, return the whole CFG register value
             case COMMS_NUM_INT_OFFSET:
             case COMMS_MULT_EN_OFFSET:
@@ -393,6 +912,22 @@ int ext_mem_access (uint32_t byte_addr, uint32_t *data, int type, int cache_hit,
     }
 }
 
+// -------------------------------------------------------------------------
+// ext_mem_probe()
+//
+// Memory callback for testing callback address and access type filtering.
+// Added over a small internal memory range through the mailbox, it counts
+// the accesses it is called for, but leaves them to internal memory.
+//
+// -------------------------------------------------------------------------
+
+int ext_mem_probe (uint32_t byte_addr, uint32_t *data, int type, int cache_hit, lm32_time_t time)
+{
+    api_probe_count++;
+
+    return LM32_EXT_MEM_NOT_PROCESSED;
+}
+
 // -------------------------------------------------------------------------
 // ext_interrupt()
 //
@@ -406,6 +941,12 @@ uint32_t ext_interrupt (lm32_time_t time, lm32_time_t *wakeup_time)
 {
     uint32_t tmp;
 
+    // Action any API test request at this instruction boundary
+    if (api_request != API_REQ_NONE)
+    {
+        api_test_request();
+    }
+
     // If the time has expired to generate an interrupt, then fire the
     // interrupts with the pre-defined pattern
     if (time >= next_interrupt_time)
@@ -426,6 +967,126 @@ uint32_t ext_interrupt (lm32_time_t time, lm32_time_t *wakeup_time)
     }
 }
 
+// -------------------------------------------------------------------------
+// api_test_request()
+//
+// Action a request made through the API test mailbox registers, from the
+// interrupt callback, so that snapshots are taken and restored between
+// instructions. A snapshot is taken (with a serialised copy, for restoring
+// after a round trip) when recording starts, and restored to replay from.
+// The first instruction of a restored snapshot runs straight after the
+// callback, so recording and replaying both start at the callback after
+// the snapshot's first instruction, for the inputs to line up. Failures are
+// left for the test program to detect.
+//
+// -------------------------------------------------------------------------
+
+static void api_test_request (void)
+{
+    lm32_snapshot_t* p_snap;
+    int              request = api_request;
+
+    api_request = API_REQ_NONE;
+
+    switch (request)
+    {
+    case API_REQ_SNAP_TAKE:
+    case API_REQ_RECORD:
+        cpu->lm32_free_snapshot(api_snap);
+
+        if (api_snap_fp != NULL)
+        {
+            fclose(api_snap_fp);
+        }
+
+        api_snap    = cpu->lm32_take_snapshot();
+        api_snap_fp = tmpfile();
+
+        if (api_snap_fp != NULL && cpu->lm32_serialise_snapshot(api_snap, api_snap_fp, LM32_SNAP_COMPRESS) != LM32_SNAP_OK)
+        {
+            fclose(api_snap_fp);
+            api_snap_fp = NULL;
+        }
+
+        if (request == API_REQ_RECORD)
+        {
+            api_request = API_REQ_RECORD_OPEN;
+        }
+        break;
+
+    case API_REQ_RECORD_OPEN:
+        cpu->lm32_open_replay(API_REPLAY_FNAME, LM32_REPLAY_RECORD);
+        break;
+
+    case API_REQ_SNAP_RESTORE:
+        if (cpu->lm32_restore_snapshot(api_snap))
+        {
+            api_restores++;
+        }
+        break;
+
+    case API_REQ_SNAP_RESTORE_COPY:
+        if (api_snap_fp != NULL)
+        {
+            rewind(api_snap_fp);
+
+            if ((p_snap = cpu->lm32_deserialise_snapshot(api_snap_fp)) != NULL && cpu->lm32_restore_snapshot(p_snap))
+            {
+                api_restores++;
+            }
+
+            cpu->lm32_free_snapshot(p_snap);
+        }
+        break;
+
+    case API_REQ_PLAY:
+        cpu->lm32_close_replay();
+
+        if (cpu->lm32_restore_snapshot(api_snap))
+        {
+            api_request = API_REQ_PLAY_OPEN;
+        }
+        break;
+
+    case API_REQ_PLAY_OPEN:
+        cpu->lm32_open_replay(API_REPLAY_FNAME, LM32_REPLAY_PLAY);
+        break;
+
+    case API_REQ_SNAP_SAVE:
+        cpu->lm32_save_snapshot(API_SNAP_FNAME, LM32_SNAP_MAPPABLE);
+        break;
+
+    case API_REQ_SNAP_LOAD:
+        if (cpu->lm32_load_snapshot(API_SNAP_FNAME) == LM32_SNAP_OK)
+        {
+            api_restores++;
+        }
+        break;
+
+    case API_REQ_RELOAD:
+        if (api_elf_fname != NULL)
+        {
+            cpu->lm32_load_elf(api_elf_fname);
+        }
+        break;
+
+    case API_REQ_CKPT_WRITE:
+        if (cpu->lm32_write_checkpoint(API_CKPT_BASE_FNAME, API_CKPT_KEEP, LM32_SNAP_COMPRESS) == LM32_SNAP_OK)
+        {
+            api_ckpts++;
+        }
+        break;
+
+    case API_REQ_CKPT_RESTORE:
+    case API_REQ_CKPT_FIRST:
+        if (cpu->lm32_restore_checkpoint(API_CKPT_BASE_FNAME, (request == API_REQ_CKPT_RESTORE) ? LM32_CKPT_LATEST : 0) == LM32_SNAP_OK)
+        {
+            api_restores++;
+        }
+        break;
+    }
+}
+
 // -------------------------------------------------------------------------
 // jtag_access()
 //
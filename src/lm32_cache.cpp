@@ -127,6 +127,71 @@ void lm32_cache::lm32_cache_invalidate (void)
     }
 }
 
+// -------------------------------------------------------------------------
+// get_state()
+//
+// Copies the cache geometry and line state to buf, which must be at least
+// get_state_size() bytes.
+//
+
+void lm32_cache::get_state (uint32_t* buf)
+{
+    *buf++ = line_width;
+    *buf++ = ways;
+    *buf++ = sets;
+    *buf++ = base_addr;
+    *buf++ = limit;
+
+    for (int sidx = 0; sidx < sets; sidx++)
+    {
+        *buf++ = next_way_update[sidx];
+    }
+
+    for (int widx = 0; widx < ways; widx++)
+    {
+        for (int sidx = 0; sidx < sets; sidx++)
+        {
+            *buf++ = m[widx][sidx].addr;
+            *buf++ = m[widx][sidx].valid;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// set_state()
+//
+// Restores the cache line state from a buffer previously filled by
+// get_state(). If the geometry doesn't match this cache, the state is
+// not restored and false returned.
+//
+
+bool lm32_cache::set_state (const uint32_t* buf, const int bytes)
+{
+    if (bytes != get_state_size() || buf[0] != (uint32_t)line_width || buf[1] != (uint32_t)ways || 
+        buf[2] != (uint32_t)sets  || buf[3] != base_addr || buf[4] != limit)
+    {
+        return false;
+    }
+
+    buf += LM32_CACHE_STATE_HDR_WORDS;
+
+    for (int sidx = 0; sidx < sets; sidx++)
+    {
+        next_way_update[sidx] = *buf++;
+    }
+
+    for (int widx = 0; widx < ways; widx++)
+    {
+        for (int sidx = 0; sidx < sets; sidx++)
+        {
+            m[widx][sidx].addr  = *buf++;
+            m[widx][sidx].valid = *buf++;
+        }
+    }
+
+    return true;
+}
+
 // -------------------------------------------------------------------------
 // lm32_cache_access()
 //
@@ -36,6 +36,12 @@
 
 #include "lm32_cpu_hdr.h"
 
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+#define LM32_CACHE_STATE_HDR_WORDS 5
+
 // -------------------------------------------------------------------------
 // TYPEDEFS
 // -------------------------------------------------------------------------
@@ -69,6 +75,12 @@ public:
 
     // Return configured line width (in bytes)
     inline int get_line_width (void) { return line_width; };
+
+    // Snapshot support: size of, and copy of, the cache state (geometry followed
+    // by the line tags). Setting fails if the geometry differs from the cache's.
+    inline int get_state_size (void) { return (LM32_CACHE_STATE_HDR_WORDS + sets + 2*ways*sets) * sizeof(uint32_t); };
+    void get_state            (uint32_t* buf);
+    bool set_state            (const uint32_t* buf, const int bytes);
     
 
 private:
@@ -34,6 +34,16 @@
 #include <cstdio>
 #include <cstring>
 
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#else
+#include <Windows.h>
+#endif
+
 #include "lm32_cpu.h"
 #include "lm32_cpu_mico32.h"
 
@@ -91,8 +101,23 @@ lm32_cpu::lm32_cpu (const int verbose_in,
     p_dcache_cfg(p_dcache_cfg_in),
     disassemble_start(disassemble_start_in)
 {
+    // Time construction for the startup profile, from now unless the caller sets an earlier origin
+    startup_stats       = false;
+    startup_phase       = LM32_STARTUP_NONE;
+    startup_first_usecs = -1.0;
+    startup_origin      = lm32_host_usecs();
+    startup_mark        = startup_origin;
+    for (int idx = 0; idx < LM32_STARTUP_NUM_PHASES; idx++)
+    {
+        startup_usecs[idx] = 0.0;
+    }
+    int prev_phase = lm32_enter_startup_phase(LM32_STARTUP_CONSTRUCT);
+
     icache_p = dcache_p = NULL;
 
+    huge_pages    = false;
+    mem_page_type = LM32_MEM_PAGES_NORMAL;
+
     disassemble_active = disassemble_start ? false : true;
 
     // Round up the count of byte to a word boundary
@@ -115,11 +140,95 @@ lm32_cpu::lm32_cpu (const int verbose_in,
         op_count[idx] = 0;
     }
 
+    // Allocate the dirty page bitmaps, with a bit for each page of internal memory
+    dirty_map_words = ((num_mem_bytes >> LM32_DIRTY_PAGE_BITS) + 64) / 64;
+    if ((dirty_map       = (uint64_t*)calloc(dirty_map_words, sizeof(uint64_t))) == NULL ||
+        (ckpt_dirty_map  = (uint64_t*)calloc(dirty_map_words, sizeof(uint64_t))) == NULL ||
+        (prior_dirty_map = (uint64_t*)calloc(dirty_map_words, sizeof(uint64_t))) == NULL ||
+        (rp_dirty_map    = (uint64_t*)calloc(dirty_map_words, sizeof(uint64_t))) == NULL ||
+        (snap_dirty_map  = (uint64_t*)calloc(dirty_map_words, sizeof(uint64_t))) == NULL)
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    // No periodic checkpoints until user configures
+    ckpt_interval_instr = 0;
+    ckpt_interval_secs  = 0;
+    ckpt_next_instr     = ~0ULL;
+    ckpt_due_instr      = 0;
+    ckpt_due_time       = 0;
+    ckpt_num            = 0;
+    ckpt_base_num       = -1;
+    ckpt_prev_base_num  = -1;
+    snap_pid            = 0;
+    snap_is_ckpt        = false;
+    clone_pids          = NULL;
+    num_clones          = 0;
+    replay_fp           = NULL;
+    replay_mode         = LM32_REPLAY_OFF;
+    replay_time         = 0;
+    replay_int_delta    = 0;
+    replay_diverged     = 0;
+    replay_next_valid   = false;
+    cov_map             = NULL;
+    cov_prev_loc        = 0;
+    rp_mem              = NULL;
+    snap_base           = NULL;
+    num_syms            = 0;
+    sym_addr            = NULL;
+    sym_size            = NULL;
+    sym_name            = NULL;
+    sym_by_name         = NULL;
+    sym_strings         = NULL;
+    line_elf_fname      = NULL;
+    line_cache_dir      = NULL;
+    line_table_built    = false;
+    line_image          = NULL;
+    line_image_len      = 0;
+    line_image_mapped   = false;
+    num_lines           = 0;
+    num_line_files      = 0;
+    line_addr           = NULL;
+    line_num            = NULL;
+    line_file           = NULL;
+    line_file_name      = NULL;
+    line_strings        = NULL;
+    prof_interval       = 0;
+    prof_next_cycle     = LM32_PROF_NEVER;
+    prof_table          = NULL;
+    prof_num_samples    = 0;
+    host_prof_usecs        = 0;
+    host_prof_ra           = false;
+    host_prof_table        = NULL;
+    host_prof_num_samples  = 0;
+    host_prof_dropped_base = 0;
+    cg_stack            = NULL;
+    cg_depth            = 0;
+    cg_fns              = NULL;
+    cg_fn_hash          = NULL;
+    cg_num_fns          = 0;
+    cg_max_fns          = 0;
+    cg_edges            = NULL;
+    cg_edge_hash        = NULL;
+    cg_num_edges        = 0;
+    cg_max_edges        = 0;
+
+    // No memory latency map regions until user configures
+    num_mem_regions     = 0;
+    last_mem_region     = 0;
+    mem_regions_overlap = false;
+    memset(mem_region_stats, 0, sizeof(mem_region_stats));
+
     // No callback until user configures
     pIntCallback        = NULL;
-    pMemCallback        = NULL;
     pJtagCallback       = NULL;
 
+    num_mem_callbacks       = 0;
+    mem_callback_types      = 0;
+    mem_callback_start_addr = LM32_MEM_CB_END_ADDR;
+    mem_callback_end_addr   = LM32_MEM_CB_START_ADDR;
+
     // Start with wakeup time always in the past
     state.wakeup_time_ext_int = 0;
 
@@ -219,6 +328,7 @@ lm32_cpu::lm32_cpu (const int verbose_in,
     tbl_p[idx++] = &lm32_cpu::lm32_calli;
     tbl_p[idx++] = &lm32_cpu::lm32_cmpne;
 
+    lm32_leave_startup_phase(prev_phase);
 }
 
 // -------------------------------------------------------------------------
@@ -233,6 +343,8 @@ void lm32_cpu::lm32_set_configuration(const uint32_t word)
     // Only allow updates to valid and supported fields
     state.cfg = word & LM32_CONFIG_WRITE_MASK;
 
+    int prev_phase = lm32_enter_startup_phase(LM32_STARTUP_CACHE_ALLOC);
+
     // If configured an ICACHE, and none exists, create one now
     if ((state.cfg & (1 << LM32_CFG_IC)) && icache_p == NULL)
     {
@@ -282,6 +394,8 @@ void lm32_cpu::lm32_set_configuration(const uint32_t word)
         delete dcache_p;
         dcache_p = NULL;
     }
+
+    lm32_leave_startup_phase(prev_phase);
 }
 
 // -------------------------------------------------------------------------
@@ -435,12 +549,13 @@ uint32_t lm32_cpu::lm32_read_mem (const uint32_t byte_addr_raw, const int type)
 #endif
 
 #ifndef LM32_FAST_COMPILE
-    uint32_t byte_addr = paddr % num_mem_bytes;
+    // Offset into internal memory (only valid once the address is checked to be within it)
+    uint32_t byte_addr = paddr - mem_offset;
 
     // Allocate some space for the memory tag as well, initialised to 0
     if (mem_tag == NULL)
     {
-        if ((mem_tag = (uint8_t *)calloc(num_mem_bytes/sizeof(uint8_t), sizeof(uint8_t))) == NULL)
+        if ((mem_tag = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
         {
             fprintf(stderr, "***ERROR: memory allocation failure\n");                    //LCOV_EXCL_LINE
             exit(LM32_INTERNAL_ERROR);                                                   //LCOV_EXCL_LINE
@@ -494,16 +609,16 @@ uint32_t lm32_cpu::lm32_read_mem (const uint32_t byte_addr_raw, const int type)
 #endif
 
 
-    // If there's a memory access callback function, call it and flag if it's
-    // intercepted the access
-    if (pMemCallback != NULL
+    // If there's a memory access callback registered for this address and access
+    // type, call it and flag if it's intercepted the access
+    if (mem_callback_match(paddr, type)
 #ifdef LM32_FAST_COMPILE
         && !(paddr >= mem_offset && paddr < (mem_offset + num_mem_bytes))
 #endif
         )
     {
         // Execute callback function
-        mem_callback_delay = pMemCallback(paddr, &data, type, cache_hit, state.cycle_count);
+        mem_callback_delay = call_mem_callbacks(paddr, &data, type, cache_hit);
 
         // TODO: lnxmico32 hangs after boot if state.cycle_count incremented by any amount on callback read.
         // (Seems okay for writes.) Don't yet know why.
@@ -514,7 +629,17 @@ uint32_t lm32_cpu::lm32_read_mem (const uint32_t byte_addr_raw, const int type)
             // Cycle count is incremented by returned amount when not cached, or returned amount scaled for
             // the number of words to update a cache line if cached and a miss. When a cache hit, no wait
             // states are added
-            state.cycle_count += (!cache_hit) ? (lm32_time_t)mem_callback_delay * (cache_access ? cache_words_per_line : 1) : 0;
+            if (!cache_hit)
+            {
+                lm32_time_t cycles = (lm32_time_t)mem_callback_delay * (cache_access ? cache_words_per_line : 1);
+
+                state.cycle_count += cycles;
+
+                if (num_mem_regions)
+                {
+                    update_mem_region_stats(LM32_MEM_REGION_EXTERNAL, type, cache_access ? cache_words_per_line : 1, cycles);
+                }
+            }
         }
 #endif
     }
@@ -526,13 +651,15 @@ uint32_t lm32_cpu::lm32_read_mem (const uint32_t byte_addr_raw, const int type)
     if (mem_callback_delay == LM32_EXT_MEM_NOT_PROCESSED)
     {
 
-        // Cycle count is incremented by memory wait states when not cached, or wait states scaled for
-        // the number of words to update a cache line if cached and a miss. When a cache hit, no wait
-        // states are added
-        state.cycle_count += (!cache_hit) ? mem_wait_states * (cache_access ? cache_words_per_line : 1) : 0;
+        // Cycle count is incremented by memory wait states when not cached, or the wait states for
+        // updating a cache line if cached and a miss. When a cache hit, no wait states are added
+        if (!cache_hit)
+        {
+            state.cycle_count += mem_access_cycles(paddr, type, cache_access ? cache_words_per_line : 1);
+        }
 
         // Check input is a valid address
-        if (paddr > (num_mem_bytes + mem_offset) || (paddr < mem_offset)) 
+        if (paddr >= (num_mem_bytes + mem_offset) || (paddr < mem_offset)) 
         {
             // Flag as a bus error only if this is not a debug access, as debugger may try
             // an inspect non-valid addresses.
@@ -661,12 +788,13 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
 #endif
 
 #ifndef LM32_FAST_COMPILE
-    uint32_t byte_addr = paddr % num_mem_bytes;
+    // Offset into internal memory (only valid once the address is checked to be within it)
+    uint32_t byte_addr = paddr - mem_offset;
 
     // Allocate some space for the memory tag as well, initialised to 0
     if (mem_tag == NULL)
     {
-        if ((mem_tag = (uint8_t *)calloc(num_mem_bytes/sizeof(uint8_t), sizeof(uint8_t))) == NULL)
+        if ((mem_tag = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
         {
             fprintf(stderr, "***ERROR: memory allocation failure\n");                    //LCOV_EXCL_LINE
             exit(LM32_INTERNAL_ERROR);                                                   //LCOV_EXCL_LINE
@@ -678,12 +806,12 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
     uint32_t byte_addr = paddr & num_mem_bytes_mask;
 #endif
 
-    // If there's a memory access callback function, and not accessing internal memory,
-    // call it and flag if it intercepted the access
-    if (pMemCallback != NULL)
+    // If there's a memory access callback registered for this address and access
+    // type, call it and flag if it intercepted the access
+    if (mem_callback_match(paddr, type))
     {
         // Execute callback function
-        mem_callback_delay = pMemCallback(paddr, &word, type, LM32_CACHE_MISS, state.cycle_count);
+        mem_callback_delay = call_mem_callbacks(paddr, &word, type, LM32_CACHE_MISS);
 
         // Advance time by the returned amount, if intercepted, and flag no local access
         if (mem_callback_delay != LM32_EXT_MEM_NOT_PROCESSED) 
@@ -694,6 +822,11 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
             if (!disable_cycle_count)
             {
                 state.cycle_count += (lm32_time_t)mem_callback_delay;
+
+                if (num_mem_regions)
+                {
+                    update_mem_region_stats(LM32_MEM_REGION_EXTERNAL, type, 1, (lm32_time_t)mem_callback_delay);
+                }
             }
 #endif
         }
@@ -705,11 +838,11 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
         // Add wait states for internal memory accesses
         if (!disable_cycle_count)
         {
-            state.cycle_count += mem_wait_states;
+            state.cycle_count += mem_access_cycles(paddr, type, 1);
         }
 
         // Check input is a valid address
-        if ((paddr  > (num_mem_bytes + mem_offset)) || (paddr  < mem_offset))
+        if ((paddr  >= (num_mem_bytes + mem_offset)) || (paddr  < mem_offset))
         {
             state.int_flags |= (1 << INT_ID_DBUSERROR);
             return;
@@ -764,6 +897,9 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
             exit(LM32_USER_ERROR);                                                      //LCOV_EXCL_LINE
             break;
         }
+
+        // Only a write that completed (not faulting) dirties its page
+        mark_page_dirty(byte_addr);
     }
 
 #ifndef LM32_FAST_COMPILE
@@ -782,245 +918,1234 @@ void lm32_cpu::lm32_write_mem(const uint32_t byte_addr_raw, const uint32_t data,
 #endif
 }
 
+#ifndef LM32_FAST_COMPILE
 // -------------------------------------------------------------------------
-//  load_mem()
-// 
-//  load memory with program code/data words. For use mainly by read_elf().
-// 
+// mem_access_cycles()
+//
+// Returns the number of wait states for an internal memory access of
+// num_words words (more than one for a cache line fill), from the memory
+// latency map region containing the address, or mem_wait_states for
+// each word if no region matches. The access is added to the region's
+// statistics, when a map is configured.
+//
 // -------------------------------------------------------------------------
 
-void lm32_cpu::load_mem_word (const uint32_t byte_addr, const uint32_t word, const uint32_t flags)
+lm32_time_t lm32_cpu::mem_access_cycles (const uint32_t addr, const int type, const int num_words)
 {
+    int                    region = last_mem_region;
+    lm32_mem_region_cfg_t* p      = &mem_regions[region];
+    lm32_time_t            cycles;
 
-    lm32_write_mem(byte_addr, word, (flags & PF_X) ? LM32_MEM_WR_ACCESS_INSTR : LM32_MEM_WR_ACCESS_WORD);
-}
+    // With no map configured, there are no regions or statistics to update
+    if (num_mem_regions == 0)
+    {
+        return (lm32_time_t)mem_wait_states * num_words;
+    }
 
-// -------------------------------------------------------------------------
-// lm32_register_int_callback()
-//
-// Routine for registering user functions as callbacks for generating 
-// external interrupts.
-//
-// -------------------------------------------------------------------------
+    // Check the last matched region first (if regions can't overlap, so that no earlier
+    // region could take precedence), else search all the regions in order
+    if (mem_regions_overlap || region >= num_mem_regions || addr < p->base_addr || addr > p->limit)
+    {
+        for (region = 0, p = mem_regions; region < num_mem_regions; region++, p++)
+        {
+            if (addr >= p->base_addr && addr <= p->limit)
+            {
+                last_mem_region = region;
+                break;
+            }
+        }
+    }
 
-void lm32_cpu::lm32_register_int_callback (p_lm32_intcallback_t callback_func)
-{
-    pIntCallback = callback_func;
+    if (region >= num_mem_regions)
+    {
+        cycles = (lm32_time_t)mem_wait_states * num_words;
+        update_mem_region_stats(LM32_MEM_REGION_DEFAULT, type, num_words, cycles);
+        return cycles;
+    }
+
+    // First word takes the read or write latency, and any subsequent words of a line fill the burst latency
+    cycles = (type & LM32_MEM_RNW_MASK) ? p->rd_wait_states : p->wr_wait_states;
+    cycles += (lm32_time_t)p->burst_wait_states * (num_words - 1);
+
+    // For SDRAM-like regions, add the page miss cost if not accessing the open page
+    if (p->page_bytes)
+    {
+        uint32_t page = (addr - p->base_addr) / p->page_bytes;
+
+        if (page != mem_region_open_page[region])
+        {
+            mem_region_open_page[region] = page;
+            mem_region_stats[region].page_misses++;
+            cycles += p->page_miss_wait_states;
+        }
+    }
+
+    update_mem_region_stats(region, type, num_words, cycles);
+
+    return cycles;
 }
 
 // -------------------------------------------------------------------------
-// lm32_register_ext_mem_callback()
+// update_mem_region_stats()
 //
-// Routine for registering user function as callback for accesses to
-// external memory.
+// Accumulate an access's statistics for the specified memory region
 //
 // -------------------------------------------------------------------------
 
-void lm32_cpu::lm32_register_ext_mem_callback (p_lm32_memcallback_t callback_func)
+void lm32_cpu::update_mem_region_stats (const int region, const int type, const int num_words, const lm32_time_t cycles)
 {
-    pMemCallback = callback_func;
+    lm32_mem_region_stats_t* p = &mem_region_stats[region];
+
+    if (type & LM32_MEM_RNW_MASK)
+    {
+        p->reads++;
+    }
+    else
+    {
+        p->writes++;
+    }
+
+    if (num_words > 1)
+    {
+        p->line_fills++;
+    }
+
+    p->wait_cycles += cycles;
 }
 
 // -------------------------------------------------------------------------
-// lm32_register_jtag_callback()
+// lm32_set_mem_regions()
 //
-// Routine for registering user function as callback for accesses to
-// JTAG interface.
+// Configure the memory latency map from an array of region configurations,
+// replacing any previous map and clearing the statistics. Where regions
+// overlap, the first in the array takes precedence.
 //
 // -------------------------------------------------------------------------
 
-void lm32_cpu::lm32_register_jtag_callback (p_lm32_jtagcallback_t callback_func)
+void lm32_cpu::lm32_set_mem_regions (const lm32_mem_region_cfg_t* p_regions, const int num_regions)
 {
-    state.cfg |= (1 << LM32_CFG_J);
-    pJtagCallback = callback_func;
+    if (num_regions < 0 || num_regions > LM32_MAX_MEM_REGIONS)
+    {
+        fprintf(stderr, "***ERROR: invalid number of memory regions (%d)\n", num_regions); //LCOV_EXCL_LINE
+        exit(LM32_USER_ERROR);                                                            //LCOV_EXCL_LINE
+    }
+
+    for (int idx = 0; idx < num_regions; idx++)
+    {
+        mem_regions[idx]          = p_regions[idx];
+        mem_region_open_page[idx] = LM32_MEM_REGION_NO_PAGE;
+    }
+
+    num_mem_regions     = num_regions;
+    last_mem_region     = 0;
+    mem_regions_overlap = false;
+
+    for (int idx = 0; idx < num_regions; idx++)
+    {
+        for (int jdx = idx + 1; jdx < num_regions; jdx++)
+        {
+            if (mem_regions[idx].base_addr <= mem_regions[jdx].limit && mem_regions[jdx].base_addr <= mem_regions[idx].limit)
+            {
+                mem_regions_overlap = true;
+            }
+        }
+    }
+
+    memset(mem_region_stats, 0, sizeof(mem_region_stats));
 }
 
 // -------------------------------------------------------------------------
-// internal_reset_cpu()
-// 
-// Reset the state of the CPU as at power-up, or reset pin asserted.
+// lm32_dump_mem_region_stats()
+//
+// Dump the accumulated memory latency map statistics for each configured
+// region, for internal memory outside of the regions, and for accesses
+// processed by an external memory callback.
 //
 // -------------------------------------------------------------------------
 
-void lm32_cpu::internal_reset_cpu()
+void lm32_cpu::lm32_dump_mem_region_stats (void)
 {
-    state.pc   = entry_point_addr;
-    state.ie   = 0;
-    state.im   = 0;
-    state.ip   = 0;
-    state.icc  = 0;
-    state.dcc  = 0;
-    state.cfg  = LM32_DEFAULT_CONFIG;
-    state.eba  = LM32_EBA_RESET;
-    state.cfg2 = 0;
-
-    // Do the debug registers get reset?
-    state.dc   = 0;
-    state.deba = LM32_DEBA_RESET;
-    state.jtx  = 0;
-    state.jrx  = 0;
-    state.bp0  = 0;
-    state.bp1  = 0;
-    state.bp2  = 0;
-    state.bp3  = 0;
-    state.wp0  = 0;
-    state.wp1  = 0;
-    state.wp2  = 0;
-    state.wp3  = 0;
-
-#ifdef LM32_MMU
-    state.psw         = 0;
-    state.tlbvaddr    = 0;
-    state.tlbbadvaddr = 0;
+    lm32_time_t total = 0;
 
-    memset(dtlb.valid, 0, sizeof(dtlb.valid));
-    memset(itlb.valid, 0, sizeof(itlb.valid));
-#endif
+    fprintf(ofp, "\n%-25s%12s %12s %12s %12s %12s\n", "REGION", "READS", "WRITES", "LINE FILLS", "PAGE MISSES", "WAIT CYCLES");
 
-    // Reset the frame and stack pointers to top of configured internal
-    // memory (will be 0 if no internal memory). This is not really done
-    // at reset, but is useful to forgo a start up routine. Will get 
-    // overwritten in any case if a real startup is executed at reset (when r 
-    // registers have undefined state anyway).
-    state.r[SP_REG_IDX] = mem_offset + num_mem_bytes - 4;
-    state.r[FP_REG_IDX] = mem_offset + num_mem_bytes - 4;
-    state.r[R0_REG_IDX] = 0;
+    for (int idx = 0; idx < LM32_NUM_MEM_REGION_STATS; idx++)
+    {
+        lm32_mem_region_stats_t* p = &mem_region_stats[idx];
 
-    // Model state
-    break_point    = 0;
+        if (idx < LM32_MAX_MEM_REGIONS)
+        {
+            if (idx >= num_mem_regions)
+            {
+                continue;
+            }
+            fprintf(ofp, "%d 0x%08x-0x%08x  ", idx, mem_regions[idx].base_addr, mem_regions[idx].limit);
+        }
+        else
+        {
+            fprintf(ofp, "%-24s ", (idx == LM32_MEM_REGION_DEFAULT) ? "internal (default)" : "external (callback)");
+        }
 
-    // The cc register will be reset to 0, but state.cycle_count is
-    // not cleared. So cc_adjust is set to -cycle_count, so that
-    // reads of the cc register start from 0 after reset.
-    cc_adjust      = -1 * state.cycle_count;
+        fprintf(ofp, "%12llu %12llu %12llu %12llu %12lld\n", (unsigned long long)p->reads, (unsigned long long)p->writes,
+                                                          (unsigned long long)p->line_fills, (unsigned long long)p->page_misses,
+                                                          (long long)p->wait_cycles);
+        total += p->wait_cycles;
+    }
 
-    // Flag to invalidate the caches (if any)
-    dcc_invalidate = true;
-    icc_invalidate = true;
+    fprintf(ofp, "Total memory wait cycles = %lld (of %lld cycles)\n", (long long)total, (long long)state.cycle_count);
 }
 
 // -------------------------------------------------------------------------
-// interrupt()
+// lm32_get_mem_region_stats()
 //
-// Handle exceptions, not handled by instructions directly (such as break).
-// Used mainly for external exceptions generated by interrupt callback.
+// Return the accumulated memory latency map statistics for a region (0 to
+// LM32_MAX_MEM_REGIONS-1), or for LM32_MEM_REGION_DEFAULT or
+// LM32_MEM_REGION_EXTERNAL.
 //
 // -------------------------------------------------------------------------
 
-void lm32_cpu::interrupt (const int interrupt_id)
+lm32_mem_region_stats_t lm32_cpu::lm32_get_mem_region_stats (const int region)
 {
-    switch(interrupt_id)
+    if (region < 0 || region >= LM32_NUM_MEM_REGION_STATS)
     {
-    case INT_ID_RESET:
-        internal_reset_cpu();
-    case INT_ID_IBUSERROR:
-    case INT_ID_DBUSERROR:
-    case INT_ID_DIVZERO:
-    case INT_ID_SYSCALL:
-    case INT_ID_EXTINT:
-#ifdef LM32_MMU
-    case INT_ID_ITLB_MISS:
-    case INT_ID_DTLB_MISS: 
-    case INT_ID_DTLB_FAULT: 
-        if (interrupt_id >= INT_ID_ITLB_MISS)
-        {
-	    state.pc -= 4;
-        }
-    case INT_ID_PRIV_ACCESS:
-        state.psw = (state.psw & ~(IE_EITLBE_MASK)) | ((state.psw & IE_ITLBE_MASK) ? IE_EITLBE_MASK : 0);
-        state.psw = (state.psw & ~(IE_EDTLBE_MASK)) | ((state.psw & IE_DTLBE_MASK) ? IE_EDTLBE_MASK : 0);
-        state.psw = (state.psw & ~(IE_EUSR_MASK))   | ((state.psw & IE_USR_MASK)   ? IE_EUSR_MASK   : 0);
-#endif
-        state.r[EA_REG_IDX] = state.pc;
-        state.ie  = (state.ie & ~IE_EIE_MASK) | ((state.ie & IE_IE_MASK) ? IE_EIE_MASK : 0);
-        state.pc = ((state.dc & DEBUG_REMAP_ALL) ? state.deba : state.eba) + (interrupt_id << 5);
-        break;
+        fprintf(stderr, "***ERROR: invalid memory region (%d)\n", region);                 //LCOV_EXCL_LINE
+        exit(LM32_USER_ERROR);                                                            //LCOV_EXCL_LINE
+    }
 
-    case INT_ID_BREAKPOINT:
-    case INT_ID_WATCHPOINT:
-        state.r[BA_REG_IDX] = state.pc;
-        state.ie = (state.ie & ~IE_BIE_MASK) | ((state.ie & IE_IE_MASK) ? IE_BIE_MASK : 0);
-#ifdef LM32_MMU
-        state.psw = (state.psw & ~(IE_BITLBE_MASK)) | ((state.psw & IE_ITLBE_MASK) ? IE_BITLBE_MASK : 0);
-        state.psw = (state.psw & ~(IE_BDTLBE_MASK)) | ((state.psw & IE_DTLBE_MASK) ? IE_BDTLBE_MASK : 0);
-        state.psw = (state.psw & ~(IE_BUSR_MASK))   | ((state.psw & IE_USR_MASK)   ? IE_BUSR_MASK   : 0);
+    return mem_region_stats[region];
+}
 #endif
-        state.pc = state.deba + (interrupt_id << 5);
-        break;
-
-    default:
-        fprintf(stderr, "***ERROR: invalid exception ID (%d)\n", interrupt_id);                 //LCOV_EXCL_LINE
-        exit(LM32_INTERNAL_ERROR);                                                              //LCOV_EXCL_LINE
-        break;
-    }
 
-    // Clear the master interrupt enable
-    state.ie &= ~IE_IE_MASK;
+// -------------------------------------------------------------------------
+// lm32_alloc_mem()
+//
+// Allocation of internal memory (and its tags), timed for the startup
+// profile
+//
+// -------------------------------------------------------------------------
 
-#ifdef LM32_MMU
-    state.psw &= ~(IE_ITLBE_MASK | IE_DTLBE_MASK | IE_USR_MASK);
-#endif
+void* lm32_cpu::lm32_alloc_mem (const int nbytes)
+{
+    int   prev_phase = lm32_enter_startup_phase(LM32_STARTUP_MEM_ALLOC);
+    void* p          = alloc_mem_pages(nbytes);
 
-    // Clear the flag the caused the interrupt
-    state.int_flags &= ~(1ULL << interrupt_id);
+    lm32_leave_startup_phase(prev_phase);
 
+    return p;
 }
 
 // -------------------------------------------------------------------------
-// process_exceptions()
+// alloc_mem_pages()
 //
-// Called once per instruction to monitor for exceptions
+// Page aligned memory is allocated directly from the OS. This is zero
+// filled on first touch (so any BSS section is initialised without the
+// need for CRT0 startup code, without an up front cost), and allows file
+// images to be mapped over it (see lm32_map_file_to_mem()).
+//
+// If huge pages are selected, explicit huge pages (MAP_HUGETLB) are tried
+// first, and then a huge page aligned region advised as suitable for
+// transparent huge pages, falling back to normal pages if neither is
+// available. Note that images can't be mapped over explicit huge pages.
 //
 // -------------------------------------------------------------------------
 
-bool lm32_cpu::process_exceptions() 
+void* lm32_cpu::alloc_mem_pages (const int nbytes)
 {
-    int int_id;
+#if !(defined _WIN32) && !(defined _WIN64)
+    void* p;
 
-    // If there's a callback function registered, and we're at or beyond the
-    // wakeup time, call the function and handle external interrupt state
-    if (pIntCallback != NULL)
+    if (huge_pages)
     {
-        if (state.cycle_count >= state.wakeup_time_ext_int)
+        size_t huge_bytes = ((size_t)nbytes + LM32_HUGE_PAGE_SIZE - 1) & ~(size_t)(LM32_HUGE_PAGE_SIZE - 1);
+
+# ifdef MAP_HUGETLB
+        if ((p = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)) != MAP_FAILED)
         {
-            // Get interrupts from callback function, up to the maximum supported. Any
-            // interrupt outside supported number is ignored.
-            state.ip |= ((1ULL << ((state.cfg >> LM32_CFG_INT) & LM32_CFG_INT_MASK))-1) & pIntCallback(state.cycle_count, &state.wakeup_time_ext_int);
+            mem_page_type = (mem == NULL) ? LM32_MEM_PAGES_HUGETLB : mem_page_type;
+            return p;
+        }
+# endif
+# ifdef MADV_HUGEPAGE
+        // Over-allocate so that a huge page aligned region can be trimmed from it
+        uint8_t* p_raw;
+        if ((p_raw = (uint8_t*)mmap(NULL, huge_bytes + LM32_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED)
+        {
+            uint8_t* p_aligned = (uint8_t*)(((uintptr_t)p_raw + LM32_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(LM32_HUGE_PAGE_SIZE - 1));
 
-            // If the callback function returns a negative wakeup value, it is requesting
-            // termination. Return immediately with a 'true' status.
-            if (state.wakeup_time_ext_int < 0)
+            if (p_aligned != p_raw)
             {
-                return true;                                                                    //LCOV_EXCL_LINE
+                munmap(p_raw, p_aligned - p_raw);
             }
+            munmap(p_aligned + huge_bytes, (p_raw + LM32_HUGE_PAGE_SIZE) - p_aligned);
 
-            // If not masked, flag any external interrupt
-            state.int_flags = (state.int_flags & ~(1 << INT_ID_EXTINT)) | (((state.ie & IE_IE_MASK) && (state.ip & state.im)) ? (1 << INT_ID_EXTINT) : 0);
-        }
-    }
-
-    // If interrupts enabled, and anyone is interrupting, call the interrupt function
-    if (state.int_flags)
-    {
-        // Find the highest priority interrupt
-        for (int_id = 0; int_id < INT_ID_NUM; int_id++) 
-        {
-            // If the bit is set in state.int_flags, highest priority found,
-            // so break out of loop
-            if ((1 << int_id) & state.int_flags)
+            if (madvise(p_aligned, huge_bytes, MADV_HUGEPAGE) == 0)
             {
-                break;
+                mem_page_type = (mem == NULL) ? LM32_MEM_PAGES_TRANSPARENT : mem_page_type;
             }
+            return p_aligned;
         }
-
-        // Call interrupt with highest priority ID
-        interrupt(int_id);
+# endif
     }
-    return false;
+
+    p = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+#else
+    // Committed pages are zero filled on first touch, as for mmap(), rather than up front
+    return VirtualAlloc(NULL, nbytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#endif
 }
 
 // -------------------------------------------------------------------------
-// lm32_reset_cpu()
+// lm32_set_huge_pages()
+//
+// Select whether internal memory is allocated with huge pages, where
+// available. Only has an effect if called before memory is allocated
+// (i.e. before the first memory access).
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_set_huge_pages (const bool enable)
+{
+    huge_pages = enable;
+}
+
+// -------------------------------------------------------------------------
+// lm32_host_usecs()
+//
+// Returns the host time in microseconds, for timing startup phases
+//
+// -------------------------------------------------------------------------
+
+double lm32_cpu::lm32_host_usecs (void)
+{
+#if (!(defined _WIN32) && !(defined _WIN64)) || defined __CYGWIN__
+    struct timeval tv;
+
+    (void)gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec*1e6 + (double)tv.tv_usec;
+#else
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart*1e6/(double)frequency.QuadPart;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_enter_startup_phase()
+//
+// Start timing a startup phase, pausing the timing of any phase it's
+// nested within (so that phases are timed exclusively). Returns the
+// paused phase, to pass to lm32_leave_startup_phase(). Does nothing once
+// the first instruction has been reached.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_enter_startup_phase (const int phase)
+{
+    if (startup_first_usecs >= 0.0)
+    {
+        return LM32_STARTUP_NONE;
+    }
+
+    double now        = lm32_host_usecs();
+    int    prev_phase = startup_phase;
+
+    if (startup_phase != LM32_STARTUP_NONE)
+    {
+        startup_usecs[startup_phase] += now - startup_mark;
+    }
+
+    startup_phase = phase;
+    startup_mark  = now;
+
+    return prev_phase;
+}
+
+// -------------------------------------------------------------------------
+// lm32_leave_startup_phase()
+//
+// Stop timing the current startup phase, and resume timing of the phase
+// paused by the matching lm32_enter_startup_phase()
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_leave_startup_phase (const int prev_phase)
+{
+    if (startup_first_usecs >= 0.0)
+    {
+        return;
+    }
+
+    double now = lm32_host_usecs();
+
+    if (startup_phase != LM32_STARTUP_NONE)
+    {
+        startup_usecs[startup_phase] += now - startup_mark;
+    }
+
+    startup_phase = prev_phase;
+    startup_mark  = now;
+}
+
+// -------------------------------------------------------------------------
+// startup_complete()
+//
+// Note that the first instruction has been reached, ending the startup
+// profile, and output it if enabled
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::startup_complete (void)
+{
+    startup_first_usecs = lm32_host_usecs() - startup_origin;
+
+    if (startup_stats)
+    {
+        lm32_dump_startup_stats(ofp);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_startup_origin()
+//
+// Set the host time (from lm32_host_usecs()) from which the startup
+// profile is measured, such as at the start of the program, before
+// construction
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_set_startup_origin (const double usecs)
+{
+    startup_origin = usecs;
+}
+
+// -------------------------------------------------------------------------
+// lm32_add_startup_usecs()
+//
+// Add time spent by the caller in a startup phase (such as processing the
+// configuration) to the startup profile
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_add_startup_usecs (const int phase, const double usecs)
+{
+    if (phase >= 0 && phase < LM32_STARTUP_NUM_PHASES)
+    {
+        startup_usecs[phase] += usecs;
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_dump_startup_stats()
+//
+// Output the startup profile, with the time of each phase, any time not
+// accounted for by the phases, and the time at which the first
+// instruction was reached (if it has been)
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_dump_startup_stats (FILE* fp)
+{
+    static const char* phase_names[LM32_STARTUP_NUM_PHASES] = {"Configuration", "Construction", "Memory allocation", "Cache allocation", "Loading"};
+
+    double total = 0.0;
+
+    fprintf(fp, "Startup profile (host ms):\n");
+
+    for (int idx = 0; idx < LM32_STARTUP_NUM_PHASES; idx++)
+    {
+        fprintf(fp, "  %-20s %9.3f\n", phase_names[idx], startup_usecs[idx]/1000.0);
+        total += startup_usecs[idx];
+    }
+
+    if (startup_first_usecs >= 0.0)
+    {
+        fprintf(fp, "  %-20s %9.3f\n", "Other", (startup_first_usecs > total ? startup_first_usecs - total : 0.0)/1000.0);
+        fprintf(fp, "  %-20s %9.3f\n", "First instruction", startup_first_usecs/1000.0);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_get_next_dirty_page()
+//
+// Finds the first dirty page of internal memory at or after the address
+// pointed to by p_byte_addr. If found, the page's address is returned
+// in *p_byte_addr, and true is returned, else false is returned. The
+// bitmap is scanned a word at a time, skipping clean runs of pages.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_get_next_dirty_page (uint32_t* p_byte_addr)
+{
+    if (*p_byte_addr < mem_offset)
+    {
+        *p_byte_addr = mem_offset;
+    }
+
+    uint32_t offset = *p_byte_addr - mem_offset;
+
+    if (offset >= num_mem_bytes)
+    {
+        return false;
+    }
+
+    uint32_t page = offset >> LM32_DIRTY_PAGE_BITS;
+    uint32_t wdx  = page >> 6;
+
+    // Mask off pages in the first word that are below the start page
+    uint64_t bits = dirty_map_word(wdx) & (~0ULL << (page & 63));
+
+    while (bits == 0)
+    {
+        if (++wdx >= dirty_map_words)
+        {
+            return false;
+        }
+        bits = dirty_map_word(wdx);
+    }
+
+    // Find the lowest set bit
+    int bdx = 0;
+    while (!((bits >> bdx) & 1))
+    {
+        bdx++;
+    }
+
+    offset = ((wdx << 6) + bdx) << LM32_DIRTY_PAGE_BITS;
+
+    if (offset >= num_mem_bytes)
+    {
+        return false;
+    }
+
+    *p_byte_addr = mem_offset + offset;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_dirty_pages()
+//
+// Marks all pages of internal memory as clean. Any restore point still
+// copies back the pages written since it was set.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_dirty_pages (void)
+{
+    fold_dirty_map();
+
+    memset(ckpt_dirty_map,  0, dirty_map_words * sizeof(uint64_t));
+    memset(prior_dirty_map, 0, dirty_map_words * sizeof(uint64_t));
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_coverage()
+//
+// Enable or disable collection of control flow edge coverage. When enabled,
+// returns the coverage map (allocated on the first call), or NULL if it
+// couldn't be allocated. Returns NULL when disabled, and in fast builds,
+// which don't collect coverage.
+//
+// -------------------------------------------------------------------------
+
+uint8_t* lm32_cpu::lm32_set_coverage (const bool enable)
+{
+#ifdef LM32_FAST_COMPILE
+    if (enable)
+    {
+        return NULL;
+    }
+#endif
+
+    if (!enable)
+    {
+        free(cov_map);
+        cov_map = NULL;
+    }
+    else if (cov_map == NULL)
+    {
+        cov_map = (uint8_t*)calloc(LM32_COV_MAP_SIZE, sizeof(uint8_t));
+    }
+
+    cov_prev_loc = 0;
+
+    return cov_map;
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_coverage()
+//
+// Clears the edge coverage map's hit counts, with the next edge recorded
+// starting afresh.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_coverage (void)
+{
+    if (cov_map != NULL)
+    {
+        memset(cov_map, 0, LM32_COV_MAP_SIZE);
+    }
+
+    cov_prev_loc = 0;
+}
+
+// -------------------------------------------------------------------------
+// lm32_flip_mem_bit()
+//
+// Invert a bit of a byte in internal memory, for fault injection. Unlike
+// lm32_write_mem(), there is no effect on timing, caches or memory tags,
+// so that the fault disturbs nothing else. Returns false if the address
+// isn't in internal memory.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_flip_mem_bit (const uint32_t byte_addr, const int bit)
+{
+    if (mem == NULL || byte_addr < mem_offset || (byte_addr - mem_offset) >= num_mem_bytes)
+    {
+        return false;
+    }
+
+    uint32_t offset = byte_addr - mem_offset;
+
+    mark_page_dirty(offset);
+
+    mem[offset] ^= (uint8_t)(1 << (bit & 7));
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_map_file_to_mem()
+//
+// Maps a binary file image into internal memory at byte_addr, as a private
+// copy-on-write mapping. The file's pages are shared between all processes
+// mapping the same file (via the host's page cache), and only copied when
+// written to. The image is not copied up front, so this is much faster than
+// loading it byte by byte for large images. The address must be aligned to
+// a host page within internal memory, and the image must fit. Returns the
+// length of the image, or LM32_MAP_FAILED if the file could not be mapped,
+// in which case the caller should load the image by other means.
+//
+// Note that the file must not be modified whilst mapped, as any pages not
+// yet written by the model would reflect the change.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_map_file_to_mem (const char* fname, const uint32_t byte_addr)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    int         fd;
+    struct stat st;
+    uint32_t    offset    = byte_addr - mem_offset;
+    long        page_size = sysconf(_SC_PAGESIZE);
+
+    // Make sure we have some memory
+    if (mem == NULL) 
+    {
+         if ((mem = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+         {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+         }
+         mem16 = (uint16_t*)mem;
+         mem32 = (uint32_t*)mem;
+    }
+
+    // Both the internal memory and the offset into it must be page aligned
+    if (page_size <= 0 || byte_addr < mem_offset || offset >= num_mem_bytes ||
+        (((uintptr_t)mem | offset) & (page_size - 1)))
+    {
+        return LM32_MAP_FAILED;
+    }
+
+    if ((fd = open(fname, O_RDONLY)) < 0)
+    {
+        return LM32_MAP_FAILED;
+    }
+
+    // The image, rounded up to whole pages, must fit in internal memory
+    if (fstat(fd, &st) < 0 || st.st_size == 0 || (uint64_t)st.st_size > (uint64_t)(num_mem_bytes - offset))
+    {
+        close(fd);
+        return LM32_MAP_FAILED;
+    }
+
+    size_t map_len = ((size_t)st.st_size + page_size - 1) & ~(size_t)(page_size - 1);
+
+    if ((uint64_t)map_len > (uint64_t)(num_mem_bytes - offset) ||
+        mmap(&mem[offset], map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        close(fd);
+        return LM32_MAP_FAILED;
+    }
+
+    // The mapping remains valid after the file is closed
+    close(fd);
+
+    // Mark the image's pages as dirty, as for a load of the data
+    for (uint32_t pdx = offset; pdx < offset + (uint32_t)st.st_size; pdx += LM32_DIRTY_PAGE_SIZE)
+    {
+        mark_page_dirty(pdx);
+    }
+
+#ifndef LM32_FAST_COMPILE
+    // Allocate some space for the memory tag as well, initialised to 0
+    if (mem_tag == NULL)
+    {
+        if ((mem_tag = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+        {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                    //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                   //LCOV_EXCL_LINE
+        }
+    }
+
+    // Tag the image as loaded code, as for byte loads with cycle counting disabled
+    for (uint32_t idx = offset; idx < offset + (uint32_t)st.st_size; idx++)
+    {
+        mem_tag[idx] |= MEM_INSTRUCTION_WR;
+    }
+#endif
+
+    return (int)st.st_size;
+#else
+    return LM32_MAP_FAILED;
+#endif
+}
+
+// -------------------------------------------------------------------------
+//  load_mem()
+// 
+//  load memory with program code/data words. For use mainly by read_elf().
+// 
+// -------------------------------------------------------------------------
+
+void lm32_cpu::load_mem_word (const uint32_t byte_addr, const uint32_t word, const uint32_t flags)
+{
+
+    lm32_write_mem(byte_addr, word, (flags & PF_X) ? LM32_MEM_WR_ACCESS_INSTR : LM32_MEM_WR_ACCESS_WORD);
+}
+
+// -------------------------------------------------------------------------
+// bulk_mem_range()
+//
+// Check whether len bytes from byte_addr can be loaded directly into
+// internal memory, returning true, with the index into mem[] in *p_idx, if
+// the range is wholly within internal memory (not wrapping), no memory
+// callback for any of cb_types covers any part of it, and no data TLB is
+// translating. Memory is allocated if not already.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::bulk_mem_range (const uint32_t byte_addr, const uint32_t len, const uint32_t cb_types, uint32_t* p_idx)
+{
+    // Make sure we have some memory
+    if (mem == NULL) 
+    {
+         if ((mem = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+         {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+         }
+         mem16 = (uint16_t*)mem;
+         mem32 = (uint32_t*)mem;
+    }
+
+    *p_idx = byte_addr - mem_offset;
+
+#ifdef LM32_MMU
+    if (state.psw & IE_DTLBE_MASK)
+    {
+        return false;
+    }
+#endif
+
+    return len != 0 &&
+           byte_addr >= mem_offset && ((uint64_t)byte_addr + len) <= ((uint64_t)mem_offset + num_mem_bytes) &&
+           ((uint64_t)*p_idx + len) <= num_mem_bytes &&
+           !((mem_callback_types & cb_types) && byte_addr <= mem_callback_end_addr && (byte_addr + len - 1) >= mem_callback_start_addr);
+}
+
+// -------------------------------------------------------------------------
+// bulk_mem_loaded()
+//
+// Account for len bytes loaded directly into mem[] from idx, marking their
+// pages dirty and (when tags are kept) tagging them with tag.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::bulk_mem_loaded (const uint32_t idx, const uint32_t len, const uint8_t tag)
+{
+    for (uint32_t pdx = idx & ~(LM32_DIRTY_PAGE_SIZE - 1); pdx < idx + len; pdx += LM32_DIRTY_PAGE_SIZE)
+    {
+        mark_page_dirty(pdx);
+    }
+
+#ifndef LM32_FAST_COMPILE
+    // Allocate some space for the memory tag as well, initialised to 0
+    if (mem_tag == NULL)
+    {
+        if ((mem_tag = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+        {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                    //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                   //LCOV_EXCL_LINE
+        }
+    }
+
+    for (uint32_t tdx = idx; tdx < idx + len; tdx++)
+    {
+        mem_tag[tdx] |= tag;
+    }
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_load_buf_to_mem()
+//
+// Load len bytes from a host buffer to memory at byte_addr, with the same
+// effect as byte writes with cycle counting disabled (data tagged as
+// loaded code, pages marked dirty, and any memory callback called). Where
+// the whole range is in internal memory, and not intercepted, it is
+// copied in one go, rather than a byte at a time.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_load_buf_to_mem (const void* buf, const uint32_t len, const uint32_t byte_addr)
+{
+    const uint8_t* p_buf = (const uint8_t*)buf;
+    uint32_t       idx;
+
+    if (bulk_mem_range(byte_addr, len, LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_BYTE), &idx))
+    {
+        memcpy(&mem[idx], p_buf, len);
+        bulk_mem_loaded(idx, len, MEM_INSTRUCTION_WR);
+    }
+    else
+    {
+        for (uint32_t bdx = 0; bdx < len; bdx++)
+        {
+            lm32_write_mem(byte_addr + bdx, p_buf[bdx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_load_file_to_mem()
+//
+// Load a binary file image to memory at byte_addr, reading it in chunks of
+// LM32_LOAD_CHUNK_BYTES through lm32_load_buf_to_mem(). Returns the length
+// of the image, or LM32_LOAD_FAILED if the file can't be opened or read.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_load_file_to_mem (const char* fname, const uint32_t byte_addr)
+{
+    FILE*    fp;
+    uint8_t* buf;
+    uint32_t length = 0;
+    size_t   num;
+
+    if ((fp = fopen(fname, "rb")) == NULL)
+    {
+        return LM32_LOAD_FAILED;
+    }
+
+    if ((buf = (uint8_t*)malloc(LM32_LOAD_CHUNK_BYTES)) == NULL)
+    {
+        fclose(fp);                                                                     //LCOV_EXCL_LINE
+        return LM32_LOAD_FAILED;                                                        //LCOV_EXCL_LINE
+    }
+
+    while ((num = fread(buf, 1, LM32_LOAD_CHUNK_BYTES, fp)) > 0)
+    {
+        lm32_load_buf_to_mem(buf, (uint32_t)num, byte_addr + length);
+        length += (uint32_t)num;
+    }
+
+    bool read_error = ferror(fp) != 0;
+
+    free(buf);
+    fclose(fp);
+
+    return read_error ? LM32_LOAD_FAILED : (int)length;
+}
+
+// -------------------------------------------------------------------------
+// lm32_register_int_callback()
+//
+// Routine for registering user functions as callbacks for generating 
+// external interrupts.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_register_int_callback (p_lm32_intcallback_t callback_func)
+{
+    pIntCallback = callback_func;
+}
+
+// -------------------------------------------------------------------------
+// lm32_register_ext_mem_callback()
+//
+// Routine for registering user function as callback for accesses to
+// external memory, replacing any callbacks already registered. The callback
+// is only called for accesses within the inclusive address range start_addr
+// to end_addr, and whose access type is set in type_mask (see
+// LM32_MEM_CB_xxx). By default, all addresses and types match. Registering
+// a NULL callback removes all registered callbacks.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_register_ext_mem_callback (p_lm32_memcallback_t callback_func,
+                                               const uint32_t       start_addr,
+                                               const uint32_t       end_addr,
+                                               const uint32_t       type_mask)
+{
+    num_mem_callbacks = 0;
+
+    if (callback_func != NULL)
+    {
+        lm32_add_ext_mem_callback(callback_func, start_addr, end_addr, type_mask);
+    }
+
+    update_mem_callback_filter();
+}
+
+// -------------------------------------------------------------------------
+// lm32_add_ext_mem_callback()
+//
+// Routine for adding a user function as a callback for accesses to
+// external memory, alongside any callbacks already registered, with an
+// address range and access types as for lm32_register_ext_mem_callback().
+// Callbacks (or the same callback with different ranges) are called in
+// the order added until one processes the access. Returns false if the
+// callback is NULL, or LM32_MAX_MEM_CALLBACKS are already registered.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_add_ext_mem_callback (p_lm32_memcallback_t callback_func,
+                                          const uint32_t       start_addr,
+                                          const uint32_t       end_addr,
+                                          const uint32_t       type_mask)
+{
+    if (callback_func == NULL || num_mem_callbacks == LM32_MAX_MEM_CALLBACKS)
+    {
+        return false;
+    }
+
+    mem_callbacks[num_mem_callbacks].callback   = callback_func;
+    mem_callbacks[num_mem_callbacks].start_addr = start_addr;
+    mem_callbacks[num_mem_callbacks].end_addr   = end_addr;
+    mem_callbacks[num_mem_callbacks].type_mask  = type_mask & LM32_MEM_CB_ALL_TYPES;
+    num_mem_callbacks++;
+
+    update_mem_callback_filter();
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_remove_ext_mem_callback()
+//
+// Routine for removing every registration of a user function as an
+// external memory callback. Returns false if it wasn't registered.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_remove_ext_mem_callback (p_lm32_memcallback_t callback_func)
+{
+    int num = 0;
+
+    for (int idx = 0; idx < num_mem_callbacks; idx++)
+    {
+        if (mem_callbacks[idx].callback != callback_func)
+        {
+            mem_callbacks[num++] = mem_callbacks[idx];
+        }
+    }
+
+    bool removed = (num != num_mem_callbacks);
+
+    num_mem_callbacks = num;
+
+    update_mem_callback_filter();
+
+    return removed;
+}
+
+// -------------------------------------------------------------------------
+// update_mem_callback_filter()
+//
+// Recalculate the union of all the registered memory callbacks' address
+// ranges and access types, used to quickly reject non-matching accesses
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::update_mem_callback_filter (void)
+{
+    mem_callback_types      = 0;
+    mem_callback_start_addr = LM32_MEM_CB_END_ADDR;
+    mem_callback_end_addr   = LM32_MEM_CB_START_ADDR;
+
+    for (int idx = 0; idx < num_mem_callbacks; idx++)
+    {
+        lm32_mem_callback_t* p = &mem_callbacks[idx];
+
+        mem_callback_types      |= p->type_mask;
+        mem_callback_start_addr  = (p->start_addr < mem_callback_start_addr) ? p->start_addr : mem_callback_start_addr;
+        mem_callback_end_addr    = (p->end_addr   > mem_callback_end_addr)   ? p->end_addr   : mem_callback_end_addr;
+    }
+}
+
+// -------------------------------------------------------------------------
+// call_mem_callbacks()
+//
+// Calls each registered memory callback whose address range and access
+// types match the access, until one processes it. Returns the processing
+// callback's delay, or LM32_EXT_MEM_NOT_PROCESSED if none did.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::call_mem_callbacks (const uint32_t addr, uint32_t *data, const int type, const int cache_hit)
+{
+    int delay = LM32_EXT_MEM_NOT_PROCESSED;
+
+    for (int idx = 0; idx < num_mem_callbacks; idx++)
+    {
+        lm32_mem_callback_t* p = &mem_callbacks[idx];
+
+        if ((p->type_mask & LM32_MEM_CB_TYPE(type)) && addr >= p->start_addr && addr <= p->end_addr)
+        {
+            if ((delay = p->callback(addr, data, type, cache_hit, state.cycle_count)) != LM32_EXT_MEM_NOT_PROCESSED)
+            {
+                break;
+            }
+        }
+    }
+
+    return delay;
+}
+
+// -------------------------------------------------------------------------
+// lm32_register_jtag_callback()
+//
+// Routine for registering user function as callback for accesses to
+// JTAG interface.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_register_jtag_callback (p_lm32_jtagcallback_t callback_func)
+{
+    state.cfg |= (1 << LM32_CFG_J);
+    pJtagCallback = callback_func;
+}
+
+// -------------------------------------------------------------------------
+// internal_reset_cpu()
+// 
+// Reset the state of the CPU as at power-up, or reset pin asserted.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::internal_reset_cpu()
+{
+    state.pc   = entry_point_addr;
+    state.ie   = 0;
+    state.im   = 0;
+    state.ip   = 0;
+    state.icc  = 0;
+    state.dcc  = 0;
+    state.cfg  = LM32_DEFAULT_CONFIG;
+    state.eba  = LM32_EBA_RESET;
+    state.cfg2 = 0;
+
+    // Do the debug registers get reset?
+    state.dc   = 0;
+    state.deba = LM32_DEBA_RESET;
+    state.jtx  = 0;
+    state.jrx  = 0;
+    state.bp0  = 0;
+    state.bp1  = 0;
+    state.bp2  = 0;
+    state.bp3  = 0;
+    state.wp0  = 0;
+    state.wp1  = 0;
+    state.wp2  = 0;
+    state.wp3  = 0;
+
+#ifdef LM32_MMU
+    state.psw         = 0;
+    state.tlbvaddr    = 0;
+    state.tlbbadvaddr = 0;
+
+    memset(dtlb.valid, 0, sizeof(dtlb.valid));
+    memset(itlb.valid, 0, sizeof(itlb.valid));
+#endif
+
+    // Reset the frame and stack pointers to top of configured internal
+    // memory (will be 0 if no internal memory). This is not really done
+    // at reset, but is useful to forgo a start up routine. Will get 
+    // overwritten in any case if a real startup is executed at reset (when r 
+    // registers have undefined state anyway).
+    state.r[SP_REG_IDX] = mem_offset + num_mem_bytes - 4;
+    state.r[FP_REG_IDX] = mem_offset + num_mem_bytes - 4;
+    state.r[R0_REG_IDX] = 0;
+
+    // Model state
+    break_point    = 0;
+
+    // The cc register will be reset to 0, but state.cycle_count is
+    // not cleared. So cc_adjust is set to -cycle_count, so that
+    // reads of the cc register start from 0 after reset.
+    cc_adjust      = -1 * state.cycle_count;
+
+    // Flag to invalidate the caches (if any)
+    dcc_invalidate = true;
+    icc_invalidate = true;
+}
+
+// -------------------------------------------------------------------------
+// interrupt()
+//
+// Handle exceptions, not handled by instructions directly (such as break).
+// Used mainly for external exceptions generated by interrupt callback.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::interrupt (const int interrupt_id)
+{
+    switch(interrupt_id)
+    {
+    case INT_ID_RESET:
+        internal_reset_cpu();
+    case INT_ID_IBUSERROR:
+    case INT_ID_DBUSERROR:
+    case INT_ID_DIVZERO:
+    case INT_ID_SYSCALL:
+    case INT_ID_EXTINT:
+#ifdef LM32_MMU
+    case INT_ID_ITLB_MISS:
+    case INT_ID_DTLB_MISS: 
+    case INT_ID_DTLB_FAULT: 
+        if (interrupt_id >= INT_ID_ITLB_MISS)
+        {
+	    state.pc -= 4;
+        }
+    case INT_ID_PRIV_ACCESS:
+        state.psw = (state.psw & ~(IE_EITLBE_MASK)) | ((state.psw & IE_ITLBE_MASK) ? IE_EITLBE_MASK : 0);
+        state.psw = (state.psw & ~(IE_EDTLBE_MASK)) | ((state.psw & IE_DTLBE_MASK) ? IE_EDTLBE_MASK : 0);
+        state.psw = (state.psw & ~(IE_EUSR_MASK))   | ((state.psw & IE_USR_MASK)   ? IE_EUSR_MASK   : 0);
+#endif
+        state.r[EA_REG_IDX] = state.pc;
+        state.ie  = (state.ie & ~IE_EIE_MASK) | ((state.ie & IE_IE_MASK) ? IE_EIE_MASK : 0);
+        state.pc = ((state.dc & DEBUG_REMAP_ALL) ? state.deba : state.eba) + (interrupt_id << 5);
+        break;
+
+    case INT_ID_BREAKPOINT:
+    case INT_ID_WATCHPOINT:
+        state.r[BA_REG_IDX] = state.pc;
+        state.ie = (state.ie & ~IE_BIE_MASK) | ((state.ie & IE_IE_MASK) ? IE_BIE_MASK : 0);
+#ifdef LM32_MMU
+        state.psw = (state.psw & ~(IE_BITLBE_MASK)) | ((state.psw & IE_ITLBE_MASK) ? IE_BITLBE_MASK : 0);
+        state.psw = (state.psw & ~(IE_BDTLBE_MASK)) | ((state.psw & IE_DTLBE_MASK) ? IE_BDTLBE_MASK : 0);
+        state.psw = (state.psw & ~(IE_BUSR_MASK))   | ((state.psw & IE_USR_MASK)   ? IE_BUSR_MASK   : 0);
+#endif
+        state.pc = state.deba + (interrupt_id << 5);
+        break;
+
+    default:
+        fprintf(stderr, "***ERROR: invalid exception ID (%d)\n", interrupt_id);                 //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                              //LCOV_EXCL_LINE
+        break;
+    }
+
+    // Clear the master interrupt enable
+    state.ie &= ~IE_IE_MASK;
+
+#ifdef LM32_MMU
+    state.psw &= ~(IE_ITLBE_MASK | IE_DTLBE_MASK | IE_USR_MASK);
+#endif
+
+    // Clear the flag the caused the interrupt
+    state.int_flags &= ~(1ULL << interrupt_id);
+
+#ifndef LM32_FAST_COMPILE
+    // If building a call graph, the exception handler is a frame of its own
+    if (cg_stack != NULL)
+    {
+        cg_exception(interrupt_id);
+    }
+#endif
+
+}
+
+// -------------------------------------------------------------------------
+// process_exceptions()
+//
+// Called once per instruction to monitor for exceptions
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::process_exceptions() 
+{
+    int int_id;
+
+    // If there's a callback function registered, and we're at or beyond the
+    // wakeup time, call the function and handle external interrupt state
+    if (pIntCallback != NULL)
+    {
+        if (state.cycle_count >= state.wakeup_time_ext_int)
+        {
+            // Get interrupts from callback function, up to the maximum supported. Any
+            // interrupt outside supported number is ignored.
+            lm32_time_t cb_time = state.cycle_count;
+            uint32_t    ints    = pIntCallback(cb_time, &state.wakeup_time_ext_int);
+
+            // When recording or replaying, log the results, or replace them with those logged
+            if (replay_mode != LM32_REPLAY_OFF)
+            {
+                replay_int_callback(cb_time, &ints, &state.wakeup_time_ext_int);
+            }
+
+            state.ip |= ((1ULL << ((state.cfg >> LM32_CFG_INT) & LM32_CFG_INT_MASK))-1) & ints;
+
+            // If the callback function returns a negative wakeup value, it is requesting
+            // termination. Return immediately with a 'true' status.
+            if (state.wakeup_time_ext_int < 0)
+            {
+                return true;                                                                    //LCOV_EXCL_LINE
+            }
+
+            // If not masked, flag any external interrupt
+            state.int_flags = (state.int_flags & ~(1 << INT_ID_EXTINT)) | (((state.ie & IE_IE_MASK) && (state.ip & state.im)) ? (1 << INT_ID_EXTINT) : 0);
+        }
+    }
+
+    // If interrupts enabled, and anyone is interrupting, call the interrupt function
+    if (state.int_flags)
+    {
+        // Find the highest priority interrupt
+        for (int_id = 0; int_id < INT_ID_NUM; int_id++) 
+        {
+            // If the bit is set in state.int_flags, highest priority found,
+            // so break out of loop
+            if ((1 << int_id) & state.int_flags)
+            {
+                break;
+            }
+        }
+
+        // Call interrupt with highest priority ID
+        interrupt(int_id);
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------
+// lm32_reset_cpu()
 //
 // Externally called function to emulate the reset pin being asserted and
 // release. Raises an interrupt request (highest priority) which will
@@ -1066,6 +2191,8 @@ bool lm32_cpu::execute_instruction (p_lm32_decode_t d)
             state.int_flags |= (1 << INT_ID_BREAKPOINT);
         }
     }
+
+    uint32_t pc = state.pc;
 #endif
 
 #ifndef LNXMICO32
@@ -1102,7 +2229,7 @@ bool lm32_cpu::execute_instruction (p_lm32_decode_t d)
     }
 
     // Disassemble 
-    if (((verbose  && disassemble_active) || disassemble_run) && ((state.pc < (mem_offset + num_mem_bytes))
+    if (((verbose  && disassemble_active) || disassemble_run) && ((state.pc >= mem_offset && state.pc < (mem_offset + num_mem_bytes))
 #ifndef LNXMICO32
         // By default only disassemble memory labelled as instructions
         && (mem_tag[state.pc - mem_offset] & MEM_INSTRUCTION_WR)                                //LCOV_EXCL_LINE
@@ -1121,10 +2248,37 @@ bool lm32_cpu::execute_instruction (p_lm32_decode_t d)
     {
         state.pc = state.pc + 4;                                                        //LCOV_EXCL_LINE
     }
+
+    // If collecting coverage, record an edge for any change of flow, and for
+    // conditional branches not taken
+    if (cov_map != NULL && (state.pc != pc + 4 || d->decode->issue_not_takencycles))
+    {
+        cov_edge(state.pc);
+    }
+
+    // If profiling, sample this instruction's PC when it reaches a sample point
+    if (state.cycle_count >= prof_next_cycle)
+    {
+        prof_sample(pc, state.cycle_count);
+    }
+
+    // If building a call graph, follow calls and returns
+    if (cg_stack != NULL && (table_index == OPCODE_IDX_CALL || table_index == OPCODE_IDX_CALLI || table_index == OPCODE_IDX_B))
+    {
+        cg_branch(d, pc);
+    }
 #else
+    // If profiling, sample this instruction's PC if it reaches a sample point (known
+    // before it's executed, as every instruction takes a cycle)
+    if (state.cycle_count + 1 >= prof_next_cycle)
+    {
+        prof_sample(state.pc, state.cycle_count + 1);
+    }
+
     (this->*tbl_p[table_index])(d);
     state.cycle_count += 1;
 #endif
+
     return false;
 }
 
@@ -1162,13 +2316,27 @@ int lm32_cpu::lm32_run_program (const char* filename, const lm32_time_t cycles,
     // Load program if asked to do so, or running from reset, but only if a filename specified
     if ((exec_type == LM32_RUN_FROM_RESET || load_code) && filename != NULL)
     {
-        read_elf(filename);
+        lm32_load_elf(filename);
     }
 #endif
 
     // Clear breakpoint
     break_point = 0;
 
+    // Startup ends as the first instruction is about to be executed
+    if (startup_first_usecs < 0.0)
+    {
+        startup_complete();
+    }
+
+#ifndef LM32_FAST_COMPILE
+    // Start any enabled call graph from the program's current PC
+    if (cg_stack != NULL && cg_depth == 0)
+    {
+        cg_root();
+    }
+#endif
+
 #ifdef LM32_FAST_COMPILE
     while(LM32_FOREVER)
     {
@@ -1180,6 +2348,12 @@ int lm32_cpu::lm32_run_program (const char* filename, const lm32_time_t cycles,
         
         // Keep a tally of the number of instructions executed
         state.instr_count++;
+
+        // Break if a periodic checkpoint is due
+        if (state.instr_count >= ckpt_next_instr && checkpoint_due())
+        {
+           return LM32_CHECKPOINT_BREAK;
+        }
     }
 #else
     // Loop executing instructions either forever (if cycles negative) or
@@ -1290,6 +2464,13 @@ int lm32_cpu::lm32_run_program (const char* filename, const lm32_time_t cycles,
             break;
         }
 
+        // Break if a periodic checkpoint is due
+        if (state.instr_count >= ckpt_next_instr && checkpoint_due())
+        {
+            break_point = LM32_CHECKPOINT_BREAK;
+            break;
+        }
+
         // Break after only 1 instruction execution in single step mode
         if (exec_type == LM32_RUN_SINGLE_STEP)
         {
@@ -36,6 +36,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <time.h>
 
 #include "lm32_cpu_hdr.h"
 #include "lm32_cache.h"
@@ -152,7 +153,15 @@ public:
 
     // Callback function registration
     LIBMICO32_API void        lm32_register_int_callback     (p_lm32_intcallback_t callback_func);
-    LIBMICO32_API void        lm32_register_ext_mem_callback (p_lm32_memcallback_t callback_func);
+    LIBMICO32_API void        lm32_register_ext_mem_callback (p_lm32_memcallback_t callback_func,
+                                                              const uint32_t start_addr = LM32_MEM_CB_START_ADDR,
+                                                              const uint32_t end_addr   = LM32_MEM_CB_END_ADDR,
+                                                              const uint32_t type_mask  = LM32_MEM_CB_ALL_TYPES);
+    LIBMICO32_API bool        lm32_add_ext_mem_callback      (p_lm32_memcallback_t callback_func,
+                                                              const uint32_t start_addr = LM32_MEM_CB_START_ADDR,
+                                                              const uint32_t end_addr   = LM32_MEM_CB_END_ADDR,
+                                                              const uint32_t type_mask  = LM32_MEM_CB_ALL_TYPES);
+    LIBMICO32_API bool        lm32_remove_ext_mem_callback   (p_lm32_memcallback_t callback_func);
     LIBMICO32_API void        lm32_register_jtag_callback    (p_lm32_jtagcallback_t callback_func);
 
     // Reset the cpu (i.e. generate a reset pin assertion event)
@@ -162,24 +171,156 @@ public:
     LIBMICO32_API uint32_t    lm32_read_mem                  (const uint32_t byte_addr, const int type);
     LIBMICO32_API void        lm32_write_mem                 (const uint32_t byte_addr, const uint32_t data, const int type, const bool disable_cycle_count=false);
 
+    // Internal memory dirty page tracking. Pages (of LM32_DIRTY_PAGE_SIZE bytes) are
+    // marked dirty on any write to internal memory, until cleared.
+    LIBMICO32_API inline bool lm32_is_page_dirty             (const uint32_t byte_addr) {
+        uint32_t offset = byte_addr - mem_offset;
+        return (offset < num_mem_bytes) && ((dirty_map_word(offset >> (LM32_DIRTY_PAGE_BITS + 6)) >> ((offset >> LM32_DIRTY_PAGE_BITS) & 63)) & 1);
+    };
+    LIBMICO32_API bool        lm32_get_next_dirty_page       (uint32_t* p_byte_addr);
+    LIBMICO32_API void        lm32_clear_dirty_pages         (void);
+
+    // Map a file image copy-on-write into internal memory (returns length, or LM32_MAP_FAILED)
+    LIBMICO32_API int         lm32_map_file_to_mem           (const char* fname, const uint32_t byte_addr);
+
+    // Bulk loads of a host buffer, or a binary file image (returning its length, or LM32_LOAD_FAILED),
+    // into memory at byte_addr, as for byte writes with cycle counting disabled
+    LIBMICO32_API void        lm32_load_buf_to_mem           (const void* buf, const uint32_t len, const uint32_t byte_addr);
+    LIBMICO32_API int         lm32_load_file_to_mem          (const char* fname, const uint32_t byte_addr);
+
+    // Load an ELF program to memory, as lm32_run_program() does, without running it
+    LIBMICO32_API void        lm32_load_elf                  (const char* fname);
+
+    // Symbol index, built from the symbol table of each ELF program loaded, or loaded from an ELF or
+    // System.map file (returning the number of symbols, or LM32_SYM_LOAD_FAILED). Lookups by address
+    // return the name of the containing symbol (or NULL) and the offset into it, and by name the address.
+    LIBMICO32_API int         lm32_load_symbols              (const char* fname);
+    LIBMICO32_API void        lm32_clear_symbols             (void);
+    LIBMICO32_API inline uint32_t lm32_get_num_symbols       (void) { return num_syms; };
+    LIBMICO32_API const char* lm32_lookup_symbol             (const uint32_t byte_addr, uint32_t* p_offset = NULL);
+    LIBMICO32_API bool        lm32_find_symbol               (const char* name, uint32_t* p_addr);
+
+    // Source line table, from the DWARF line table of the last ELF program loaded (or the set ELF
+    // file), read on the first lookup. Lookups return the source file name and line number of an
+    // address, or false if it has none. When a cache directory is set ("" for alongside the ELF
+    // file), parsed tables are cached there for later runs. By default (NULL), nothing is cached.
+    LIBMICO32_API void        lm32_set_line_file             (const char* fname);
+    LIBMICO32_API void        lm32_set_line_cache            (const char* dir);
+    LIBMICO32_API void        lm32_clear_lines               (void);
+    LIBMICO32_API bool        lm32_lookup_line               (const uint32_t byte_addr, const char** p_file, uint32_t* p_line);
+
+    // Cycle sampling profile. When set with a non-zero interval, the PC is sampled every interval
+    // simulated cycles, accumulating the sampled cycles by address until cleared (returns false if
+    // the samples can't be allocated). The profile is written attributed to symbols, and to source
+    // lines where known, in LM32_PROF_FMT_xxx format (returning false if it can't be written).
+    LIBMICO32_API bool        lm32_set_profile               (const uint32_t interval);
+    LIBMICO32_API void        lm32_clear_profile             (void);
+    LIBMICO32_API inline uint64_t lm32_get_profile_samples   (void) { return prof_num_samples; };
+    LIBMICO32_API bool        lm32_write_profile             (const char* fname, const int format);
+
+    // Call graph profile (not in fast builds, where setting returns false). When enabled, a shadow
+    // call stack is kept from calls and returns, with each exception a frame of its own, and the
+    // inclusive and exclusive cycles and instructions of each function and call edge accumulated
+    // until cleared. The call graph is written in callgrind format (returning false if it can't be).
+    LIBMICO32_API bool        lm32_set_call_graph            (const bool enable);
+    LIBMICO32_API void        lm32_clear_call_graph          (void);
+    LIBMICO32_API bool        lm32_write_call_graph          (const char* fname);
+
+    // Host sampling profile (not on Windows, where setting returns false), sampling the PC
+    // (and RA if with_ra) every usecs microseconds of host CPU time (0 to stop), from a
+    // SIGPROF handler, so that fast builds can be profiled without instrumentation. Only one
+    // lm32_cpu per process may be sampled at a time. Written as for lm32_write_profile().
+    LIBMICO32_API bool        lm32_set_host_profile          (const uint32_t usecs, const bool with_ra = false);
+    LIBMICO32_API void        lm32_clear_host_profile        (void);
+    LIBMICO32_API inline uint64_t lm32_get_host_profile_samples (void) { host_prof_drain(); return host_prof_num_samples; };
+    LIBMICO32_API bool        lm32_write_host_profile        (const char* fname, const int format);
+
+    // Snapshot save and restore of CPU, timing, TLB, cache and internal memory state,
+    // with optional user sections (returns LM32_SNAP_OK, or an LM32_SNAP_xxx error)
+    LIBMICO32_API int         lm32_save_snapshot             (const char* fname, const int flags = 0,
+                                                              const lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+    LIBMICO32_API int         lm32_load_snapshot             (const char* fname, lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+    LIBMICO32_API int         lm32_write_snapshot            (FILE* fp, const int flags = 0,
+                                                              const lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+    LIBMICO32_API int         lm32_read_snapshot             (FILE* fp, lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+
+    // Wait for a background (LM32_SNAP_BACKGROUND) snapshot or checkpoint to complete, returning its status
+    LIBMICO32_API int         lm32_wait_snapshot             (void);
+
+    // Clone the model into num_instances forked processes, sharing its memory copy-on-write. Returns
+    // the instance number (1 to num_instances) in each clone, 0 in the original, or -1 if not all
+    // could be created. The original then waits for each clone to exit with lm32_wait_instance(),
+    // which returns the clone's instance number (or 0 when none remain), and its exit status.
+    LIBMICO32_API int         lm32_clone_instances           (const int num_instances);
+    LIBMICO32_API int         lm32_wait_instance             (int* p_status);
+
+    // Periodic checkpoints. When set, lm32_run_program() returns LM32_CHECKPOINT_BREAK every
+    // num_instr instructions and/or num_secs host seconds (0 disables either), when a checkpoint
+    // should be written before continuing. Checkpoints are chains of a full snapshot followed by
+    // snapshots of the pages dirtied since the previous checkpoint.
+    LIBMICO32_API void        lm32_set_checkpoint_interval   (const uint64_t num_instr, const int num_secs);
+    LIBMICO32_API int         lm32_write_checkpoint          (const char* base_fname, const int keep, const int flags = 0,
+                                                              const lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+    LIBMICO32_API int         lm32_restore_checkpoint        (const char* base_fname, const int num = LM32_CKPT_LATEST,
+                                                              lm32_snap_section_t* p_user = NULL, const int num_user = 0);
+
+    // Record and replay of external inputs. Interrupt callback results and JTAG reads are logged
+    // by the model, with device models logging their own inputs on user channels.
+    LIBMICO32_API bool        lm32_open_replay               (const char* fname, const int mode);
+    LIBMICO32_API uint64_t    lm32_close_replay              (void);
+    LIBMICO32_API inline int  lm32_get_replay_mode           (void) { return replay_mode; };
+    LIBMICO32_API void        lm32_record_input              (const uint32_t chan, const lm32_time_t time, const uint32_t data);
+    LIBMICO32_API bool        lm32_replay_input              (const uint32_t chan, const lm32_time_t time, uint32_t* p_data);
+
+    // Restore points and edge coverage, for fuzzing. lm32_restore() returns to the state at the last
+    // lm32_set_restore_point(), copying back only the internal memory pages written since. When enabled,
+    // lm32_set_coverage() returns a map of LM32_COV_MAP_SIZE hit counts of executed control flow edges,
+    // accumulated until lm32_clear_coverage() (or NULL when disabled, or it can't be allocated).
+    LIBMICO32_API bool        lm32_set_restore_point         (void);
+    LIBMICO32_API void        lm32_restore                   (void);
+    LIBMICO32_API uint8_t*    lm32_set_coverage              (const bool enable);
+    LIBMICO32_API void        lm32_clear_coverage            (void);
+
+    // Fault injection. lm32_flip_mem_bit() inverts a bit of an internal memory byte, with no timing
+    // or cache side effects (returning false if not an internal memory address). lm32_mem_digest()
+    // returns a digest of the differences of internal memory from the restore point (0 if none),
+    // so that runs from the same restore point can be compared.
+    LIBMICO32_API bool        lm32_flip_mem_bit              (const uint32_t byte_addr, const int bit);
+    LIBMICO32_API uint64_t    lm32_mem_digest                (void);
+
+    // In memory snapshots of the complete state (CPU, timing, TLBs, caches and internal memory),
+    // held as handles until freed. Memory pages unchanged since the last snapshot taken or restored
+    // are shared between handles, and restoring copies back only the pages that differ. Serialising
+    // writes a handle in the lm32_write_snapshot() format, and deserialising reads one into a new
+    // handle, without disturbing the live state. Take and deserialise return NULL on failure.
+    LIBMICO32_API lm32_snapshot_t* lm32_take_snapshot        (void);
+    LIBMICO32_API bool        lm32_restore_snapshot          (const lm32_snapshot_t* p_snap);
+    LIBMICO32_API void        lm32_free_snapshot             (lm32_snapshot_t* p_snap);
+    LIBMICO32_API int         lm32_serialise_snapshot        (const lm32_snapshot_t* p_snap, FILE* fp, const int flags = 0);
+    LIBMICO32_API lm32_snapshot_t* lm32_deserialise_snapshot (FILE* fp);
+
 #ifdef LNXMICO32
 
 #include "lnxmico32.h"
 
+    // Fast access to internal memory, where RAM is a power of 2 in size and aligned to its
+    // size (as configured at run time). Any other address is accessed via lm32_read_mem().
+    LIBMICO32_API inline bool     lm32_is_ram_addr           (const uint32_t byte_addr) { return (byte_addr & ~num_mem_bytes_mask) == mem_offset; };
+
     LIBMICO32_API inline uint32_t lm32_read_word             (const uint32_t byte_addr) {
-        return (byte_addr & LM32_PERIPH_MASK) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_WORD) : 
-                                                SWAP(mem32[(byte_addr & LM32_RAM_MASK)>>2]);
+        return !lm32_is_ram_addr(byte_addr) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_WORD) : 
+                                              SWAP(mem32[(byte_addr & num_mem_bytes_mask)>>2]);
     };
 
-    LIBMICO32_API inline uint32_t lm32_read_instr            (const uint32_t byte_addr) { return SWAP(mem32[(byte_addr & LM32_RAM_MASK)>>2]);};
+    LIBMICO32_API inline uint32_t lm32_read_instr            (const uint32_t byte_addr) { return SWAP(mem32[(byte_addr & num_mem_bytes_mask)>>2]);};
 
     LIBMICO32_API inline void     lm32_write_word            (const uint32_t byte_addr, const uint32_t data) {
         lm32_write_mem(byte_addr, data, LM32_MEM_WR_ACCESS_WORD); 
     };
 
     LIBMICO32_API inline uint32_t lm32_read_hword            (const uint32_t byte_addr) {
-        return (byte_addr & LM32_PERIPH_MASK) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_HWORD) : 
-                                                SWAPHALF(mem16[(byte_addr & LM32_RAM_MASK)>>1]);
+        return !lm32_is_ram_addr(byte_addr) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_HWORD) : 
+                                              SWAPHALF(mem16[(byte_addr & num_mem_bytes_mask)>>1]);
     };
 
     LIBMICO32_API inline void     lm32_write_hword           (const uint32_t byte_addr, const uint32_t data) {
@@ -187,8 +328,8 @@ public:
     };
 
     LIBMICO32_API inline uint32_t lm32_read_byte             (const uint32_t byte_addr) {
-        return (byte_addr & LM32_PERIPH_MASK) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_BYTE) : 
-                                                mem[byte_addr & LM32_RAM_MASK];
+        return !lm32_is_ram_addr(byte_addr) ? lm32_read_mem(byte_addr, LM32_MEM_RD_ACCESS_BYTE) : 
+                                              mem[byte_addr & num_mem_bytes_mask];
     };
 
     LIBMICO32_API inline void     lm32_write_byte            (const uint32_t byte_addr, const uint32_t data) {
@@ -198,18 +339,23 @@ public:
 #endif
 
     // Allocation of memory function
-    inline void* lm32_alloc_mem(int nbytes) 
-    {
-#ifdef LM32_FAST_COMPILE
-        // For fast compile, allocate but don't initialise memory
-        return malloc(nbytes);
-#else
-        // For normal compile, initialise memory with zeros. This ensures
-        // any BSS section is initialised properly, without the need for
-        // CRT0 startup code.
-        return calloc(nbytes, 1);
-#endif
-    }
+    void*                     lm32_alloc_mem                 (const int nbytes);
+
+    // Select huge page backed internal memory (call before first memory access), and get page type used
+    LIBMICO32_API void        lm32_set_huge_pages            (const bool enable);
+    LIBMICO32_API inline int  lm32_get_mem_page_type         (void) { return mem_page_type; };
+
+    // Startup profile: host time spent in each LM32_STARTUP_xxx phase up to the first instruction
+    // executed (when, if enabled, the profile is output). Time is measured from construction, or
+    // from an earlier origin set by the caller, which may time its own phases, or add their times.
+    // Nested phases are timed exclusively, entering returning the phase to resume on leaving.
+    LIBMICO32_API static double lm32_host_usecs              (void);
+    LIBMICO32_API inline void lm32_set_startup_stats         (const bool enable) { startup_stats = enable; };
+    LIBMICO32_API void        lm32_set_startup_origin        (const double usecs);
+    LIBMICO32_API int         lm32_enter_startup_phase       (const int phase);
+    LIBMICO32_API void        lm32_leave_startup_phase       (const int prev_phase);
+    LIBMICO32_API void        lm32_add_startup_usecs         (const int phase, const double usecs);
+    LIBMICO32_API void        lm32_dump_startup_stats        (FILE* fp);
 
     // Internal register access
     LIBMICO32_API void        lm32_set_gp_reg                (const unsigned index, const uint32_t val);
@@ -229,7 +375,25 @@ public:
         return state;
     }
 
-    LIBMICO32_API inline void        lm32_set_cpu_state(const lm32_state new_state) { state = new_state; }
+    // Set state of CPU internal registers. Moving the cycle count (e.g. restoring saved state)
+    // restarts any cycle sampling profile's sample points from the new count, and any call
+    // graph's shadow call stack.
+    LIBMICO32_API inline void        lm32_set_cpu_state(const lm32_state new_state)
+    {
+        bool resync = new_state.cycle_count != state.cycle_count;
+
+        if (resync)
+        {
+            cg_restart();
+        }
+
+        state = new_state;
+
+        if (resync)
+        {
+            prof_resync();
+        }
+    }
 
     // User run-time configuration and status routines
     LIBMICO32_API void               lm32_set_configuration         (const uint32_t word);       // Enable/disable CPU features
@@ -245,6 +409,11 @@ public:
 
 #ifndef LM32_FAST_COMPILE
     LIBMICO32_API        void        lm32_dump_op_stats(void);
+
+    // Memory latency map configuration and per-region statistics
+    LIBMICO32_API        void        lm32_set_mem_regions(const lm32_mem_region_cfg_t* p_regions, const int num_regions);
+    LIBMICO32_API        void        lm32_dump_mem_region_stats(void);
+    LIBMICO32_API        lm32_mem_region_stats_t lm32_get_mem_region_stats(const int region);
 #endif
 
     // User called routine to set verbosity level of debug information.
@@ -279,6 +448,11 @@ private:
     // Internal method to load program words to memory (used by lm32_read_elf)
     void        load_mem_word                  (const uint32_t byte_addr, const uint32_t word, const uint32_t flags);
 
+    // Bulk loading support. A range can be loaded directly into mem[] (from the returned index)
+    // if it's wholly in internal memory, and not intercepted by a callback of cb_types or a TLB.
+    bool        bulk_mem_range                 (const uint32_t byte_addr, const uint32_t len, const uint32_t cb_types, uint32_t* p_idx);
+    void        bulk_mem_loaded                (const uint32_t idx, const uint32_t len, const uint8_t tag);
+
     // Support method for instructions to calculate stall times on pending register
     // updates
     lm32_time_t calc_stall                     (const int ry, const int rz, const lm32_time_t cycle_count);
@@ -359,6 +533,108 @@ private:
     void        lm32_rcsr                      (const p_lm32_decode_t p);
     void        lm32_wcsr                      (const p_lm32_decode_t p);
 
+    // Dirty page bitmap word, with pages dirtied before and since the last checkpoint
+    inline uint64_t dirty_map_word (const uint32_t wdx) { return dirty_map[wdx] | ckpt_dirty_map[wdx] | prior_dirty_map[wdx]; };
+
+    // Restart the cycle sampling profile's sample points from the current cycle count,
+    // when the state has been restored, and poll to drain any host profile at the next
+    // instruction, as the instruction count may have moved back past its next poll
+    inline void prof_resync (void) {
+        if (prof_interval)
+        {
+            prof_next_cycle = state.cycle_count + prof_interval;
+        }
+
+        if (host_prof_usecs)
+        {
+            ckpt_next_instr = state.instr_count;
+        }
+    };
+
+    // Mark the page containing the internal memory byte offset as dirty (see fold_dirty_map())
+    inline void mark_page_dirty (const uint32_t byte_offset) {
+        dirty_map[byte_offset >> (LM32_DIRTY_PAGE_BITS + 6)] |= 1ULL << ((byte_offset >> LM32_DIRTY_PAGE_BITS) & 63);
+    };
+
+    // Record a coverage edge, from the last location recorded to the one for pc.
+    // The location is a (multiplicative) hash of the pc, so that neighbouring
+    // edges are spread over the map.
+    inline void cov_edge (const uint32_t pc) {
+        uint32_t loc = ((pc >> 2) * LM32_COV_HASH_MULT) >> (32 - LM32_COV_MAP_BITS);
+        cov_map[loc ^ cov_prev_loc]++;
+        cov_prev_loc = loc >> 1;
+    };
+
+    // External memory callback filtering and dispatch
+    inline bool mem_callback_match (const uint32_t addr, const int type) {
+        return (mem_callback_types & LM32_MEM_CB_TYPE(type)) && addr >= mem_callback_start_addr && addr <= mem_callback_end_addr;
+    };
+
+    int         call_mem_callbacks             (const uint32_t addr, uint32_t *data, const int type, const int cache_hit);
+    void        update_mem_callback_filter     (void);
+
+    // Snapshot support
+    void        snap_cpu_fields                (lm32_state& st, uint32_t* p32[], uint64_t* p64[]);
+    bool        get_snap_regs                  (lm32_snapshot_t* p_snap);
+    int         write_snapshot                 (FILE* fp, const int flags, const lm32_snap_section_t* p_user, const int num_user,
+                                                const lm32_snapshot_t* p_snap);
+    int         read_snapshot                  (FILE* fp, lm32_snap_section_t* p_user, const int num_user, lm32_snapshot_t* p_snap);
+    int         write_snap_mem                 (FILE* fp, const int flags, const lm32_snapshot_t* p_snap);
+    int         read_snap_mem                  (FILE* fp, const uint64_t len);
+    int         read_snap_pages                (FILE* fp, const uint64_t len, lm32_snapshot_t* p_snap);
+    int         write_snap_image               (FILE* fp, const lm32_snapshot_t* p_snap);
+    int         read_snap_image                (FILE* fp, const uint32_t offset, const uint32_t len);
+    bool        checkpoint_due                 (void);
+    void        start_dirty_interval           (void);
+    void        fold_dirty_map                 (void);
+    int         fork_snapshot                  (const bool is_ckpt, int* p_prev_status);
+    void        set_snap_base                  (const lm32_snapshot_t* p_snap);
+
+    // Record and replay support
+    void        replay_int_callback            (const lm32_time_t time, uint32_t* p_ints, lm32_time_t* p_wakeup);
+    void        replay_jtag                    (const uint32_t chan, uint32_t* p_reg);
+    void        write_replay_event             (const uint32_t chan, const lm32_time_t time, const uint64_t data0, const uint64_t data1);
+    void        read_replay_event              (void);
+
+    // Startup profile support
+    void*       alloc_mem_pages                (const int nbytes);
+    void        startup_complete               (void);
+
+    // Cycle sampling profile support
+    void        prof_sample                    (const uint32_t pc, const lm32_time_t cycle);
+
+    // Host sampling profile support
+    bool        host_prof_timer                (const uint32_t usecs);
+    void        host_prof_drain                (void);
+
+    // Call graph profile support
+    void        cg_root                        (void);
+    void        cg_branch                      (const p_lm32_decode_t d, const uint32_t pc);
+    void        cg_exception                   (const int interrupt_id);
+    void        cg_push                        (const uint32_t fn_addr, const bool is_exception, const uint32_t site,
+                                                const uint32_t ret_addr, const uint64_t instr);
+    void        cg_return                      (const uint32_t target, const uint64_t instr);
+    void        cg_unwind                      (const uint32_t depth, const uint64_t instr);
+    void        cg_restart                     (void);
+    uint32_t    cg_fn_index                    (const uint32_t fn_addr, const bool is_exception);
+    uint32_t    cg_edge_index                  (const uint32_t caller, const uint32_t site, const uint32_t callee);
+
+    // Symbol index support
+    int         build_symbol_index             (struct lm32_sym_build_s* p_syms, const uint32_t num, char* p_strings);
+    int         read_elf_symbols               (const uint8_t* image, const size_t image_len);
+    int         read_map_symbols               (FILE* fp);
+
+    // Source line table support
+    bool        set_line_image                 (uint8_t* image, const size_t len, const bool is_mapped,
+                                                const uint64_t elf_size, const uint64_t elf_digest);
+    void        build_line_table               (void);
+
+#ifndef LM32_FAST_COMPILE
+    // Memory latency map
+    lm32_time_t mem_access_cycles              (const uint32_t addr, const int type, const int num_words);
+    void        update_mem_region_stats        (const int region, const int type, const int num_words, const lm32_time_t cycles);
+#endif
+
 #ifdef LM32_MMU
     lm32_tlb_status_e tlb_lookup (uint32_t &paddr, const uint32_t vaddr, const bool is_data, const bool is_write);
     void tlb_vaddr_update        (uint32_t vaddr);
@@ -370,9 +646,16 @@ private:
 
     // Callback function pointers
     p_lm32_intcallback_t       pIntCallback;
-    p_lm32_memcallback_t       pMemCallback;
     p_lm32_jtagcallback_t      pJtagCallback;
 
+    // Registered memory callbacks, with the union of their access types and
+    // address ranges, for a quick reject of non-matching accesses
+    lm32_mem_callback_t        mem_callbacks[LM32_MAX_MEM_CALLBACKS];
+    int                        num_mem_callbacks;
+    uint32_t                   mem_callback_types;
+    uint32_t                   mem_callback_start_addr;
+    uint32_t                   mem_callback_end_addr;
+
     // Wakeup time for external interrupt callback function
     //lm32_time_t wakeup_time_ext_int;
 
@@ -390,6 +673,16 @@ private:
     int                        mem_wait_states;      // Number of wait states for internal memory access
     bool                       disassemble_run;        
 
+    // Memory latency map regions, with each region's open SDRAM page, the
+    // last matched region (checked first on the next access, unless regions
+    // overlap, when the first matching region must be found) and statistics
+    int                        num_mem_regions;
+    int                        last_mem_region;
+    bool                       mem_regions_overlap;
+    lm32_mem_region_cfg_t      mem_regions[LM32_MAX_MEM_REGIONS];
+    uint32_t                   mem_region_open_page[LM32_MAX_MEM_REGIONS];
+    lm32_mem_region_stats_t    mem_region_stats[LM32_NUM_MEM_REGION_STATS];
+
     // Flag to indicate a termination/break point specified externally
     uint32_t                   break_point;
 
@@ -397,9 +690,27 @@ private:
     // and mico32 is 32 bit big-endian
     uint8_t*                   mem;
     uint8_t*                   mem_tag;
+    uint64_t*                  dirty_map;            // Bitmap of written pages of mem (since last folded into those below)
+    uint64_t*                  ckpt_dirty_map;       // Bitmap of pages written since the last checkpoint
+    uint64_t*                  prior_dirty_map;      // Bitmap of pages written before the last checkpoint
+    uint32_t                   dirty_map_words;      // Number of 64 bit words in dirty_map
+    uint64_t*                  rp_dirty_map;         // Bitmap of pages of mem written since the restore point was set
+    uint64_t*                  snap_dirty_map;       // Bitmap of pages of mem changed since snap_base was set
+    bool                       huge_pages;           // Try to allocate memory with huge pages
+    int                        mem_page_type;        // Type of host pages backing mem (LM32_MEM_PAGES_xxx)
     uint16_t*                  mem16;
     uint32_t*                  mem32;
 
+    // Startup profile: accumulated time of each phase, the phase being timed (or LM32_STARTUP_NONE)
+    // and when it was last entered or resumed, the time origin, and when the first instruction was
+    // reached (relative to the origin, or negative until then)
+    bool                       startup_stats;
+    double                     startup_usecs[LM32_STARTUP_NUM_PHASES];
+    int                        startup_phase;
+    double                     startup_mark;
+    double                     startup_origin;
+    double                     startup_first_usecs;
+
     // Pointer to decode table of pointers to instruction functions
     pFunc_t                    tbl_p[LM32_NUM_OPCODES];
 
@@ -440,9 +751,117 @@ private:
 
     uint64_t                   op_count[LM32_NUM_OPCODES];
 
+    // Periodic checkpoint state. The run loop checks for a due checkpoint when
+    // the instruction count reaches ckpt_next_instr (polling the host time when
+    // ckpt_interval_secs set, and draining the host profile when sampling).
+    uint64_t                   ckpt_interval_instr;
+    int                        ckpt_interval_secs;
+    uint64_t                   ckpt_next_instr;
+    uint64_t                   ckpt_due_instr;
+    time_t                     ckpt_due_time;
+    int                        ckpt_num;             // Number of the next checkpoint
+    int                        ckpt_base_num;        // Number of the current chain's full checkpoint (or -1)
+    int                        ckpt_prev_base_num;   // Number of the previous chain's full checkpoint (or -1)
+
+    // Outstanding background snapshot process (or 0), and whether it's a checkpoint
+    int                        snap_pid;
+    bool                       snap_is_ckpt;
+
+    // Process IDs of running clone instances (0 when exited), indexed by instance number - 1
+    int*                       clone_pids;
+    int                        num_clones;
+
+    // Record and replay log state, with the next event to replay
+    FILE*                      replay_fp;
+    int                        replay_mode;
+    lm32_time_t                replay_time;
+    lm32_time_t                replay_int_delta;
+    uint64_t                   replay_diverged;
+    bool                       replay_next_valid;
+    uint32_t                   replay_next_chan;
+    lm32_time_t                replay_next_time;
+    uint64_t                   replay_next_data[2];
+
+    // Edge coverage map (or NULL), and the (shifted) last location recorded
+    uint8_t*                   cov_map;
+    uint32_t                   cov_prev_loc;
+
+    // Restore point copy of internal memory (or NULL if none), and of the CPU,
+    // timing and TLB state
+    uint8_t*                   rp_mem;
+    lm32_state                 rp_state;
+    lm32_time_t                rp_rt[LM32_NUM_OF_REGISTERS];
+    lm32_time_t                rp_cc_adjust;
+    bool                       rp_dcc_invalidate;
+    bool                       rp_icc_invalidate;
+
+    // Memory pages of the last in memory snapshot taken or restored (or NULL), for
+    // sharing unchanged pages with the next snapshot taken
+    lm32_snapshot_t*           snap_base;
+
+    // Symbol index: addresses in ascending order, with each symbol's size (or 0 if
+    // unknown) and name offset into the string pool, and symbol numbers sorted by name
+    uint32_t                   num_syms;
+    uint32_t*                  sym_addr;
+    uint32_t*                  sym_size;
+    uint32_t*                  sym_name;
+    uint32_t*                  sym_by_name;
+    char*                      sym_strings;
+
+    // Source line table, built on first lookup from the ELF file named, held in a line table cache
+    // image (mapped from the cache file, or allocated): row addresses in ascending order, with each
+    // row's line number (0 for none) and file number, and each file's name offset into the pool
+    char*                      line_elf_fname;
+    char*                      line_cache_dir;
+    bool                       line_table_built;
+    uint8_t*                   line_image;
+    size_t                     line_image_len;
+    bool                       line_image_mapped;
+    uint32_t                   num_lines;
+    uint32_t                   num_line_files;
+    const uint32_t*            line_addr;
+    const uint32_t*            line_num;
+    const uint32_t*            line_file;
+    const uint32_t*            line_file_name;
+    const char*                line_strings;
+
+    // Cycle sampling profile: the sampling interval (0 when off) and the cycle count of
+    // the next sample point, with an open addressed hash table of sampled cycles by PC
+    // (allocated when first started), and the number of samples
+    uint32_t                   prof_interval;
+    lm32_time_t                prof_next_cycle;
+    struct lm32_prof_table_s*  prof_table;
+    uint64_t                   prof_num_samples;
+
+    // Host sampling profile: the host CPU time sampling interval in microseconds (0 when
+    // off), whether return addresses are sampled, the table of samples drained from the
+    // signal handler's ring buffer by PC (and RA), the number of samples, and the count of
+    // samples dropped (from a full ring buffer) as at the last clear
+    uint32_t                   host_prof_usecs;
+    bool                       host_prof_ra;
+    struct lm32_prof_table_s*  host_prof_table;
+    uint64_t                   host_prof_num_samples;
+    uint64_t                   host_prof_dropped_base;
+
+    // Call graph profile: the shadow call stack (NULL when off), with the root frame first,
+    // and the functions and call edges, in arrays indexed by open addressed hash tables of
+    // twice their maximum size (holding array index + 1, with 0 marking an empty slot)
+    struct lm32_cg_frame_s*    cg_stack;
+    uint32_t                   cg_depth;
+    struct lm32_cg_fn_s*       cg_fns;
+    uint32_t*                  cg_fn_hash;
+    uint32_t                   cg_num_fns;
+    uint32_t                   cg_max_fns;
+    struct lm32_cg_edge_s*     cg_edges;
+    uint32_t*                  cg_edge_hash;
+    uint32_t                   cg_num_edges;
+    uint32_t                   cg_max_edges;
+
 #ifdef LM32_MMU
     lm32_tbl_t                 dtlb;
     lm32_tbl_t                 itlb;
+    lm32_tbl_t                 rp_dtlb;
+    lm32_tbl_t                 rp_itlb;
 #endif
 };
 #endif
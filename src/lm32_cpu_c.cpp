@@ -94,6 +94,32 @@ extern "C" void lm32c_register_ext_mem_callback (lm32c_hdl cpu_hdl, p_lm32_memca
     cpu->lm32_register_ext_mem_callback(callback_func);
 }
 
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_register_ext_mem_range_callback (lm32c_hdl cpu_hdl, p_lm32_memcallback_t callback_func,
+                                                       uint32_t start_addr, uint32_t end_addr, uint32_t type_mask)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_register_ext_mem_callback(callback_func, start_addr, end_addr, type_mask);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_add_ext_mem_callback (lm32c_hdl cpu_hdl, p_lm32_memcallback_t callback_func,
+                                           uint32_t start_addr, uint32_t end_addr, uint32_t type_mask)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_add_ext_mem_callback(callback_func, start_addr, end_addr, type_mask) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_remove_ext_mem_callback (lm32c_hdl cpu_hdl, p_lm32_memcallback_t callback_func)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_remove_ext_mem_callback(callback_func) ? TRUE : FALSE;
+}
+
 // --------------------------------------------------------------------------
 
 extern "C" void lm32c_register_jtag_callback (lm32c_hdl cpu_hdl, p_lm32_jtagcallback_t callback_func)
@@ -212,5 +238,195 @@ extern "C" lm32c_state lm32c_get_cpu_state (lm32c_hdl cpu_hdl)
     state_c.jtx  = state_cpp.jtx;
     state_c.jrx  = state_cpp.jrx;
 
+#ifdef LM32_MMU
+    state_c.psw         = state_cpp.psw;
+    state_c.tlbvaddr    = state_cpp.tlbvaddr;
+    state_c.tlbbadvaddr = state_cpp.tlbbadvaddr;
+#else
+    state_c.psw         = 0;
+    state_c.tlbvaddr    = 0;
+    state_c.tlbbadvaddr = 0;
+#endif
+
+    state_c.int_flags   = state_cpp.int_flags;
+    state_c.cycle_count = state_cpp.cycle_count;
+    state_c.instr_count = state_cpp.instr_count;
+
     return state_c;
 }
+
+// -------------------------------------------------------------------------
+
+extern "C" lm32c_snap_hdl lm32c_take_snapshot (lm32c_hdl cpu_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return (lm32c_snap_hdl)cpu->lm32_take_snapshot();
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_restore_snapshot (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_restore_snapshot((lm32_snapshot_t*)snap_hdl) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_serialise_snapshot (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl, FILE* fp, int flags)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_serialise_snapshot((lm32_snapshot_t*)snap_hdl, fp, flags);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" lm32c_snap_hdl lm32c_deserialise_snapshot (lm32c_hdl cpu_hdl, FILE* fp)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return (lm32c_snap_hdl)cpu->lm32_deserialise_snapshot(fp);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_free_snapshot (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_free_snapshot((lm32_snapshot_t*)snap_hdl);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_load_symbols (lm32c_hdl cpu_hdl, const char* fname)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_load_symbols(fname);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" const char* lm32c_lookup_symbol (lm32c_hdl cpu_hdl, uint32_t byte_addr, uint32_t* p_offset)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_lookup_symbol(byte_addr, p_offset);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_find_symbol (lm32c_hdl cpu_hdl, const char* name, uint32_t* p_addr)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_find_symbol(name, p_addr) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_set_line_file (lm32c_hdl cpu_hdl, const char* fname)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_set_line_file(fname);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_set_line_cache (lm32c_hdl cpu_hdl, const char* dir)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_set_line_cache(dir);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_lookup_line (lm32c_hdl cpu_hdl, uint32_t byte_addr, const char** p_file, uint32_t* p_line)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_lookup_line(byte_addr, p_file, p_line) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_set_startup_stats (lm32c_hdl cpu_hdl, int enable)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_set_startup_stats(enable ? true : false);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_dump_startup_stats (lm32c_hdl cpu_hdl, FILE* fp)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_dump_startup_stats(fp);
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_set_profile (lm32c_hdl cpu_hdl, uint32_t interval)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_set_profile(interval) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_clear_profile (lm32c_hdl cpu_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_clear_profile();
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_write_profile (lm32c_hdl cpu_hdl, const char* fname, int format)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_write_profile(fname, format) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_set_call_graph (lm32c_hdl cpu_hdl, int enable)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_set_call_graph(enable ? true : false) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_clear_call_graph (lm32c_hdl cpu_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_clear_call_graph();
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_write_call_graph (lm32c_hdl cpu_hdl, const char* fname)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_write_call_graph(fname) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_set_host_profile (lm32c_hdl cpu_hdl, uint32_t usecs, int with_ra)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_set_host_profile(usecs, with_ra ? true : false) ? TRUE : FALSE;
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" void lm32c_clear_host_profile (lm32c_hdl cpu_hdl)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    cpu->lm32_clear_host_profile();
+}
+
+// -------------------------------------------------------------------------
+
+extern "C" int lm32c_write_host_profile (lm32c_hdl cpu_hdl, const char* fname, int format)
+{
+    lm32_cpu* cpu = (lm32_cpu*)cpu_hdl;
+    return cpu->lm32_write_host_profile(fname, format) ? TRUE : FALSE;
+}
@@ -63,6 +63,9 @@ extern "C" {
 // Define a handle type for the C++ object that can be returned to the world of C
 typedef void* lm32c_hdl;
 
+// Handle type for in memory snapshots of a model's complete state
+typedef void* lm32c_snap_hdl;
+
 // Structure to return CPU register state
 typedef struct  {
 
@@ -90,6 +93,16 @@ typedef struct  {
     uint32_t jtx;   // JTAG TX register
     uint32_t jrx;   // JTAG RX register
 
+    // MMU registers (0 unless the model is built with LM32_MMU)
+    uint32_t psw;         // Processor status word
+    uint32_t tlbvaddr;    // TLB virtual address
+    uint32_t tlbbadvaddr; // TLB bad virtual address
+
+    // Model state not directly a mico32 register
+    uint32_t    int_flags;   // Bitmap flags to indicate requesting interrupt
+    lm32_time_t cycle_count; // Cycle count (doubles up as cc register)
+    uint64_t    instr_count; // Number of instructions executed since time 0
+
 } lm32c_state;
 
 // -------------------------------------------------------------------------
@@ -123,6 +136,12 @@ void        lm32c_reset_cpu                 (lm32c_hdl cpu_hdl);
 // Callback function registration
 void        lm32c_register_int_callback     (lm32c_hdl cpu_hdl, p_lm32_intcallback_t  callback_func);
 void        lm32c_register_ext_mem_callback (lm32c_hdl cpu_hdl, p_lm32_memcallback_t  callback_func);
+void        lm32c_register_ext_mem_range_callback
+                                            (lm32c_hdl cpu_hdl, p_lm32_memcallback_t  callback_func,
+                                             uint32_t start_addr, uint32_t end_addr, uint32_t type_mask);
+int         lm32c_add_ext_mem_callback      (lm32c_hdl cpu_hdl, p_lm32_memcallback_t  callback_func,
+                                             uint32_t start_addr, uint32_t end_addr, uint32_t type_mask);
+int         lm32c_remove_ext_mem_callback   (lm32c_hdl cpu_hdl, p_lm32_memcallback_t  callback_func);
 void        lm32c_register_jtag_callback    (lm32c_hdl cpu_hdl, p_lm32_jtagcallback_t callback_func);
 
 // Run-time re-configuration and status
@@ -141,6 +160,56 @@ void        lm32c_dump_registers            (lm32c_hdl cpu_hdl);
 uint32_t    lm32c_set_hw_debug_reg          (lm32c_hdl cpu_hdl, uint32_t address, int register_type);
 lm32c_state lm32c_get_cpu_state             (lm32c_hdl cpu_hdl);
 
+// In memory snapshots of the complete state (CPU, caches, TLBs and internal
+// memory). Handles share unchanged memory pages, and must be freed with
+// lm32c_free_snapshot(). Take and deserialise return NULL on failure, while
+// restore returns FALSE, and serialise an LM32_SNAP_xxx status.
+lm32c_snap_hdl lm32c_take_snapshot          (lm32c_hdl cpu_hdl);
+int         lm32c_restore_snapshot          (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl);
+int         lm32c_serialise_snapshot        (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl, FILE* fp, int flags);
+lm32c_snap_hdl lm32c_deserialise_snapshot   (lm32c_hdl cpu_hdl, FILE* fp);
+void        lm32c_free_snapshot             (lm32c_hdl cpu_hdl, lm32c_snap_hdl snap_hdl);
+
+// Symbol index, built from loaded ELF programs, or loaded from an ELF or
+// System.map file. Address lookups return the containing symbol's name (or
+// NULL) and the offset into it, and name lookups return TRUE if found.
+int         lm32c_load_symbols              (lm32c_hdl cpu_hdl, const char* fname);
+const char* lm32c_lookup_symbol             (lm32c_hdl cpu_hdl, uint32_t byte_addr, uint32_t* p_offset);
+int         lm32c_find_symbol               (lm32c_hdl cpu_hdl, const char* name, uint32_t* p_addr);
+
+// Source line table, from loaded ELF programs' DWARF line tables (or the set
+// ELF file), read on first lookup, and cached in any set cache directory.
+// Lookups return TRUE if the address has a source line, with its file name
+// and line number.
+void        lm32c_set_line_file             (lm32c_hdl cpu_hdl, const char* fname);
+void        lm32c_set_line_cache            (lm32c_hdl cpu_hdl, const char* dir);
+int         lm32c_lookup_line               (lm32c_hdl cpu_hdl, uint32_t byte_addr, const char** p_file, uint32_t* p_line);
+
+// Startup profile of host time spent in each startup phase, output when the
+// first instruction is executed if enabled, or dumped on demand.
+void        lm32c_set_startup_stats         (lm32c_hdl cpu_hdl, int enable);
+void        lm32c_dump_startup_stats        (lm32c_hdl cpu_hdl, FILE* fp);
+
+// Cycle sampling profile, sampling the PC every interval cycles (0 to stop),
+// written in LM32_PROF_FMT_xxx format. Set and write return TRUE on success.
+int         lm32c_set_profile               (lm32c_hdl cpu_hdl, uint32_t interval);
+void        lm32c_clear_profile             (lm32c_hdl cpu_hdl);
+int         lm32c_write_profile             (lm32c_hdl cpu_hdl, const char* fname, int format);
+
+// Call graph profile (not in fast builds), of the inclusive and exclusive costs
+// of each function and call edge, written in callgrind format. Set and write
+// return TRUE on success.
+int         lm32c_set_call_graph            (lm32c_hdl cpu_hdl, int enable);
+void        lm32c_clear_call_graph          (lm32c_hdl cpu_hdl);
+int         lm32c_write_call_graph          (lm32c_hdl cpu_hdl, const char* fname);
+
+// Host sampling profile (not on Windows), sampling the PC (and RA if with_ra)
+// every usecs microseconds of host CPU time (0 to stop), written in
+// LM32_PROF_FMT_xxx format. Set and write return TRUE on success.
+int         lm32c_set_host_profile          (lm32c_hdl cpu_hdl, uint32_t usecs, int with_ra);
+void        lm32c_clear_host_profile        (lm32c_hdl cpu_hdl);
+int         lm32c_write_host_profile        (lm32c_hdl cpu_hdl, const char* fname, int format);
+
 
 #ifdef __cplusplus
 }
@@ -182,6 +182,10 @@ void lm32_cpu::disassemble(const p_lm32_decode_t d, FILE *ofp, const bool disass
     // Remember the last disassembled PC to aid in display of jumps
     static int last_disassembled_pc = -1;
 
+    // Remember the last source line noted, to note only changes
+    static const char* last_src_file = NULL;
+    static uint32_t    last_src_line = 0;
+
     // List of CSR register strings
     static const char* csr_name_str[] = CSR_NAMES;
 
@@ -195,6 +199,30 @@ void lm32_cpu::disassemble(const p_lm32_decode_t d, FILE *ofp, const bool disass
         fprintf(ofp, "*\n");
     }
 
+    // Label the start of each indexed symbol
+    if (num_syms)
+    {
+        uint32_t    sym_offset;
+        const char* sym = lm32_lookup_symbol(state.pc, &sym_offset);
+
+        if (sym != NULL && sym_offset == 0)
+        {
+            fprintf(ofp, "<%s>:\n", sym);
+        }
+    }
+
+    // Note the source line, where it changes
+    const char* src_file;
+    uint32_t    src_line;
+
+    if (lm32_lookup_line(state.pc, &src_file, &src_line) && (src_file != last_src_file || src_line != last_src_line))
+    {
+        fprintf(ofp, "; %s:%u\n", src_file, src_line);
+
+        last_src_file = src_file;
+        last_src_line = src_line;
+    }
+
     fprintf(ofp, "0x%08x: (0x%08x)   %s", state.pc, d->opcode, (d->opcode == INSTR_NOP)   ? "nop  " :
                                                                (d->opcode == INSTR_BREAK) ? "break    " :
                                                                (d->opcode == INSTR_SCALL) ? "scall    " :
@@ -31,135 +31,258 @@
 // -------------------------------------------------------------------------
 
 #include <cstdio>
+#include <cstring>
 #include <stdint.h>
 
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
 #include "lm32_cpu.h"
 #include "lm32_cpu_elf.h"
 #include "lm32_cpu_mico32.h"
 
+// -------------------------------------------------------------------------
+// map_elf_file()
+//
+// Map the named file (an ELF file, or a line table cache) read only,
+// returning a pointer to its contents and setting *p_len to its length, or
+// returning NULL on failure. Where mmap isn't supported, the file is read
+// whole into an allocated buffer instead.
+//
+// -------------------------------------------------------------------------
+
+uint8_t* map_elf_file (const char* filename, size_t* p_len)
+{
+    uint8_t* image;
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    int         fd;
+    struct stat st;
+
+    if ((fd = open(filename, O_RDONLY)) < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    *p_len = (size_t)st.st_size;
+    image  = (uint8_t*)mmap(NULL, *p_len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping remains valid after the file is closed
+    close(fd);
+
+    return (image == (uint8_t*)MAP_FAILED) ? NULL : image;
+#else
+    FILE* fp;
+    long  len;
+
+    if ((fp = fopen(filename, "rb")) == NULL)
+    {
+        return NULL;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0 ||
+        (image = (uint8_t*)malloc((size_t)len)) == NULL)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    if (fread(image, 1, (size_t)len, fp) != (size_t)len)
+    {
+        free(image);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    *p_len = (size_t)len;
+    return image;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// unmap_elf_file()
+//
+// Release a file image returned by map_elf_file().
+//
+// -------------------------------------------------------------------------
+
+void unmap_elf_file (uint8_t* image, const size_t len)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    munmap(image, len);
+#else
+    free(image);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// read_elf()
+//
+// Load the PT_LOAD segments of an executable mico32 ELF file to memory.
+// Segments that lie wholly in internal memory, and aren't intercepted by a
+// memory write callback (see bulk_mem_range()), are copied in bulk to the
+// backing store (which holds words big endian, as in the file), with the
+// segment's BSS zero filled, and its pages marked dirty and memory tagged
+// for the whole range. Any other segment is loaded a word at a time
+// through lm32_write_mem(). There is no limit on the number of program
+// headers. The program's symbols are indexed, and its source line table
+// (if any) used for source line lookups.
+//
+// -------------------------------------------------------------------------
+
 void lm32_cpu::read_elf (const char * const filename)
 {
-    int         i, c;
-    uint32_t    pcount, bytecount = 0;
-    uint32_t    word;
-    pElf32_Ehdr h;
-    pElf32_Phdr h2[ELF_MAX_NUM_PHDR];
-    char        buf[sizeof(Elf32_Ehdr)];
-    char        buf2[sizeof(Elf32_Phdr)*ELF_MAX_NUM_PHDR];
-    const char* ptr;
-    FILE*       elf_fp;
-
-
-    // Open program file ready for loading
-    if ((elf_fp = fopen(filename, "rb")) == NULL)
+    uint8_t*    image;
+    size_t      image_len;
+    Elf32_Ehdr  h;
+    Elf32_Phdr  ph;
+
+    // Map program file ready for loading
+    if ((image = map_elf_file(filename, &image_len)) == NULL)
     {
         fprintf(stderr, "*** ReadElf(): Unable to open file %s for reading\n", filename); //LCOV_EXCL_LINE
         exit(LM32_USER_ERROR);                                                            //LCOV_EXCL_LINE
     }
 
-    // Read elf header
-    h = (pElf32_Ehdr) buf;
-    for (i = 0; i < sizeof(Elf32_Ehdr); i++)
+    //LCOV_EXCL_START
+    // Check some things
+    if (image_len < sizeof(Elf32_Ehdr))
     {
-        buf[i] = fgetc(elf_fp);
-        bytecount++;
-        if (buf[i] == EOF) 
-        {
-            fprintf(stderr, "*** ReadElf(): unexpected EOF\n");                           //LCOV_EXCL_LINE
-            exit(LM32_USER_ERROR);                                                        //LCOV_EXCL_LINE
-        } 
+        fprintf(stderr, "*** ReadElf(): unexpected EOF\n");
+        exit(LM32_USER_ERROR);
     }
 
-    //LCOV_EXCL_START
-    // Check some things
-    ptr= ELF_IDENT;
-    for (i = 0; i < 4; i++) 
+    memcpy(&h, image, sizeof(Elf32_Ehdr));
+
+    if (memcmp(h.e_ident, ELF_IDENT, 4))
     {
-        if (h->e_ident[i] != ptr[i])
-        {
-            fprintf(stderr, "*** ReadElf(): not an ELF file\n");
-            exit(LM32_USER_ERROR);
-        }
+        fprintf(stderr, "*** ReadElf(): not an ELF file\n");
+        exit(LM32_USER_ERROR);
     }
 
-    if (SWAPHALF(h->e_type) != ET_EXEC)
+    if (SWAPHALF(h.e_type) != ET_EXEC)
     {
         fprintf(stderr, "*** ReadElf(): not an executable ELF file\n");
         exit(LM32_USER_ERROR);
     }
 
-    if (SWAPHALF(h->e_machine) != EM_LATTICEMICO32 && SWAPHALF(h->e_machine) != EM_LATTICEMICO32_OLD)
+    if (SWAPHALF(h.e_machine) != EM_LATTICEMICO32 && SWAPHALF(h.e_machine) != EM_LATTICEMICO32_OLD)
     {
         fprintf(stderr, "*** ReadElf(): not a Mico32 ELF file\n");
         exit(LM32_USER_ERROR);
     }
 
-    if (SWAPHALF(h->e_phnum) > ELF_MAX_NUM_PHDR)
+    uint32_t phoff     = SWAP(h.e_phoff);
+    uint32_t phnum     = SWAPHALF(h.e_phnum);
+    uint32_t phentsize = SWAPHALF(h.e_phentsize);
+
+    if (phnum && (phentsize < sizeof(Elf32_Phdr) || (uint64_t)phoff + (uint64_t)phnum * phentsize > image_len))
     {
-        fprintf(stderr, "*** ReadElf(): Number of Phdr (%d) exceeds maximum supported (%d)\n", SWAPHALF(h->e_phnum), ELF_MAX_NUM_PHDR);
+        fprintf(stderr, "*** ReadElf(): unexpected EOF\n");
         exit(LM32_USER_ERROR);
     }
     //LCOV_EXCL_STOP
 
-    // Read program headers
-    for (pcount=0 ; pcount < SWAPHALF(h->e_phnum); pcount++)
+    // Load text/data segments
+    for (uint32_t pcount = 0; pcount < phnum; pcount++)
     {
-        for (i = 0; i < sizeof(Elf32_Phdr); i++)
+        memcpy(&ph, &image[phoff + pcount * phentsize], sizeof(Elf32_Phdr));
+
+        if (SWAP(ph.p_type) != PT_LOAD)
         {
-            c = fgetc(elf_fp);
-            if (c == EOF)
-            {
-                fprintf(stderr, "*** ReadElf(): unexpected EOF\n");                         //LCOV_EXCL_LINE
-                exit(LM32_USER_ERROR);                                                      //LCOV_EXCL_LINE
-            } 
-            buf2[i+(pcount * sizeof(Elf32_Phdr))] = c;
-            bytecount++;
+            continue;
         }
-    }
 
-    // Load text/data segments
-    for (pcount=0 ; pcount < SWAPHALF(h->e_phnum); pcount++)
-    {
-        h2[pcount] = (pElf32_Phdr) &buf2[pcount * sizeof(Elf32_Phdr)];
+        uint32_t vaddr  = SWAP(ph.p_vaddr);
+        uint32_t offset = SWAP(ph.p_offset);
+        uint32_t filesz = SWAP(ph.p_filesz);
+        uint32_t memsz  = SWAP(ph.p_memsz);
+        uint32_t flags  = SWAP(ph.p_flags);
 
-        // Gobble bytes until section start
-        for (; bytecount < SWAP(h2[pcount]->p_offset); bytecount++)
+        if (memsz < filesz)
         {
-            c = fgetc(elf_fp);
-            if (c == EOF) {
-                fprintf(stderr, "*** ReadElf(): unexpected EOF\n");                         //LCOV_EXCL_LINE
-                exit(LM32_USER_ERROR);                                                      //LCOV_EXCL_LINE
-            }
+            memsz = filesz;                                                             //LCOV_EXCL_LINE
+        }
+
+        if ((uint64_t)offset + filesz > image_len)
+        {
+            fprintf(stderr, "*** ReadElf(): unexpected EOF\n");                         //LCOV_EXCL_LINE
+            exit(LM32_USER_ERROR);                                                      //LCOV_EXCL_LINE
         }
 
         // Check we can load the segment to memory
-        if ((SWAP(h2[pcount]->p_vaddr) + SWAP(h2[pcount]->p_memsz)) >= (1 << MEM_SIZE_BITS))
+        if (((uint64_t)vaddr + memsz) >= (1ULL << MEM_SIZE_BITS))
         {
             fprintf(stderr, "*** ReadElf(): segment memory footprint outside of internal memory range\n"); //LCOV_EXCL_LINE
             exit(LM32_USER_ERROR);                                                                         //LCOV_EXCL_LINE
         }
 
-        // For p_filesz bytes ...
-        i = 0;
-        word = 0;
-        for (; bytecount < (SWAP(h2[pcount]->p_offset) + SWAP(h2[pcount]->p_filesz)); bytecount++)
+        if (memsz == 0)
         {
-            if ((c = fgetc(elf_fp)) == EOF)
-            {
-                fprintf(stderr, "*** ReadElf(): unexpected EOF\n");                         //LCOV_EXCL_LINE
-                exit(LM32_USER_ERROR);                                                      //LCOV_EXCL_LINE
-            }
+            continue;
+        }
 
-            // Big endian
-            word |= (c << ((3-(bytecount&3)) * 8));
+        // Load in bulk if the segment is all in internal memory, and can't be intercepted
+        uint32_t mem_idx;
 
-            if ((bytecount&3) == 3)
+        if (bulk_mem_range(vaddr, memsz, LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_WORD) | LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_INSTR), &mem_idx))
+        {
+            memcpy(&mem[mem_idx], &image[offset], filesz);
+            memset(&mem[mem_idx + filesz], 0, memsz - filesz);
+
+            bulk_mem_loaded(mem_idx, memsz, (flags & PF_X) ? MEM_INSTRUCTION_WR : MEM_DATA_WR);
+        }
+        else
+        {
+            // Load big endian words, with any bytes beyond the file data as zero
+            for (uint32_t idx = 0; idx < memsz; idx += 4)
             {
-                load_mem_word(SWAP(h2[pcount]->p_vaddr) + i, word, SWAP(h2[pcount]->p_flags));
-                i+=4;
-                word = 0;
+                uint32_t word = 0;
+
+                for (uint32_t bdx = idx; bdx < idx + 4; bdx++)
+                {
+                    word = (word << 8) | ((bdx < filesz) ? image[offset + bdx] : 0);
+                }
+
+                load_mem_word(vaddr + idx, word, flags);
             }
         }
     }
+
+    // Index the program's symbols (if it has any)
+    read_elf_symbols(image, image_len);
+
+    // Look up source lines in the program's line table (read on first lookup)
+    lm32_set_line_file(filename);
+
+    unmap_elf_file(image, image_len);
 }
 
+// -------------------------------------------------------------------------
+// lm32_load_elf()
+//
+// Load an ELF program to memory (see read_elf()) without running it, as
+// part of the model's startup.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_load_elf (const char* fname)
+{
+    int prev_phase = lm32_enter_startup_phase(LM32_STARTUP_LOAD);
+
+    read_elf(fname);
+
+    lm32_leave_startup_phase(prev_phase);
+}
@@ -65,7 +65,70 @@
 
 #define ELF_IDENT                 "\177ELF"
 
-#define ELF_MAX_NUM_PHDR          4
+// Program header types
+#define PT_NULL                   0
+#define PT_LOAD                   1
+#define PT_DYNAMIC                2
+#define PT_INTERP                 3
+#define PT_NOTE                   4
+
+// Section header types, and special section indexes
+#define SHT_NULL                  0
+#define SHT_PROGBITS              1
+#define SHT_SYMTAB                2
+#define SHT_STRTAB                3
+
+#define SHN_UNDEF                 0
+#define SHN_ABS                   0xfff1
+
+// Symbol types and bindings
+#define STT_NOTYPE                0
+#define STT_OBJECT                1
+#define STT_FUNC                  2
+#define STT_SECTION               3
+#define STT_FILE                  4
+
+#define STB_LOCAL                 0
+#define STB_GLOBAL                1
+#define STB_WEAK                  2
+
+#define ELF32_ST_BIND(_I)         ((_I) >> 4)
+#define ELF32_ST_TYPE(_I)         ((_I) & 0xf)
+
+// DWARF line number program standard opcodes
+#define DW_LNS_copy               1
+#define DW_LNS_advance_pc         2
+#define DW_LNS_advance_line       3
+#define DW_LNS_set_file           4
+#define DW_LNS_set_column         5
+#define DW_LNS_negate_stmt        6
+#define DW_LNS_set_basic_block    7
+#define DW_LNS_const_add_pc       8
+#define DW_LNS_fixed_advance_pc   9
+
+// DWARF line number program extended opcodes
+#define DW_LNE_end_sequence       1
+#define DW_LNE_set_address        2
+#define DW_LNE_define_file        3
+
+// DWARF 5 line table header entry content types, and the forms they may take
+#define DW_LNCT_path              1
+#define DW_LNCT_directory_index   2
+
+#define DW_FORM_block2            0x03
+#define DW_FORM_block4            0x04
+#define DW_FORM_data2             0x05
+#define DW_FORM_data4             0x06
+#define DW_FORM_data8             0x07
+#define DW_FORM_string            0x08
+#define DW_FORM_block             0x09
+#define DW_FORM_block1            0x0a
+#define DW_FORM_data1             0x0b
+#define DW_FORM_sdata             0x0d
+#define DW_FORM_strp              0x0e
+#define DW_FORM_udata             0x0f
+#define DW_FORM_data16            0x1e
+#define DW_FORM_line_strp         0x1f
 
 #define PrintPhdr(_P) {\
     fprintf(stderr, " p_type = %x\n p_offset = %x\n p_vaddr = %x\n p_paddr = %x\n p_filesz = %x\n p_memsz = %x\n p_flags = %x\n p_align = %x\n\n", \
@@ -109,5 +172,33 @@ typedef struct {
     Elf32_Word p_align;
 } Elf32_Phdr, *pElf32_Phdr;
 
+typedef struct {
+    Elf32_Word sh_name;
+    Elf32_Word sh_type;
+    Elf32_Word sh_flags;
+    Elf32_Addr sh_addr;
+    Elf32_Off  sh_offset;
+    Elf32_Word sh_size;
+    Elf32_Word sh_link;
+    Elf32_Word sh_info;
+    Elf32_Word sh_addralign;
+    Elf32_Word sh_entsize;
+} Elf32_Shdr, *pElf32_Shdr;
+
+typedef struct {
+    Elf32_Word    st_name;
+    Elf32_Addr    st_value;
+    Elf32_Word    st_size;
+    unsigned char st_info;
+    unsigned char st_other;
+    Elf32_Half    st_shndx;
+} Elf32_Sym, *pElf32_Sym;
+
+// -------------------------------------------------------------------------
+// PUBLIC PROTOTYPES
+// -------------------------------------------------------------------------
+
+extern uint8_t* map_elf_file   (const char* filename, size_t* p_len);
+extern void     unmap_elf_file (uint8_t* image, const size_t len);
 
 #endif
@@ -61,6 +61,7 @@
 #define LM32_INT_BREAK               9
 #define LM32_BUS_ERROR_BREAK         10
 #define LM32_DIV_ZERO_BREAK          11
+#define LM32_CHECKPOINT_BREAK        12
 
 // Default values for configuration
 #ifndef LNXMICO32
@@ -109,6 +110,27 @@
 // External memory callback return values
 #define LM32_EXT_MEM_NOT_PROCESSED   (-1)
 
+// External memory callback filtering. Each registered callback has an
+// inclusive address range and a mask of access types (one bit per
+// memory access type, as defined above) for which it is called.
+#define LM32_MAX_MEM_CALLBACKS       8
+
+#define LM32_MEM_CB_START_ADDR       0x00000000U
+#define LM32_MEM_CB_END_ADDR         0xffffffffU
+
+#define LM32_MEM_CB_TYPE(_TYPE)      (1U << ((_TYPE) & LM32_MEM_NOT_DBG_MASK))
+
+#define LM32_MEM_CB_WR_DATA          (LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_BYTE)  | \
+                                      LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_HWORD) | \
+                                      LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_WORD))
+#define LM32_MEM_CB_RD_DATA          (LM32_MEM_CB_TYPE(LM32_MEM_RD_ACCESS_BYTE)  | \
+                                      LM32_MEM_CB_TYPE(LM32_MEM_RD_ACCESS_HWORD) | \
+                                      LM32_MEM_CB_TYPE(LM32_MEM_RD_ACCESS_WORD))
+#define LM32_MEM_CB_WR_INSTR         LM32_MEM_CB_TYPE(LM32_MEM_WR_ACCESS_INSTR)
+#define LM32_MEM_CB_RD_INSTR         LM32_MEM_CB_TYPE(LM32_MEM_RD_INSTR)
+#define LM32_MEM_CB_DATA             (LM32_MEM_CB_WR_DATA | LM32_MEM_CB_RD_DATA)
+#define LM32_MEM_CB_ALL_TYPES        (LM32_MEM_CB_DATA | LM32_MEM_CB_WR_INSTR | LM32_MEM_CB_RD_INSTR)
+
 // Bit field definitions for CFG register
 #define LM32_CFG_M                   0
 #define LM32_CFG_D                   1
@@ -233,6 +255,147 @@
 // Default size of internal memory
 #define LM32_DEFAULT_MEM_SIZE        (0x10000)
 
+// Dirty page tracking of internal memory, with one bit per page
+#define LM32_DIRTY_PAGE_BITS         10
+#define LM32_DIRTY_PAGE_SIZE         (1 << LM32_DIRTY_PAGE_BITS)
+
+// Control flow edge coverage map, with a hit count for each (hashed) edge
+#define LM32_COV_MAP_BITS            16
+#define LM32_COV_MAP_SIZE            (1 << LM32_COV_MAP_BITS)
+#define LM32_COV_HASH_MULT           0x9e3779b1U
+
+// Fuzzing defaults for maximum input size (bytes) and output file prefix
+#define LM32_FUZZ_DEFAULT_MAX_INPUT  4096
+#define LM32_FUZZ_DEFAULT_PREFIX     "fuzz"
+
+// Fault injection defaults: fault targets (r = registers, m = memory, i = instructions)
+// and random number seed
+#define LM32_FAULT_DEFAULT_TARGETS   "rmi"
+#define LM32_FAULT_DEFAULT_SEED      1
+
+// Return value of lm32_map_file_to_mem() when a file can't be mapped
+#define LM32_MAP_FAILED              (-1)
+
+// Return value of lm32_load_file_to_mem() when a file can't be read, and the
+// size of the host buffer it's read through
+#define LM32_LOAD_FAILED             (-1)
+#define LM32_LOAD_CHUNK_BYTES        (1 << 20)
+
+// Startup profile phases, timed in host microseconds up to the first instruction
+#define LM32_STARTUP_NONE            (-1)
+#define LM32_STARTUP_CONFIG          0                  // Command line and .ini file processing (timed by the caller)
+#define LM32_STARTUP_CONSTRUCT       1                  // Model construction
+#define LM32_STARTUP_MEM_ALLOC       2                  // Internal memory and tag allocation
+#define LM32_STARTUP_CACHE_ALLOC     3                  // Cache allocation
+#define LM32_STARTUP_LOAD            4                  // Program, image and snapshot loading
+#define LM32_STARTUP_NUM_PHASES      5
+
+// Cycle sampling profile default interval (simulated cycles), host sampling profile
+// default interval (microseconds of host CPU time), output file prefix, and output formats
+#define LM32_PROF_DEFAULT_INTERVAL   10000
+#define LM32_PROF_DEFAULT_HOST_USECS 1000
+#define LM32_PROF_DEFAULT_PREFIX     "profile"
+#define LM32_PROF_NEVER              0x7fffffffffffffffLL   // Next sample point when not profiling
+#define LM32_PROF_FMT_CALLGRIND      0                  // Callgrind format, for KCachegrind and callgrind_annotate
+#define LM32_PROF_FMT_FOLDED         1                  // Folded stacks, for flame graphs
+
+// The host sampling profile's samples are drained from the signal handler's ring buffer
+// by the run loop's checkpoint poll, every LM32_PROF_HOST_POLL_INSTR instructions
+#define LM32_PROF_HOST_POLL_INSTR    10000
+
+// Return value of lm32_load_symbols() when a symbol file can't be read
+#define LM32_SYM_LOAD_FAILED         (-1)
+
+// Source line table cache, when enabled with lm32_set_line_cache(), written
+// the first time an ELF file's DWARF line table is parsed (as <file>.lines),
+// in host byte order
+#define LM32_LINE_CACHE_EXT          ".lines"
+#define LM32_LINE_CACHE_MAGIC        "LM32LINE"
+#define LM32_LINE_CACHE_VERSION      2
+
+// Snapshot file format. A file header (magic, version and host byte order
+// marker) is followed by sections, each with an ID, a version and a byte length,
+// and terminated with an END section. Unknown sections are skipped on loading,
+// and section contents are only ever appended to, so that older snapshots remain
+// loadable (missing fields default to 0).
+#define LM32_SNAP_MAGIC              "LM32SNAP"
+#define LM32_SNAP_MAGIC_LEN          8
+#define LM32_SNAP_VERSION            1
+#define LM32_SNAP_BYTE_ORDER         0x01020304U
+
+#define LM32_SNAP_SECT_END           0
+#define LM32_SNAP_SECT_CPU           1
+#define LM32_SNAP_SECT_TIMING        2
+#define LM32_SNAP_SECT_TLB           3
+#define LM32_SNAP_SECT_ICACHE        4
+#define LM32_SNAP_SECT_DCACHE        5
+#define LM32_SNAP_SECT_MEM           6
+#define LM32_SNAP_SECT_CKPT          7
+#define LM32_SNAP_SECT_USER          0x100           // First ID for user (e.g. peripheral) sections
+
+// Snapshot save flags
+#define LM32_SNAP_DIRTY_PAGES        0x1             // Save only dirty internal memory pages (else all non-zero pages)
+#define LM32_SNAP_COMPRESS           0x2             // Compress internal memory data
+#define LM32_SNAP_CHECKPOINT         0x4             // Dirty pages are those since the last checkpoint, which this starts
+#define LM32_SNAP_BACKGROUND         0x8             // Write from a forked copy-on-write process (where supported)
+#define LM32_SNAP_MAPPABLE           0x10            // Save all internal memory as an uncompressed image that restores can map
+
+// Internal memory is saved in chunks of up to this many contiguous pages
+#define LM32_SNAP_CHUNK_PAGES        64
+#define LM32_SNAP_CHUNK_COMPRESSED   0x1
+#define LM32_SNAP_CHUNK_IMAGE        0x2
+
+// Mappable memory images are aligned in the file to this many bytes (a multiple
+// of any host's page size)
+#define LM32_SNAP_MAP_ALIGN          0x10000
+
+// Periodic checkpoints. Host time intervals are polled every LM32_CKPT_POLL_INSTR
+// instructions. Checkpoint numbers for lm32_restore_checkpoint() can be the latest,
+// whilst LM32_CKPT_NONE is for use by configuration, for no restore.
+#define LM32_CKPT_POLL_INSTR         1000000
+#define LM32_CKPT_DEFAULT_KEEP       4
+#define LM32_CKPT_LATEST             (-1)
+#define LM32_CKPT_NONE               (-2)
+
+// Record and replay of external inputs
+#define LM32_REPLAY_OFF              0
+#define LM32_REPLAY_RECORD           1
+#define LM32_REPLAY_PLAY             2
+
+#define LM32_REPLAY_MAGIC            "LM32RPLY"
+#define LM32_REPLAY_MAGIC_LEN        8
+#define LM32_REPLAY_VERSION          1
+
+// Replay log input channels
+#define LM32_REPLAY_CHAN_INT         0               // External interrupt callback results
+#define LM32_REPLAY_CHAN_JTX         1               // JTAG TX register reads
+#define LM32_REPLAY_CHAN_JRX         2               // JTAG RX register reads
+#define LM32_REPLAY_CHAN_USER        0x10            // First channel for user (e.g. peripheral) inputs
+
+// Snapshot save/load return status
+#define LM32_SNAP_OK                 0
+#define LM32_SNAP_OPEN_ERROR         (-1)
+#define LM32_SNAP_IO_ERROR           (-2)
+#define LM32_SNAP_FORMAT_ERROR       (-3)
+#define LM32_SNAP_VERSION_ERROR      (-4)
+#define LM32_SNAP_MEM_ERROR          (-5)
+
+// Types of host pages backing internal memory
+#define LM32_MEM_PAGES_NORMAL        0
+#define LM32_MEM_PAGES_TRANSPARENT   1
+#define LM32_MEM_PAGES_HUGETLB       2
+
+#define LM32_HUGE_PAGE_SIZE          (2 * 1024 * 1024)
+
+// Memory latency map definitions. Statistics are kept for each configured
+// region, plus internal memory accesses outside of all regions (using
+// mem_wait_states) and accesses processed by an external memory callback.
+#define LM32_MAX_MEM_REGIONS         8
+#define LM32_MEM_REGION_DEFAULT      LM32_MAX_MEM_REGIONS
+#define LM32_MEM_REGION_EXTERNAL     (LM32_MAX_MEM_REGIONS + 1)
+#define LM32_NUM_MEM_REGION_STATS    (LM32_MAX_MEM_REGIONS + 2)
+#define LM32_MEM_REGION_NO_PAGE      0xffffffffU
+
 // Basic configurations definitions
 #define LM32_NUM_OF_REGISTERS        (32)
 #define LM32_NUM_OPCODES             (64)
@@ -307,6 +470,15 @@ typedef int      (*p_lm32_memcallback_t) (const uint32_t byte_addr, uint32_t *da
 // JTAG callback types
 typedef void     (*p_lm32_jtagcallback_t) (uint32_t *data, const int type, const lm32_time_t time);
 
+// Registered memory callback entry, with the address range (inclusive) and
+// access types (LM32_MEM_CB_xxx mask) for which the callback is called
+typedef struct {
+    p_lm32_memcallback_t callback;
+    uint32_t             start_addr;
+    uint32_t             end_addr;
+    uint32_t             type_mask;
+} lm32_mem_callback_t;
+
 // Decode table entry structure type definition
 typedef struct {
     const char* instr_name;            // Instruction name string for disassembly
@@ -337,6 +509,45 @@ typedef struct {
     int      cache_bytes_per_line;
 } lm32_cache_config_t;
 
+// Memory latency map region configuration. An access within base_addr to
+// limit (inclusive) that is not a cache hit takes rd_wait_states or
+// wr_wait_states, with each subsequent word of a cache line fill taking
+// burst_wait_states. If page_bytes is non-zero the region is modelled as
+// SDRAM-like, with a single open page, and an access to any other page
+// additionally takes page_miss_wait_states (and opens that page).
+typedef struct {
+    uint32_t base_addr;
+    uint32_t limit;
+    int      rd_wait_states;
+    int      wr_wait_states;
+    int      burst_wait_states;
+    uint32_t page_bytes;
+    int      page_miss_wait_states;
+} lm32_mem_region_cfg_t;
+
+// Memory latency map per-region statistics
+typedef struct {
+    uint64_t    reads;
+    uint64_t    writes;
+    uint64_t    line_fills;
+    uint64_t    page_misses;
+    lm32_time_t wait_cycles;
+} lm32_mem_region_stats_t;
+
+// User snapshot section, for saving and restoring state external to the CPU
+// (e.g. peripherals) along with the CPU's. On loading, data is filled up to
+// len bytes (zero filled if the saved section is shorter), and version set to
+// the saved section's version, or 0 if not present in the snapshot.
+typedef struct {
+    uint32_t id;
+    uint32_t version;
+    void*    data;
+    uint32_t len;
+} lm32_snap_section_t;
+
+// In memory snapshot (opaque), as returned by lm32_take_snapshot()
+typedef struct lm32_snapshot_s lm32_snapshot_t;
+
 // Configuration structure for use externally to the model (not used internally)
 typedef struct {
     char*               filename;
@@ -359,6 +570,8 @@ typedef struct {
     uint32_t            mem_size;
     uint32_t            mem_offset;
     int                 mem_wait_states;
+    int                 num_mem_regions;
+    lm32_mem_region_cfg_t mem_regions[LM32_MAX_MEM_REGIONS];
     int32_t             disassemble_start;
     uint32_t            cfg_word;
     lm32_cache_config_t dcache_cfg;
@@ -366,9 +579,45 @@ typedef struct {
     char*               save_fname;
     bool                load_state_file;
     bool                save_state_file;
+    bool                compress_state;
+    int64_t             checkpoint_instr;
+    int                 checkpoint_secs;
+    int                 checkpoint_keep;
+    bool                background_checkpoints;
+    bool                mappable_state;
+    int                 num_instances;
+    char*               record_fname;
+    char*               replay_fname;
+    int                 restore_checkpoint;
+    bool                fork_server;
+    int32_t             fork_server_start_addr;
+    char*               fuzz_seed_fname;
+    int32_t             harness_entry_addr;
+    int32_t             fuzz_input_addr;
+    int                 fuzz_max_input_bytes;
+    int                 fuzz_iterations;
+    char*               fuzz_out_prefix;
+    int                 fault_runs;
+    int                 fault_jobs;
+    char*               fault_targets;
+    uint32_t            fault_mem_start_addr;
+    uint32_t            fault_mem_end_addr;
+    uint32_t            fault_seed;
+    char*               fault_results_fname;
     bool                gdb_run;
     int                 com_port_num;
     bool                use_tcp_skt;
+    bool                map_images;
+    bool                huge_pages;
+    bool                startup_stats;
+    uint32_t            prof_cycle_interval;
+    bool                prof_call_graph;
+    uint32_t            prof_host_usecs;
+    bool                prof_host_ra;
+    char*               prof_out_prefix;
+    char*               line_cache_dir;
+    uint32_t            initrd_addr;
+    char*               cmdline;
 } lm32_config_t;
 
 #endif
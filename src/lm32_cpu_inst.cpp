@@ -1298,6 +1298,11 @@ void lm32_cpu::lm32_rcsr (const p_lm32_decode_t p)
                 pJtagCallback (&state.jtx, LM32_JTX_RD, state.cycle_count);
             }
                 
+            if (replay_mode != LM32_REPLAY_OFF)
+            {
+                replay_jtag(LM32_REPLAY_CHAN_JTX, &state.jtx);
+            }
+
             state.jtx &= ~(0xfffffe00);
             state.r[p->reg2] = state.jtx;
         }
@@ -1312,6 +1317,11 @@ void lm32_cpu::lm32_rcsr (const p_lm32_decode_t p)
                 pJtagCallback (&state.jrx, LM32_JRX_RD, state.cycle_count);
             }
                 
+            if (replay_mode != LM32_REPLAY_OFF)
+            {
+                replay_jtag(LM32_REPLAY_CHAN_JRX, &state.jrx);
+            }
+
             state.jrx &= ~(0xfffffe00);
             state.r[p->reg2] = state.jrx;
         }
@@ -0,0 +1,1293 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell
+//
+// Source line table methods for the lm32_cpu class
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <sys/types.h>
+
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+#include "lm32_cpu.h"
+#include "lm32_cpu_elf.h"
+#include "lm32_cpu_mico32.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Initial number of rows, files, file name pool bytes and per compilation
+// unit table entries allocated when building a line table (doubled as needed)
+#define LINE_INIT_ROWS           4096
+#define LINE_INIT_FILES          256
+#define LINE_INIT_STRING_BYTES   16384
+#define LINE_INIT_CU_ENTRIES     64
+
+// Maximum length of a file name, including its directory
+#define LINE_MAX_PATH            1024
+
+// Escape value of a 32 bit DWARF unit length, indicating the 64 bit format
+#define LINE_DWARF64_ESCAPE      0xffffffff
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+// Line table cache file header, followed by the row addresses, line numbers
+// and file numbers, the file name offsets, and the file name pool. A line
+// number of 0 marks the end of a sequence of rows (i.e. no source line).
+// The ELF file's size and content digest are checked, on mapping the
+// cache, to detect a stale cache.
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t elf_size;
+    uint64_t elf_digest;
+    uint32_t num_rows;
+    uint32_t num_files;
+    uint32_t str_bytes;
+    uint32_t reserved;
+} line_cache_hdr_t;
+
+// Row of the line number program state machine whilst building a table,
+// with its position in the program, so that where rows share an address
+// the last (and any after an end of sequence) is kept
+typedef struct {
+    uint32_t addr;
+    uint32_t line;
+    uint32_t file;
+    uint32_t order;
+} line_row_t;
+
+// Line table whilst being built: rows, and the file names (deduplicated
+// across compilation units with a hash table of file numbers)
+typedef struct {
+    line_row_t* rows;
+    uint32_t    num_rows;
+    uint32_t    max_rows;
+    uint32_t*   file_name;
+    uint32_t    num_files;
+    uint32_t    max_files;
+    char*       strings;
+    uint32_t    str_len;
+    uint32_t    str_max;
+    uint32_t*   hash;
+    uint32_t    hash_size;
+} line_build_t;
+
+// Reader of big endian DWARF data, with a sticky error on overrunning the end
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool           err;
+} dw_rd_t;
+
+// Directory or file name entry of a compilation unit's line table header,
+// with the file number it's been given in the table being built (files only)
+typedef struct {
+    const char* name;
+    uint32_t    dir;
+    uint32_t    file;
+} dw_entry_t;
+
+// Sections of the ELF file holding the line table, and the strings that
+// DWARF 5 line table headers may refer to
+typedef struct {
+    const uint8_t* line;
+    uint32_t       line_len;
+    const uint8_t* line_str;
+    uint32_t       line_str_len;
+    const uint8_t* str;
+    uint32_t       str_len;
+} dw_sections_t;
+
+// -------------------------------------------------------------------------
+// DWARF data readers
+//
+// Each returns 0 (or NULL) and sets the reader's error if the data would
+// overrun the end of the section
+//
+// -------------------------------------------------------------------------
+
+static uint64_t dw_rd_bytes (dw_rd_t* r, const uint32_t num)
+{
+    uint64_t val = 0;
+
+    if (r->err || (size_t)(r->end - r->p) < num)
+    {
+        r->err = true;
+        return 0;
+    }
+
+    for (uint32_t idx = 0; idx < num; idx++)
+    {
+        val = (val << 8) | *r->p++;
+    }
+
+    return val;
+}
+
+static uint64_t dw_rd_uleb (dw_rd_t* r)
+{
+    uint64_t val   = 0;
+    uint32_t shift = 0;
+    uint8_t  byte;
+
+    do
+    {
+        if (r->err || r->p >= r->end)
+        {
+            r->err = true;
+            return 0;
+        }
+
+        byte = *r->p++;
+
+        if (shift < 64)
+        {
+            val |= (uint64_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+
+    } while (byte & 0x80);
+
+    return val;
+}
+
+static int64_t dw_rd_sleb (dw_rd_t* r)
+{
+    int64_t  val   = 0;
+    uint32_t shift = 0;
+    uint8_t  byte;
+
+    do
+    {
+        if (r->err || r->p >= r->end)
+        {
+            r->err = true;
+            return 0;
+        }
+
+        byte = *r->p++;
+
+        if (shift < 64)
+        {
+            val |= (int64_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+
+    } while (byte & 0x80);
+
+    // Sign extend from the last byte
+    if (shift < 64 && (byte & 0x40))
+    {
+        val |= -((int64_t)1 << shift);
+    }
+
+    return val;
+}
+
+static const char* dw_rd_str (dw_rd_t* r)
+{
+    const char* str = (const char*)r->p;
+    size_t      len;
+
+    if (r->err || (len = strnlen(str, (size_t)(r->end - r->p))) == (size_t)(r->end - r->p))
+    {
+        r->err = true;
+        return NULL;
+    }
+
+    r->p += len + 1;
+
+    return str;
+}
+
+static void dw_rd_skip (dw_rd_t* r, const uint64_t num)
+{
+    if (r->err || (uint64_t)(r->end - r->p) < num)
+    {
+        r->err = true;
+        return;
+    }
+
+    r->p += num;
+}
+
+// -------------------------------------------------------------------------
+// dw_str_at()
+//
+// Returns the string at offset off of a string section, or NULL if off is
+// out of range or the string isn't terminated
+//
+// -------------------------------------------------------------------------
+
+static const char* dw_str_at (const uint8_t* sec, const uint32_t len, const uint64_t off)
+{
+    if (sec == NULL || off >= len || strnlen((const char*)&sec[off], len - (size_t)off) == len - (size_t)off)
+    {
+        return NULL;
+    }
+
+    return (const char*)&sec[off];
+}
+
+// -------------------------------------------------------------------------
+// line_grow()
+//
+// Double the allocation of an array of *p_max entries of size bytes, if
+// num entries have filled it. Returns false on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static bool line_grow (void** p_array, uint32_t* p_max, const uint32_t num, const size_t size)
+{
+    if (num < *p_max)
+    {
+        return true;
+    }
+
+    void* p_new = realloc(*p_array, (size_t)*p_max * 2 * size);
+
+    if (p_new == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    *p_array = p_new;
+    *p_max  *= 2;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// line_hash()
+//
+// FNV-1a hash of a file name
+//
+// -------------------------------------------------------------------------
+
+static uint32_t line_hash (const char* name)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*name)
+    {
+        hash = (hash ^ (uint8_t)*name++) * 16777619U;
+    }
+
+    return hash;
+}
+
+// -------------------------------------------------------------------------
+// line_digest()
+//
+// 64 bit FNV-1a digest of an ELF file's contents, identifying the file a
+// line table cache was built from
+//
+// -------------------------------------------------------------------------
+
+static uint64_t line_digest (const uint8_t* image, const size_t len)
+{
+    uint64_t digest = 0xcbf29ce484222325ULL;
+
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        digest = (digest ^ image[idx]) * 0x100000001b3ULL;
+    }
+
+    return digest;
+}
+
+// -------------------------------------------------------------------------
+// line_add_file()
+//
+// Returns the file number of a file name (from its directory, if dir isn't
+// NULL and name is relative, and name) in the table being built, adding it
+// if not already present. Returns false on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static bool line_add_file (line_build_t* b, const char* dir, const char* name, uint32_t* p_file)
+{
+    char     path[LINE_MAX_PATH];
+    uint32_t len;
+    uint32_t idx;
+
+    if (dir != NULL && *dir && name[0] != '/' && name[0] != '\\' && !(name[0] && name[1] == ':'))
+    {
+        snprintf(path, LINE_MAX_PATH, "%s/%s", dir, name);
+    }
+    else
+    {
+        snprintf(path, LINE_MAX_PATH, "%s", name);
+    }
+
+    // Look up the name, by linear probing from its hash
+    for (idx = line_hash(path) & (b->hash_size - 1); b->hash[idx] != UINT32_MAX; idx = (idx + 1) & (b->hash_size - 1))
+    {
+        if (!strcmp(&b->strings[b->file_name[b->hash[idx]]], path))
+        {
+            *p_file = b->hash[idx];
+            return true;
+        }
+    }
+
+    len = (uint32_t)strlen(path);
+
+    if (!line_grow((void**)&b->file_name, &b->max_files, b->num_files, sizeof(uint32_t)))
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    while (b->str_len + len + 1 > b->str_max)
+    {
+        if (!line_grow((void**)&b->strings, &b->str_max, b->str_max, 1))
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+    }
+
+    memcpy(&b->strings[b->str_len], path, len + 1);
+    b->file_name[b->num_files] = b->str_len;
+    b->hash[idx]               = b->num_files;
+    b->str_len                += len + 1;
+    *p_file                    = b->num_files++;
+
+    // Keep the hash table no more than half full
+    if (b->num_files * 2 > b->hash_size)
+    {
+        uint32_t* p_new = (uint32_t*)malloc((size_t)b->hash_size * 2 * sizeof(uint32_t));
+
+        if (p_new == NULL)
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+
+        free(b->hash);
+        b->hash       = p_new;
+        b->hash_size *= 2;
+        memset(b->hash, 0xff, (size_t)b->hash_size * sizeof(uint32_t));
+
+        for (uint32_t fdx = 0; fdx < b->num_files; fdx++)
+        {
+            for (idx = line_hash(&b->strings[b->file_name[fdx]]) & (b->hash_size - 1); b->hash[idx] != UINT32_MAX;
+                 idx = (idx + 1) & (b->hash_size - 1))
+                ;
+
+            b->hash[idx] = fdx;
+        }
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// line_add_row()
+//
+// Add a row to the table being built. Returns false on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static bool line_add_row (line_build_t* b, const uint32_t addr, const uint32_t line, const uint32_t file)
+{
+    if (!line_grow((void**)&b->rows, &b->max_rows, b->num_rows, sizeof(line_row_t)))
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    b->rows[b->num_rows].addr  = addr;
+    b->rows[b->num_rows].line  = line;
+    b->rows[b->num_rows].file  = file;
+    b->rows[b->num_rows].order = b->num_rows;
+    b->num_rows++;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// line_cmp_row()
+//
+// qsort() comparison of rows, by address, then ends of sequences before
+// other rows, then by position in the line number programs
+//
+// -------------------------------------------------------------------------
+
+static int line_cmp_row (const void* a, const void* b)
+{
+    const line_row_t* p_a = (const line_row_t*)a;
+    const line_row_t* p_b = (const line_row_t*)b;
+
+    if (p_a->addr != p_b->addr)
+    {
+        return (p_a->addr < p_b->addr) ? -1 : 1;
+    }
+
+    if ((p_a->line == 0) != (p_b->line == 0))
+    {
+        return (p_a->line == 0) ? -1 : 1;
+    }
+
+    return (p_a->order < p_b->order) ? -1 : (p_a->order > p_b->order) ? 1 : 0;
+}
+
+
+// -------------------------------------------------------------------------
+// dw_entry_table()
+//
+// Read a DWARF 5 line table header directory or file name table, of the
+// entry format preceding it, into a table of entries (grown as required).
+// Returns the number of entries, with the reader's error set on malformed
+// data or allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static uint32_t dw_entry_table (dw_rd_t* r, const dw_sections_t* s, const uint32_t offset_size, dw_entry_t** p_tab, uint32_t* p_max)
+{
+    uint64_t fmt[2 * 256];
+    uint32_t fmt_count = (uint32_t)dw_rd_bytes(r, 1);
+    uint32_t num       = 0;
+
+    for (uint32_t fdx = 0; fdx < fmt_count; fdx++)
+    {
+        fmt[fdx * 2]     = dw_rd_uleb(r);
+        fmt[fdx * 2 + 1] = dw_rd_uleb(r);
+    }
+
+    uint64_t count = dw_rd_uleb(r);
+
+    while (num < count && !r->err)
+    {
+        const char* name = NULL;
+        uint64_t    dir  = 0;
+
+        for (uint32_t fdx = 0; fdx < fmt_count && !r->err; fdx++)
+        {
+            uint64_t    val = 0;
+            const char* str = NULL;
+
+            switch (fmt[fdx * 2 + 1])
+            {
+            case DW_FORM_string:    str = dw_rd_str(r); break;
+            case DW_FORM_line_strp: str = dw_str_at(s->line_str, s->line_str_len, dw_rd_bytes(r, offset_size)); break;
+            case DW_FORM_strp:      str = dw_str_at(s->str, s->str_len, dw_rd_bytes(r, offset_size)); break;
+            case DW_FORM_udata:     val = dw_rd_uleb(r); break;
+            case DW_FORM_sdata:     val = (uint64_t)dw_rd_sleb(r); break;
+            case DW_FORM_data1:     val = dw_rd_bytes(r, 1); break;
+            case DW_FORM_data2:     val = dw_rd_bytes(r, 2); break;
+            case DW_FORM_data4:     val = dw_rd_bytes(r, 4); break;
+            case DW_FORM_data8:     val = dw_rd_bytes(r, 8); break;
+            case DW_FORM_data16:    dw_rd_skip(r, 16); break;
+            case DW_FORM_block:     dw_rd_skip(r, dw_rd_uleb(r)); break;
+            case DW_FORM_block1:    dw_rd_skip(r, dw_rd_bytes(r, 1)); break;
+            case DW_FORM_block2:    dw_rd_skip(r, dw_rd_bytes(r, 2)); break;
+            case DW_FORM_block4:    dw_rd_skip(r, dw_rd_bytes(r, 4)); break;
+            default:                r->err = true; break;
+            }
+
+            if (fmt[fdx * 2] == DW_LNCT_path)
+            {
+                name = str;
+            }
+            else if (fmt[fdx * 2] == DW_LNCT_directory_index)
+            {
+                dir = val;
+            }
+        }
+
+        if (name == NULL || !line_grow((void**)p_tab, p_max, num, sizeof(dw_entry_t)))
+        {
+            r->err = true;
+            break;
+        }
+
+        (*p_tab)[num].name = name;
+        (*p_tab)[num].dir  = (uint32_t)dir;
+        num++;
+    }
+
+    return num;
+}
+
+// -------------------------------------------------------------------------
+// dw_line_unit()
+//
+// Run the line number program of one compilation unit (the reader
+// covering the unit, following its length field), adding its rows to the
+// table being built. Supports DWARF versions 2 to 5. Returns false if the
+// unit is malformed (or on allocation failure), leaving any rows added.
+//
+// -------------------------------------------------------------------------
+
+static bool dw_line_unit (dw_rd_t* r, const dw_sections_t* s, const uint32_t offset_size, line_build_t* b,
+                          dw_entry_t** p_dirs, uint32_t* p_max_dirs, dw_entry_t** p_files, uint32_t* p_max_files)
+{
+    uint32_t num_dirs  = 0;
+    uint32_t num_files = 0;
+
+    uint32_t version = (uint32_t)dw_rd_bytes(r, 2);
+
+    if (version < 2 || version > 5)
+    {
+        return false;
+    }
+
+    if (version >= 5)
+    {
+        dw_rd_skip(r, 2);                                   // Address and segment selector sizes
+    }
+
+    uint64_t hdr_len = dw_rd_bytes(r, offset_size);
+
+    if (r->err || hdr_len > (uint64_t)(r->end - r->p))
+    {
+        return false;
+    }
+
+    const uint8_t* prog = r->p + hdr_len;
+
+    uint32_t min_inst    = (uint32_t)dw_rd_bytes(r, 1);
+
+    if (version >= 4)
+    {
+        dw_rd_skip(r, 1);                                   // Maximum operations per instruction
+    }
+
+    dw_rd_skip(r, 1);                                       // Default is_stmt
+    int32_t  line_base   = (int8_t)dw_rd_bytes(r, 1);
+    uint32_t line_range  = (uint32_t)dw_rd_bytes(r, 1);
+    uint32_t opcode_base = (uint32_t)dw_rd_bytes(r, 1);
+
+    const uint8_t* std_lengths = r->p;
+    dw_rd_skip(r, opcode_base ? opcode_base - 1 : 0);
+
+    if (r->err || line_range == 0 || opcode_base == 0)
+    {
+        return false;
+    }
+
+    // Directory and file name tables, with directory 0 (the compilation
+    // directory) left off file names. Before DWARF 5, directory 0 and file
+    // 0 are implicit, and the tables are lists terminated by an empty name.
+    if (version >= 5)
+    {
+        num_dirs  = dw_entry_table(r, s, offset_size, p_dirs, p_max_dirs);
+        num_files = dw_entry_table(r, s, offset_size, p_files, p_max_files);
+    }
+    else
+    {
+        (*p_dirs)[num_dirs++].name   = NULL;
+        (*p_files)[num_files++].name = NULL;
+
+        while (!r->err && r->p < r->end && *r->p)
+        {
+            if (!line_grow((void**)p_dirs, p_max_dirs, num_dirs, sizeof(dw_entry_t)))
+            {
+                return false;                                                           //LCOV_EXCL_LINE
+            }
+            (*p_dirs)[num_dirs++].name = dw_rd_str(r);
+        }
+        dw_rd_skip(r, 1);
+
+        while (!r->err && r->p < r->end && *r->p)
+        {
+            if (!line_grow((void**)p_files, p_max_files, num_files, sizeof(dw_entry_t)))
+            {
+                return false;                                                           //LCOV_EXCL_LINE
+            }
+            (*p_files)[num_files].name  = dw_rd_str(r);
+            (*p_files)[num_files++].dir = (uint32_t)dw_rd_uleb(r);
+            dw_rd_uleb(r);                                  // Modification time
+            dw_rd_uleb(r);                                  // Length
+        }
+        dw_rd_skip(r, 1);
+    }
+
+    if (r->err || prog > r->end)
+    {
+        return false;
+    }
+
+    for (uint32_t fdx = 0; fdx < num_files; fdx++)
+    {
+        dw_entry_t* f = &(*p_files)[fdx];
+
+        if (f->name == NULL)
+        {
+            f->file = UINT32_MAX;
+        }
+        else if (!line_add_file(b, (f->dir > 0 && f->dir < num_dirs) ? (*p_dirs)[f->dir].name : NULL, f->name, &f->file))
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+    }
+
+    // Run the line number program
+    uint32_t addr = 0;
+    uint32_t file = 1;
+    uint32_t line = 1;
+    bool     emit;
+    bool     end_seq;
+
+    r->p = prog;
+
+    while (!r->err && r->p < r->end)
+    {
+        uint32_t opcode = (uint32_t)dw_rd_bytes(r, 1);
+
+        emit    = false;
+        end_seq = false;
+
+        if (opcode >= opcode_base)
+        {
+            uint32_t adj = opcode - opcode_base;
+            addr += (adj / line_range) * min_inst;
+            line += line_base + (int32_t)(adj % line_range);
+            emit  = true;
+        }
+        else
+        {
+            switch (opcode)
+            {
+            case 0:
+            {
+                uint64_t ext_len = dw_rd_uleb(r);
+
+                if (r->err || ext_len == 0 || ext_len > (uint64_t)(r->end - r->p))
+                {
+                    return false;
+                }
+
+                const uint8_t* ext_end = r->p + ext_len;
+
+                switch (dw_rd_bytes(r, 1))
+                {
+                case DW_LNE_end_sequence:
+                    emit    = true;
+                    end_seq = true;
+                    break;
+
+                case DW_LNE_set_address:
+                    addr = (uint32_t)dw_rd_bytes(r, (ext_len - 1 <= 8) ? (uint32_t)(ext_len - 1) : 8);
+                    break;
+
+                case DW_LNE_define_file:
+                    if (!line_grow((void**)p_files, p_max_files, num_files, sizeof(dw_entry_t)))
+                    {
+                        return false;                                                   //LCOV_EXCL_LINE
+                    }
+                    (*p_files)[num_files].name = dw_rd_str(r);
+                    (*p_files)[num_files].dir  = (uint32_t)dw_rd_uleb(r);
+
+                    if (r->err || !line_add_file(b, ((*p_files)[num_files].dir > 0 && (*p_files)[num_files].dir < num_dirs) ?
+                                                    (*p_dirs)[(*p_files)[num_files].dir].name : NULL,
+                                                 (*p_files)[num_files].name, &(*p_files)[num_files].file))
+                    {
+                        return false;
+                    }
+                    num_files++;
+                    break;
+                }
+
+                r->p = ext_end;
+                break;
+            }
+
+            case DW_LNS_copy:
+                emit = true;
+                break;
+
+            case DW_LNS_advance_pc:
+                addr += (uint32_t)dw_rd_uleb(r) * min_inst;
+                break;
+
+            case DW_LNS_advance_line:
+                line += (int32_t)dw_rd_sleb(r);
+                break;
+
+            case DW_LNS_set_file:
+                file = (uint32_t)dw_rd_uleb(r);
+                break;
+
+            case DW_LNS_const_add_pc:
+                addr += ((255 - opcode_base) / line_range) * min_inst;
+                break;
+
+            case DW_LNS_fixed_advance_pc:
+                addr += (uint32_t)dw_rd_bytes(r, 2);
+                break;
+
+            // Opcodes with no effect on the rows kept, or unknown, skipping their operands
+            default:
+                for (uint32_t adx = 0; adx < std_lengths[opcode - 1]; adx++)
+                {
+                    dw_rd_uleb(r);
+                }
+                break;
+            }
+        }
+
+        if (emit && !r->err)
+        {
+            // The end of a sequence has no file, and rows with no valid file are dropped
+            if (end_seq && !line_add_row(b, addr, 0, 0))
+            {
+                return false;                                                           //LCOV_EXCL_LINE
+            }
+            else if (!end_seq && file < num_files && (*p_files)[file].file != UINT32_MAX &&
+                     !line_add_row(b, addr, line, (*p_files)[file].file))
+            {
+                return false;                                                           //LCOV_EXCL_LINE
+            }
+
+            if (end_seq)
+            {
+                addr = 0;
+                file = 1;
+                line = 1;
+            }
+        }
+    }
+
+    return !r->err;
+}
+
+// -------------------------------------------------------------------------
+// dw_read_lines()
+//
+// Add the rows of all the line number programs in the .debug_line section
+// of an ELF file image, of image_len bytes, to the table being built.
+// Malformed compilation units are skipped. Returns false if the section
+// headers are malformed, or there is no .debug_line section.
+//
+// -------------------------------------------------------------------------
+
+static bool dw_read_lines (const uint8_t* image, const size_t image_len, line_build_t* b)
+{
+    Elf32_Ehdr    h;
+    Elf32_Shdr    sh;
+    Elf32_Shdr    shstr;
+    dw_sections_t s;
+    dw_entry_t*   p_dirs;
+    dw_entry_t*   p_files;
+    uint32_t      max_dirs  = LINE_INIT_CU_ENTRIES;
+    uint32_t      max_files = LINE_INIT_CU_ENTRIES;
+
+    memset(&s, 0, sizeof(dw_sections_t));
+    memcpy(&h, image, sizeof(Elf32_Ehdr));
+
+    uint32_t shoff     = SWAP(h.e_shoff);
+    uint32_t shnum     = SWAPHALF(h.e_shnum);
+    uint32_t shentsize = SWAPHALF(h.e_shentsize);
+    uint32_t shstrndx  = SWAPHALF(h.e_shstrndx);
+
+    if (shnum == 0 || shentsize < sizeof(Elf32_Shdr) || (uint64_t)shoff + (uint64_t)shnum * shentsize > image_len || shstrndx >= shnum)
+    {
+        return false;
+    }
+
+    memcpy(&shstr, &image[shoff + shstrndx * shentsize], sizeof(Elf32_Shdr));
+
+    uint32_t names_off = SWAP(shstr.sh_offset);
+    uint32_t names_len = SWAP(shstr.sh_size);
+
+    if ((uint64_t)names_off + names_len > image_len)
+    {
+        return false;
+    }
+
+    // Find the line table, and any string sections it refers to, by name
+    for (uint32_t sdx = 0; sdx < shnum; sdx++)
+    {
+        memcpy(&sh, &image[shoff + sdx * shentsize], sizeof(Elf32_Shdr));
+
+        const char* name = dw_str_at(&image[names_off], names_len, SWAP(sh.sh_name));
+        uint32_t    off  = SWAP(sh.sh_offset);
+        uint32_t    len  = SWAP(sh.sh_size);
+
+        if (name == NULL || SWAP(sh.sh_type) != SHT_PROGBITS || (uint64_t)off + len > image_len)
+        {
+            continue;
+        }
+
+        if (!strcmp(name, ".debug_line"))
+        {
+            s.line     = &image[off];
+            s.line_len = len;
+        }
+        else if (!strcmp(name, ".debug_line_str"))
+        {
+            s.line_str     = &image[off];
+            s.line_str_len = len;
+        }
+        else if (!strcmp(name, ".debug_str"))
+        {
+            s.str     = &image[off];
+            s.str_len = len;
+        }
+    }
+
+    if (s.line == NULL)
+    {
+        return false;
+    }
+
+    if ((p_dirs = (dw_entry_t*)malloc(max_dirs * sizeof(dw_entry_t))) == NULL ||
+        (p_files = (dw_entry_t*)malloc(max_files * sizeof(dw_entry_t))) == NULL)
+    {
+        free(p_dirs);                                                                   //LCOV_EXCL_LINE
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    dw_rd_t r;
+    r.p   = s.line;
+    r.end = s.line + s.line_len;
+    r.err = false;
+
+    // Each unit starts with its length, after which the next unit follows
+    while (!r.err && r.p < r.end)
+    {
+        uint32_t offset_size = 4;
+        uint64_t unit_len    = dw_rd_bytes(&r, 4);
+
+        if (unit_len == LINE_DWARF64_ESCAPE)
+        {
+            offset_size = 8;
+            unit_len    = dw_rd_bytes(&r, 8);
+        }
+
+        if (r.err || unit_len > (uint64_t)(r.end - r.p))
+        {
+            break;
+        }
+
+        dw_rd_t unit;
+        unit.p   = r.p;
+        unit.end = r.p + unit_len;
+        unit.err = false;
+
+        dw_line_unit(&unit, &s, offset_size, b, &p_dirs, &max_dirs, &p_files, &max_files);
+
+        r.p = unit.end;
+    }
+
+    free(p_dirs);
+    free(p_files);
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// line_make_image()
+//
+// Sort the rows of a built table, keeping only the last row at each
+// address and dropping rows that don't change the source line, and lay
+// out the table as a cache file image (see line_cache_hdr_t) for the ELF
+// file of the given size and content digest. Frees the built table.
+// Returns the image, setting *p_len to its length, or NULL on allocation
+// failure.
+//
+// -------------------------------------------------------------------------
+
+static uint8_t* line_make_image (line_build_t* b, const uint64_t elf_size, const uint64_t elf_digest, size_t* p_len)
+{
+    uint32_t num = 0;
+
+    qsort(b->rows, b->num_rows, sizeof(line_row_t), line_cmp_row);
+
+    for (uint32_t idx = 0; idx < b->num_rows; idx++)
+    {
+        // A later row at the same address replaces the last kept
+        if (num && b->rows[num - 1].addr == b->rows[idx].addr)
+        {
+            num--;
+        }
+
+        if (num && b->rows[num - 1].line == b->rows[idx].line && (b->rows[idx].line == 0 || b->rows[num - 1].file == b->rows[idx].file))
+        {
+            continue;
+        }
+
+        b->rows[num++] = b->rows[idx];
+    }
+
+    *p_len = sizeof(line_cache_hdr_t) + (size_t)num * 3 * sizeof(uint32_t) + (size_t)b->num_files * sizeof(uint32_t) + b->str_len;
+
+    uint8_t* image = (uint8_t*)malloc(*p_len);
+
+    if (image != NULL)
+    {
+        line_cache_hdr_t* p_hdr  = (line_cache_hdr_t*)image;
+        uint32_t*         p_addr = (uint32_t*)&image[sizeof(line_cache_hdr_t)];
+        uint32_t*         p_line = &p_addr[num];
+        uint32_t*         p_file = &p_line[num];
+
+        memset(p_hdr, 0, sizeof(line_cache_hdr_t));
+        memcpy(p_hdr->magic, LM32_LINE_CACHE_MAGIC, sizeof(p_hdr->magic));
+        p_hdr->version    = LM32_LINE_CACHE_VERSION;
+        p_hdr->byte_order = LM32_SNAP_BYTE_ORDER;
+        p_hdr->elf_size   = elf_size;
+        p_hdr->elf_digest = elf_digest;
+        p_hdr->num_rows   = num;
+        p_hdr->num_files  = b->num_files;
+        p_hdr->str_bytes  = b->str_len;
+
+        for (uint32_t idx = 0; idx < num; idx++)
+        {
+            p_addr[idx] = b->rows[idx].addr;
+            p_line[idx] = b->rows[idx].line;
+            p_file[idx] = b->rows[idx].file;
+        }
+
+        memcpy(&p_file[num], b->file_name, (size_t)b->num_files * sizeof(uint32_t));
+        memcpy(&p_file[num + b->num_files], b->strings, b->str_len);
+    }
+
+    free(b->rows);
+    free(b->file_name);
+    free(b->strings);
+    free(b->hash);
+
+    return image;
+}
+
+// -------------------------------------------------------------------------
+// set_line_image()
+//
+// Use a line table cache image (mapped if is_mapped, else allocated) for
+// source line lookups, taking ownership of it, if it's valid for the ELF
+// file of the given size and content digest. Returns false (releasing the
+// image) if not.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::set_line_image (uint8_t* image, const size_t len, const bool is_mapped, const uint64_t elf_size, const uint64_t elf_digest)
+{
+    line_cache_hdr_t hdr;
+    bool             valid = false;
+
+    if (len >= sizeof(line_cache_hdr_t))
+    {
+        memcpy(&hdr, image, sizeof(line_cache_hdr_t));
+
+        valid = !memcmp(hdr.magic, LM32_LINE_CACHE_MAGIC, sizeof(hdr.magic)) && hdr.version == LM32_LINE_CACHE_VERSION &&
+                hdr.byte_order == LM32_SNAP_BYTE_ORDER && hdr.elf_size == elf_size && hdr.elf_digest == elf_digest &&
+                len == sizeof(line_cache_hdr_t) + ((uint64_t)hdr.num_rows * 3 + hdr.num_files) * sizeof(uint32_t) + hdr.str_bytes &&
+                (hdr.str_bytes == 0 || image[len - 1] == 0);
+    }
+
+    if (valid)
+    {
+        line_addr      = (const uint32_t*)&image[sizeof(line_cache_hdr_t)];
+        line_num       = &line_addr[hdr.num_rows];
+        line_file      = &line_num[hdr.num_rows];
+        line_file_name = &line_file[hdr.num_rows];
+        line_strings   = (const char*)&line_file_name[hdr.num_files];
+
+        // File name offsets must lie within the pool
+        for (uint32_t fdx = 0; fdx < hdr.num_files && valid; fdx++)
+        {
+            valid = line_file_name[fdx] < hdr.str_bytes;
+        }
+    }
+
+    if (!valid)
+    {
+        if (is_mapped)
+        {
+            unmap_elf_file(image, len);
+        }
+        else
+        {
+            free(image);
+        }
+        return false;
+    }
+
+    line_image        = image;
+    line_image_len    = len;
+    line_image_mapped = is_mapped;
+    num_lines         = hdr.num_rows;
+    num_line_files    = hdr.num_files;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// build_line_table()
+//
+// Build the source line table for the line table ELF file. If a cache
+// directory is set, its cache file is mapped if it was built from the same
+// ELF file contents. Otherwise the ELF file's .debug_line section is parsed,
+// and any cache (re)written, via a temporary file renamed when complete, so
+// that concurrent runs never see a partial cache. Failing to write the
+// cache isn't an error, leaving the table in memory only. If the ELF file
+// has no line table, the table is empty.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::build_line_table (void)
+{
+    char         cache_fname[FILENAME_MAX];
+    char         tmp_fname[FILENAME_MAX];
+    uint8_t*     image;
+    uint8_t*     elf_image;
+    size_t       len;
+    size_t       elf_len;
+    line_build_t b;
+
+    if ((elf_image = map_elf_file(line_elf_fname, &elf_len)) == NULL)
+    {
+        return;
+    }
+
+    uint64_t digest = line_digest(elf_image, elf_len);
+
+    // The cache file is named from the ELF file, alongside it or in the cache directory
+    if (line_cache_dir != NULL)
+    {
+        const char* base_fname = strrchr(line_elf_fname, '/');
+
+#if defined _WIN32 || defined _WIN64
+        const char* bs_fname   = strrchr(line_elf_fname, '\\');
+
+        base_fname = (bs_fname != NULL && (base_fname == NULL || bs_fname > base_fname)) ? bs_fname : base_fname;
+#endif
+        if (line_cache_dir[0] == 0)
+        {
+            snprintf(cache_fname, FILENAME_MAX, "%s%s", line_elf_fname, LM32_LINE_CACHE_EXT);
+        }
+        else
+        {
+            snprintf(cache_fname, FILENAME_MAX, "%s/%s%s", line_cache_dir, base_fname ? base_fname + 1 : line_elf_fname, LM32_LINE_CACHE_EXT);
+        }
+
+        if ((image = map_elf_file(cache_fname, &len)) != NULL &&
+            set_line_image(image, len, true, (uint64_t)elf_len, digest))
+        {
+            unmap_elf_file(elf_image, elf_len);
+            return;
+        }
+    }
+
+    // Parse the ELF file's line table
+    memset(&b, 0, sizeof(line_build_t));
+    b.max_rows  = LINE_INIT_ROWS;
+    b.max_files = LINE_INIT_FILES;
+    b.str_max   = LINE_INIT_STRING_BYTES;
+    b.hash_size = LINE_INIT_FILES * 2;
+
+    if ((b.rows      = (line_row_t*)malloc(b.max_rows * sizeof(line_row_t))) == NULL ||
+        (b.file_name = (uint32_t*)malloc(b.max_files * sizeof(uint32_t)))    == NULL ||
+        (b.strings   = (char*)malloc(b.str_max))                               == NULL ||
+        (b.hash      = (uint32_t*)malloc(b.hash_size * sizeof(uint32_t)))    == NULL)
+    {
+        free(b.rows);                                                                   //LCOV_EXCL_LINE
+        free(b.file_name);                                                              //LCOV_EXCL_LINE
+        free(b.strings);                                                                //LCOV_EXCL_LINE
+        unmap_elf_file(elf_image, elf_len);                                             //LCOV_EXCL_LINE
+        return;                                                                         //LCOV_EXCL_LINE
+    }
+
+    memset(b.hash, 0xff, b.hash_size * sizeof(uint32_t));
+
+    bool has_lines = elf_len >= sizeof(Elf32_Ehdr) && !memcmp(elf_image, ELF_IDENT, 4) && dw_read_lines(elf_image, elf_len, &b);
+
+    unmap_elf_file(elf_image, elf_len);
+
+    if ((image = line_make_image(&b, (uint64_t)elf_len, digest, &len)) == NULL)
+    {
+        return;                                                                         //LCOV_EXCL_LINE
+    }
+
+    // Only cache a table parsed from an actual line table
+    if (has_lines && line_cache_dir != NULL)
+    {
+        FILE* fp;
+
+#if !(defined _WIN32) && !(defined _WIN64)
+        snprintf(tmp_fname, FILENAME_MAX, "%s.%d.tmp", cache_fname, (int)getpid());
+#else
+        snprintf(tmp_fname, FILENAME_MAX, "%s.%d.tmp", cache_fname, (int)_getpid());
+#endif
+
+        if ((fp = fopen(tmp_fname, "wb")) != NULL)
+        {
+            bool ok = fwrite(image, 1, len, fp) == len;
+
+            ok = !fclose(fp) && ok;
+
+#if defined _WIN32 || defined _WIN64
+            if (ok)
+            {
+                remove(cache_fname);
+            }
+#endif
+            if (!ok || rename(tmp_fname, cache_fname))
+            {
+                remove(tmp_fname);
+            }
+        }
+    }
+
+    set_line_image(image, len, false, (uint64_t)elf_len, digest);
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_line_cache()
+//
+// Set the directory in which source line tables are cached, with "" for
+// alongside their ELF files, or NULL (the default) for no caching. The
+// current line table, if built, is kept.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_set_line_cache (const char* dir)
+{
+    free(line_cache_dir);
+
+    line_cache_dir = NULL;
+
+    if (dir != NULL && (line_cache_dir = (char*)malloc(strlen(dir) + 1)) != NULL)
+    {
+        strcpy(line_cache_dir, dir);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_line_file()
+//
+// Set the ELF file from which source lines are looked up (or none, if
+// fname is NULL), discarding any current line table. (Programs loaded from
+// ELF files are set automatically.) The file's line table is only read on
+// the first lookup.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_set_line_file (const char* fname)
+{
+    lm32_clear_lines();
+
+    if (fname != NULL && (line_elf_fname = (char*)malloc(strlen(fname) + 1)) != NULL)
+    {
+        strcpy(line_elf_fname, fname);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_lines()
+//
+// Discard the source line table, and forget the file it's read from
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_lines (void)
+{
+    if (line_image != NULL)
+    {
+        if (line_image_mapped)
+        {
+            unmap_elf_file(line_image, line_image_len);
+        }
+        else
+        {
+            free(line_image);
+        }
+    }
+
+    free(line_elf_fname);
+
+    line_elf_fname    = NULL;
+    line_table_built  = false;
+    line_image        = NULL;
+    line_image_len    = 0;
+    line_image_mapped = false;
+    num_lines         = 0;
+    num_line_files    = 0;
+    line_addr         = NULL;
+    line_num          = NULL;
+    line_file         = NULL;
+    line_file_name    = NULL;
+    line_strings      = NULL;
+}
+
+// -------------------------------------------------------------------------
+// lm32_lookup_line()
+//
+// Look up the source file and line of byte_addr, building the line table
+// on first use. This is the last row at or below byte_addr, by binary
+// search of the address array, unless that ends a sequence. Returns false
+// if byte_addr has no source line.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_lookup_line (const uint32_t byte_addr, const char** p_file, uint32_t* p_line)
+{
+    if (!line_table_built)
+    {
+        line_table_built = true;
+
+        if (line_elf_fname != NULL)
+        {
+            build_line_table();
+        }
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = num_lines;
+
+    // Find the first row above byte_addr
+    while (lo < hi)
+    {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+
+        if (line_addr[mid] <= byte_addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0 || line_num[lo - 1] == 0 || line_file[lo - 1] >= num_line_files)
+    {
+        return false;
+    }
+
+    *p_file = &line_strings[line_file_name[line_file[lo - 1]]];
+    *p_line = line_num[lo - 1];
+
+    return true;
+}
@@ -53,6 +53,11 @@
 #define MASK_OPCODE             (0xfc000000)
 #define OPCODE_START_BIT        (26)
 
+// Decode table indices of the call and return opcodes
+#define OPCODE_IDX_B            (0x30)
+#define OPCODE_IDX_CALL         (0x36)
+#define OPCODE_IDX_CALLI        (0x3e)
+
 #define MASK_INSTR_ADDR         (0xfffffffc)
 #define BYTE_MASK               (0x000000ff)
 #define HWORD_MASK              (0x0000ffff)
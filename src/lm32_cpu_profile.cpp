@@ -0,0 +1,1521 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell
+//
+// Cycle sampling, host sampling and call graph profile methods for the lm32_cpu class
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+#include "lm32_cpu.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Initial number of sample table entries (doubled whenever half full)
+#define PROF_INIT_ENTRIES        4096
+
+// Name given to samples at addresses with no symbol
+#define PROF_UNKNOWN_FN          "[unknown]"
+
+// Callgrind name for an unknown source file
+#define PROF_UNKNOWN_FILE        "???"
+
+// Number of samples in the host profile's ring buffer (a power of 2). This holds
+// the samples between the run loop's drains, every LM32_PROF_HOST_POLL_INSTR
+// instructions, unless they take longer than this many sampling intervals.
+#define HOST_RING_SIZE           4096
+
+// Maximum depth of the call graph's shadow call stack, and the initial number
+// of functions and call edges (doubled as needed)
+#define CG_MAX_DEPTH             1024
+#define CG_INIT_FNS              256
+#define CG_INIT_EDGES            1024
+
+// Index of no call edge (for the root frame)
+#define CG_NO_EDGE               0xffffffff
+
+// Maximum length of a call graph function name
+#define CG_MAX_NAME              512
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+// Sample table entry, with the cost sampled at an address, and return
+// address if sampled (else 0). For cycle samples, this is the number of
+// samples taken there multiplied by the sampling interval, and for host
+// samples the number of samples.
+typedef struct lm32_prof_entry_s {
+    uint32_t pc;
+    uint32_t ra;
+    uint64_t cost;
+} prof_entry_t;
+
+// Sample table, of size entries (a power of 2), with used of them sampled
+typedef struct lm32_prof_table_s {
+    prof_entry_t* p_entries;
+    uint32_t      size;
+    uint32_t      used;
+} prof_table_t;
+
+// Folded stack, of a sampled function and its caller (if known)
+typedef struct lm32_prof_folded_s {
+    const char* fn;
+    const char* caller;
+    uint64_t    cost;
+} prof_folded_t;
+
+// Host profile ring buffer sample
+typedef struct lm32_host_sample_s {
+    uint32_t pc;
+    uint32_t ra;
+} host_sample_t;
+
+// Call graph function, identified by its entry address (an exception vector for
+// exception frames), with the number of calls, the number of its frames on the
+// shadow call stack (so that recursive calls aren't counted twice in its
+// inclusive costs), and its exclusive and inclusive costs
+typedef struct lm32_cg_fn_s {
+    uint32_t addr;
+    bool     is_exception;
+    uint32_t active;
+    uint64_t calls;
+    uint64_t self_cycles;
+    uint64_t self_instr;
+    uint64_t incl_cycles;
+    uint64_t incl_instr;
+} cg_fn_t;
+
+// Call graph edge, from a call site in a calling function to a called function,
+// with the number of calls and their inclusive costs
+typedef struct lm32_cg_edge_s {
+    uint32_t caller;
+    uint32_t site;
+    uint32_t callee;
+    uint64_t calls;
+    uint64_t incl_cycles;
+    uint64_t incl_instr;
+} cg_edge_t;
+
+// Shadow call stack frame, with its function and call edge, the address it
+// returns to, the stack pointer at the call, when it was entered, and the
+// inclusive costs of the frames it has called
+typedef struct lm32_cg_frame_s {
+    uint32_t    fn;
+    uint32_t    edge;
+    uint32_t    ret_addr;
+    uint32_t    sp;
+    lm32_time_t start_cycles;
+    uint64_t    start_instr;
+    uint64_t    child_cycles;
+    uint64_t    child_instr;
+} cg_frame_t;
+
+// -------------------------------------------------------------------------
+// STATIC VARIABLES
+// -------------------------------------------------------------------------
+
+// Functions of the call graph being written, for the qsort() comparisons
+static const cg_fn_t* sort_fns;
+
+#if !(defined _WIN32) && !(defined _WIN64)
+// Host profile state shared with the SIGPROF handler (one sampled lm32_cpu per
+// process): the sampled CPU, its PC and RA (or NULL if not sampled), the ring
+// buffer and its head and tail counts, the count of samples dropped, and the
+// SIGPROF action to restore when sampling stops
+static lm32_cpu*                 host_owner = NULL;
+static volatile uint32_t*        host_pc;
+static volatile uint32_t*        host_ra;
+static volatile host_sample_t    host_ring[HOST_RING_SIZE];
+static volatile uint32_t         host_head    = 0;
+static volatile uint32_t         host_tail    = 0;
+static volatile uint64_t         host_dropped = 0;
+static struct sigaction          host_old_action;
+#endif
+
+// -------------------------------------------------------------------------
+// prof_hash()
+//
+// Sample table hash of a PC and return address, spreading neighbouring
+// instructions and distant code regions over the table
+//
+// -------------------------------------------------------------------------
+
+static inline uint32_t prof_hash (const uint32_t pc, const uint32_t ra)
+{
+    uint32_t hash = ((pc >> 2) ^ (ra * LM32_COV_HASH_MULT)) * LM32_COV_HASH_MULT;
+
+    return hash ^ (hash >> 16);
+}
+
+// -------------------------------------------------------------------------
+// prof_cmp_pc()
+//
+// qsort() comparison of sample table entries, by address and then return
+// address
+//
+// -------------------------------------------------------------------------
+
+static int prof_cmp_pc (const void* a, const void* b)
+{
+    const prof_entry_t* p_a = (const prof_entry_t*)a;
+    const prof_entry_t* p_b = (const prof_entry_t*)b;
+
+    if (p_a->pc != p_b->pc)
+    {
+        return (p_a->pc < p_b->pc) ? -1 : 1;
+    }
+
+    return (p_a->ra < p_b->ra) ? -1 : (p_a->ra > p_b->ra) ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------
+// prof_table_resize()
+//
+// Allocate a sample table of size entries (a power of 2), moving any
+// samples from the current table into it. Returns false if the table
+// can't be allocated, leaving the current table in place.
+//
+// -------------------------------------------------------------------------
+
+static bool prof_table_resize (prof_table_t* p_table, const uint32_t size)
+{
+    prof_entry_t* p_entries = (prof_entry_t*)calloc(size, sizeof(prof_entry_t));
+
+    if (p_entries == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    for (uint32_t edx = 0; edx < p_table->size; edx++)
+    {
+        if (p_table->p_entries[edx].cost != 0)
+        {
+            uint32_t idx = prof_hash(p_table->p_entries[edx].pc, p_table->p_entries[edx].ra) & (size - 1);
+
+            while (p_entries[idx].cost != 0)
+            {
+                idx = (idx + 1) & (size - 1);
+            }
+
+            p_entries[idx] = p_table->p_entries[edx];
+        }
+    }
+
+    free(p_table->p_entries);
+
+    p_table->p_entries = p_entries;
+    p_table->size      = size;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// prof_table_alloc()
+//
+// Allocate an empty sample table, returning NULL on failure
+//
+// -------------------------------------------------------------------------
+
+static prof_table_t* prof_table_alloc (void)
+{
+    prof_table_t* p_table = (prof_table_t*)calloc(1, sizeof(prof_table_t));
+
+    if (p_table != NULL && !prof_table_resize(p_table, PROF_INIT_ENTRIES))
+    {
+        free(p_table);                                                                  //LCOV_EXCL_LINE
+        p_table = NULL;                                                                 //LCOV_EXCL_LINE
+    }
+
+    return p_table;
+}
+
+// -------------------------------------------------------------------------
+// prof_table_add()
+//
+// Add cost to the sample table entry for pc and ra, creating it if not yet
+// sampled. Failure to grow the table is fatal.
+//
+// -------------------------------------------------------------------------
+
+static void prof_table_add (prof_table_t* p_table, const uint32_t pc, const uint32_t ra, const uint64_t cost)
+{
+    // Keep the table no more than half full, so that probe sequences stay short
+    if ((p_table->used + 1) * 2 > p_table->size && !prof_table_resize(p_table, p_table->size * 2))
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    prof_entry_t* p_entries = p_table->p_entries;
+    uint32_t      idx       = prof_hash(pc, ra) & (p_table->size - 1);
+
+    while (p_entries[idx].cost != 0 && (p_entries[idx].pc != pc || p_entries[idx].ra != ra))
+    {
+        idx = (idx + 1) & (p_table->size - 1);
+    }
+
+    if (p_entries[idx].cost == 0)
+    {
+        p_entries[idx].pc = pc;
+        p_entries[idx].ra = ra;
+        p_table->used++;
+    }
+
+    p_entries[idx].cost += cost;
+}
+
+// -------------------------------------------------------------------------
+// prof_table_clear()
+//
+// Discard all the samples in a sample table (if allocated)
+//
+// -------------------------------------------------------------------------
+
+static void prof_table_clear (prof_table_t* p_table)
+{
+    if (p_table != NULL)
+    {
+        memset(p_table->p_entries, 0, p_table->size * sizeof(prof_entry_t));
+        p_table->used = 0;
+    }
+}
+
+// -------------------------------------------------------------------------
+// prof_sample()
+//
+// Called when the cycle count reaches the next sample point, with the PC
+// of the instruction that takes it there, and the cycle count after it.
+// An instruction that takes the cycle count past more than one sample point
+// (e.g. on a cache miss) gets a sample for each, so that samples remain in
+// proportion to cycles.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::prof_sample (const uint32_t pc, const lm32_time_t cycle)
+{
+    uint64_t num = (uint64_t)(cycle - prof_next_cycle) / prof_interval + 1;
+
+    prof_next_cycle += (lm32_time_t)(num * prof_interval);
+
+    prof_table_add(prof_table, pc, 0, num * prof_interval);
+    prof_num_samples += num;
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_profile()
+//
+// Start sampling the PC every interval cycles, from the current cycle
+// count, or stop sampling if interval is 0. Samples taken so far are kept
+// (each weighted by the interval it was taken at) until cleared. Returns
+// false if the sample table can't be allocated.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_set_profile (const uint32_t interval)
+{
+    if (interval == 0)
+    {
+        prof_interval   = 0;
+        prof_next_cycle = LM32_PROF_NEVER;
+        return true;
+    }
+
+    if (prof_table == NULL && (prof_table = prof_table_alloc()) == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    prof_interval   = interval;
+    prof_next_cycle = state.cycle_count + interval;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_profile()
+//
+// Discard the samples taken so far, with any sampling continuing
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_profile (void)
+{
+    prof_table_clear(prof_table);
+
+    prof_num_samples = 0;
+}
+
+// -------------------------------------------------------------------------
+// write_callgrind()
+//
+// Write sorted samples in callgrind format, with a cost line of the event
+// sampled at each address (and its source line, or 0 if unknown) under the
+// function containing it. Lines from source files other than the
+// function's (i.e. inlined) are marked with fi= and fe= lines.
+//
+// -------------------------------------------------------------------------
+
+static void write_callgrind (lm32_cpu* cpu, FILE* fp, const prof_entry_t* p_entries, const uint32_t num, const char* event)
+{
+    uint64_t    total     = 0;
+    const char* fn_name   = NULL;
+    const char* fn_file   = NULL;
+    const char* line_file = NULL;
+
+    for (uint32_t edx = 0; edx < num; edx++)
+    {
+        total += p_entries[edx].cost;
+    }
+
+    fprintf(fp, "# callgrind format\n"
+                "version: 1\n"
+                "creator: mico32\n"
+                "positions: instr line\n"
+                "events: %s\n"
+                "summary: %llu\n",
+                event, (unsigned long long)total);
+
+    for (uint32_t edx = 0; edx < num; edx++)
+    {
+        const char* name = cpu->lm32_lookup_symbol(p_entries[edx].pc);
+        uint32_t    pc   = p_entries[edx].pc;
+        uint64_t    cost = p_entries[edx].cost;
+        const char* file;
+        uint32_t    line;
+
+        // Samples at the same address with different return addresses share a cost line
+        while (edx + 1 < num && p_entries[edx + 1].pc == pc)
+        {
+            cost += p_entries[++edx].cost;
+        }
+
+        if (name == NULL)
+        {
+            name = PROF_UNKNOWN_FN;
+        }
+
+        if (!cpu->lm32_lookup_line(pc, &file, &line))
+        {
+            file = PROF_UNKNOWN_FILE;
+            line = 0;
+        }
+
+        // A new function (with callgrind merging the costs of any repeated function)
+        if (fn_name == NULL || strcmp(name, fn_name))
+        {
+            fprintf(fp, "\nfl=%s\nfn=%s\n", file, name);
+            fn_name   = name;
+            fn_file   = file;
+            line_file = file;
+        }
+        else if (strcmp(file, line_file))
+        {
+            fprintf(fp, "%s=%s\n", strcmp(file, fn_file) ? "fi" : "fe", file);
+            line_file = file;
+        }
+
+        fprintf(fp, "0x%08x %u %llu\n", pc, line, (unsigned long long)cost);
+    }
+}
+
+// -------------------------------------------------------------------------
+// prof_cmp_folded()
+//
+// qsort() comparison of folded stacks, by function name (unknown last) and
+// then caller name (none first)
+//
+// -------------------------------------------------------------------------
+
+static int prof_cmp_folded (const void* a, const void* b)
+{
+    const prof_folded_t* p_a = (const prof_folded_t*)a;
+    const prof_folded_t* p_b = (const prof_folded_t*)b;
+
+    if (p_a->fn != p_b->fn)
+    {
+        if (p_a->fn == NULL || p_b->fn == NULL)
+        {
+            return (p_a->fn == NULL) ? 1 : -1;
+        }
+
+        int cmp = strcmp(p_a->fn, p_b->fn);
+
+        if (cmp != 0)
+        {
+            return cmp;
+        }
+    }
+
+    if (p_a->caller == p_b->caller)
+    {
+        return 0;
+    }
+    else if (p_a->caller == NULL || p_b->caller == NULL)
+    {
+        return (p_a->caller == NULL) ? -1 : 1;
+    }
+
+    return strcmp(p_a->caller, p_b->caller);
+}
+
+// -------------------------------------------------------------------------
+// write_folded()
+//
+// Write samples as folded stacks, with a line of the cost sampled in each
+// function. Where samples have a return address (in a different function)
+// the stack is two frames, with the caller from the return address, and
+// otherwise a single frame. Samples with no symbol are totalled on a final
+// line.
+//
+// -------------------------------------------------------------------------
+
+static void write_folded (lm32_cpu* cpu, FILE* fp, const prof_entry_t* p_entries, const uint32_t num)
+{
+    prof_folded_t* p_stacks = (prof_folded_t*)malloc((num + 1) * sizeof(prof_folded_t));
+
+    if (p_stacks == NULL)
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    for (uint32_t edx = 0; edx < num; edx++)
+    {
+        p_stacks[edx].fn     = cpu->lm32_lookup_symbol(p_entries[edx].pc);
+        p_stacks[edx].caller = (p_entries[edx].ra != 0 && p_stacks[edx].fn != NULL) ? cpu->lm32_lookup_symbol(p_entries[edx].ra - 4) : NULL;
+        p_stacks[edx].cost   = p_entries[edx].cost;
+
+        if (p_stacks[edx].caller == p_stacks[edx].fn)
+        {
+            p_stacks[edx].caller = NULL;
+        }
+    }
+
+    qsort(p_stacks, num, sizeof(prof_folded_t), prof_cmp_folded);
+
+    for (uint32_t sdx = 0; sdx < num; sdx++)
+    {
+        uint64_t cost = p_stacks[sdx].cost;
+
+        while (sdx + 1 < num && prof_cmp_folded(&p_stacks[sdx], &p_stacks[sdx + 1]) == 0)
+        {
+            cost += p_stacks[++sdx].cost;
+        }
+
+        if (p_stacks[sdx].fn == NULL)
+        {
+            fprintf(fp, "%s %llu\n", PROF_UNKNOWN_FN, (unsigned long long)cost);
+        }
+        else if (p_stacks[sdx].caller == NULL)
+        {
+            fprintf(fp, "%s %llu\n", p_stacks[sdx].fn, (unsigned long long)cost);
+        }
+        else
+        {
+            fprintf(fp, "%s;%s %llu\n", p_stacks[sdx].caller, p_stacks[sdx].fn, (unsigned long long)cost);
+        }
+    }
+
+    free(p_stacks);
+}
+
+// -------------------------------------------------------------------------
+// write_table()
+//
+// Write the samples of a sample table to the named file, in callgrind
+// (with costs of the named event) or folded stack format. Returns false
+// if the file can't be written.
+//
+// -------------------------------------------------------------------------
+
+static bool write_table (lm32_cpu* cpu, const prof_table_t* p_table, const char* fname, const int format, const char* event)
+{
+    FILE*         fp;
+    prof_entry_t* p_entries;
+    uint32_t      num  = 0;
+    uint32_t      used = (p_table != NULL) ? p_table->used : 0;
+
+    // Gather the sampled addresses, in ascending order
+    if ((p_entries = (prof_entry_t*)malloc((used + 1) * sizeof(prof_entry_t))) == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    for (uint32_t edx = 0; p_table != NULL && edx < p_table->size; edx++)
+    {
+        if (p_table->p_entries[edx].cost != 0)
+        {
+            p_entries[num++] = p_table->p_entries[edx];
+        }
+    }
+
+    qsort(p_entries, num, sizeof(prof_entry_t), prof_cmp_pc);
+
+    if ((fp = fopen(fname, "w")) == NULL)
+    {
+        free(p_entries);
+        return false;
+    }
+
+    if (format == LM32_PROF_FMT_CALLGRIND)
+    {
+        write_callgrind(cpu, fp, p_entries, num, event);
+    }
+    else
+    {
+        write_folded(cpu, fp, p_entries, num);
+    }
+
+    free(p_entries);
+
+    bool ok = !ferror(fp);
+
+    return (fclose(fp) == 0) && ok;
+}
+
+// -------------------------------------------------------------------------
+// lm32_write_profile()
+//
+// Write the samples taken so far to the named file, in callgrind
+// (LM32_PROF_FMT_CALLGRIND) or folded stack (LM32_PROF_FMT_FOLDED) format,
+// attributed to functions from the symbol index. Returns false if the file
+// can't be written.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_write_profile (const char* fname, const int format)
+{
+    return write_table(this, prof_table, fname, format, "Cycles");
+}
+
+// -------------------------------------------------------------------------
+// host_prof_handler()
+//
+// SIGPROF handler, adding a sample of the sampled CPU's PC (and RA) to the
+// ring buffer, or counting it as dropped if the ring buffer is full. The
+// run loop drains it from its checkpoint poll (see lm32_cpu::checkpoint_due()).
+// Only the handler advances the head, and only the (interrupted) run loop
+// the tail, so no locking is needed.
+//
+// -------------------------------------------------------------------------
+
+#if !(defined _WIN32) && !(defined _WIN64)
+static void host_prof_handler (int sig)
+{
+    (void)sig;
+
+    uint32_t head = host_head;
+
+    if (head - host_tail >= HOST_RING_SIZE)
+    {
+        host_dropped++;
+        return;
+    }
+
+    host_ring[head & (HOST_RING_SIZE - 1)].pc = *host_pc;
+    host_ring[head & (HOST_RING_SIZE - 1)].ra = (host_ra != NULL) ? *host_ra : 0;
+
+    host_head = head + 1;
+}
+#endif
+
+// -------------------------------------------------------------------------
+// host_prof_timer()
+//
+// Set the host profile's interval timer to signal every usecs microseconds
+// of host CPU time (0 to stop it). Returns false on failure.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::host_prof_timer (const uint32_t usecs)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    struct itimerval timer;
+
+    timer.it_interval.tv_sec  = usecs / 1000000;
+    timer.it_interval.tv_usec = usecs % 1000000;
+    timer.it_value            = timer.it_interval;
+
+    return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+#else
+    return usecs == 0;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// host_prof_drain()
+//
+// Move the samples in the host profile's ring buffer into its sample table
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::host_prof_drain (void)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    if (host_owner != this)
+    {
+        return;
+    }
+
+    uint32_t head = host_head;
+    uint32_t tail = host_tail;
+
+    for (; tail != head; tail++)
+    {
+        volatile host_sample_t* p_sample = &host_ring[tail & (HOST_RING_SIZE - 1)];
+
+        prof_table_add(host_prof_table, p_sample->pc, p_sample->ra, 1);
+        host_prof_num_samples++;
+    }
+
+    host_tail = tail;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_host_profile()
+//
+// Start sampling the PC (and RA, if with_ra) every usecs microseconds of
+// host CPU time, or stop sampling if usecs is 0. Samples taken so far are
+// kept until cleared. Returns false if the host can't be sampled, another
+// lm32_cpu is already being sampled, or the sample table can't be allocated.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_set_host_profile (const uint32_t usecs, const bool with_ra)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    struct sigaction action;
+
+    if (usecs == 0)
+    {
+        if (host_owner == this)
+        {
+            host_prof_timer(0);
+            sigaction(SIGPROF, &host_old_action, NULL);
+            host_prof_drain();
+            host_owner = NULL;
+        }
+
+        host_prof_usecs = 0;
+        return true;
+    }
+
+    if (host_owner != NULL && host_owner != this)
+    {
+        return false;
+    }
+
+    if (host_prof_table == NULL && (host_prof_table = prof_table_alloc()) == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    // Drain samples from any previous setting first, as they're kept with or without a return address
+    host_prof_drain();
+
+    host_pc   = &state.pc;
+    host_ra   = with_ra ? &state.r[RA_REG_IDX] : NULL;
+
+    if (host_owner == NULL)
+    {
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = host_prof_handler;
+        action.sa_flags   = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+
+        if (sigaction(SIGPROF, &action, &host_old_action) != 0)
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+
+        host_owner = this;
+    }
+
+    host_prof_usecs = usecs;
+    host_prof_ra    = with_ra;
+
+    // Have the run loop's checkpoint poll start draining at the next instruction
+    ckpt_next_instr = state.instr_count;
+
+    if (!host_prof_timer(usecs))
+    {
+        lm32_set_host_profile(0);                                                       //LCOV_EXCL_LINE
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    return true;
+#else
+    return usecs == 0;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_host_profile()
+//
+// Discard the host samples taken so far, with any sampling continuing
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_host_profile (void)
+{
+    host_prof_drain();
+    prof_table_clear(host_prof_table);
+
+    host_prof_num_samples  = 0;
+#if !(defined _WIN32) && !(defined _WIN64)
+    host_prof_dropped_base = host_dropped;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_write_host_profile()
+//
+// Write the host samples taken so far to the named file, in callgrind
+// or folded stack format, as for lm32_write_profile(), warning of any
+// samples dropped. Returns false if the file can't be written.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_write_host_profile (const char* fname, const int format)
+{
+    host_prof_drain();
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    if (host_owner == this && host_dropped != host_prof_dropped_base)
+    {
+        fprintf(stderr, "Warning: %llu host profile samples dropped\n", (unsigned long long)(host_dropped - host_prof_dropped_base));
+        host_prof_dropped_base = host_dropped;
+    }
+#endif
+
+    return write_table(this, host_prof_table, fname, format, "Samples");
+}
+
+// -------------------------------------------------------------------------
+// cg_hash()
+//
+// Call graph hash table hash of up to three values
+//
+// -------------------------------------------------------------------------
+
+static inline uint32_t cg_hash (const uint32_t a, const uint32_t b, const uint32_t c)
+{
+    uint32_t hash = ((a * LM32_COV_HASH_MULT) ^ b) * LM32_COV_HASH_MULT ^ c;
+
+    hash *= LM32_COV_HASH_MULT;
+
+    return hash ^ (hash >> 16);
+}
+
+// -------------------------------------------------------------------------
+// cg_cmp_fn()
+//
+// qsort() comparison of function indices, by function address
+//
+// -------------------------------------------------------------------------
+
+static int cg_cmp_fn (const void* a, const void* b)
+{
+    uint32_t addr_a = sort_fns[*(const uint32_t*)a].addr;
+    uint32_t addr_b = sort_fns[*(const uint32_t*)b].addr;
+
+    return (addr_a < addr_b) ? -1 : (addr_a > addr_b) ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------
+// cg_cmp_edge()
+//
+// qsort() comparison of call edges, by calling function address and then
+// call site
+//
+// -------------------------------------------------------------------------
+
+static int cg_cmp_edge (const void* a, const void* b)
+{
+    const cg_edge_t* p_a    = (const cg_edge_t*)a;
+    const cg_edge_t* p_b    = (const cg_edge_t*)b;
+    uint32_t         addr_a = sort_fns[p_a->caller].addr;
+    uint32_t         addr_b = sort_fns[p_b->caller].addr;
+
+    if (addr_a != addr_b)
+    {
+        return (addr_a < addr_b) ? -1 : 1;
+    }
+
+    return (p_a->site < p_b->site) ? -1 : (p_a->site > p_b->site) ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------
+// cg_close_frame()
+//
+// Close the frame at the top of a shadow call stack of depth frames, at
+// the given cycle and instruction counts, adding its costs to its function,
+// its call edge and the frame that called it
+//
+// -------------------------------------------------------------------------
+
+static void cg_close_frame (cg_fn_t* p_fns, cg_edge_t* p_edges, cg_frame_t* p_stack, const uint32_t depth,
+                            const lm32_time_t cycles, const uint64_t instr)
+{
+    cg_frame_t* p_frame     = &p_stack[depth - 1];
+    cg_fn_t*    p_fn        = &p_fns[p_frame->fn];
+    uint64_t    incl_cycles = (uint64_t)(cycles - p_frame->start_cycles);
+    uint64_t    incl_instr  = instr - p_frame->start_instr;
+
+    p_fn->self_cycles += incl_cycles - p_frame->child_cycles;
+    p_fn->self_instr  += incl_instr  - p_frame->child_instr;
+
+    // Only the outermost frame of a recursive function counts towards its inclusive costs
+    if (--p_fn->active == 0)
+    {
+        p_fn->incl_cycles += incl_cycles;
+        p_fn->incl_instr  += incl_instr;
+    }
+
+    if (p_frame->edge != CG_NO_EDGE)
+    {
+        p_edges[p_frame->edge].incl_cycles += incl_cycles;
+        p_edges[p_frame->edge].incl_instr  += incl_instr;
+    }
+
+    if (depth > 1)
+    {
+        p_stack[depth - 2].child_cycles += incl_cycles;
+        p_stack[depth - 2].child_instr  += incl_instr;
+    }
+}
+
+// -------------------------------------------------------------------------
+// cg_fn_index()
+//
+// Returns the index of the function at fn_addr (or exception vector), adding
+// it if not yet seen
+//
+// -------------------------------------------------------------------------
+
+uint32_t lm32_cpu::cg_fn_index (const uint32_t fn_addr, const bool is_exception)
+{
+    uint32_t mask = cg_max_fns * 2 - 1;
+    uint32_t idx  = cg_hash(fn_addr, is_exception, 0) & mask;
+
+    while (cg_fn_hash[idx] != 0)
+    {
+        cg_fn_t* p_fn = &cg_fns[cg_fn_hash[idx] - 1];
+
+        if (p_fn->addr == fn_addr && p_fn->is_exception == is_exception)
+        {
+            return cg_fn_hash[idx] - 1;
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    // Grow the function array and its hash table when full
+    if (cg_num_fns == cg_max_fns)
+    {
+        uint32_t max  = cg_max_fns * 2;
+        cg_fn_t* fns  = (cg_fn_t*)realloc(cg_fns, max * sizeof(cg_fn_t));
+        uint32_t* hash = (uint32_t*)calloc(max * 2, sizeof(uint32_t));
+
+        if (fns == NULL || hash == NULL)
+        {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+        }
+
+        for (uint32_t fdx = 0; fdx < cg_num_fns; fdx++)
+        {
+            uint32_t hdx = cg_hash(fns[fdx].addr, fns[fdx].is_exception, 0) & (max * 2 - 1);
+
+            while (hash[hdx] != 0)
+            {
+                hdx = (hdx + 1) & (max * 2 - 1);
+            }
+
+            hash[hdx] = fdx + 1;
+        }
+
+        free(cg_fn_hash);
+
+        cg_fns     = fns;
+        cg_fn_hash = hash;
+        cg_max_fns = max;
+
+        return cg_fn_index(fn_addr, is_exception);
+    }
+
+    cg_fn_t* p_fn = &cg_fns[cg_num_fns];
+
+    memset(p_fn, 0, sizeof(cg_fn_t));
+    p_fn->addr         = fn_addr;
+    p_fn->is_exception = is_exception;
+
+    cg_fn_hash[idx] = ++cg_num_fns;
+
+    return cg_num_fns - 1;
+}
+
+// -------------------------------------------------------------------------
+// cg_edge_index()
+//
+// Returns the index of the call edge from the call site in the caller
+// function to the callee function, adding it if not yet seen
+//
+// -------------------------------------------------------------------------
+
+uint32_t lm32_cpu::cg_edge_index (const uint32_t caller, const uint32_t site, const uint32_t callee)
+{
+    uint32_t mask = cg_max_edges * 2 - 1;
+    uint32_t idx  = cg_hash(caller, site, callee) & mask;
+
+    while (cg_edge_hash[idx] != 0)
+    {
+        cg_edge_t* p_edge = &cg_edges[cg_edge_hash[idx] - 1];
+
+        if (p_edge->caller == caller && p_edge->site == site && p_edge->callee == callee)
+        {
+            return cg_edge_hash[idx] - 1;
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    // Grow the edge array and its hash table when full
+    if (cg_num_edges == cg_max_edges)
+    {
+        uint32_t   max   = cg_max_edges * 2;
+        cg_edge_t* edges = (cg_edge_t*)realloc(cg_edges, max * sizeof(cg_edge_t));
+        uint32_t*  hash  = (uint32_t*)calloc(max * 2, sizeof(uint32_t));
+
+        if (edges == NULL || hash == NULL)
+        {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+        }
+
+        for (uint32_t edx = 0; edx < cg_num_edges; edx++)
+        {
+            uint32_t hdx = cg_hash(edges[edx].caller, edges[edx].site, edges[edx].callee) & (max * 2 - 1);
+
+            while (hash[hdx] != 0)
+            {
+                hdx = (hdx + 1) & (max * 2 - 1);
+            }
+
+            hash[hdx] = edx + 1;
+        }
+
+        free(cg_edge_hash);
+
+        cg_edges     = edges;
+        cg_edge_hash = hash;
+        cg_max_edges = max;
+
+        return cg_edge_index(caller, site, callee);
+    }
+
+    cg_edge_t* p_edge = &cg_edges[cg_num_edges];
+
+    memset(p_edge, 0, sizeof(cg_edge_t));
+    p_edge->caller = caller;
+    p_edge->site   = site;
+    p_edge->callee = callee;
+
+    cg_edge_hash[idx] = ++cg_num_edges;
+
+    return cg_num_edges - 1;
+}
+
+// -------------------------------------------------------------------------
+// cg_unwind()
+//
+// Close frames at the top of the shadow call stack, at instruction count
+// instr, until it is depth frames deep
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_unwind (const uint32_t depth, const uint64_t instr)
+{
+    while (cg_depth > depth)
+    {
+        cg_close_frame(cg_fns, cg_edges, cg_stack, cg_depth--, state.cycle_count, instr);
+    }
+}
+
+// -------------------------------------------------------------------------
+// cg_restart()
+//
+// Close all the frames on the shadow call stack, before the state is
+// restored, as they belong to the abandoned execution. The stack restarts
+// from a new root frame (see cg_root()) when the program is next run.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_restart (void)
+{
+    cg_unwind(0, state.instr_count);
+}
+
+// -------------------------------------------------------------------------
+// cg_push()
+//
+// Push a frame for a call (or exception) from site to the function at
+// fn_addr, returning to ret_addr, entered at instruction count instr. If
+// the shadow call stack is full (e.g. from calls that never return), it
+// is unwound to the root frame first.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_push (const uint32_t fn_addr, const bool is_exception, const uint32_t site,
+                        const uint32_t ret_addr, const uint64_t instr)
+{
+    if (cg_depth == CG_MAX_DEPTH)
+    {
+        cg_unwind(1, instr);
+    }
+
+    uint32_t    fn      = cg_fn_index(fn_addr, is_exception);
+    uint32_t    edge    = cg_edge_index(cg_stack[cg_depth - 1].fn, site, fn);
+    cg_frame_t* p_frame = &cg_stack[cg_depth++];
+
+    cg_fns[fn].calls++;
+    cg_fns[fn].active++;
+    cg_edges[edge].calls++;
+
+    p_frame->fn           = fn;
+    p_frame->edge         = edge;
+    p_frame->ret_addr     = ret_addr;
+    p_frame->sp           = state.r[SP_REG_IDX];
+    p_frame->start_cycles = state.cycle_count;
+    p_frame->start_instr  = instr;
+    p_frame->child_cycles = 0;
+    p_frame->child_instr  = 0;
+}
+
+// -------------------------------------------------------------------------
+// cg_return()
+//
+// Close frames for a return to target, at instruction count instr. This
+// is normally the frame at the top of the shadow call stack, but a return
+// to a frame further down (e.g. after calls that jumped to other functions
+// rather than returning) closes all the frames above it too. An exception
+// frame also matches a return to the instruction after the interrupted one,
+// as from a system call handler, which returns to ea+4. Where no frame
+// returns to target (such as for a longjmp() to an earlier setjmp()), the
+// frames called at or below the restored stack pointer are unwound instead.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_return (const uint32_t target, const uint64_t instr)
+{
+    uint32_t depth;
+
+    for (depth = cg_depth; depth > 1; depth--)
+    {
+        const cg_frame_t* p_frame = &cg_stack[depth - 1];
+
+        if (p_frame->ret_addr == target || (cg_fns[p_frame->fn].is_exception && p_frame->ret_addr + 4 == target))
+        {
+            cg_unwind(depth - 1, instr);
+            return;
+        }
+    }
+
+    for (depth = cg_depth; depth > 1 && cg_stack[depth - 1].sp <= state.r[SP_REG_IDX]; depth--)
+        ;
+
+    cg_unwind(depth, instr);
+}
+
+// -------------------------------------------------------------------------
+// cg_root()
+//
+// Start the shadow call stack with a root frame, never returned from, for
+// the code at the current PC, as a program is about to be run (and so after
+// any program loading has set its entry point)
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_root (void)
+{
+    uint32_t    fn      = cg_fn_index(state.pc, false);
+    cg_frame_t* p_frame = &cg_stack[cg_depth++];
+
+    cg_fns[fn].active++;
+
+    p_frame->fn           = fn;
+    p_frame->edge         = CG_NO_EDGE;
+    p_frame->ret_addr     = 0;
+    p_frame->sp           = state.r[SP_REG_IDX];
+    p_frame->start_cycles = state.cycle_count;
+    p_frame->start_instr  = state.instr_count;
+    p_frame->child_cycles = 0;
+    p_frame->child_instr  = 0;
+}
+
+// -------------------------------------------------------------------------
+// cg_branch()
+//
+// Called after executing a call or branch instruction from pc, when
+// building a call graph. Calls (call and calli) push a frame for the
+// called function, and branches to ra, ea or ba are returns, with any
+// other branch (e.g. a computed jump) ignored. Nothing is done if the
+// instruction raised an exception instead (leaving the PC unchanged), or
+// if the call graph was enabled mid-run and has yet to start.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_branch (const p_lm32_decode_t d, const uint32_t pc)
+{
+    // The instruction has yet to be counted
+    uint64_t instr = state.instr_count + 1;
+
+    if (cg_depth == 0 || state.pc == pc)
+    {
+        return;
+    }
+
+    if ((d->opcode >> OPCODE_START_BIT) != OPCODE_IDX_B)
+    {
+        cg_push(state.pc, false, pc, pc + 4, instr);
+    }
+    else if (d->reg0_csr == RA_REG_IDX || d->reg0_csr == EA_REG_IDX || d->reg0_csr == BA_REG_IDX)
+    {
+        cg_return(state.pc, instr);
+    }
+}
+
+// -------------------------------------------------------------------------
+// cg_exception()
+//
+// Called after an exception is taken, when building a call graph, pushing
+// a frame for the exception vector, from the interrupted instruction, and
+// returning to it. A reset unwinds the shadow call stack to the root.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::cg_exception (const int interrupt_id)
+{
+    if (cg_depth == 0)
+    {
+        return;
+    }
+
+    if (interrupt_id == INT_ID_RESET)
+    {
+        cg_unwind(1, state.instr_count);
+        return;
+    }
+
+    uint32_t ret_addr = state.r[(interrupt_id == INT_ID_BREAKPOINT || interrupt_id == INT_ID_WATCHPOINT) ? BA_REG_IDX : EA_REG_IDX];
+
+    cg_push(state.pc, true, ret_addr, ret_addr, state.instr_count);
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_call_graph()
+//
+// Enable or disable building a call graph. When enabled, the shadow call
+// stack starts (see cg_root()) when the program is next run, and when
+// disabled, the call graph so far is discarded. Returns false if not
+// supported (in fast builds), or the call graph can't be allocated.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_set_call_graph (const bool enable)
+{
+#ifdef LM32_FAST_COMPILE
+    return !enable;
+#else
+    if (!enable || cg_stack != NULL)
+    {
+        free(cg_stack);
+        free(cg_fns);
+        free(cg_fn_hash);
+        free(cg_edges);
+        free(cg_edge_hash);
+
+        cg_stack     = NULL;
+        cg_fns       = NULL;
+        cg_fn_hash   = NULL;
+        cg_edges     = NULL;
+        cg_edge_hash = NULL;
+        cg_depth     = 0;
+        cg_num_fns   = 0;
+        cg_num_edges = 0;
+
+        if (!enable)
+        {
+            return true;
+        }
+    }
+
+    cg_max_fns   = CG_INIT_FNS;
+    cg_max_edges = CG_INIT_EDGES;
+
+    if ((cg_stack     = (cg_frame_t*)malloc(CG_MAX_DEPTH * sizeof(cg_frame_t)))   == NULL ||
+        (cg_fns       = (cg_fn_t*)malloc(cg_max_fns * sizeof(cg_fn_t)))           == NULL ||
+        (cg_fn_hash   = (uint32_t*)calloc(cg_max_fns * 2, sizeof(uint32_t)))      == NULL ||
+        (cg_edges     = (cg_edge_t*)malloc(cg_max_edges * sizeof(cg_edge_t)))     == NULL ||
+        (cg_edge_hash = (uint32_t*)calloc(cg_max_edges * 2, sizeof(uint32_t)))    == NULL)
+    {
+        lm32_set_call_graph(false);                                                     //LCOV_EXCL_LINE
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    return true;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_call_graph()
+//
+// Zero the costs of the call graph so far, with the frames on the shadow
+// call stack restarting from the current counts
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_call_graph (void)
+{
+    for (uint32_t fdx = 0; fdx < cg_num_fns; fdx++)
+    {
+        cg_fns[fdx].calls       = 0;
+        cg_fns[fdx].self_cycles = 0;
+        cg_fns[fdx].self_instr  = 0;
+        cg_fns[fdx].incl_cycles = 0;
+        cg_fns[fdx].incl_instr  = 0;
+    }
+
+    for (uint32_t edx = 0; edx < cg_num_edges; edx++)
+    {
+        cg_edges[edx].calls       = 0;
+        cg_edges[edx].incl_cycles = 0;
+        cg_edges[edx].incl_instr  = 0;
+    }
+
+    for (uint32_t fdx = 0; fdx < cg_depth; fdx++)
+    {
+        cg_stack[fdx].start_cycles = state.cycle_count;
+        cg_stack[fdx].start_instr  = state.instr_count;
+        cg_stack[fdx].child_cycles = 0;
+        cg_stack[fdx].child_instr  = 0;
+    }
+}
+
+// -------------------------------------------------------------------------
+// cg_fn_name()
+//
+// Name a call graph function from the symbol index: the symbol's name if
+// the function is at its start, else an offset from it, or else the
+// address. Exception frames are named for their vector.
+//
+// -------------------------------------------------------------------------
+
+static const char* cg_fn_name (lm32_cpu* cpu, const cg_fn_t* p_fn, char* name)
+{
+    uint32_t    offset;
+    const char* sym    = cpu->lm32_lookup_symbol(p_fn->addr, &offset);
+    const char* prefix = p_fn->is_exception ? "exception:" : "";
+
+    if (sym == NULL)
+    {
+        snprintf(name, CG_MAX_NAME, "%s0x%08x", prefix, p_fn->addr);
+    }
+    else if (offset != 0)
+    {
+        snprintf(name, CG_MAX_NAME, "%s%s+0x%x", prefix, sym, offset);
+    }
+    else
+    {
+        snprintf(name, CG_MAX_NAME, "%s%s", prefix, sym);
+    }
+
+    return name;
+}
+
+// -------------------------------------------------------------------------
+// cg_position()
+//
+// Write a callgrind cost line's position for addr (its address, and its
+// source line, or 0 if unknown), first switching the position's file with
+// an fi= (or fe= when back to the function's) line, if it's changed
+//
+// -------------------------------------------------------------------------
+
+static void cg_position (lm32_cpu* cpu, FILE* fp, const uint32_t addr, const char* fn_file, const char** p_line_file)
+{
+    const char* file;
+    uint32_t    line;
+
+    if (!cpu->lm32_lookup_line(addr, &file, &line))
+    {
+        file = PROF_UNKNOWN_FILE;
+        line = 0;
+    }
+
+    if (strcmp(file, *p_line_file))
+    {
+        fprintf(fp, "%s=%s\n", strcmp(file, fn_file) ? "fi" : "fe", file);
+        *p_line_file = file;
+    }
+
+    fprintf(fp, "0x%08x %u", addr, line);
+}
+
+// -------------------------------------------------------------------------
+// lm32_write_call_graph()
+//
+// Write the call graph so far to the named file in callgrind format, with
+// the exclusive cycles and instructions of each function at its entry
+// address, and the calls from each call site with their inclusive costs.
+// Frames still on the shadow call stack are included as if returning now.
+// Returns false if the file can't be written.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_write_call_graph (const char* fname)
+{
+    FILE*       fp;
+    cg_fn_t*    p_fns;
+    cg_edge_t*  p_edges;
+    cg_frame_t* p_stack;
+    uint32_t*   p_order;
+    char        name[CG_MAX_NAME];
+    uint64_t    total_cycles = 0;
+    uint64_t    total_instr  = 0;
+
+    if (cg_stack == NULL)
+    {
+        return false;
+    }
+
+    // Work on copies, so that open frames can be closed without disturbing the live call graph
+    p_fns   = (cg_fn_t*)malloc((cg_num_fns + 1) * sizeof(cg_fn_t));
+    p_edges = (cg_edge_t*)malloc((cg_num_edges + 1) * sizeof(cg_edge_t));
+    p_stack = (cg_frame_t*)malloc((cg_depth + 1) * sizeof(cg_frame_t));
+    p_order = (uint32_t*)malloc((cg_num_fns + 1) * sizeof(uint32_t));
+
+    if (p_fns == NULL || p_edges == NULL || p_stack == NULL || p_order == NULL || (fp = fopen(fname, "w")) == NULL)
+    {
+        free(p_fns);
+        free(p_edges);
+        free(p_stack);
+        free(p_order);
+        return false;
+    }
+
+    memcpy(p_fns,   cg_fns,   cg_num_fns   * sizeof(cg_fn_t));
+    memcpy(p_edges, cg_edges, cg_num_edges * sizeof(cg_edge_t));
+    memcpy(p_stack, cg_stack, cg_depth     * sizeof(cg_frame_t));
+
+    for (uint32_t depth = cg_depth; depth > 0; depth--)
+    {
+        cg_close_frame(p_fns, p_edges, p_stack, depth, state.cycle_count, state.instr_count);
+    }
+
+    // Order the functions, and the edges by their calling functions, by address
+    for (uint32_t fdx = 0; fdx < cg_num_fns; fdx++)
+    {
+        p_order[fdx]  = fdx;
+        total_cycles += p_fns[fdx].self_cycles;
+        total_instr  += p_fns[fdx].self_instr;
+    }
+
+    sort_fns = p_fns;
+    qsort(p_order, cg_num_fns, sizeof(uint32_t), cg_cmp_fn);
+    qsort(p_edges, cg_num_edges, sizeof(cg_edge_t), cg_cmp_edge);
+
+    fprintf(fp, "# callgrind format\n"
+                "version: 1\n"
+                "creator: mico32\n"
+                "positions: instr line\n"
+                "events: Cycles Instructions\n"
+                "summary: %llu %llu\n",
+                (unsigned long long)total_cycles, (unsigned long long)total_instr);
+
+    uint32_t edx = 0;
+
+    for (uint32_t odx = 0; odx < cg_num_fns; odx++)
+    {
+        const cg_fn_t* p_fn = &p_fns[p_order[odx]];
+        const char*    fn_file;
+        const char*    line_file;
+        uint32_t       line;
+
+        if (!lm32_lookup_line(p_fn->addr, &fn_file, &line))
+        {
+            fn_file = PROF_UNKNOWN_FILE;
+        }
+        line_file = fn_file;
+
+        fprintf(fp, "\nfl=%s\nfn=%s\n", fn_file, cg_fn_name(this, p_fn, name));
+
+        cg_position(this, fp, p_fn->addr, fn_file, &line_file);
+        fprintf(fp, " %llu %llu\n", (unsigned long long)p_fn->self_cycles, (unsigned long long)p_fn->self_instr);
+
+        // The calls made by the function (with its edges next in order, as sorted by caller address)
+        while (edx < cg_num_edges && p_fns[p_edges[edx].caller].addr < p_fn->addr)
+        {
+            edx++;
+        }
+
+        for (; edx < cg_num_edges && p_edges[edx].caller == p_order[odx]; edx++)
+        {
+            const cg_fn_t* p_callee = &p_fns[p_edges[edx].callee];
+            const char*    callee_file;
+
+            if (!lm32_lookup_line(p_callee->addr, &callee_file, &line))
+            {
+                callee_file = PROF_UNKNOWN_FILE;
+                line        = 0;
+            }
+
+            fprintf(fp, "cfi=%s\ncfn=%s\ncalls=%llu 0x%08x %u\n", callee_file, cg_fn_name(this, p_callee, name),
+                        (unsigned long long)p_edges[edx].calls, p_callee->addr, line);
+
+            cg_position(this, fp, p_edges[edx].site, fn_file, &line_file);
+            fprintf(fp, " %llu %llu\n", (unsigned long long)p_edges[edx].incl_cycles, (unsigned long long)p_edges[edx].incl_instr);
+        }
+    }
+
+    free(p_fns);
+    free(p_edges);
+    free(p_stack);
+    free(p_order);
+
+    bool ok = !ferror(fp);
+
+    return (fclose(fp) == 0) && ok;
+}
@@ -0,0 +1,325 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell
+//
+// Record and replay methods for the lm32_cpu class
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "lm32_cpu.h"
+#include "lm32_cpu_mico32.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Variable length integers have 7 bits per byte, with the top bit set on
+// all but the last byte
+#define REPLAY_VARINT_BITS       7
+#define REPLAY_VARINT_MORE       0x80
+
+// -------------------------------------------------------------------------
+// lm32_open_replay()
+//
+// Start recording external inputs to, or replaying them from, the named
+// file. The log is a header (magic string and version), followed by an
+// event for each input, in the order they occurred. Each event is a
+// channel byte, the cycles since the previous event and the input data
+// (plus, for interrupt callbacks, the wakeup time relative to the call),
+// all as variable length integers. Interrupt callback results of no
+// interrupts, with the same relative wakeup time as the last logged, are
+// implied rather than logged. Returns false if the file could not be
+// opened, or isn't a valid log.
+//
+// Recording and replaying must both start from the same state (e.g. reset,
+// or the same loaded snapshot) for the inputs to line up.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_open_replay (const char* fname, const int mode)
+{
+    char     magic[LM32_REPLAY_MAGIC_LEN];
+    uint32_t version = LM32_REPLAY_VERSION;
+
+    lm32_close_replay();
+
+    if ((replay_fp = fopen(fname, (mode == LM32_REPLAY_RECORD) ? "wb" : "rb")) == NULL)
+    {
+        return false;
+    }
+
+    if (mode == LM32_REPLAY_RECORD)
+    {
+        if (fwrite(LM32_REPLAY_MAGIC, LM32_REPLAY_MAGIC_LEN, 1, replay_fp) != 1 || fwrite(&version, sizeof(version), 1, replay_fp) != 1)
+        {
+            fclose(replay_fp);
+            replay_fp = NULL;
+            return false;
+        }
+    }
+    else if (fread(magic, LM32_REPLAY_MAGIC_LEN, 1, replay_fp) != 1 || memcmp(magic, LM32_REPLAY_MAGIC, LM32_REPLAY_MAGIC_LEN) ||
+             fread(&version, sizeof(version), 1, replay_fp) != 1 || version > LM32_REPLAY_VERSION)
+    {
+        fclose(replay_fp);
+        replay_fp = NULL;
+        return false;
+    }
+
+    replay_mode      = mode;
+    replay_time      = 0;
+    replay_int_delta = 0;
+    replay_diverged  = 0;
+
+    if (mode == LM32_REPLAY_PLAY)
+    {
+        read_replay_event();
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_close_replay()
+//
+// Finish any recording or replaying, returning the number of replayed
+// inputs that diverged from the log (i.e. were due at a different cycle,
+// or, for interrupt callbacks, differed from the callback's own result).
+//
+// -------------------------------------------------------------------------
+
+uint64_t lm32_cpu::lm32_close_replay (void)
+{
+    if (replay_fp != NULL)
+    {
+        fclose(replay_fp);
+        replay_fp = NULL;
+    }
+
+    replay_mode       = LM32_REPLAY_OFF;
+    replay_next_valid = false;
+
+    return replay_diverged;
+}
+
+// -------------------------------------------------------------------------
+// lm32_record_input()
+//
+// When recording, log an input on a (user) channel, received at the given
+// time. For use by device models for their nondeterministic inputs.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_record_input (const uint32_t chan, const lm32_time_t time, const uint32_t data)
+{
+    if (replay_mode == LM32_REPLAY_RECORD)
+    {
+        write_replay_event(chan, time, data, 0);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_replay_input()
+//
+// When replaying, returns true, with the input data in *p_data, if the next
+// logged input is on the given channel, and is due at or before the given
+// time. Otherwise returns false (i.e. no input).
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_replay_input (const uint32_t chan, const lm32_time_t time, uint32_t* p_data)
+{
+    if (!replay_next_valid || replay_next_chan != chan || replay_next_time > time)
+    {
+        return false;
+    }
+
+    if (replay_next_time != time)
+    {
+        replay_diverged++;
+    }
+
+    *p_data = (uint32_t)replay_next_data[0];
+
+    read_replay_event();
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// replay_int_callback()
+//
+// Record the results of the external interrupt callback, or replace them
+// with those logged, counting any divergence from the log. Results with no
+// interrupts and an unchanged relative wakeup time aren't logged.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::replay_int_callback (const lm32_time_t time, uint32_t* p_ints, lm32_time_t* p_wakeup)
+{
+    uint32_t    ints  = 0;
+    lm32_time_t delta = *p_wakeup - time;
+
+    if (replay_mode == LM32_REPLAY_RECORD)
+    {
+        if (*p_ints || delta != replay_int_delta)
+        {
+            write_replay_event(LM32_REPLAY_CHAN_INT, time, *p_ints, (uint64_t)delta);
+            replay_int_delta = delta;
+        }
+        return;
+    }
+
+    // Use the logged results if due now, else those implied. Any logged results
+    // that were due earlier (and so missed) are consumed, as divergences, with
+    // their interrupts kept.
+    while (replay_next_valid && replay_next_chan == LM32_REPLAY_CHAN_INT && replay_next_time <= time)
+    {
+        if (replay_next_time != time)
+        {
+            replay_diverged++;
+        }
+
+        ints            |= (uint32_t)replay_next_data[0];
+        replay_int_delta = (lm32_time_t)replay_next_data[1];
+
+        read_replay_event();
+    }
+
+    if (*p_ints != ints || delta != replay_int_delta)
+    {
+        replay_diverged++;
+    }
+
+    *p_ints   = ints;
+    *p_wakeup = time + replay_int_delta;
+}
+
+// -------------------------------------------------------------------------
+// replay_jtag()
+//
+// Record a JTAG register read (from the JTAG callback), or replace it with
+// that logged.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::replay_jtag (const uint32_t chan, uint32_t* p_reg)
+{
+    if (replay_mode == LM32_REPLAY_RECORD)
+    {
+        write_replay_event(chan, state.cycle_count, *p_reg, 0);
+    }
+    else if (!lm32_replay_input(chan, state.cycle_count, p_reg))
+    {
+        replay_diverged++;
+    }
+}
+
+// -------------------------------------------------------------------------
+// write_replay_event()
+//
+// Write an event to the recording log. Only interrupt callback events have
+// a second data value. On a write error, recording stops with a warning.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::write_replay_event (const uint32_t chan, const lm32_time_t time, const uint64_t data0, const uint64_t data1)
+{
+    uint8_t  buf[1 + 3*10];
+    int      len      = 0;
+    uint64_t vals[3]  = {(uint64_t)(time - replay_time), data0, data1};
+    int      num_vals = (chan == LM32_REPLAY_CHAN_INT) ? 3 : 2;
+
+    buf[len++] = (uint8_t)chan;
+
+    for (int vdx = 0; vdx < num_vals; vdx++)
+    {
+        uint64_t val = vals[vdx];
+
+        while (val >= REPLAY_VARINT_MORE)
+        {
+            buf[len++] = (uint8_t)(val | REPLAY_VARINT_MORE);
+            val      >>= REPLAY_VARINT_BITS;
+        }
+        buf[len++] = (uint8_t)val;
+    }
+
+    if (fwrite(buf, len, 1, replay_fp) != 1)
+    {
+        fprintf(stderr, "Warning: error writing replay log. Recording stopped\n");
+        lm32_close_replay();
+        return;
+    }
+
+    replay_time = time;
+}
+
+// -------------------------------------------------------------------------
+// read_replay_event()
+//
+// Read the next event from the replay log, which is then pending until
+// consumed. At the end of the log, no event is pending.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::read_replay_event (void)
+{
+    int chan;
+
+    replay_next_valid = false;
+
+    if ((chan = fgetc(replay_fp)) == EOF)
+    {
+        return;
+    }
+
+    uint64_t vals[3]  = {0, 0, 0};
+    int      num_vals = (chan == LM32_REPLAY_CHAN_INT) ? 3 : 2;
+
+    for (int vdx = 0; vdx < num_vals; vdx++)
+    {
+        int c;
+        int shift = 0;
+
+        do
+        {
+            if ((c = fgetc(replay_fp)) == EOF)
+            {
+                return;
+            }
+            vals[vdx] |= (uint64_t)(c & ~REPLAY_VARINT_MORE) << shift;
+            shift     += REPLAY_VARINT_BITS;
+        }
+        while (c & REPLAY_VARINT_MORE);
+    }
+
+    replay_time         += (lm32_time_t)vals[0];
+    replay_next_chan     = (uint32_t)chan;
+    replay_next_time     = replay_time;
+    replay_next_data[0]  = vals[1];
+    replay_next_data[1]  = vals[2];
+    replay_next_valid    = true;
+}
@@ -0,0 +1,2523 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell
+//
+// Snapshot save and restore methods for the lm32_cpu class
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include "lm32_cpu.h"
+#include "lm32_cpu_mico32.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Section header: ID, version and 64 bit payload length
+#define SNAP_SECT_HDR_BYTES      16
+
+// Number of 32 and 64 bit values in the CPU section (version 1)
+#define SNAP_CPU_NUM_WORDS       (LM32_NUM_OF_REGISTERS + 26)
+#define SNAP_CPU_NUM_DWORDS      4
+#define SNAP_CPU_BYTES           (SNAP_CPU_NUM_WORDS*4 + SNAP_CPU_NUM_DWORDS*8)
+
+// Timing section: cc_adjust and rt[] (64 bit), plus cache invalidate flags
+#define SNAP_TIMING_BYTES        ((1 + LM32_NUM_OF_REGISTERS)*8 + 2*4)
+
+// Memory section header words (mem_offset, num_mem_bytes, page bytes, flags),
+// and chunk header words (address, raw length, stored length, flags)
+#define SNAP_MEM_HDR_WORDS       4
+#define SNAP_CHUNK_HDR_WORDS     4
+#define SNAP_CHUNK_BYTES         (LM32_SNAP_CHUNK_PAGES * LM32_DIRTY_PAGE_SIZE)
+
+// Compression parameters. The compressed format is LZF-like: a control byte
+// of less than 32 is followed by a run of (control + 1) literal bytes, otherwise
+// its top 3 bits are a match length - 2 (extended by the next byte when 7), and
+// the bottom 5 bits and following byte are the match's distance - 1.
+#define SNAP_HASH_BITS           12
+#define SNAP_MAX_LITERAL         32
+#define SNAP_MAX_OFFSET          (1 << 13)
+#define SNAP_MAX_MATCH           (7 + 255 + 2)
+
+// 64 bit FNV-1a hash parameters, for memory digests
+#define SNAP_FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define SNAP_FNV_PRIME           0x100000001b3ULL
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+// Reference counted internal memory page, shared between in memory snapshots
+typedef struct {
+    uint32_t refs;
+    uint8_t  data[LM32_DIRTY_PAGE_SIZE];
+} snap_page_t;
+
+// In memory snapshot, with internal memory pages that are all zero held as NULL
+struct lm32_snapshot_s {
+    lm32_cpu::lm32_state state;
+    lm32_time_t          cc_adjust;
+    lm32_time_t          rt[LM32_NUM_OF_REGISTERS];
+    bool                 dcc_invalidate;
+    bool                 icc_invalidate;
+#ifdef LM32_MMU
+    lm32_tbl_t           dtlb;
+    lm32_tbl_t           itlb;
+#endif
+    uint32_t*            cache_state[2];     // Instruction and data cache state (or NULL if no cache)
+    int                  cache_bytes[2];
+    uint32_t             num_mem_bytes;
+    uint32_t             num_pages;
+    snap_page_t**        pages;
+};
+
+// -------------------------------------------------------------------------
+// STATIC VARIABLES
+// -------------------------------------------------------------------------
+
+static const uint8_t snap_zero_page[LM32_DIRTY_PAGE_SIZE] = {0};
+
+#ifndef LM32_MMU
+// Stand in for the CPU section's MMU registers when built without an MMU
+static uint32_t snap_no_mmu_reg;
+#endif
+
+// -------------------------------------------------------------------------
+// snap_compress()
+//
+// Compress in_len bytes from in to out, returning the compressed length, or 0
+// if it would not fit in out_len bytes.
+//
+// -------------------------------------------------------------------------
+
+static uint32_t snap_compress (const uint8_t* in, const uint32_t in_len, uint8_t* out, const uint32_t out_len)
+{
+    uint32_t       htab[1 << SNAP_HASH_BITS];
+    const uint8_t* ip       = in;
+    const uint8_t* in_end   = in + in_len;
+    uint8_t*       op       = out;
+    uint8_t*       out_end  = out + out_len;
+    uint8_t*       lit_ctrl;
+    int            lit      = 0;
+
+    if (out_len == 0)
+    {
+        return 0;
+    }
+
+    // Hash table entries hold input offset + 1, with 0 for no entry
+    memset(htab, 0, sizeof(htab));
+
+    // Reserve the control byte of the first literal run
+    lit_ctrl = op++;
+
+    while (ip < in_end)
+    {
+        if (ip + 2 < in_end)
+        {
+            uint32_t h   = (((ip[0] << 16) | (ip[1] << 8) | ip[2]) * 2654435761U) >> (32 - SNAP_HASH_BITS);
+            uint32_t ref_idx = htab[h];
+
+            htab[h] = (uint32_t)(ip - in) + 1;
+
+            if (ref_idx)
+            {
+                const uint8_t* ref = in + ref_idx - 1;
+                uint32_t       off = (uint32_t)(ip - ref) - 1;
+
+                if (off < SNAP_MAX_OFFSET && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+                {
+                    uint32_t max_len = (uint32_t)(in_end - ip) < SNAP_MAX_MATCH ? (uint32_t)(in_end - ip) : SNAP_MAX_MATCH;
+                    uint32_t len     = 3;
+
+                    while (len < max_len && ref[len] == ip[len])
+                    {
+                        len++;
+                    }
+
+                    // Terminate any literal run, or drop its unused control byte
+                    if (lit)
+                    {
+                        *lit_ctrl = lit - 1;
+                    }
+                    else
+                    {
+                        op--;
+                    }
+
+                    // Room for the match and the next control byte
+                    if (op + 4 > out_end)
+                    {
+                        return 0;
+                    }
+
+                    ip  += len;
+                    len -= 2;
+
+                    if (len < 7)
+                    {
+                        *op++ = (len << 5) | (off >> 8);
+                    }
+                    else
+                    {
+                        *op++ = (7 << 5) | (off >> 8);
+                        *op++ = len - 7;
+                    }
+                    *op++ = off & 0xff;
+
+                    lit      = 0;
+                    lit_ctrl = op++;
+                    continue;
+                }
+            }
+        }
+
+        // Copy a literal
+        if (op >= out_end)
+        {
+            return 0;
+        }
+
+        *op++ = *ip++;
+
+        if (++lit == SNAP_MAX_LITERAL)
+        {
+            *lit_ctrl = lit - 1;
+            lit       = 0;
+
+            if (op >= out_end)
+            {
+                return 0;
+            }
+            lit_ctrl = op++;
+        }
+    }
+
+    if (lit)
+    {
+        *lit_ctrl = lit - 1;
+    }
+    else
+    {
+        op--;
+    }
+
+    return (uint32_t)(op - out);
+}
+
+// -------------------------------------------------------------------------
+// snap_decompress()
+//
+// Decompress in_len bytes from in, which must expand to exactly out_len bytes
+// at out. Returns false on malformed data.
+//
+// -------------------------------------------------------------------------
+
+static bool snap_decompress (const uint8_t* in, const uint32_t in_len, uint8_t* out, const uint32_t out_len)
+{
+    const uint8_t* ip      = in;
+    const uint8_t* in_end  = in + in_len;
+    uint8_t*       op      = out;
+    uint8_t*       out_end = out + out_len;
+
+    while (ip < in_end)
+    {
+        uint32_t ctrl = *ip++;
+
+        if (ctrl < SNAP_MAX_LITERAL)
+        {
+            uint32_t len = ctrl + 1;
+
+            if (ip + len > in_end || op + len > out_end)
+            {
+                return false;
+            }
+
+            memcpy(op, ip, len);
+            op += len;
+            ip += len;
+        }
+        else
+        {
+            uint32_t len = ctrl >> 5;
+
+            if (len == 7)
+            {
+                if (ip >= in_end)
+                {
+                    return false;
+                }
+                len += *ip++;
+            }
+            len += 2;
+
+            if (ip >= in_end)
+            {
+                return false;
+            }
+
+            uint32_t off = ((ctrl & 0x1f) << 8) | *ip++;
+
+            if ((uint32_t)(op - out) < off + 1 || op + len > out_end)
+            {
+                return false;
+            }
+
+            // Matches may overlap the output, so copy bytewise
+            const uint8_t* ref = op - off - 1;
+            while (len--)
+            {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op == out_end;
+}
+
+// -------------------------------------------------------------------------
+// write_snap_section()
+//
+// Write a section header and (if not NULL) its payload
+//
+// -------------------------------------------------------------------------
+
+static bool write_snap_section (FILE* fp, const uint32_t id, const uint32_t version, const void* data, const uint64_t len)
+{
+    uint32_t hdr[SNAP_SECT_HDR_BYTES/4] = {id, version, (uint32_t)(len & 0xffffffffULL), (uint32_t)(len >> 32)};
+
+    if (fwrite(hdr, sizeof(hdr), 1, fp) != 1)
+    {
+        return false;
+    }
+
+    return data == NULL || len == 0 || fwrite(data, (size_t)len, 1, fp) == 1;
+}
+
+// -------------------------------------------------------------------------
+// read_snap_payload()
+//
+// Read a section's payload of len bytes into buf of buf_len bytes, zero filling
+// if shorter, and skipping any bytes beyond buf_len (from a newer format).
+// Returns the number of bytes read into buf, or -1 on an error.
+//
+// -------------------------------------------------------------------------
+
+static int64_t read_snap_payload (FILE* fp, void* buf, const uint64_t buf_len, const uint64_t len)
+{
+    uint64_t rd_len = (len < buf_len) ? len : buf_len;
+
+    memset(buf, 0, (size_t)buf_len);
+
+    if (rd_len && fread(buf, (size_t)rd_len, 1, fp) != 1)
+    {
+        return -1;
+    }
+
+    if (len > rd_len && fseek(fp, (long)(len - rd_len), SEEK_CUR))
+    {
+        return -1;
+    }
+
+    return (int64_t)rd_len;
+}
+
+// -------------------------------------------------------------------------
+// snap_page_data()
+//
+// Returns the data of page pdx of an in memory snapshot, or of internal
+// memory mem (of num_mem_bytes, with any last page partial) when p_snap
+// is NULL, or NULL if the page is all zeros.
+//
+// -------------------------------------------------------------------------
+
+static const uint8_t* snap_page_data (const lm32_snapshot_t* p_snap, const uint8_t* mem, const uint32_t num_mem_bytes, const uint32_t pdx)
+{
+    if (p_snap != NULL)
+    {
+        return p_snap->pages[pdx] ? p_snap->pages[pdx]->data : NULL;
+    }
+
+    uint32_t       offset = pdx << LM32_DIRTY_PAGE_BITS;
+    const uint8_t* p_data = &mem[offset];
+
+    return memcmp(p_data, snap_zero_page, (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE) ? p_data : NULL;
+}
+
+// -------------------------------------------------------------------------
+// snap_set_page()
+//
+// Set page pdx of an in memory snapshot (not shared with any other) to len
+// bytes of data, allocating the page if needed, or freeing it if the data
+// is all zeros. Returns false on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static bool snap_set_page (lm32_snapshot_t* p_snap, const uint32_t pdx, const uint8_t* data, const uint32_t len)
+{
+    snap_page_t* p_page = p_snap->pages[pdx];
+
+    if (memcmp(data, snap_zero_page, len) == 0)
+    {
+        free(p_page);
+        p_snap->pages[pdx] = NULL;
+        return true;
+    }
+
+    if (p_page == NULL && (p_page = p_snap->pages[pdx] = (snap_page_t*)calloc(1, sizeof(snap_page_t))) == NULL)
+    {
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    p_page->refs = 1;
+    memcpy(p_page->data, data, len);
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// snap_cpu_fields()
+//
+// Fill arrays of pointers to the 32 and 64 bit values of CPU state st, in
+// the order they are saved in the CPU section. New fields must only be
+// appended.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::snap_cpu_fields (lm32_state& st, uint32_t* p32[], uint64_t* p64[])
+{
+    int idx = 0;
+
+    for (int rdx = 0; rdx < LM32_NUM_OF_REGISTERS; rdx++)
+    {
+        p32[idx++] = &st.r[rdx];
+    }
+
+    p32[idx++] = &st.pc;
+    p32[idx++] = &st.ie;
+    p32[idx++] = &st.im;
+    p32[idx++] = &st.ip;
+    p32[idx++] = &st.eba;
+    p32[idx++] = &st.icc;
+    p32[idx++] = &st.dcc;
+    p32[idx++] = &st.cfg;
+    p32[idx++] = &st.cfg2;
+#ifdef LM32_MMU
+    p32[idx++] = &st.psw;
+    p32[idx++] = &st.tlbvaddr;
+    p32[idx++] = &st.tlbbadvaddr;
+#else
+    snap_no_mmu_reg = 0;
+    p32[idx++] = &snap_no_mmu_reg;
+    p32[idx++] = &snap_no_mmu_reg;
+    p32[idx++] = &snap_no_mmu_reg;
+#endif
+    p32[idx++] = &st.cc;
+    p32[idx++] = &st.dc;
+    p32[idx++] = &st.deba;
+    p32[idx++] = &st.bp0;
+    p32[idx++] = &st.bp1;
+    p32[idx++] = &st.bp2;
+    p32[idx++] = &st.bp3;
+    p32[idx++] = &st.wp0;
+    p32[idx++] = &st.wp1;
+    p32[idx++] = &st.wp2;
+    p32[idx++] = &st.wp3;
+    p32[idx++] = &st.jtx;
+    p32[idx++] = &st.jrx;
+    p32[idx++] = &st.int_flags;
+
+    p64[0] = (uint64_t*)&st.wakeup_time_ext_int;
+    p64[1] = (uint64_t*)&st.cycle_count;
+    p64[2] = (uint64_t*)&st.clk_count;
+    p64[3] = &st.instr_count;
+}
+
+// -------------------------------------------------------------------------
+// fork_snapshot()
+//
+// Fork a child process to write a snapshot in the background, from its
+// copy-on-write image of the model's state, whilst the parent continues
+// executing. Only one background snapshot is outstanding at a time, so any
+// previous one is waited for first, with its status returned in
+// *p_prev_status. Returns the child's PID in the parent, 0 in the child,
+// or -1 if a process couldn't be forked (when the snapshot should be
+// written in the foreground).
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::fork_snapshot (const bool is_ckpt, int* p_prev_status)
+{
+    *p_prev_status = lm32_wait_snapshot();
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    pid_t pid = fork();
+
+    if (pid > 0)
+    {
+        snap_pid     = (int)pid;
+        snap_is_ckpt = is_ckpt;
+    }
+
+    return (int)pid;
+#else
+    return -1;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_wait_snapshot()
+//
+// Wait for any outstanding background snapshot to complete, and return its
+// status (LM32_SNAP_OK if none). If a background checkpoint failed, the
+// next checkpoint starts a new chain.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_wait_snapshot (void)
+{
+    int status = LM32_SNAP_OK;
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    if (snap_pid > 0)
+    {
+        int wstatus;
+
+        if (waitpid((pid_t)snap_pid, &wstatus, 0) < 0 || !WIFEXITED(wstatus))
+        {
+            status = LM32_SNAP_IO_ERROR;
+        }
+        else
+        {
+            status = -WEXITSTATUS(wstatus);
+        }
+
+        if (status != LM32_SNAP_OK && snap_is_ckpt)
+        {
+            ckpt_base_num = -1;
+        }
+
+        snap_pid = 0;
+    }
+#endif
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_clone_instances()
+//
+// Clone the model into num_instances forked processes, each continuing
+// from the current state with its own copy of the CPU state and of the
+// caller's devices. Memory pages are shared copy-on-write between all the
+// processes, so each clone only costs the pages it writes (and, if memory
+// was mapped from a snapshot or image file, unwritten pages are shared with
+// any other process mapping that file). Returns the instance number in each
+// clone, 0 in the original process, or -1 if not all clones could be
+// created, when the clones that were should still be waited for.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_clone_instances (const int num_instances)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    // Clones shouldn't inherit an outstanding background snapshot, or output buffered so far
+    lm32_wait_snapshot();
+    fflush(NULL);
+
+    if (num_instances <= 0 || (clone_pids = (int*)calloc(num_instances, sizeof(int))) == NULL)
+    {
+        return -1;
+    }
+
+    for (num_clones = 0; num_clones < num_instances; num_clones++)
+    {
+        pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            // A clone has no clones of its own
+            free(clone_pids);
+            clone_pids  = NULL;
+            int inst    = num_clones + 1;
+            num_clones  = 0;
+
+            // Interval timers aren't inherited, so restart any host profile's
+            if (host_prof_usecs)
+            {
+                host_prof_timer(host_prof_usecs);
+            }
+            return inst;
+        }
+        else if (pid < 0)
+        {
+            return -1;
+        }
+
+        clone_pids[num_clones] = (int)pid;
+    }
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+// -------------------------------------------------------------------------
+// lm32_wait_instance()
+//
+// Wait for the next clone instance to exit, returning its instance number,
+// with its exit status in *p_status (-1 if terminated by a signal), or 0 if
+// no clones remain.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_wait_instance (int* p_status)
+{
+#if !(defined _WIN32) && !(defined _WIN64)
+    int   wstatus;
+    pid_t pid;
+
+    while (num_clones > 0 && (pid = wait(&wstatus)) > 0)
+    {
+        for (int idx = 0; idx < num_clones; idx++)
+        {
+            if (clone_pids[idx] == (int)pid)
+            {
+                clone_pids[idx] = 0;
+                *p_status       = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : -1;
+                return idx + 1;
+            }
+        }
+    }
+
+    // All exited
+    free(clone_pids);
+    clone_pids = NULL;
+    num_clones = 0;
+#endif
+
+    return 0;
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_restore_point()
+//
+// Set a restore point at the current state, for lm32_restore() to return
+// to, keeping a copy of internal memory and of the CPU, timing and TLB
+// state in host memory. Pages written from here on are tracked in the
+// restore point's own dirty page bitmap (apart from checkpoints' dirty
+// intervals), so that only those need copying back. Returns false if there
+// is no internal memory yet, or the copy can't be allocated.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_set_restore_point (void)
+{
+    if (mem == NULL || (rp_mem == NULL && (rp_mem = (uint8_t*)malloc(num_mem_bytes)) == NULL))
+    {
+        return false;
+    }
+
+    memcpy(rp_mem, mem, num_mem_bytes);
+
+    rp_state          = state;
+    rp_cc_adjust      = cc_adjust;
+    rp_dcc_invalidate = dcc_invalidate;
+    rp_icc_invalidate = icc_invalidate;
+    memcpy(rp_rt, rt, sizeof(rt));
+
+#ifdef LM32_MMU
+    rp_dtlb           = dtlb;
+    rp_itlb           = itlb;
+#endif
+
+    fold_dirty_map();
+    memset(rp_dirty_map, 0, dirty_map_words * sizeof(uint64_t));
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_restore()
+//
+// Return to the state at the last restore point, copying back only the
+// pages of internal memory written since it was set. The caches are
+// invalidated rather than restored, which only affects timing, and does
+// so in the same way on every restore.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_restore (void)
+{
+    if (rp_mem == NULL)
+    {
+        return;
+    }
+
+    fold_dirty_map();
+
+    for (uint32_t wdx = 0; wdx < dirty_map_words; wdx++)
+    {
+        uint64_t bits = rp_dirty_map[wdx];
+
+        for (uint32_t pdx = wdx << 6; bits != 0; pdx++, bits >>= 1)
+        {
+            uint32_t offset = pdx << LM32_DIRTY_PAGE_BITS;
+
+            if ((bits & 1) && offset < num_mem_bytes)
+            {
+                memcpy(&mem[offset], &rp_mem[offset], (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE);
+            }
+        }
+
+        // Pages copied back have changed since the last checkpoint, and for in memory snapshots
+        ckpt_dirty_map[wdx] |= rp_dirty_map[wdx];
+        snap_dirty_map[wdx] |= rp_dirty_map[wdx];
+        rp_dirty_map[wdx]    = 0;
+    }
+
+    cg_restart();
+
+    state          = rp_state;
+    cc_adjust      = rp_cc_adjust;
+    dcc_invalidate = rp_dcc_invalidate;
+    icc_invalidate = rp_icc_invalidate;
+    memcpy(rt, rp_rt, sizeof(rt));
+
+#ifdef LM32_MMU
+    dtlb           = rp_dtlb;
+    itlb           = rp_itlb;
+#endif
+
+    prof_resync();
+
+    if (icache_p != NULL)
+    {
+        icache_p->lm32_cache_invalidate();
+    }
+
+    if (dcache_p != NULL)
+    {
+        dcache_p->lm32_cache_invalidate();
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_mem_digest()
+//
+// Returns a digest (64 bit FNV-1a) of the internal memory pages written
+// since the last restore point that no longer match it, hashing each
+// page's number and contents. Unwritten pages match the restore point in
+// any run from it, so two runs ending with the same memory contents have
+// the same digest, whichever pages they wrote. Returns 0 if there is no
+// restore point, or memory matches it.
+//
+// -------------------------------------------------------------------------
+
+uint64_t lm32_cpu::lm32_mem_digest (void)
+{
+    uint64_t digest = 0;
+
+    if (rp_mem == NULL)
+    {
+        return 0;
+    }
+
+    for (uint32_t wdx = 0; wdx < dirty_map_words; wdx++)
+    {
+        uint64_t bits = rp_dirty_map[wdx] | dirty_map[wdx];
+
+        for (uint32_t pdx = wdx << 6; bits != 0; pdx++, bits >>= 1)
+        {
+            uint32_t offset = pdx << LM32_DIRTY_PAGE_BITS;
+            uint32_t len    = (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE;
+
+            if ((bits & 1) && offset < num_mem_bytes && memcmp(&mem[offset], &rp_mem[offset], len))
+            {
+                if (digest == 0)
+                {
+                    digest = SNAP_FNV_OFFSET_BASIS;
+                }
+
+                digest = (digest ^ pdx) * SNAP_FNV_PRIME;
+
+                for (uint32_t bdx = 0; bdx < len; bdx++)
+                {
+                    digest = (digest ^ mem[offset + bdx]) * SNAP_FNV_PRIME;
+                }
+            }
+        }
+    }
+
+    return digest;
+}
+
+// -------------------------------------------------------------------------
+// get_snap_regs()
+//
+// Fill an in memory snapshot with all of the state except internal memory:
+// the CPU state (with the CC register updated from the cycle count), timing,
+// TLBs and cache state. Returns false on allocation failure, with the
+// cache state freed by lm32_free_snapshot().
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::get_snap_regs (lm32_snapshot_t* p_snap)
+{
+    p_snap->state          = lm32_get_cpu_state();
+    p_snap->cc_adjust      = cc_adjust;
+    p_snap->dcc_invalidate = dcc_invalidate;
+    p_snap->icc_invalidate = icc_invalidate;
+    memcpy(p_snap->rt, rt, sizeof(rt));
+
+#ifdef LM32_MMU
+    p_snap->dtlb           = dtlb;
+    p_snap->itlb           = itlb;
+#endif
+
+    for (int cdx = 0; cdx < LM32_MAX_NUM_CACHES; cdx++)
+    {
+        lm32_cache* cache_p = cdx ? dcache_p : icache_p;
+
+        if (cache_p != NULL)
+        {
+            p_snap->cache_bytes[cdx] = cache_p->get_state_size();
+
+            if ((p_snap->cache_state[cdx] = (uint32_t*)malloc(p_snap->cache_bytes[cdx])) == NULL)
+            {
+                return false;                                                           //LCOV_EXCL_LINE
+            }
+
+            cache_p->get_state(p_snap->cache_state[cdx]);
+        }
+    }
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_take_snapshot()
+//
+// Take an in memory snapshot of the complete state, returning a handle to
+// it (or NULL on allocation failure).
+// Internal memory is held as reference counted pages, with all zero pages
+// not held at all. Pages not written since the last snapshot taken or
+// restored are shared with it, rather than compared or copied, as are
+// written pages found to still match it, so successive snapshots only
+// cost the pages changed in between.
+//
+// -------------------------------------------------------------------------
+
+lm32_snapshot_t* lm32_cpu::lm32_take_snapshot (void)
+{
+    lm32_snapshot_t* p_snap;
+
+    // Make sure we have some memory
+    if (mem == NULL) 
+    {
+         if ((mem = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+         {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+         }
+         mem16 = (uint16_t*)mem;
+         mem32 = (uint32_t*)mem;
+    }
+
+    if ((p_snap = (lm32_snapshot_t*)calloc(1, sizeof(lm32_snapshot_t))) == NULL)
+    {
+        return NULL;
+    }
+
+    if (!get_snap_regs(p_snap))
+    {
+        lm32_free_snapshot(p_snap);                                                     //LCOV_EXCL_LINE
+        return NULL;                                                                    //LCOV_EXCL_LINE
+    }
+
+    p_snap->num_mem_bytes = num_mem_bytes;
+    p_snap->num_pages     = (num_mem_bytes + LM32_DIRTY_PAGE_SIZE - 1) >> LM32_DIRTY_PAGE_BITS;
+
+    if ((p_snap->pages = (snap_page_t**)calloc(p_snap->num_pages, sizeof(snap_page_t*))) == NULL)
+    {
+        lm32_free_snapshot(p_snap);                                                     //LCOV_EXCL_LINE
+        return NULL;                                                                    //LCOV_EXCL_LINE
+    }
+
+    bool share = snap_base != NULL && snap_base->num_mem_bytes == num_mem_bytes;
+
+    fold_dirty_map();
+
+    for (uint32_t pdx = 0; pdx < p_snap->num_pages; pdx++)
+    {
+        uint32_t     offset = pdx << LM32_DIRTY_PAGE_BITS;
+        uint32_t     len    = (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE;
+        snap_page_t* p_base = share ? snap_base->pages[pdx] : NULL;
+
+        // A page unwritten since the base was set still matches it (NULL being a zero page)
+        if (share && !((snap_dirty_map[pdx >> 6] >> (pdx & 63)) & 1))
+        {
+            if (p_base != NULL)
+            {
+                p_base->refs++;
+                p_snap->pages[pdx] = p_base;
+            }
+            continue;
+        }
+
+        if (memcmp(&mem[offset], snap_zero_page, len) == 0)
+        {
+            continue;
+        }
+
+        if (p_base != NULL && memcmp(&mem[offset], p_base->data, len) == 0)
+        {
+            p_base->refs++;
+            p_snap->pages[pdx] = p_base;
+        }
+        else
+        {
+            if ((p_snap->pages[pdx] = (snap_page_t*)calloc(1, sizeof(snap_page_t))) == NULL)
+            {
+                lm32_free_snapshot(p_snap);                                             //LCOV_EXCL_LINE
+                return NULL;                                                            //LCOV_EXCL_LINE
+            }
+
+            p_snap->pages[pdx]->refs = 1;
+            memcpy(p_snap->pages[pdx]->data, &mem[offset], len);
+        }
+    }
+
+    set_snap_base(p_snap);
+
+    return p_snap;
+}
+
+// -------------------------------------------------------------------------
+// lm32_restore_snapshot()
+//
+// Restore the complete state from an in memory snapshot handle, copying
+// back (and marking dirty) only those internal memory pages that differ
+// from it. Where the handle shares a page with the last snapshot taken or
+// restored, and the page hasn't been written since, it is known to match
+// without comparing. Caches are created or removed to match the snapshot's
+// configuration, as for lm32_read_snapshot(). Returns false if the handle
+// is NULL, or was taken with a different internal memory size.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_restore_snapshot (const lm32_snapshot_t* p_snap)
+{
+    if (p_snap == NULL || p_snap->num_mem_bytes != num_mem_bytes)
+    {
+        return false;
+    }
+
+    // Make sure we have some memory
+    if (mem == NULL) 
+    {
+         if ((mem = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+         {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+         }
+         mem16 = (uint16_t*)mem;
+         mem32 = (uint32_t*)mem;
+    }
+
+    bool share = snap_base != NULL && snap_base->num_mem_bytes == num_mem_bytes;
+
+    fold_dirty_map();
+
+    for (uint32_t pdx = 0; pdx < p_snap->num_pages; pdx++)
+    {
+        uint32_t       offset = pdx << LM32_DIRTY_PAGE_BITS;
+        uint32_t       len    = (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE;
+        const uint8_t* p_data = p_snap->pages[pdx] ? p_snap->pages[pdx]->data : snap_zero_page;
+
+        if (share && snap_base->pages[pdx] == p_snap->pages[pdx] && !((snap_dirty_map[pdx >> 6] >> (pdx & 63)) & 1))
+        {
+            continue;
+        }
+
+        if (memcmp(&mem[offset], p_data, len))
+        {
+            memcpy(&mem[offset], p_data, len);
+            mark_page_dirty(offset);
+        }
+    }
+
+    cg_restart();
+
+    state          = p_snap->state;
+    cc_adjust      = p_snap->cc_adjust;
+    dcc_invalidate = p_snap->dcc_invalidate;
+    icc_invalidate = p_snap->icc_invalidate;
+    memcpy(rt, p_snap->rt, sizeof(rt));
+
+#ifdef LM32_MMU
+    dtlb           = p_snap->dtlb;
+    itlb           = p_snap->itlb;
+#endif
+
+    prof_resync();
+
+    // Create (or remove) caches to match the restored configuration
+    lm32_set_configuration(state.cfg);
+
+    for (int cdx = 0; cdx < 2; cdx++)
+    {
+        lm32_cache* cache_p = cdx ? dcache_p : icache_p;
+
+        if (cache_p != NULL && (p_snap->cache_state[cdx] == NULL || !cache_p->set_state(p_snap->cache_state[cdx], p_snap->cache_bytes[cdx])))
+        {
+            cache_p->lm32_cache_invalidate();
+        }
+    }
+
+    set_snap_base(p_snap);
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32_free_snapshot()
+//
+// Free an in memory snapshot handle, along with any of its memory pages no
+// longer shared with other handles. A NULL handle is ignored.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_free_snapshot (lm32_snapshot_t* p_snap)
+{
+    if (p_snap == NULL)
+    {
+        return;
+    }
+
+    if (p_snap->pages != NULL)
+    {
+        for (uint32_t pdx = 0; pdx < p_snap->num_pages; pdx++)
+        {
+            if (p_snap->pages[pdx] != NULL && --p_snap->pages[pdx]->refs == 0)
+            {
+                free(p_snap->pages[pdx]);
+            }
+        }
+
+        free(p_snap->pages);
+    }
+
+    free(p_snap->cache_state[0]);
+    free(p_snap->cache_state[1]);
+    free(p_snap);
+}
+
+// -------------------------------------------------------------------------
+// lm32_serialise_snapshot()
+//
+// Write an in memory snapshot to fp, in the same format as
+// lm32_write_snapshot() (with all non-zero pages, optionally compressed or
+// mappable). The snapshot is written directly from the handle's state and
+// memory pages, leaving the live state untouched. Returns
+// LM32_SNAP_FORMAT_ERROR if the handle is NULL, or was taken with a
+// different internal memory size.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_serialise_snapshot (const lm32_snapshot_t* p_snap, FILE* fp, const int flags)
+{
+    if (p_snap == NULL || p_snap->num_mem_bytes != num_mem_bytes)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    return write_snapshot(fp, flags & (LM32_SNAP_COMPRESS | LM32_SNAP_MAPPABLE), NULL, 0, p_snap);
+}
+
+// -------------------------------------------------------------------------
+// lm32_deserialise_snapshot()
+//
+// Read a snapshot from fp (as written by lm32_write_snapshot() or
+// lm32_serialise_snapshot()) directly into a new in memory snapshot
+// handle, leaving the live state unchanged. The pages of a snapshot of
+// only dirty pages are applied over a copy of the live internal memory.
+// Returns NULL if the snapshot can't be read.
+//
+// -------------------------------------------------------------------------
+
+lm32_snapshot_t* lm32_cpu::lm32_deserialise_snapshot (FILE* fp)
+{
+    lm32_snapshot_t* p_snap;
+
+    if ((p_snap = (lm32_snapshot_t*)calloc(1, sizeof(lm32_snapshot_t))) == NULL)
+    {
+        return NULL;                                                                    //LCOV_EXCL_LINE
+    }
+
+    // Sections missing from the snapshot are as for the live state, with memory all zeros
+    p_snap->num_mem_bytes = num_mem_bytes;
+    p_snap->num_pages     = (num_mem_bytes + LM32_DIRTY_PAGE_SIZE - 1) >> LM32_DIRTY_PAGE_BITS;
+
+    if (!get_snap_regs(p_snap) || (p_snap->pages = (snap_page_t**)calloc(p_snap->num_pages, sizeof(snap_page_t*))) == NULL ||
+        read_snapshot(fp, NULL, 0, p_snap) != LM32_SNAP_OK)
+    {
+        lm32_free_snapshot(p_snap);
+        return NULL;
+    }
+
+    return p_snap;
+}
+
+// -------------------------------------------------------------------------
+// set_snap_base()
+//
+// Hold a reference to the memory pages of the given snapshot as the ones
+// for the next lm32_take_snapshot() to share, releasing those of any
+// previous one, and start tracking the pages changed from them. On
+// allocation failure, there is simply no sharing.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::set_snap_base (const lm32_snapshot_t* p_snap)
+{
+    lm32_free_snapshot(snap_base);
+
+    // Pages written so far (including by a restore) still count for the other dirty page bitmaps
+    fold_dirty_map();
+    memset(snap_dirty_map, 0, dirty_map_words * sizeof(uint64_t));
+
+    if ((snap_base = (lm32_snapshot_t*)calloc(1, sizeof(lm32_snapshot_t))) == NULL)
+    {
+        return;                                                                         //LCOV_EXCL_LINE
+    }
+
+    if ((snap_base->pages = (snap_page_t**)malloc(p_snap->num_pages * sizeof(snap_page_t*))) == NULL)
+    {
+        free(snap_base);                                                                //LCOV_EXCL_LINE
+        snap_base = NULL;                                                               //LCOV_EXCL_LINE
+        return;                                                                         //LCOV_EXCL_LINE
+    }
+
+    snap_base->num_mem_bytes = p_snap->num_mem_bytes;
+    snap_base->num_pages     = p_snap->num_pages;
+
+    for (uint32_t pdx = 0; pdx < p_snap->num_pages; pdx++)
+    {
+        if ((snap_base->pages[pdx] = p_snap->pages[pdx]) != NULL)
+        {
+            snap_base->pages[pdx]->refs++;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32_save_snapshot()
+//
+// Save a snapshot of the CPU to the named file. See lm32_write_snapshot().
+// With LM32_SNAP_BACKGROUND, the file is written by a forked process, and
+// the status of any previous background snapshot is returned.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_save_snapshot (const char* fname, const int flags, const lm32_snap_section_t* p_user, const int num_user)
+{
+    FILE* fp;
+    int   pid    = -1;
+    int   status = LM32_SNAP_OK;
+
+    if (flags & LM32_SNAP_BACKGROUND)
+    {
+        if ((pid = fork_snapshot(false, &status)) > 0)
+        {
+            if (flags & LM32_SNAP_CHECKPOINT)
+            {
+                start_dirty_interval();
+            }
+            return status;
+        }
+    }
+
+    // Write to a temporary file, renamed when complete, so that an existing snapshot
+    // is never partially overwritten, and any memory mapped from it stays valid
+    char tmp_fname[FILENAME_MAX];
+    snprintf(tmp_fname, FILENAME_MAX, "%s.tmp", fname);
+
+    if ((fp = fopen(tmp_fname, "wb")) == NULL)
+    {
+        status = LM32_SNAP_OPEN_ERROR;
+    }
+    else
+    {
+        status = lm32_write_snapshot(fp, flags, p_user, num_user);
+
+        if (fclose(fp) && status == LM32_SNAP_OK)
+        {
+            status = LM32_SNAP_IO_ERROR;                                                //LCOV_EXCL_LINE
+        }
+
+#if defined _WIN32 || defined _WIN64
+        if (status == LM32_SNAP_OK)
+        {
+            remove(fname);
+        }
+#endif
+        if (status != LM32_SNAP_OK || rename(tmp_fname, fname))
+        {
+            remove(tmp_fname);
+            status = (status == LM32_SNAP_OK) ? LM32_SNAP_OPEN_ERROR : status;
+        }
+    }
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    // A background child exits without flushing its copies of the parent's stdio buffers
+    if (pid == 0)
+    {
+        _exit(-status);
+    }
+#endif
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_write_snapshot()
+//
+// Write a snapshot of the CPU state, register timing, TLBs, caches and
+// internal memory, plus any user sections, to a stream opened for binary
+// writing. With LM32_SNAP_DIRTY_PAGES only pages marked dirty are saved,
+// else all non-zero pages. With LM32_SNAP_COMPRESS, memory data is
+// compressed where that makes it smaller.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_write_snapshot (FILE* fp, const int flags, const lm32_snap_section_t* p_user, const int num_user)
+{
+    lm32_snapshot_t* p_regs;
+    int              status;
+
+    // The live state, other than internal memory, is written from a snapshot of it
+    if ((p_regs = (lm32_snapshot_t*)calloc(1, sizeof(lm32_snapshot_t))) == NULL)
+    {
+        return LM32_SNAP_MEM_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    status = get_snap_regs(p_regs) ? write_snapshot(fp, flags, p_user, num_user, p_regs) : LM32_SNAP_MEM_ERROR;
+
+    lm32_free_snapshot(p_regs);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// write_snapshot()
+//
+// Write the snapshot sections for the state held in p_snap. If p_snap has
+// no memory pages, the live internal memory is written (if allocated).
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::write_snapshot (FILE* fp, const int flags, const lm32_snap_section_t* p_user, const int num_user,
+                              const lm32_snapshot_t* p_snap)
+{
+    uint32_t   hdr[4]  = {LM32_SNAP_VERSION, LM32_SNAP_BYTE_ORDER, 0, 0};
+    uint8_t    buf[SNAP_CPU_BYTES + SNAP_TIMING_BYTES];
+    uint32_t*  p32[SNAP_CPU_NUM_WORDS];
+    uint64_t*  p64[SNAP_CPU_NUM_DWORDS];
+    uint8_t*   bp;
+    lm32_state cpu_state = p_snap->state;
+
+    // File header
+    if (fwrite(LM32_SNAP_MAGIC, LM32_SNAP_MAGIC_LEN, 1, fp) != 1 || fwrite(hdr, sizeof(hdr), 1, fp) != 1)
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    // CPU section
+    snap_cpu_fields(cpu_state, p32, p64);
+
+    bp = buf;
+    for (int idx = 0; idx < SNAP_CPU_NUM_WORDS; idx++, bp += 4)
+    {
+        memcpy(bp, p32[idx], 4);
+    }
+    for (int idx = 0; idx < SNAP_CPU_NUM_DWORDS; idx++, bp += 8)
+    {
+        memcpy(bp, p64[idx], 8);
+    }
+
+    if (!write_snap_section(fp, LM32_SNAP_SECT_CPU, 1, buf, SNAP_CPU_BYTES))
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    // Register availability timing section
+    uint32_t inval[2] = {p_snap->dcc_invalidate, p_snap->icc_invalidate};
+
+    bp = buf;
+    memcpy(bp, &p_snap->cc_adjust, 8);                  bp += 8;
+    memcpy(bp, p_snap->rt,         sizeof(p_snap->rt)); bp += sizeof(p_snap->rt);
+    memcpy(bp, inval,              sizeof(inval));
+
+    if (!write_snap_section(fp, LM32_SNAP_SECT_TIMING, 1, buf, SNAP_TIMING_BYTES))
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+#ifdef LM32_MMU
+    // TLB section: number of entries, the DTLB and ITLB entries, then their valid flags
+    uint32_t num_entries = LM32_TLB_NUM_ENTRIES;
+    uint8_t  valid[2*LM32_TLB_NUM_ENTRIES];
+
+    for (int idx = 0; idx < LM32_TLB_NUM_ENTRIES; idx++)
+    {
+        valid[idx]                        = p_snap->dtlb.valid[idx];
+        valid[idx + LM32_TLB_NUM_ENTRIES] = p_snap->itlb.valid[idx];
+    }
+
+    if (!write_snap_section(fp, LM32_SNAP_SECT_TLB, 1, NULL, sizeof(num_entries) + sizeof(dtlb.entry) + sizeof(itlb.entry) + sizeof(valid)) ||
+        fwrite(&num_entries, sizeof(num_entries), 1, fp) != 1      ||
+        fwrite(p_snap->dtlb.entry, sizeof(dtlb.entry), 1, fp) != 1 ||
+        fwrite(p_snap->itlb.entry, sizeof(itlb.entry), 1, fp) != 1 ||
+        fwrite(valid, sizeof(valid), 1, fp) != 1)
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+#endif
+
+    // Cache sections
+    for (int cdx = 0; cdx < LM32_MAX_NUM_CACHES; cdx++)
+    {
+        if (p_snap->cache_state[cdx] != NULL &&
+            !write_snap_section(fp, cdx ? LM32_SNAP_SECT_DCACHE : LM32_SNAP_SECT_ICACHE, 1, p_snap->cache_state[cdx], p_snap->cache_bytes[cdx]))
+        {
+            return LM32_SNAP_IO_ERROR;
+        }
+    }
+
+    // User sections
+    for (int udx = 0; udx < num_user; udx++)
+    {
+        if (!write_snap_section(fp, p_user[udx].id, p_user[udx].version, p_user[udx].data, p_user[udx].len))
+        {
+            return LM32_SNAP_IO_ERROR;
+        }
+    }
+
+    // Internal memory section (if any memory allocated), with the length
+    // patched in once all the chunks have been written
+    if (p_snap->pages != NULL || mem != NULL)
+    {
+        int status = write_snap_mem(fp, flags, p_snap->pages != NULL ? p_snap : NULL);
+
+        if (status != LM32_SNAP_OK)
+        {
+            return status;
+        }
+    }
+
+    return write_snap_section(fp, LM32_SNAP_SECT_END, 1, NULL, 0) ? LM32_SNAP_OK : LM32_SNAP_IO_ERROR;
+}
+
+// -------------------------------------------------------------------------
+// write_snap_mem()
+//
+// Write the internal memory section, as chunks of up to LM32_SNAP_CHUNK_PAGES
+// contiguous pages, written directly from memory (or compressed), or as a
+// single image chunk for a mappable snapshot, and terminated with a zero
+// length chunk. The memory is that of the in memory snapshot p_snap, with
+// its pages gathered into a chunk buffer, or the live internal memory when
+// p_snap is NULL. Any partial last page is saved up to the end of memory.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::write_snap_mem (FILE* fp, const int flags, const lm32_snapshot_t* p_snap)
+{
+    uint32_t mem_hdr[SNAP_MEM_HDR_WORDS] = {mem_offset, num_mem_bytes, LM32_DIRTY_PAGE_SIZE, (uint32_t)flags};
+    uint32_t num_pages                   = (num_mem_bytes + LM32_DIRTY_PAGE_SIZE - 1) >> LM32_DIRTY_PAGE_BITS;
+    uint8_t* cbuf                        = NULL;
+    uint8_t* gbuf                        = NULL;
+    long     sect_pos                    = ftell(fp);
+
+    if (sect_pos < 0 || !write_snap_section(fp, LM32_SNAP_SECT_MEM, 1, mem_hdr, sizeof(mem_hdr)))
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    // A full mappable snapshot has all of memory as a single page aligned image
+    bool image = (flags & LM32_SNAP_MAPPABLE) && !(flags & LM32_SNAP_DIRTY_PAGES);
+
+    if (image)
+    {
+        int status = write_snap_image(fp, p_snap);
+
+        if (status != LM32_SNAP_OK)
+        {
+            return status;
+        }
+    }
+    else if (((flags & LM32_SNAP_COMPRESS) && (cbuf = (uint8_t*)malloc(SNAP_CHUNK_BYTES)) == NULL) ||
+             (p_snap != NULL && (gbuf = (uint8_t*)malloc(SNAP_CHUNK_BYTES)) == NULL))
+    {
+        free(cbuf);                                                                     //LCOV_EXCL_LINE
+        return LM32_SNAP_MEM_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    uint32_t pdx = 0;
+    while (!image && pdx <= num_pages)
+    {
+        uint32_t start = pdx;
+
+        // Find a run of pages to save, up to a chunk's worth
+        while (pdx < num_pages && (pdx - start) < LM32_SNAP_CHUNK_PAGES)
+        {
+            uint32_t offset = pdx << LM32_DIRTY_PAGE_BITS;
+            bool     save;
+
+            if ((flags & LM32_SNAP_DIRTY_PAGES) && p_snap == NULL)
+            {
+                uint32_t wdx = offset >> (LM32_DIRTY_PAGE_BITS + 6);
+                save = (((flags & LM32_SNAP_CHECKPOINT) ? (dirty_map[wdx] | ckpt_dirty_map[wdx]) : dirty_map_word(wdx)) >> (pdx & 63)) & 1;
+            }
+            else
+            {
+                save = snap_page_data(p_snap, mem, num_mem_bytes, pdx) != NULL;
+            }
+
+            if (!save)
+            {
+                break;
+            }
+            pdx++;
+        }
+
+        if (pdx > start)
+        {
+            uint32_t  raw_len   = (pdx - start) << LM32_DIRTY_PAGE_BITS;
+            uint8_t*  p_data    = (gbuf != NULL) ? gbuf : &mem[start << LM32_DIRTY_PAGE_BITS];
+
+            // A chunk with the last page ends with memory
+            if (raw_len > num_mem_bytes - (start << LM32_DIRTY_PAGE_BITS))
+            {
+                raw_len = num_mem_bytes - (start << LM32_DIRTY_PAGE_BITS);
+            }
+
+            uint32_t  chunk_hdr[SNAP_CHUNK_HDR_WORDS] = {mem_offset + (start << LM32_DIRTY_PAGE_BITS), raw_len, raw_len, 0};
+
+            // A snapshot's pages are gathered into a contiguous chunk
+            for (uint32_t idx = start; gbuf != NULL && idx < pdx; idx++)
+            {
+                memcpy(&gbuf[(idx - start) << LM32_DIRTY_PAGE_BITS], p_snap->pages[idx]->data, LM32_DIRTY_PAGE_SIZE);
+            }
+
+            if (cbuf != NULL)
+            {
+                uint32_t clen = snap_compress(p_data, raw_len, cbuf, raw_len - 1);
+
+                if (clen)
+                {
+                    p_data       = cbuf;
+                    chunk_hdr[2] = clen;
+                    chunk_hdr[3] = LM32_SNAP_CHUNK_COMPRESSED;
+                }
+            }
+
+            if (fwrite(chunk_hdr, sizeof(chunk_hdr), 1, fp) != 1 || fwrite(p_data, chunk_hdr[2], 1, fp) != 1)
+            {
+                free(cbuf);
+                free(gbuf);
+                return LM32_SNAP_IO_ERROR;
+            }
+        }
+        else
+        {
+            // Skip the unsaved page
+            pdx++;
+        }
+    }
+
+    free(cbuf);
+    free(gbuf);
+
+    // Terminating chunk
+    uint32_t end_hdr[SNAP_CHUNK_HDR_WORDS] = {0, 0, 0, 0};
+    if (fwrite(end_hdr, sizeof(end_hdr), 1, fp) != 1)
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    // Patch the section length
+    long end_pos = ftell(fp);
+    if (end_pos < 0 || fseek(fp, sect_pos, SEEK_SET) ||
+        !write_snap_section(fp, LM32_SNAP_SECT_MEM, 1, NULL, (uint64_t)(end_pos - sect_pos - SNAP_SECT_HDR_BYTES)) ||
+        fseek(fp, end_pos, SEEK_SET))
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    if (flags & LM32_SNAP_CHECKPOINT)
+    {
+        start_dirty_interval();
+    }
+
+    return LM32_SNAP_OK;
+}
+
+// -------------------------------------------------------------------------
+// lm32_load_snapshot()
+//
+// Restore a snapshot from the named file. See lm32_read_snapshot().
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_load_snapshot (const char* fname, lm32_snap_section_t* p_user, const int num_user)
+{
+    FILE* fp;
+
+    if ((fp = fopen(fname, "rb")) == NULL)
+    {
+        return LM32_SNAP_OPEN_ERROR;
+    }
+
+    int status = lm32_read_snapshot(fp, p_user, num_user);
+
+    fclose(fp);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_read_snapshot()
+//
+// Restore a snapshot from a stream opened for binary reading. Sections not
+// recognised (and user sections not in p_user) are skipped. Each p_user
+// section's version is updated to that saved, or 0 if not in the snapshot.
+// If a cache's configuration differs from the snapshot's, it is invalidated
+// instead.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_read_snapshot (FILE* fp, lm32_snap_section_t* p_user, const int num_user)
+{
+    return read_snapshot(fp, p_user, num_user, NULL);
+}
+
+// -------------------------------------------------------------------------
+// read_snapshot()
+//
+// Read the snapshot sections into the live state, or into the in memory
+// snapshot p_snap (with its pages allocated) when not NULL, leaving the
+// live state unchanged.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_snapshot (FILE* fp, lm32_snap_section_t* p_user, const int num_user, lm32_snapshot_t* p_snap)
+{
+    char         magic[LM32_SNAP_MAGIC_LEN];
+    uint32_t     hdr[4];
+    uint32_t     sect_hdr[SNAP_SECT_HDR_BYTES/4];
+    uint8_t      buf[SNAP_CPU_BYTES + SNAP_TIMING_BYTES];
+    uint32_t*    p32[SNAP_CPU_NUM_WORDS];
+    uint64_t*    p64[SNAP_CPU_NUM_DWORDS];
+    uint8_t*     bp;
+
+    // Targets of the restored state
+    lm32_state*  p_state          = p_snap ? &p_snap->state          : &state;
+    lm32_time_t* p_cc_adjust      = p_snap ? &p_snap->cc_adjust      : &cc_adjust;
+    lm32_time_t* p_rt             = p_snap ? p_snap->rt              : rt;
+    bool*        p_dcc_invalidate = p_snap ? &p_snap->dcc_invalidate : &dcc_invalidate;
+    bool*        p_icc_invalidate = p_snap ? &p_snap->icc_invalidate : &icc_invalidate;
+#ifdef LM32_MMU
+    lm32_tbl_t*  p_dtlb           = p_snap ? &p_snap->dtlb           : &dtlb;
+    lm32_tbl_t*  p_itlb           = p_snap ? &p_snap->itlb           : &itlb;
+#endif
+
+    if (fread(magic, LM32_SNAP_MAGIC_LEN, 1, fp) != 1 || memcmp(magic, LM32_SNAP_MAGIC, LM32_SNAP_MAGIC_LEN) ||
+        fread(hdr, sizeof(hdr), 1, fp) != 1 || hdr[1] != LM32_SNAP_BYTE_ORDER)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    if (hdr[0] > LM32_SNAP_VERSION)
+    {
+        return LM32_SNAP_VERSION_ERROR;
+    }
+
+    // User sections not found in the snapshot are flagged with a version of 0
+    for (int udx = 0; udx < num_user; udx++)
+    {
+        p_user[udx].version = 0;
+    }
+
+    while (true)
+    {
+        if (fread(sect_hdr, sizeof(sect_hdr), 1, fp) != 1)
+        {
+            return LM32_SNAP_FORMAT_ERROR;
+        }
+
+        uint32_t id  = sect_hdr[0];
+        uint64_t len = (uint64_t)sect_hdr[2] | ((uint64_t)sect_hdr[3] << 32);
+        bool     skip = false;
+
+        switch (id)
+        {
+        case LM32_SNAP_SECT_END:
+            return LM32_SNAP_OK;
+
+        case LM32_SNAP_SECT_CPU:
+            if (read_snap_payload(fp, buf, SNAP_CPU_BYTES, len) < 0)
+            {
+                return LM32_SNAP_IO_ERROR;
+            }
+
+            if (p_snap == NULL)
+            {
+                cg_restart();
+            }
+
+            snap_cpu_fields(*p_state, p32, p64);
+
+            bp = buf;
+            for (int idx = 0; idx < SNAP_CPU_NUM_WORDS; idx++, bp += 4)
+            {
+                memcpy(p32[idx], bp, 4);
+            }
+            for (int idx = 0; idx < SNAP_CPU_NUM_DWORDS; idx++, bp += 8)
+            {
+                memcpy(p64[idx], bp, 8);
+            }
+
+            // Create (or remove) caches to match the restored configuration, and
+            // restart profile sampling from the restored cycle count
+            if (p_snap == NULL)
+            {
+                lm32_set_configuration(state.cfg);
+                prof_resync();
+            }
+            break;
+
+        case LM32_SNAP_SECT_TIMING:
+            if (read_snap_payload(fp, buf, SNAP_TIMING_BYTES, len) < 0)
+            {
+                return LM32_SNAP_IO_ERROR;
+            }
+            else
+            {
+                uint32_t inval[2];
+
+                bp = buf;
+                memcpy(p_cc_adjust, bp, 8);          bp += 8;
+                memcpy(p_rt,        bp, sizeof(rt)); bp += sizeof(rt);
+                memcpy(inval,       bp, sizeof(inval));
+
+                *p_dcc_invalidate = inval[0] != 0;
+                *p_icc_invalidate = inval[1] != 0;
+            }
+            break;
+
+#ifdef LM32_MMU
+        case LM32_SNAP_SECT_TLB:
+            {
+                uint32_t num_entries;
+                uint8_t  valid[2*LM32_TLB_NUM_ENTRIES];
+
+                if (len != sizeof(num_entries) + sizeof(dtlb.entry) + sizeof(itlb.entry) + sizeof(valid))
+                {
+                    return LM32_SNAP_FORMAT_ERROR;
+                }
+
+                if (fread(&num_entries, sizeof(num_entries), 1, fp) != 1  ||
+                    fread(p_dtlb->entry, sizeof(dtlb.entry), 1, fp) != 1 ||
+                    fread(p_itlb->entry, sizeof(itlb.entry), 1, fp) != 1 ||
+                    fread(valid, sizeof(valid), 1, fp) != 1)
+                {
+                    return LM32_SNAP_IO_ERROR;
+                }
+
+                for (int idx = 0; idx < LM32_TLB_NUM_ENTRIES; idx++)
+                {
+                    p_dtlb->valid[idx] = valid[idx] != 0;
+                    p_itlb->valid[idx] = valid[idx + LM32_TLB_NUM_ENTRIES] != 0;
+                }
+            }
+            break;
+#endif
+
+        case LM32_SNAP_SECT_ICACHE:
+        case LM32_SNAP_SECT_DCACHE:
+            {
+                lm32_cache* cache_p = (id == LM32_SNAP_SECT_DCACHE) ? dcache_p : icache_p;
+                int         cdx     = (id == LM32_SNAP_SECT_DCACHE) ? 1 : 0;
+
+                if (cache_p == NULL && p_snap == NULL)
+                {
+                    skip = true;
+                    break;
+                }
+
+                uint32_t* cache_buf = (uint32_t*)malloc((size_t)len + sizeof(uint32_t)*LM32_CACHE_STATE_HDR_WORDS);
+
+                if (cache_buf == NULL)
+                {
+                    return LM32_SNAP_MEM_ERROR;                                         //LCOV_EXCL_LINE
+                }
+
+                if (read_snap_payload(fp, cache_buf, len + sizeof(uint32_t)*LM32_CACHE_STATE_HDR_WORDS, len) < 0)
+                {
+                    free(cache_buf);
+                    return LM32_SNAP_IO_ERROR;
+                }
+
+                // A snapshot handle keeps the cache state as saved, for restoring
+                if (p_snap != NULL)
+                {
+                    free(p_snap->cache_state[cdx]);
+                    p_snap->cache_state[cdx] = cache_buf;
+                    p_snap->cache_bytes[cdx] = (int)len;
+                    break;
+                }
+
+                if (!cache_p->set_state(cache_buf, (int)len))
+                {
+                    cache_p->lm32_cache_invalidate();
+                }
+
+                free(cache_buf);
+            }
+            break;
+
+        case LM32_SNAP_SECT_MEM:
+            {
+                int status = p_snap ? read_snap_pages(fp, len, p_snap) : read_snap_mem(fp, len);
+
+                if (status != LM32_SNAP_OK)
+                {
+                    return status;
+                }
+            }
+            break;
+
+        default:
+            skip = true;
+            for (int udx = 0; udx < num_user; udx++)
+            {
+                if (p_user[udx].id == id)
+                {
+                    if (read_snap_payload(fp, p_user[udx].data, p_user[udx].len, len) < 0)
+                    {
+                        return LM32_SNAP_IO_ERROR;
+                    }
+
+                    p_user[udx].version = sect_hdr[1];
+                    skip = false;
+                    break;
+                }
+            }
+            break;
+        }
+
+        if (skip && fseek(fp, (long)len, SEEK_CUR))
+        {
+            return LM32_SNAP_IO_ERROR;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// write_snap_image()
+//
+// Write all of internal memory (or of the in memory snapshot p_snap, if not
+// NULL) as a single image chunk, with the data starting at the next
+// LM32_SNAP_MAP_ALIGN boundary in the file, so that it can be mapped
+// directly as memory when restored. All zero pages are skipped over, rather
+// than written, leaving holes in the file where supported. Any partial last
+// page is written up to the end of memory.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::write_snap_image (FILE* fp, const lm32_snapshot_t* p_snap)
+{
+    uint32_t chunk_hdr[SNAP_CHUNK_HDR_WORDS] = {mem_offset, num_mem_bytes, num_mem_bytes, LM32_SNAP_CHUNK_IMAGE};
+    uint32_t num_pages                       = (num_mem_bytes + LM32_DIRTY_PAGE_SIZE - 1) >> LM32_DIRTY_PAGE_BITS;
+    long     pos;
+
+    if (fwrite(chunk_hdr, sizeof(chunk_hdr), 1, fp) != 1 || (pos = ftell(fp)) < 0)
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    long data_pos = (pos + LM32_SNAP_MAP_ALIGN - 1) & ~(long)(LM32_SNAP_MAP_ALIGN - 1);
+
+    if (fseek(fp, data_pos, SEEK_SET))
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    uint32_t pdx = 0;
+    while (pdx < num_pages)
+    {
+        uint32_t start   = pdx;
+        bool     nonzero = false;
+
+        // Find a run of pages that are all either zero, or non-zero
+        while (pdx < num_pages)
+        {
+            bool save = snap_page_data(p_snap, mem, num_mem_bytes, pdx) != NULL;
+
+            if (pdx > start && save != nonzero)
+            {
+                break;
+            }
+            nonzero = save;
+            pdx++;
+        }
+
+        uint32_t run_len = (pdx - start) << LM32_DIRTY_PAGE_BITS;
+
+        if (run_len > num_mem_bytes - (start << LM32_DIRTY_PAGE_BITS))
+        {
+            run_len = num_mem_bytes - (start << LM32_DIRTY_PAGE_BITS);
+        }
+
+        if (nonzero && p_snap != NULL)
+        {
+            for (uint32_t idx = start; idx < pdx; idx++)
+            {
+                uint32_t offset = idx << LM32_DIRTY_PAGE_BITS;
+
+                if (fwrite(p_snap->pages[idx]->data, (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE, 1, fp) != 1)
+                {
+                    return LM32_SNAP_IO_ERROR;
+                }
+            }
+        }
+        else if (nonzero ? fwrite(&mem[start << LM32_DIRTY_PAGE_BITS], run_len, 1, fp) != 1 : fseek(fp, run_len, SEEK_CUR) != 0)
+        {
+            return LM32_SNAP_IO_ERROR;
+        }
+    }
+
+    return LM32_SNAP_OK;
+}
+
+// -------------------------------------------------------------------------
+// read_snap_image()
+//
+// Restore internal memory from an image chunk, with its data at the next
+// LM32_SNAP_MAP_ALIGN boundary in the file. Where possible, the image is
+// mapped as a private copy-on-write mapping over internal memory, so that
+// the restore takes constant time, with pages faulted in from the file as
+// accessed. Otherwise the image is read into memory. As for
+// lm32_map_file_to_mem(), the file must not be modified whilst mapped
+// (lm32_save_snapshot() replaces files, rather than overwriting them).
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_snap_image (FILE* fp, const uint32_t offset, const uint32_t len)
+{
+    long pos;
+
+    if ((pos = ftell(fp)) < 0)
+    {
+        return LM32_SNAP_IO_ERROR;
+    }
+
+    long data_pos = (pos + LM32_SNAP_MAP_ALIGN - 1) & ~(long)(LM32_SNAP_MAP_ALIGN - 1);
+    bool mapped   = false;
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    long        page_size = sysconf(_SC_PAGESIZE);
+    struct stat st;
+    int         fd        = fileno(fp);
+
+    // The memory, offset into it and image length must all be page aligned, and the file
+    // must hold the whole image, to be mapped
+    if (page_size > 0 && fd >= 0 && !(((uintptr_t)mem | offset | len | data_pos) & (page_size - 1)) &&
+        fstat(fd, &st) == 0 && (uint64_t)st.st_size >= (uint64_t)data_pos + len)
+    {
+        mapped = mmap(&mem[offset], len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t)data_pos) != MAP_FAILED;
+    }
+#endif
+
+    if (mapped)
+    {
+        if (fseek(fp, data_pos + (long)len, SEEK_SET))
+        {
+            return LM32_SNAP_FORMAT_ERROR;
+        }
+    }
+    else if (fseek(fp, data_pos, SEEK_SET) || fread(&mem[offset], len, 1, fp) != 1)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    return LM32_SNAP_OK;
+}
+
+// -------------------------------------------------------------------------
+// start_dirty_interval()
+//
+// A checkpoint starts a new interval of dirty pages, with those dirtied so
+// far kept as prior dirty pages
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::start_dirty_interval (void)
+{
+    fold_dirty_map();
+
+    for (uint32_t wdx = 0; wdx < dirty_map_words; wdx++)
+    {
+        prior_dirty_map[wdx] |= ckpt_dirty_map[wdx];
+        ckpt_dirty_map[wdx]   = 0;
+    }
+}
+
+// -------------------------------------------------------------------------
+// fold_dirty_map()
+//
+// Stores only mark pages in dirty_map. Before any of the bitmaps tracking
+// pages written over a longer period (since the last checkpoint, the
+// restore point, or the in memory snapshot base) is cleared or used, the
+// pages marked so far are folded into all of them, so that each is
+// unaffected by the others' clears.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::fold_dirty_map (void)
+{
+    for (uint32_t wdx = 0; wdx < dirty_map_words; wdx++)
+    {
+        ckpt_dirty_map[wdx] |= dirty_map[wdx];
+        rp_dirty_map[wdx]   |= dirty_map[wdx];
+        snap_dirty_map[wdx] |= dirty_map[wdx];
+        dirty_map[wdx]       = 0;
+    }
+}
+
+// -------------------------------------------------------------------------
+// read_snap_mem()
+//
+// Read the internal memory section's chunks directly into internal memory
+// (or decompressing). A snapshot of all pages first clears the memory, as
+// zero pages were not saved. Restored pages are marked dirty, except for
+// those of a memory image, which are only marked as prior dirty pages.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_snap_mem (FILE* fp, const uint64_t len)
+{
+    uint32_t mem_hdr[SNAP_MEM_HDR_WORDS];
+    uint32_t chunk_hdr[SNAP_CHUNK_HDR_WORDS];
+    uint8_t* cbuf = NULL;
+
+    if (len < sizeof(mem_hdr) || fread(mem_hdr, sizeof(mem_hdr), 1, fp) != 1)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    // Make sure we have some memory
+    if (mem == NULL) 
+    {
+         if ((mem = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+         {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                   //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+         }
+         mem16 = (uint16_t*)mem;
+         mem32 = (uint32_t*)mem;
+    }
+
+#ifndef LM32_FAST_COMPILE
+    // Allocate some space for the memory tag as well, initialised to 0
+    if (mem_tag == NULL)
+    {
+        if ((mem_tag = (uint8_t *)lm32_alloc_mem(num_mem_bytes/sizeof(uint8_t))) == NULL)
+        {
+            fprintf(stderr, "***ERROR: memory allocation failure\n");                    //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                   //LCOV_EXCL_LINE
+        }
+    }
+#endif
+
+    // A full snapshot without a memory image (which covers all of memory) only has non-zero pages
+    if (!(mem_hdr[3] & (LM32_SNAP_DIRTY_PAGES | LM32_SNAP_MAPPABLE)))
+    {
+        memset(mem, 0, num_mem_bytes);
+        memset(rp_dirty_map,   0xff, dirty_map_words * sizeof(uint64_t));
+        memset(snap_dirty_map, 0xff, dirty_map_words * sizeof(uint64_t));
+    }
+
+    while (true)
+    {
+        if (fread(chunk_hdr, sizeof(chunk_hdr), 1, fp) != 1)
+        {
+            free(cbuf);
+            return LM32_SNAP_FORMAT_ERROR;
+        }
+
+        uint32_t addr     = chunk_hdr[0];
+        uint32_t raw_len  = chunk_hdr[1];
+        uint32_t data_len = chunk_hdr[2];
+        uint32_t offset   = addr - mem_offset;
+
+        // End of chunks
+        if (raw_len == 0)
+        {
+            break;
+        }
+
+        // Chunks must lie within the internal memory, and not expand when compressed
+        if (addr < mem_offset || offset >= num_mem_bytes || raw_len > (num_mem_bytes - offset) || data_len > raw_len)
+        {
+            free(cbuf);
+            return LM32_SNAP_MEM_ERROR;
+        }
+
+        if (chunk_hdr[3] & LM32_SNAP_CHUNK_IMAGE)
+        {
+            int status = (data_len == raw_len) ? read_snap_image(fp, offset, raw_len) : LM32_SNAP_FORMAT_ERROR;
+
+            if (status != LM32_SNAP_OK)
+            {
+                free(cbuf);
+                return status;
+            }
+
+            // A (possibly mapped) image is left untagged, and only counts as written before
+            // the current dirty interval, so that saves of all written pages still include it
+            for (uint32_t pdx = offset; pdx < offset + raw_len; pdx += LM32_DIRTY_PAGE_SIZE)
+            {
+                prior_dirty_map[pdx >> (LM32_DIRTY_PAGE_BITS + 6)] |= 1ULL << ((pdx >> LM32_DIRTY_PAGE_BITS) & 63);
+                snap_dirty_map[pdx >> (LM32_DIRTY_PAGE_BITS + 6)]  |= 1ULL << ((pdx >> LM32_DIRTY_PAGE_BITS) & 63);
+            }
+
+            continue;
+        }
+
+        if (chunk_hdr[3] & LM32_SNAP_CHUNK_COMPRESSED)
+        {
+            if (cbuf == NULL && (cbuf = (uint8_t*)malloc(SNAP_CHUNK_BYTES)) == NULL)
+            {
+                return LM32_SNAP_MEM_ERROR;                                             //LCOV_EXCL_LINE
+            }
+
+            if (data_len > SNAP_CHUNK_BYTES || fread(cbuf, data_len, 1, fp) != 1 || !snap_decompress(cbuf, data_len, &mem[offset], raw_len))
+            {
+                free(cbuf);
+                return LM32_SNAP_FORMAT_ERROR;
+            }
+        }
+        else if (data_len != raw_len || fread(&mem[offset], raw_len, 1, fp) != 1)
+        {
+            free(cbuf);
+            return LM32_SNAP_FORMAT_ERROR;
+        }
+
+        for (uint32_t pdx = offset; pdx < offset + raw_len; pdx += LM32_DIRTY_PAGE_SIZE)
+        {
+            mark_page_dirty(pdx);
+        }
+
+#ifndef LM32_FAST_COMPILE
+        // Tag as loaded data, as for byte loads with cycle counting disabled
+        for (uint32_t idx = offset; idx < offset + raw_len; idx++)
+        {
+            mem_tag[idx] |= MEM_INSTRUCTION_WR;
+        }
+#endif
+    }
+
+    free(cbuf);
+
+    return LM32_SNAP_OK;
+}
+
+// -------------------------------------------------------------------------
+// read_snap_pages()
+//
+// Read the internal memory section's chunks into the pages of an in memory
+// snapshot (with pages allocated, and all zero). As for read_snap_mem(), a
+// snapshot of only dirty pages is applied over the live internal memory,
+// whose non-zero pages are copied first.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_snap_pages (FILE* fp, const uint64_t len, lm32_snapshot_t* p_snap)
+{
+    uint32_t mem_hdr[SNAP_MEM_HDR_WORDS];
+    uint32_t chunk_hdr[SNAP_CHUNK_HDR_WORDS];
+    uint8_t* cbuf   = NULL;
+    uint8_t* dbuf   = NULL;
+    int      status = LM32_SNAP_OK;
+
+    if (len < sizeof(mem_hdr) || fread(mem_hdr, sizeof(mem_hdr), 1, fp) != 1)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    if ((mem_hdr[3] & LM32_SNAP_DIRTY_PAGES) && mem != NULL)
+    {
+        for (uint32_t pdx = 0; pdx < p_snap->num_pages; pdx++)
+        {
+            uint32_t       offset = pdx << LM32_DIRTY_PAGE_BITS;
+            const uint8_t* p_data = snap_page_data(NULL, mem, num_mem_bytes, pdx);
+
+            if (p_data != NULL && !snap_set_page(p_snap, pdx, p_data, (num_mem_bytes - offset) < LM32_DIRTY_PAGE_SIZE ? (num_mem_bytes - offset) : LM32_DIRTY_PAGE_SIZE))
+            {
+                return LM32_SNAP_MEM_ERROR;                                             //LCOV_EXCL_LINE
+            }
+        }
+    }
+
+    if ((cbuf = (uint8_t*)malloc(SNAP_CHUNK_BYTES)) == NULL || (dbuf = (uint8_t*)malloc(SNAP_CHUNK_BYTES)) == NULL)
+    {
+        free(cbuf);                                                                     //LCOV_EXCL_LINE
+        return LM32_SNAP_MEM_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    while (status == LM32_SNAP_OK)
+    {
+        if (fread(chunk_hdr, sizeof(chunk_hdr), 1, fp) != 1)
+        {
+            status = LM32_SNAP_FORMAT_ERROR;
+            break;
+        }
+
+        uint32_t addr     = chunk_hdr[0];
+        uint32_t raw_len  = chunk_hdr[1];
+        uint32_t data_len = chunk_hdr[2];
+        uint32_t offset   = addr - mem_offset;
+        long     pos;
+
+        // End of chunks
+        if (raw_len == 0)
+        {
+            break;
+        }
+
+        // Chunks must lie within the internal memory, on page boundaries (or ending with memory), and not
+        // expand when compressed
+        if (addr < mem_offset || offset >= num_mem_bytes || raw_len > (num_mem_bytes - offset) || data_len > raw_len ||
+            (offset & (LM32_DIRTY_PAGE_SIZE - 1)) || ((raw_len & (LM32_DIRTY_PAGE_SIZE - 1)) && raw_len != (num_mem_bytes - offset)))
+        {
+            status = LM32_SNAP_MEM_ERROR;
+            break;
+        }
+
+        if (chunk_hdr[3] & LM32_SNAP_CHUNK_IMAGE)
+        {
+            // Read the image a chunk's worth at a time from the next LM32_SNAP_MAP_ALIGN boundary
+            if (data_len != raw_len || (pos = ftell(fp)) < 0 ||
+                fseek(fp, (pos + LM32_SNAP_MAP_ALIGN - 1) & ~(long)(LM32_SNAP_MAP_ALIGN - 1), SEEK_SET))
+            {
+                status = LM32_SNAP_FORMAT_ERROR;
+                break;
+            }
+
+            for (uint32_t idx = 0; idx < raw_len && status == LM32_SNAP_OK; idx += SNAP_CHUNK_BYTES)
+            {
+                uint32_t rd_len = (raw_len - idx) < SNAP_CHUNK_BYTES ? (raw_len - idx) : SNAP_CHUNK_BYTES;
+
+                if (fread(dbuf, rd_len, 1, fp) != 1)
+                {
+                    status = LM32_SNAP_FORMAT_ERROR;
+                }
+
+                for (uint32_t bdx = 0; bdx < rd_len && status == LM32_SNAP_OK; bdx += LM32_DIRTY_PAGE_SIZE)
+                {
+                    if (!snap_set_page(p_snap, (offset + idx + bdx) >> LM32_DIRTY_PAGE_BITS, &dbuf[bdx],
+                                       (rd_len - bdx) < LM32_DIRTY_PAGE_SIZE ? (rd_len - bdx) : LM32_DIRTY_PAGE_SIZE))
+                    {
+                        status = LM32_SNAP_MEM_ERROR;                                   //LCOV_EXCL_LINE
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        // Other chunks are no larger than written by write_snap_mem()
+        if (raw_len > SNAP_CHUNK_BYTES)
+        {
+            status = LM32_SNAP_FORMAT_ERROR;
+            break;
+        }
+
+        if (chunk_hdr[3] & LM32_SNAP_CHUNK_COMPRESSED)
+        {
+            if (fread(cbuf, data_len, 1, fp) != 1 || !snap_decompress(cbuf, data_len, dbuf, raw_len))
+            {
+                status = LM32_SNAP_FORMAT_ERROR;
+                break;
+            }
+        }
+        else if (data_len != raw_len || fread(dbuf, raw_len, 1, fp) != 1)
+        {
+            status = LM32_SNAP_FORMAT_ERROR;
+            break;
+        }
+
+        for (uint32_t bdx = 0; bdx < raw_len && status == LM32_SNAP_OK; bdx += LM32_DIRTY_PAGE_SIZE)
+        {
+            if (!snap_set_page(p_snap, (offset + bdx) >> LM32_DIRTY_PAGE_BITS, &dbuf[bdx],
+                               (raw_len - bdx) < LM32_DIRTY_PAGE_SIZE ? (raw_len - bdx) : LM32_DIRTY_PAGE_SIZE))
+            {
+                status = LM32_SNAP_MEM_ERROR;                                           //LCOV_EXCL_LINE
+            }
+        }
+    }
+
+    free(cbuf);
+    free(dbuf);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_set_checkpoint_interval()
+//
+// Set the interval between checkpoints, in instructions and/or host seconds,
+// from now. Both 0 disables checkpoint breaks.
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_set_checkpoint_interval (const uint64_t num_instr, const int num_secs)
+{
+    ckpt_interval_instr = num_instr;
+    ckpt_interval_secs  = num_secs > 0 ? num_secs : 0;
+    ckpt_due_instr      = state.instr_count + num_instr;
+    ckpt_due_time       = time(NULL) + ckpt_interval_secs;
+    ckpt_next_instr     = ~0ULL;
+
+    (void)checkpoint_due();
+}
+
+// -------------------------------------------------------------------------
+// checkpoint_due()
+//
+// Called from the run loop when the instruction count reaches ckpt_next_instr.
+// Returns true if a checkpoint is due, and updates the instruction count for
+// the next check: the next due count, a host time poll, or a host profile
+// drain, whichever is first.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::checkpoint_due (void)
+{
+    bool   due = false;
+    time_t now = ckpt_interval_secs ? time(NULL) : 0;
+
+    // Also called to drain the host profile's samples
+    if (host_prof_usecs)
+    {
+        host_prof_drain();
+    }
+
+    if ((ckpt_interval_instr && state.instr_count >= ckpt_due_instr) ||
+        (ckpt_interval_secs  && now >= ckpt_due_time))
+    {
+        due            = true;
+        ckpt_due_instr = state.instr_count + ckpt_interval_instr;
+        ckpt_due_time  = now + ckpt_interval_secs;
+    }
+
+    ckpt_next_instr = ckpt_interval_instr ? ckpt_due_instr : ~0ULL;
+
+    if (ckpt_interval_secs && state.instr_count + LM32_CKPT_POLL_INSTR < ckpt_next_instr)
+    {
+        ckpt_next_instr = state.instr_count + LM32_CKPT_POLL_INSTR;
+    }
+
+    if (host_prof_usecs && state.instr_count + LM32_PROF_HOST_POLL_INSTR < ckpt_next_instr)
+    {
+        ckpt_next_instr = state.instr_count + LM32_PROF_HOST_POLL_INSTR;
+    }
+
+    return due;
+}
+
+// -------------------------------------------------------------------------
+// ckpt_fname()
+//
+// Construct the filename of checkpoint num, or of the index of the latest
+// checkpoint if num is negative
+//
+// -------------------------------------------------------------------------
+
+static void ckpt_fname (char* fname, const char* base_fname, const int num)
+{
+    if (num < 0)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.ckpt", base_fname);
+    }
+    else
+    {
+        snprintf(fname, FILENAME_MAX, "%s.%06d.ckpt", base_fname, num);
+    }
+}
+
+// -------------------------------------------------------------------------
+// read_ckpt_info()
+//
+// Read the checkpoint section of a checkpoint file (its number and the number
+// of its chain's full checkpoint), skipping over all other sections.
+//
+// -------------------------------------------------------------------------
+
+static int read_ckpt_info (const char* fname, uint32_t info[2])
+{
+    FILE*    fp;
+    char     magic[LM32_SNAP_MAGIC_LEN];
+    uint32_t hdr[4];
+    uint32_t sect_hdr[SNAP_SECT_HDR_BYTES/4];
+    int      status = LM32_SNAP_FORMAT_ERROR;
+
+    if ((fp = fopen(fname, "rb")) == NULL)
+    {
+        return LM32_SNAP_OPEN_ERROR;
+    }
+
+    if (fread(magic, LM32_SNAP_MAGIC_LEN, 1, fp) == 1 && !memcmp(magic, LM32_SNAP_MAGIC, LM32_SNAP_MAGIC_LEN) &&
+        fread(hdr, sizeof(hdr), 1, fp) == 1 && hdr[1] == LM32_SNAP_BYTE_ORDER)
+    {
+        while (fread(sect_hdr, sizeof(sect_hdr), 1, fp) == 1 && sect_hdr[0] != LM32_SNAP_SECT_END)
+        {
+            uint64_t len = (uint64_t)sect_hdr[2] | ((uint64_t)sect_hdr[3] << 32);
+
+            if (sect_hdr[0] == LM32_SNAP_SECT_CKPT)
+            {
+                if (read_snap_payload(fp, info, 2*sizeof(uint32_t), len) == 2*sizeof(uint32_t))
+                {
+                    status = LM32_SNAP_OK;
+                }
+                break;
+            }
+
+            if (fseek(fp, (long)len, SEEK_CUR))
+            {
+                break;
+            }
+        }
+    }
+
+    fclose(fp);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_write_checkpoint()
+//
+// Write the next checkpoint, <base_fname>.<n>.ckpt, and update the index
+// file, <base_fname>.ckpt, with its number. Every keep checkpoints a new
+// chain is started with a full snapshot, else only the pages dirtied since
+// the previous checkpoint are saved. When a new chain is started, the chain
+// before the previous one is deleted, so at least keep checkpoints are
+// always restorable. flags may include LM32_SNAP_COMPRESS, LM32_SNAP_MAPPABLE
+// (for the full checkpoints), and LM32_SNAP_BACKGROUND to write the
+// checkpoint from a forked process (when the status of the previous
+// background checkpoint is returned).
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_write_checkpoint (const char* base_fname, const int keep, const int flags,
+                                     const lm32_snap_section_t* p_user, const int num_user)
+{
+    char                 fname[FILENAME_MAX];
+    int                  del_start = -1;
+    int                  del_end   = -1;
+    int                  pid       = -1;
+    int                  status    = LM32_SNAP_OK;
+    lm32_snap_section_t* sections;
+
+    // Write in the background if asked, with the parent carrying on as if the child succeeds
+    if (flags & LM32_SNAP_BACKGROUND)
+    {
+        pid = fork_snapshot(true, &status);
+    }
+
+    // Start a new chain if none, or the current one has keep checkpoints
+    bool full = ckpt_base_num < 0 || (ckpt_num - ckpt_base_num) >= (keep > 0 ? keep : 1);
+
+    if (full)
+    {
+        del_start          = ckpt_prev_base_num;
+        del_end            = ckpt_base_num;
+        ckpt_prev_base_num = ckpt_base_num;
+        ckpt_base_num      = ckpt_num;
+    }
+
+    if (pid > 0)
+    {
+        start_dirty_interval();
+        ckpt_num++;
+        return status;
+    }
+
+    // Add the checkpoint section to the user's sections
+    uint32_t info[2] = {(uint32_t)ckpt_num, (uint32_t)ckpt_base_num};
+
+    if ((sections = (lm32_snap_section_t*)malloc((num_user + 1) * sizeof(lm32_snap_section_t))) == NULL)
+    {
+        status = LM32_SNAP_MEM_ERROR;                                                   //LCOV_EXCL_LINE
+    }
+    else
+    {
+        for (int udx = 0; udx < num_user; udx++)
+        {
+            sections[udx] = p_user[udx];
+        }
+
+        sections[num_user].id      = LM32_SNAP_SECT_CKPT;
+        sections[num_user].version = 1;
+        sections[num_user].data    = info;
+        sections[num_user].len     = sizeof(info);
+
+        ckpt_fname(fname, base_fname, ckpt_num);
+
+        status = lm32_save_snapshot(fname, (flags & (LM32_SNAP_COMPRESS | LM32_SNAP_MAPPABLE)) | LM32_SNAP_CHECKPOINT | (full ? 0 : LM32_SNAP_DIRTY_PAGES),
+                                    sections, num_user + 1);
+
+        free(sections);
+    }
+
+    if (status == LM32_SNAP_OK)
+    {
+        // Update the index with the latest checkpoint number
+        FILE* fp;
+        ckpt_fname(fname, base_fname, -1);
+
+        if ((fp = fopen(fname, "w")) != NULL)
+        {
+            fprintf(fp, "%d\n", ckpt_num);
+            fclose(fp);
+        }
+        else
+        {
+            status = LM32_SNAP_OPEN_ERROR;
+        }
+
+        // Delete the oldest chain
+        for (int num = del_start; num >= 0 && num < del_end; num++)
+        {
+            ckpt_fname(fname, base_fname, num);
+            remove(fname);
+        }
+
+        ckpt_num++;
+    }
+    else
+    {
+        // Start afresh with a full checkpoint next time
+        ckpt_base_num = -1;
+    }
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    if (pid == 0)
+    {
+        _exit(-status);
+    }
+#endif
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_restore_checkpoint()
+//
+// Restore checkpoint num (or the latest, from the index file, if
+// LM32_CKPT_LATEST) by loading its chain's full checkpoint, followed by each
+// subsequent checkpoint up to num. Checkpoints written after a restore
+// continue the numbering from num, starting a new chain.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_restore_checkpoint (const char* base_fname, const int num, lm32_snap_section_t* p_user, const int num_user)
+{
+    char     fname[FILENAME_MAX];
+    uint32_t info[2];
+    int      ckpt = num;
+    int      status;
+
+    if (ckpt < 0)
+    {
+        FILE* fp;
+        ckpt_fname(fname, base_fname, -1);
+
+        if ((fp = fopen(fname, "r")) == NULL)
+        {
+            return LM32_SNAP_OPEN_ERROR;
+        }
+
+        if (fscanf(fp, "%d", &ckpt) != 1 || ckpt < 0)
+        {
+            fclose(fp);
+            return LM32_SNAP_FORMAT_ERROR;
+        }
+        fclose(fp);
+    }
+
+    ckpt_fname(fname, base_fname, ckpt);
+
+    if ((status = read_ckpt_info(fname, info)) != LM32_SNAP_OK)
+    {
+        return status;
+    }
+
+    if (info[1] > info[0] || info[0] != (uint32_t)ckpt)
+    {
+        return LM32_SNAP_FORMAT_ERROR;
+    }
+
+    for (int cdx = (int)info[1]; cdx <= ckpt; cdx++)
+    {
+        ckpt_fname(fname, base_fname, cdx);
+
+        if ((status = lm32_load_snapshot(fname, p_user, num_user)) != LM32_SNAP_OK)
+        {
+            return status;
+        }
+    }
+
+    // Checkpoints continue from here with a new chain, and the restored pages as dirty since
+    // the last checkpoint
+    ckpt_num           = ckpt + 1;
+    ckpt_base_num      = -1;
+    ckpt_prev_base_num = -1;
+
+    return LM32_SNAP_OK;
+}
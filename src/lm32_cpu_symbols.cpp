@@ -0,0 +1,540 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell
+//
+// Symbol index methods for the lm32_cpu class
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "lm32_cpu.h"
+#include "lm32_cpu_elf.h"
+#include "lm32_cpu_mico32.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Initial number of symbol entries, and string pool bytes, allocated when
+// building an index (doubled as needed)
+#define SYM_INIT_ENTRIES         1024
+#define SYM_INIT_STRING_BYTES    16384
+
+// Maximum length of a System.map line
+#define SYM_MAX_LINE             512
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+// Symbol whilst building an index. Where symbols share an address, the one
+// with the highest rank (functions over other symbols, global over local)
+// is sorted last, so that it's the one found by address lookups.
+typedef struct lm32_sym_build_s {
+    uint32_t addr;
+    uint32_t size;
+    uint32_t name;
+    uint32_t rank;
+} sym_build_t;
+
+// -------------------------------------------------------------------------
+// STATIC VARIABLES
+// -------------------------------------------------------------------------
+
+// String pool and name offsets of the index being sorted by name, for the
+// qsort() comparison
+static const char*     sort_strings;
+static const uint32_t* sort_names;
+
+// -------------------------------------------------------------------------
+// sym_cmp_addr()
+//
+// qsort() comparison of symbols being built, by address and then rank
+//
+// -------------------------------------------------------------------------
+
+static int sym_cmp_addr (const void* a, const void* b)
+{
+    const sym_build_t* p_a = (const sym_build_t*)a;
+    const sym_build_t* p_b = (const sym_build_t*)b;
+
+    if (p_a->addr != p_b->addr)
+    {
+        return (p_a->addr < p_b->addr) ? -1 : 1;
+    }
+
+    return (p_a->rank < p_b->rank) ? -1 : (p_a->rank > p_b->rank) ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------
+// sym_cmp_name()
+//
+// qsort() comparison of symbol numbers, by their names
+//
+// -------------------------------------------------------------------------
+
+static int sym_cmp_name (const void* a, const void* b)
+{
+    return strcmp(&sort_strings[sort_names[*(const uint32_t*)a]], &sort_strings[sort_names[*(const uint32_t*)b]]);
+}
+
+// -------------------------------------------------------------------------
+// sym_add()
+//
+// Add a symbol to the list being built, copying its name to the string
+// pool. The list and pool are grown as required. Returns false on
+// allocation failure.
+//
+// -------------------------------------------------------------------------
+
+static bool sym_add (sym_build_t** p_syms, uint32_t* p_num, uint32_t* p_max,
+                     char** p_strings, uint32_t* p_str_len, uint32_t* p_str_max,
+                     const uint32_t addr, const uint32_t size, const uint32_t rank, const char* name, const uint32_t name_len)
+{
+    if (*p_num == *p_max)
+    {
+        sym_build_t* p_new = (sym_build_t*)realloc(*p_syms, (size_t)*p_max * 2 * sizeof(sym_build_t));
+
+        if (p_new == NULL)
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+
+        *p_syms = p_new;
+        *p_max *= 2;
+    }
+
+    while (*p_str_len + name_len + 1 > *p_str_max)
+    {
+        char* p_new = (char*)realloc(*p_strings, (size_t)*p_str_max * 2);
+
+        if (p_new == NULL)
+        {
+            return false;                                                               //LCOV_EXCL_LINE
+        }
+
+        *p_strings = p_new;
+        *p_str_max *= 2;
+    }
+
+    memcpy(&(*p_strings)[*p_str_len], name, name_len);
+    (*p_strings)[*p_str_len + name_len] = 0;
+
+    (*p_syms)[*p_num].addr = addr;
+    (*p_syms)[*p_num].size = size;
+    (*p_syms)[*p_num].name = *p_str_len;
+    (*p_syms)[*p_num].rank = rank;
+
+    *p_str_len += name_len + 1;
+    (*p_num)++;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// build_symbol_index()
+//
+// Replace the symbol index with the given symbols, sorting them into
+// address order (in a separate array of addresses for searching, with
+// sizes and names alongside) and building an index of symbol numbers
+// sorted by name. Takes ownership of the build list and string pool.
+// Returns the number of symbols, or LM32_SYM_LOAD_FAILED on allocation
+// failure (leaving the index empty).
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::build_symbol_index (sym_build_t* p_syms, const uint32_t num, char* p_strings)
+{
+    lm32_clear_symbols();
+
+    if (num == 0)
+    {
+        free(p_syms);
+        free(p_strings);
+        return 0;
+    }
+
+    qsort(p_syms, num, sizeof(sym_build_t), sym_cmp_addr);
+
+    if ((sym_addr    = (uint32_t*)malloc(num * sizeof(uint32_t))) == NULL ||
+        (sym_size    = (uint32_t*)malloc(num * sizeof(uint32_t))) == NULL ||
+        (sym_name    = (uint32_t*)malloc(num * sizeof(uint32_t))) == NULL ||
+        (sym_by_name = (uint32_t*)malloc(num * sizeof(uint32_t))) == NULL)
+    {
+        free(p_syms);                                                                   //LCOV_EXCL_LINE
+        free(p_strings);                                                                //LCOV_EXCL_LINE
+        lm32_clear_symbols();                                                           //LCOV_EXCL_LINE
+        return LM32_SYM_LOAD_FAILED;                                                    //LCOV_EXCL_LINE
+    }
+
+    for (uint32_t idx = 0; idx < num; idx++)
+    {
+        sym_addr[idx]    = p_syms[idx].addr;
+        sym_size[idx]    = p_syms[idx].size;
+        sym_name[idx]    = p_syms[idx].name;
+        sym_by_name[idx] = idx;
+    }
+
+    free(p_syms);
+
+    sym_strings  = p_strings;
+    sort_strings = sym_strings;
+    sort_names   = sym_name;
+    qsort(sym_by_name, num, sizeof(uint32_t), sym_cmp_name);
+
+    num_syms = num;
+
+    return (int)num;
+}
+
+// -------------------------------------------------------------------------
+// read_elf_symbols()
+//
+// Build the symbol index from the symbol table (.symtab) and its string
+// table of an ELF file image, of image_len bytes, already checked to be a
+// mico32 ELF file. Defined function, object and untyped (e.g. assembler
+// label) symbols are indexed, skipping compiler local labels. Returns the
+// number of symbols, or LM32_SYM_LOAD_FAILED if the section headers are
+// malformed or on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_elf_symbols (const uint8_t* image, const size_t image_len)
+{
+    Elf32_Ehdr   h;
+    Elf32_Shdr   symtab;
+    Elf32_Shdr   strtab;
+    Elf32_Sym    sym;
+    sym_build_t* p_syms;
+    char*        p_strings;
+    uint32_t     num       = 0;
+    uint32_t     max       = SYM_INIT_ENTRIES;
+    uint32_t     str_len   = 0;
+    uint32_t     str_max   = SYM_INIT_STRING_BYTES;
+    bool         found     = false;
+
+    memcpy(&h, image, sizeof(Elf32_Ehdr));
+
+    uint32_t shoff     = SWAP(h.e_shoff);
+    uint32_t shnum     = SWAPHALF(h.e_shnum);
+    uint32_t shentsize = SWAPHALF(h.e_shentsize);
+
+    if (shnum && (shentsize < sizeof(Elf32_Shdr) || (uint64_t)shoff + (uint64_t)shnum * shentsize > image_len))
+    {
+        lm32_clear_symbols();
+        return LM32_SYM_LOAD_FAILED;
+    }
+
+    // Find the symbol table, and the string table it links to
+    for (uint32_t sdx = 0; sdx < shnum && !found; sdx++)
+    {
+        memcpy(&symtab, &image[shoff + sdx * shentsize], sizeof(Elf32_Shdr));
+
+        if (SWAP(symtab.sh_type) == SHT_SYMTAB && SWAP(symtab.sh_link) < shnum)
+        {
+            memcpy(&strtab, &image[shoff + SWAP(symtab.sh_link) * shentsize], sizeof(Elf32_Shdr));
+            found = true;
+        }
+    }
+
+    // No symbol table isn't an error, but leaves no symbols
+    if (!found)
+    {
+        return build_symbol_index(NULL, 0, NULL);
+    }
+
+    uint32_t sym_off  = SWAP(symtab.sh_offset);
+    uint32_t sym_len  = SWAP(symtab.sh_size);
+    uint32_t str_off  = SWAP(strtab.sh_offset);
+    uint32_t str_size = SWAP(strtab.sh_size);
+
+    if ((uint64_t)sym_off + sym_len > image_len || (uint64_t)str_off + str_size > image_len || str_size == 0)
+    {
+        lm32_clear_symbols();
+        return LM32_SYM_LOAD_FAILED;
+    }
+
+    if ((p_syms = (sym_build_t*)malloc(max * sizeof(sym_build_t))) == NULL ||
+        (p_strings = (char*)malloc(str_max)) == NULL)
+    {
+        free(p_syms);                                                                   //LCOV_EXCL_LINE
+        lm32_clear_symbols();                                                           //LCOV_EXCL_LINE
+        return LM32_SYM_LOAD_FAILED;                                                    //LCOV_EXCL_LINE
+    }
+
+    const char* names = (const char*)&image[str_off];
+
+    // Entry 0 is always the null symbol
+    for (uint32_t off = sizeof(Elf32_Sym); off + sizeof(Elf32_Sym) <= sym_len; off += sizeof(Elf32_Sym))
+    {
+        memcpy(&sym, &image[sym_off + off], sizeof(Elf32_Sym));
+
+        uint32_t    type     = ELF32_ST_TYPE(sym.st_info);
+        uint32_t    bind     = ELF32_ST_BIND(sym.st_info);
+        uint32_t    name_off = SWAP(sym.st_name);
+        const char* name     = &names[name_off];
+
+        if ((type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE) ||
+            SWAPHALF(sym.st_shndx) == SHN_UNDEF || SWAPHALF(sym.st_shndx) == SHN_ABS || name_off >= str_size)
+        {
+            continue;
+        }
+
+        // The name must be terminated within the string table
+        uint32_t name_len = (uint32_t)strnlen(name, str_size - name_off);
+
+        if (name_len == 0 || name_len == str_size - name_off || !strncmp(name, ".L", 2) || name[0] == '$')
+        {
+            continue;
+        }
+
+        uint32_t rank = ((type == STT_FUNC) ? 2 : 0) + ((bind != STB_LOCAL) ? 1 : 0);
+
+        if (!sym_add(&p_syms, &num, &max, &p_strings, &str_len, &str_max, SWAP(sym.st_value), SWAP(sym.st_size), rank, name, name_len))
+        {
+            free(p_syms);                                                               //LCOV_EXCL_LINE
+            free(p_strings);                                                            //LCOV_EXCL_LINE
+            lm32_clear_symbols();                                                       //LCOV_EXCL_LINE
+            return LM32_SYM_LOAD_FAILED;                                                //LCOV_EXCL_LINE
+        }
+    }
+
+    return build_symbol_index(p_syms, num, p_strings);
+}
+
+// -------------------------------------------------------------------------
+// read_map_symbols()
+//
+// Build the symbol index from a System.map style file ("<hex address>
+// <type> <name>" on each line), skipping undefined and absolute symbols.
+// Text symbols rank above others, and global (upper case type) above
+// local. Lines that don't parse are ignored. Returns the number of
+// symbols, or LM32_SYM_LOAD_FAILED on allocation failure.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::read_map_symbols (FILE* fp)
+{
+    sym_build_t* p_syms;
+    char*        p_strings;
+    uint32_t     num       = 0;
+    uint32_t     max       = SYM_INIT_ENTRIES;
+    uint32_t     str_len   = 0;
+    uint32_t     str_max   = SYM_INIT_STRING_BYTES;
+    char         line[SYM_MAX_LINE];
+    char         name[SYM_MAX_LINE];
+    unsigned     addr;
+    char         type;
+
+    if ((p_syms = (sym_build_t*)malloc(max * sizeof(sym_build_t))) == NULL ||
+        (p_strings = (char*)malloc(str_max)) == NULL)
+    {
+        free(p_syms);                                                                   //LCOV_EXCL_LINE
+        lm32_clear_symbols();                                                           //LCOV_EXCL_LINE
+        return LM32_SYM_LOAD_FAILED;                                                    //LCOV_EXCL_LINE
+    }
+
+    while (fgets(line, SYM_MAX_LINE, fp) != NULL)
+    {
+        if (sscanf(line, "%x %c %s", &addr, &type, name) != 3 ||
+            type == 'U' || type == 'u' || type == 'A' || type == 'a' || type == 'w' || type == 'v')
+        {
+            continue;
+        }
+
+        uint32_t rank = ((type == 'T' || type == 't') ? 2 : 0) + ((type >= 'A' && type <= 'Z') ? 1 : 0);
+
+        if (!sym_add(&p_syms, &num, &max, &p_strings, &str_len, &str_max, addr, 0, rank, name, (uint32_t)strlen(name)))
+        {
+            free(p_syms);                                                               //LCOV_EXCL_LINE
+            free(p_strings);                                                            //LCOV_EXCL_LINE
+            lm32_clear_symbols();                                                       //LCOV_EXCL_LINE
+            return LM32_SYM_LOAD_FAILED;                                                //LCOV_EXCL_LINE
+        }
+    }
+
+    return build_symbol_index(p_syms, num, p_strings);
+}
+
+// -------------------------------------------------------------------------
+// lm32_load_symbols()
+//
+// Replace the symbol index with the symbols of the named file, either an
+// ELF file's symbol table, or a System.map style list. (The symbols of
+// programs loaded from ELF files are indexed automatically.) Returns the
+// number of symbols, or LM32_SYM_LOAD_FAILED if the file can't be read.
+//
+// -------------------------------------------------------------------------
+
+int lm32_cpu::lm32_load_symbols (const char* fname)
+{
+    FILE*    fp;
+    uint8_t* image;
+    long     len;
+    int      status;
+    char     ident[4];
+
+    if ((fp = fopen(fname, "rb")) == NULL)
+    {
+        return LM32_SYM_LOAD_FAILED;
+    }
+
+    // A System.map file is parsed as text
+    if (fread(ident, 1, 4, fp) != 4 || memcmp(ident, ELF_IDENT, 4))
+    {
+        rewind(fp);
+        status = read_map_symbols(fp);
+        fclose(fp);
+        return status;
+    }
+
+    // An ELF file is read whole, to find its sections
+    if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < (long)sizeof(Elf32_Ehdr) || fseek(fp, 0, SEEK_SET) != 0 ||
+        (image = (uint8_t*)malloc((size_t)len)) == NULL)
+    {
+        fclose(fp);
+        return LM32_SYM_LOAD_FAILED;
+    }
+
+    status = (fread(image, 1, (size_t)len, fp) == (size_t)len) ? read_elf_symbols(image, (size_t)len) : LM32_SYM_LOAD_FAILED;
+
+    free(image);
+    fclose(fp);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32_clear_symbols()
+//
+// Empty the symbol index, freeing its storage
+//
+// -------------------------------------------------------------------------
+
+void lm32_cpu::lm32_clear_symbols (void)
+{
+    free(sym_addr);
+    free(sym_size);
+    free(sym_name);
+    free(sym_by_name);
+    free(sym_strings);
+
+    sym_addr    = NULL;
+    sym_size    = NULL;
+    sym_name    = NULL;
+    sym_by_name = NULL;
+    sym_strings = NULL;
+    num_syms    = 0;
+}
+
+// -------------------------------------------------------------------------
+// lm32_lookup_symbol()
+//
+// Returns the name of the symbol containing byte_addr (or NULL if none),
+// setting *p_offset (if not NULL) to the offset of byte_addr from it. This
+// is the highest symbol at or below byte_addr, by binary search of the
+// address array, which must also cover byte_addr if it has a size. Symbols
+// without a size extend to the next symbol.
+//
+// -------------------------------------------------------------------------
+
+const char* lm32_cpu::lm32_lookup_symbol (const uint32_t byte_addr, uint32_t* p_offset)
+{
+    uint32_t lo = 0;
+    uint32_t hi = num_syms;
+
+    // Find the first symbol above byte_addr
+    while (lo < hi)
+    {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+
+        if (sym_addr[mid] <= byte_addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0)
+    {
+        return NULL;
+    }
+
+    uint32_t idx    = lo - 1;
+    uint32_t offset = byte_addr - sym_addr[idx];
+
+    if (sym_size[idx] != 0 && offset >= sym_size[idx])
+    {
+        return NULL;
+    }
+
+    if (p_offset != NULL)
+    {
+        *p_offset = offset;
+    }
+
+    return &sym_strings[sym_name[idx]];
+}
+
+// -------------------------------------------------------------------------
+// lm32_find_symbol()
+//
+// Look up a symbol by name, by binary search of the name index, setting
+// *p_addr to its address. Returns false if not found. Where a (local)
+// name appears more than once, any one of them may be found.
+//
+// -------------------------------------------------------------------------
+
+bool lm32_cpu::lm32_find_symbol (const char* name, uint32_t* p_addr)
+{
+    uint32_t lo = 0;
+    uint32_t hi = num_syms;
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+        int      cmp = strcmp(name, &sym_strings[sym_name[sym_by_name[mid]]]);
+
+        if (cmp == 0)
+        {
+            *p_addr = sym_addr[sym_by_name[mid]];
+            return true;
+        }
+        else if (cmp < 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    return false;
+}
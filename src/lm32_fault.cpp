@@ -0,0 +1,527 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell. All rights reserved.
+//
+// Fault injection campaigns on guest firmware
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#if !(defined _WIN32) && !(defined _WIN64)
+#include <unistd.h>
+#endif
+
+#include "lm32_fault.h"
+#include "lm32_cpu.h"
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+// Result of a run, as passed back from parallel processes
+typedef struct {
+    int         run;
+    int         target;
+    int         outcome;
+    int         bit;
+    uint32_t    location;       // Register number, memory address or instruction address
+    lm32_time_t cycle;
+} lm32fault_result_t;
+
+// -------------------------------------------------------------------------
+// LOCAL CONSTANTS
+// -------------------------------------------------------------------------
+
+static const char target_chars[LM32FAULT_NUM_TGTS]        = {'r', 'm', 'i'};
+static const char* target_names[LM32FAULT_NUM_TGTS]       = {"registers", "memory", "instructions"};
+static const char* outcome_names[LM32FAULT_NUM_OUTCOMES]  = {"masked", "sdc", "crash", "hang"};
+
+// -------------------------------------------------------------------------
+// STATIC VARIABLES
+// -------------------------------------------------------------------------
+
+// Configured targets
+static int                  targets[LM32FAULT_NUM_TGTS];
+static int                  num_targets = 0;
+
+// Golden run results, and the window of cycles in which faults are injected
+static lm32_cpu::lm32_state golden_state;
+static int                  golden_status;
+static uint64_t             golden_digest;
+static lm32_time_t          start_cycle;
+static lm32_time_t          end_cycle;
+static lm32_time_t          cycle_limit;
+
+// Internal memory range for memory faults
+static uint32_t             mem_start;
+static uint32_t             mem_end;
+
+// -------------------------------------------------------------------------
+// lm32fault_rand()
+//
+// Returns a random number below limit (which must be non-zero), from the
+// xorshift generator state at p_rng.
+//
+// -------------------------------------------------------------------------
+
+static uint32_t lm32fault_rand (uint64_t* p_rng, const uint64_t limit)
+{
+    *p_rng ^= *p_rng << 13;
+    *p_rng ^= *p_rng >> 7;
+    *p_rng ^= *p_rng << 17;
+
+    return (uint32_t)(*p_rng % limit);
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_run_to()
+//
+// Continue the program until it ends, breaks, or reaches the given cycle
+// count, returning the break status. Breaks that don't affect execution
+// are continued.
+//
+// -------------------------------------------------------------------------
+
+static int lm32fault_run_to (lm32_cpu* cpu, const lm32_config_t* p_cfg, const lm32_time_t cycles)
+{
+    int status;
+
+    do
+    {
+        status = cpu->lm32_run_program(NULL, cycles, p_cfg->user_break_addr, LM32_RUN_CONTINUE, false);
+    }
+    while (status == LM32_RESET_BREAK || status == LM32_INT_BREAK || status == LM32_CHECKPOINT_BREAK);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_ended()
+//
+// Returns true if a run with the break status has ended, rather than just
+// reaching a cycle count (also a user break).
+//
+// -------------------------------------------------------------------------
+
+static bool lm32fault_ended (lm32_cpu* cpu, const lm32_config_t* p_cfg, const int status)
+{
+    return status != LM32_USER_BREAK || cpu->lm32_get_cpu_state().pc == (p_cfg->user_break_addr & ~0x3U);
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_matches_golden()
+//
+// Returns true if the final registers and memory match the golden run's.
+//
+// -------------------------------------------------------------------------
+
+static bool lm32fault_matches_golden (lm32_cpu* cpu)
+{
+    lm32_cpu::lm32_state st = cpu->lm32_get_cpu_state();
+
+    return !memcmp(st.r, golden_state.r, sizeof(st.r)) && cpu->lm32_mem_digest() == golden_digest;
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_latent()
+//
+// Returns true if a register or memory fault is latent, i.e. the faulty bit
+// was never used, so the final state matches the golden run's apart from
+// the bit itself. The bit is flipped back to check (the run is over).
+//
+// -------------------------------------------------------------------------
+
+static bool lm32fault_latent (lm32_cpu* cpu, const lm32fault_result_t* p_result)
+{
+    lm32_cpu::lm32_state st;
+
+    switch(p_result->target)
+    {
+    case LM32FAULT_TGT_REG:
+        st = cpu->lm32_get_cpu_state();
+        st.r[p_result->location] ^= 1U << p_result->bit;
+        cpu->lm32_set_cpu_state(st);
+        return lm32fault_matches_golden(cpu);
+
+    case LM32FAULT_TGT_MEM:
+        cpu->lm32_flip_mem_bit(p_result->location, p_result->bit);
+        return lm32fault_matches_golden(cpu);
+
+    default:
+        return false;
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_inject()
+//
+// Execute a run: from the restore point, run to a random cycle in the
+// golden run's window, inject a single bit flip into a random target and
+// run to the end (or the cycle limit), and classify the outcome against
+// the golden run. The random choices depend only on the seed and run
+// number, so results don't depend on how runs are spread over processes.
+//
+// A register fault flips a bit of a general purpose register, a memory
+// fault a bit of a byte in the memory range, and an instruction fault a
+// bit of the next instruction for just its one execution.
+//
+// -------------------------------------------------------------------------
+
+static void lm32fault_inject (lm32_cpu* cpu, const lm32_config_t* p_cfg, const int run, lm32fault_result_t* p_result)
+{
+    lm32_cpu::lm32_state st;
+    int                  status;
+    uint64_t             rng = ((uint64_t)p_cfg->fault_seed << 32) ^ ((uint64_t)run * 0x9e3779b97f4a7c15ULL) ^ 0x2545f4914f6cdd1dULL;
+
+    // Warm up the generator, as neighbouring runs have similar seeds
+    for (int idx = 0; idx < 4; idx++)
+    {
+        lm32fault_rand(&rng, 1);
+    }
+
+    p_result->run      = run;
+    p_result->location = 0;
+    p_result->bit      = 0;
+    p_result->target   = targets[lm32fault_rand(&rng, num_targets)];
+    p_result->cycle    = start_cycle + ((end_cycle > start_cycle) ? lm32fault_rand(&rng, end_cycle - start_cycle) : 0);
+
+    cpu->lm32_restore();
+
+    status = lm32fault_run_to(cpu, p_cfg, p_result->cycle);
+
+    // Inject the fault, unless the program has already ended
+    if (!lm32fault_ended(cpu, p_cfg, status))
+    {
+        st     = cpu->lm32_get_cpu_state();
+        status = LM32_USER_BREAK;
+
+        switch(p_result->target)
+        {
+        case LM32FAULT_TGT_REG:
+            p_result->location  = lm32fault_rand(&rng, LM32_NUM_OF_REGISTERS);
+            p_result->bit       = lm32fault_rand(&rng, 32);
+            st.r[p_result->location] ^= 1U << p_result->bit;
+            cpu->lm32_set_cpu_state(st);
+            break;
+
+        case LM32FAULT_TGT_MEM:
+            p_result->location  = mem_start + lm32fault_rand(&rng, (uint64_t)mem_end - mem_start);
+            p_result->bit       = lm32fault_rand(&rng, 8);
+            cpu->lm32_flip_mem_bit(p_result->location, p_result->bit);
+            break;
+
+        case LM32FAULT_TGT_INSTR:
+            // Flip a bit of the (big endian) instruction word, execute it, and then
+            // restore it
+            p_result->location  = st.pc;
+            p_result->bit       = lm32fault_rand(&rng, 32);
+
+            if (cpu->lm32_flip_mem_bit(st.pc + 3 - (p_result->bit >> 3), p_result->bit))
+            {
+                status = cpu->lm32_run_program(NULL, LM32_FOREVER, p_cfg->user_break_addr, LM32_RUN_SINGLE_STEP, false);
+                cpu->lm32_flip_mem_bit(st.pc + 3 - (p_result->bit >> 3), p_result->bit);
+            }
+            break;
+        }
+
+        // Run to the end, unless the faulty instruction ended it
+        if (status == LM32_USER_BREAK || status == LM32_SINGLE_STEP_BREAK)
+        {
+            status = lm32fault_run_to(cpu, p_cfg, cycle_limit);
+        }
+    }
+
+    st = cpu->lm32_get_cpu_state();
+
+    switch(status)
+    {
+    case LM32_BUS_ERROR_BREAK:
+    case LM32_DIV_ZERO_BREAK:
+    case LM32_HW_WATCHPOINT_BREAK:
+    case LM32_HW_BREAKPOINT_BREAK:
+        p_result->outcome = LM32FAULT_CRASH;
+        break;
+
+    default:
+        if (!lm32fault_ended(cpu, p_cfg, status))
+        {
+            p_result->outcome = LM32FAULT_HANG;
+        }
+        else if (status != golden_status || st.pc != golden_state.pc)
+        {
+            p_result->outcome = LM32FAULT_CRASH;
+        }
+        else if (lm32fault_matches_golden(cpu) || lm32fault_latent(cpu, p_result))
+        {
+            p_result->outcome = LM32FAULT_MASKED;
+        }
+        else
+        {
+            p_result->outcome = LM32FAULT_SDC;
+        }
+        break;
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_golden()
+//
+// Load the program and run it to the entry address (if configured), where
+// the restore point is set, then do the golden (fault free) run from there
+// to the end, recording its final state. Returns false, with an error
+// message, if the program doesn't reach the entry address or end cleanly.
+//
+// -------------------------------------------------------------------------
+
+static bool lm32fault_golden (lm32_cpu* cpu, const lm32_config_t* p_cfg)
+{
+    int status;
+
+    // Run a zero cycles if there's no entry address, to just load the program
+    status = cpu->lm32_run_program(p_cfg->filename, (p_cfg->harness_entry_addr == -1) ? 0 : LM32_FOREVER,
+                                   p_cfg->harness_entry_addr, LM32_RUN_FROM_RESET, true);
+
+    while (p_cfg->harness_entry_addr != -1 && status != LM32_USER_BREAK)
+    {
+        if (status == LM32_LOCK_BREAK || status == LM32_DISASSEMBLE_BREAK)
+        {
+            fprintf(stderr, "***ERROR: program did not reach fault injection entry address 0x%08x\n", p_cfg->harness_entry_addr);
+            return false;
+        }
+        status = cpu->lm32_run_program(NULL, LM32_FOREVER, p_cfg->harness_entry_addr, LM32_RUN_CONTINUE, false);
+    }
+
+    if (!cpu->lm32_set_restore_point())
+    {
+        fprintf(stderr, "***ERROR: could not set fault injection restore point\n");     //LCOV_EXCL_LINE
+        return false;                                                                   //LCOV_EXCL_LINE
+    }
+
+    // Restore now, so that the golden run starts in the same way as the
+    // faulty runs (e.g. with invalidated caches)
+    cpu->lm32_restore();
+
+    start_cycle   = cpu->lm32_get_cpu_state().cycle_count;
+
+    golden_status = lm32fault_run_to(cpu, p_cfg, (p_cfg->num_run_instructions > 0) ? start_cycle + p_cfg->num_run_instructions : LM32_FOREVER);
+
+    if ((golden_status != LM32_LOCK_BREAK && golden_status != LM32_USER_BREAK) || !lm32fault_ended(cpu, p_cfg, golden_status))
+    {
+        fprintf(stderr, "***ERROR: fault free program run did not end at a lock or break address (status %d)\n", golden_status);
+        return false;
+    }
+
+    golden_state  = cpu->lm32_get_cpu_state();
+    golden_digest = cpu->lm32_mem_digest();
+    end_cycle     = golden_state.cycle_count;
+    cycle_limit   = start_cycle + (end_cycle - start_cycle) * LM32FAULT_HANG_FACTOR + LM32FAULT_HANG_MARGIN;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_report()
+//
+// Print a summary table of run outcomes for each target, and write each
+// run's result to the results file, if configured.
+//
+// -------------------------------------------------------------------------
+
+static void lm32fault_report (const lm32_config_t* p_cfg, const lm32fault_result_t* results, const int num_jobs, const double secs, FILE* lfp)
+{
+    int   counts[LM32FAULT_NUM_TGTS + 1][LM32FAULT_NUM_OUTCOMES];
+    FILE* fp = NULL;
+
+    memset(counts, 0, sizeof(counts));
+
+    if (p_cfg->fault_results_fname != NULL && (fp = fopen(p_cfg->fault_results_fname, "w")) == NULL)
+    {
+        fprintf(stderr, "Warning: could not open fault injection results file %s for writing\n", p_cfg->fault_results_fname);
+    }
+
+    if (fp != NULL)
+    {
+        fprintf(fp, "run,target,cycle,location,bit,outcome\n");
+    }
+
+    for (int run = 0; run < p_cfg->fault_runs; run++)
+    {
+        const lm32fault_result_t* p_result = &results[run];
+
+        counts[p_result->target][p_result->outcome]++;
+        counts[LM32FAULT_NUM_TGTS][p_result->outcome]++;
+
+        if (fp != NULL)
+        {
+            fprintf(fp, "%d,%c,%lld,0x%08x,%d,%s\n", run, target_chars[p_result->target], (long long)p_result->cycle,
+                    p_result->location, p_result->bit, outcome_names[p_result->outcome]);
+        }
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    fprintf(lfp, "\nFault injection: %d runs in %.0f seconds (%d jobs), fault free run of %lld cycles\n\n",
+            p_cfg->fault_runs, secs, num_jobs, (long long)(end_cycle - start_cycle));
+
+    fprintf(lfp, "  %-14s %10s %10s %10s %10s\n", "", "masked", "SDC", "crash", "hang");
+
+    for (int tdx = 0; tdx <= LM32FAULT_NUM_TGTS; tdx++)
+    {
+        fprintf(lfp, "  %-14s %10d %10d %10d %10d\n", (tdx == LM32FAULT_NUM_TGTS) ? "total" : target_names[tdx],
+                counts[tdx][LM32FAULT_MASKED], counts[tdx][LM32FAULT_SDC], counts[tdx][LM32FAULT_CRASH], counts[tdx][LM32FAULT_HANG]);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32fault_run()
+//
+// Run a fault injection campaign. After a single golden run from the
+// restore point, each run restores it and injects one fault (see
+// lm32fault_inject()). Runs are spread over parallel processes cloned from
+// the model, which pass their results back over a pipe, with run r done
+// by process (r mod jobs). Returns LM32_NO_ERROR, or an error status.
+//
+// -------------------------------------------------------------------------
+
+int lm32fault_run (lm32_cpu* cpu, const lm32_config_t* p_cfg, FILE* lfp)
+{
+    lm32fault_result_t* results;
+    int                 num_jobs   = 1;
+    time_t              start_time = time(NULL);
+
+    // Get the configured targets
+    for (int tdx = 0; tdx < LM32FAULT_NUM_TGTS; tdx++)
+    {
+        if (strchr(p_cfg->fault_targets, target_chars[tdx]) != NULL)
+        {
+            targets[num_targets++] = tdx;
+        }
+    }
+
+    mem_start = p_cfg->fault_mem_start_addr ? p_cfg->fault_mem_start_addr : p_cfg->mem_offset;
+    mem_end   = p_cfg->fault_mem_end_addr   ? p_cfg->fault_mem_end_addr   : p_cfg->mem_offset + p_cfg->mem_size;
+
+    if (num_targets == 0 || mem_end <= mem_start)
+    {
+        fprintf(stderr, "***ERROR: no valid fault injection targets or memory range\n");
+        return LM32_USER_ERROR;
+    }
+
+    if ((results = (lm32fault_result_t*)calloc(p_cfg->fault_runs, sizeof(lm32fault_result_t))) == NULL)
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        return LM32_INTERNAL_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    if (!lm32fault_golden(cpu, p_cfg))
+    {
+        free(results);
+        return LM32_USER_ERROR;
+    }
+
+#if !(defined _WIN32) && !(defined _WIN64)
+    int fds[2];
+    int inst;
+
+    num_jobs = (p_cfg->fault_jobs > 0) ? p_cfg->fault_jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    num_jobs = (num_jobs > p_cfg->fault_runs) ? p_cfg->fault_runs : (num_jobs > LM32FAULT_MAX_JOBS) ? LM32FAULT_MAX_JOBS : num_jobs;
+    num_jobs = (num_jobs < 1) ? 1 : num_jobs;
+
+    if (num_jobs > 1)
+    {
+        if (pipe(fds) < 0 || (inst = cpu->lm32_clone_instances(num_jobs)) < 0)
+        {
+            fprintf(stderr, "***ERROR: unable to create fault injection processes\n");  //LCOV_EXCL_LINE
+            exit(LM32_INTERNAL_ERROR);                                                  //LCOV_EXCL_LINE
+        }
+
+        // Each clone does its share of runs, writing each result (atomically) to the pipe
+        if (inst > 0)
+        {
+            lm32fault_result_t result;
+
+            close(fds[0]);
+
+            for (int run = inst - 1; run < p_cfg->fault_runs; run += num_jobs)
+            {
+                lm32fault_inject(cpu, p_cfg, run, &result);
+
+                if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+                {
+                    _exit(LM32_INTERNAL_ERROR);                                         //LCOV_EXCL_LINE
+                }
+            }
+
+            _exit(LM32_NO_ERROR);
+        }
+
+        // The original collects results until all the clones have closed the pipe
+        lm32fault_result_t result;
+        int                num_results = 0;
+        int                status;
+
+        close(fds[1]);
+
+        while (read(fds[0], &result, sizeof(result)) == sizeof(result))
+        {
+            if (result.run >= 0 && result.run < p_cfg->fault_runs)
+            {
+                results[result.run] = result;
+                num_results++;
+            }
+        }
+
+        close(fds[0]);
+
+        while (cpu->lm32_wait_instance(&status) > 0)
+            ;
+
+        if (num_results != p_cfg->fault_runs)
+        {
+            fprintf(stderr, "***ERROR: only %d of %d fault injection runs completed\n", num_results, p_cfg->fault_runs);
+            free(results);
+            return LM32_INTERNAL_ERROR;
+        }
+    }
+    else
+#endif
+    {
+        for (int run = 0; run < p_cfg->fault_runs; run++)
+        {
+            lm32fault_inject(cpu, p_cfg, run, &results[run]);
+        }
+    }
+
+    lm32fault_report(p_cfg, results, num_jobs, difftime(time(NULL), start_time), lfp);
+
+    free(results);
+
+    return LM32_NO_ERROR;
+}
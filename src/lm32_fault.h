@@ -0,0 +1,66 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell. All rights reserved.
+//
+// Fault injection campaigns on guest firmware
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+#ifndef _LM32_FAULT_H_
+#define _LM32_FAULT_H_
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "lm32_cpu.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Fault targets
+#define LM32FAULT_TGT_REG             0
+#define LM32FAULT_TGT_MEM             1
+#define LM32FAULT_TGT_INSTR           2
+#define LM32FAULT_NUM_TGTS            3
+
+// Run outcomes, compared with the golden (fault free) run
+#define LM32FAULT_MASKED              0              // Same final registers and memory (bar a latent faulty bit)
+#define LM32FAULT_SDC                 1              // Silent data corruption: same end, different data
+#define LM32FAULT_CRASH               2              // Trapped (bus error, divide by zero, h/w break/watchpoint), or ended elsewhere
+#define LM32FAULT_HANG                3              // Didn't end within the cycle limit
+#define LM32FAULT_NUM_OUTCOMES        4
+
+// A run hangs if not ended after this many times the golden run's cycles
+// (from the entry point), plus a margin
+#define LM32FAULT_HANG_FACTOR         2
+#define LM32FAULT_HANG_MARGIN         1000
+
+// Maximum number of parallel processes
+#define LM32FAULT_MAX_JOBS            256
+
+// -------------------------------------------------------------------------
+// PUBLIC PROTOTYPES
+// -------------------------------------------------------------------------
+
+extern int lm32fault_run (lm32_cpu* cpu, const lm32_config_t* p_cfg, FILE* lfp);
+
+#endif
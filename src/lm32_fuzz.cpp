@@ -0,0 +1,439 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell. All rights reserved.
+//
+// Snapshot based, coverage guided fuzzing of guest firmware
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "lm32_fuzz.h"
+#include "lm32_cpu.h"
+
+// -------------------------------------------------------------------------
+// TYPEDEFS
+// -------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t* data;
+    int      len;
+} lm32fuzz_input_t;
+
+// -------------------------------------------------------------------------
+// LOCAL CONSTANTS
+// -------------------------------------------------------------------------
+
+static const uint8_t  interesting8[]  = {0x00, 0x01, 0x10, 0x20, 0x40, 0x64, 0x7f, 0x80, 0xff};
+static const uint32_t interesting32[] = {0x00000000, 0x00000001, 0x0000007f, 0x00000080, 0x000000ff, 0x00000100,
+                                         0x00007fff, 0x00008000, 0x0000ffff, 0x00010000, 0x7fffffff, 0x80000000,
+                                         0xfffffffe, 0xffffffff};
+
+// -------------------------------------------------------------------------
+// STATIC VARIABLES
+// -------------------------------------------------------------------------
+
+// Inputs that found new coverage
+static lm32fuzz_input_t corpus[LM32FUZZ_MAX_CORPUS];
+static int              corpus_size = 0;
+
+// Coverage seen over all executions, as a bit per hit count bucket of each edge
+static uint8_t          virgin_map[LM32_COV_MAP_SIZE];
+
+static uint64_t         rng_state   = LM32FUZZ_RNG_SEED;
+
+// -------------------------------------------------------------------------
+// lm32fuzz_rand()
+//
+// Returns a random number below limit (which must be non-zero), from a
+// xorshift generator.
+//
+// -------------------------------------------------------------------------
+
+static uint32_t lm32fuzz_rand (const uint32_t limit)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return (uint32_t)(rng_state % limit);
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_bucket()
+//
+// Classify an edge hit count into a bucket bit, so that only changes in the
+// rough number of times an edge is executed (e.g. loop iterations) count
+// as new coverage.
+//
+// -------------------------------------------------------------------------
+
+static inline uint8_t lm32fuzz_bucket (const uint8_t count)
+{
+    return count <  4  ? (count == 3 ? 4 : count) :
+           count <  8  ? 8                        :
+           count <  16 ? 16                       :
+           count <  32 ? 32                       :
+           count < 128 ? 64                       : 128;
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_new_coverage()
+//
+// Merge the coverage of the last execution into the virgin map, returning
+// true if it hit any new edge or hit count bucket. The map is scanned a
+// word at a time, as most of it is untouched by any one execution.
+//
+// -------------------------------------------------------------------------
+
+static bool lm32fuzz_new_coverage (const uint8_t* cov_map)
+{
+    const uint64_t* cov64 = (const uint64_t*)cov_map;
+    bool            found = false;
+
+    for (int wdx = 0; wdx < LM32_COV_MAP_SIZE/8; wdx++)
+    {
+        if (cov64[wdx])
+        {
+            for (int bdx = wdx*8; bdx < (wdx+1)*8; bdx++)
+            {
+                uint8_t bucket = lm32fuzz_bucket(cov_map[bdx]);
+
+                if (bucket & ~virgin_map[bdx])
+                {
+                    virgin_map[bdx] |= bucket;
+                    found            = true;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_mutate()
+//
+// Apply a random stack of mutations to the input in buf, of length len
+// and at most max_len bytes, returning the new length.
+//
+// -------------------------------------------------------------------------
+
+static int lm32fuzz_mutate (uint8_t* buf, int len, const int max_len)
+{
+    int num_mutations = 1 + lm32fuzz_rand(LM32FUZZ_MAX_STACKED);
+
+    for (int mdx = 0; mdx < num_mutations; mdx++)
+    {
+        // An empty input can only grow
+        int op = len ? lm32fuzz_rand(7) : 5;
+
+        switch(op)
+        {
+        // Flip a bit
+        case 0:
+            buf[lm32fuzz_rand(len)] ^= 1 << lm32fuzz_rand(8);
+            break;
+
+        // Set a byte to an interesting value
+        case 1:
+            buf[lm32fuzz_rand(len)] = interesting8[lm32fuzz_rand(sizeof(interesting8))];
+            break;
+
+        // Add or subtract a small value to a byte
+        case 2:
+            buf[lm32fuzz_rand(len)] += (uint8_t)(lm32fuzz_rand(2) ? 1 + lm32fuzz_rand(35) : -(int)(1 + lm32fuzz_rand(35)));
+            break;
+
+        // Set a random byte value
+        case 3:
+            buf[lm32fuzz_rand(len)] = (uint8_t)lm32fuzz_rand(256);
+            break;
+
+        // Delete a block
+        case 4:
+            if (len > 1)
+            {
+                int del = 1 + lm32fuzz_rand(len - 1);
+                int pos = lm32fuzz_rand(len - del + 1);
+                memmove(&buf[pos], &buf[pos + del], len - pos - del);
+                len -= del;
+            }
+            break;
+
+        // Insert a block, cloned from the input, or of random bytes if empty
+        case 5:
+            if (len < max_len)
+            {
+                uint8_t blk[LM32FUZZ_MAX_BLOCK];
+                int     ins = 1 + lm32fuzz_rand((max_len - len) < LM32FUZZ_MAX_BLOCK ? (max_len - len) : LM32FUZZ_MAX_BLOCK);
+                int     pos = lm32fuzz_rand(len + 1);
+                int     src = len ? lm32fuzz_rand(len) : 0;
+
+                for (int idx = 0; idx < ins; idx++)
+                {
+                    blk[idx] = len ? buf[(src + idx) % len] : (uint8_t)lm32fuzz_rand(256);
+                }
+
+                memmove(&buf[pos + ins], &buf[pos], len - pos);
+                memcpy(&buf[pos], blk, ins);
+                len += ins;
+            }
+            break;
+
+        // Overwrite a word with an interesting (big endian) value
+        case 6:
+            if (len >= 4)
+            {
+                int      pos = lm32fuzz_rand(len - 3);
+                uint32_t val = interesting32[lm32fuzz_rand(sizeof(interesting32)/sizeof(uint32_t))];
+                buf[pos]     = (uint8_t)(val >> 24);
+                buf[pos + 1] = (uint8_t)(val >> 16);
+                buf[pos + 2] = (uint8_t)(val >> 8);
+                buf[pos + 3] = (uint8_t)val;
+            }
+            break;
+        }
+    }
+
+    return len;
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_exec()
+//
+// Execute an input from the restore point. The input is written to the
+// guest's input buffer as a (big endian) length word followed by the input
+// bytes, and the guest then runs until it completes (at the user break
+// address, or a lock condition), crashes (on a bus error, divide by zero,
+// or h/w break- or watchpoint), or hangs (reaching the cycle limit).
+//
+// -------------------------------------------------------------------------
+
+static int lm32fuzz_exec (lm32_cpu* cpu, const lm32_config_t* p_cfg, const uint8_t* buf, const int len, const lm32_time_t cycle_limit)
+{
+    int status;
+
+    cpu->lm32_restore();
+    cpu->lm32_clear_coverage();
+
+    cpu->lm32_write_mem(p_cfg->fuzz_input_addr, len, LM32_MEM_WR_ACCESS_WORD, true);
+
+    for (int idx = 0; idx < len; idx++)
+    {
+        cpu->lm32_write_mem(p_cfg->fuzz_input_addr + 4 + idx, buf[idx], LM32_MEM_WR_ACCESS_BYTE, true);
+    }
+
+    do
+    {
+        status = cpu->lm32_run_program(NULL, cycle_limit, p_cfg->user_break_addr, LM32_RUN_CONTINUE, false);
+    }
+    while (status == LM32_RESET_BREAK || status == LM32_INT_BREAK || status == LM32_CHECKPOINT_BREAK);
+
+    switch(status)
+    {
+    case LM32_BUS_ERROR_BREAK:
+    case LM32_DIV_ZERO_BREAK:
+    case LM32_HW_WATCHPOINT_BREAK:
+    case LM32_HW_BREAKPOINT_BREAK:
+        return LM32FUZZ_RUN_CRASH;
+
+    default:
+        return (cpu->lm32_get_cpu_state().cycle_count >= cycle_limit) ? LM32FUZZ_RUN_HANG : LM32FUZZ_RUN_OK;
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_save()
+//
+// Save an input to a file named <prefix>.<type>.<num>.
+//
+// -------------------------------------------------------------------------
+
+static void lm32fuzz_save (const lm32_config_t* p_cfg, const char* type, const int num, const uint8_t* buf, const int len)
+{
+    char  fname[FILENAME_MAX];
+    FILE* fp;
+
+    snprintf(fname, FILENAME_MAX, "%s.%s.%06d", p_cfg->fuzz_out_prefix, type, num);
+
+    if ((fp = fopen(fname, "wb")) == NULL || (len && fwrite(buf, len, 1, fp) != 1))
+    {
+        fprintf(stderr, "Warning: could not write fuzz input %s\n", fname);
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_add_corpus()
+//
+// Add an input that found new coverage to the corpus (if not full), and
+// save it.
+//
+// -------------------------------------------------------------------------
+
+static void lm32fuzz_add_corpus (const lm32_config_t* p_cfg, const uint8_t* buf, const int len)
+{
+    if (corpus_size == LM32FUZZ_MAX_CORPUS || (corpus[corpus_size].data = (uint8_t*)malloc(len ? len : 1)) == NULL)
+    {
+        return;
+    }
+
+    memcpy(corpus[corpus_size].data, buf, len);
+    corpus[corpus_size].len = len;
+
+    lm32fuzz_save(p_cfg, "queue", corpus_size, buf, len);
+
+    corpus_size++;
+}
+
+// -------------------------------------------------------------------------
+// lm32fuzz_run()
+//
+// Fuzz the guest firmware. The program is run from reset to the harness
+// entry address (if configured), where a restore point is set. Then,
+// starting with the seed input, inputs are repeatedly mutated from the
+// corpus and executed from the restore point, with only the memory pages
+// dirtied by the previous execution restored. Inputs finding new edge
+// coverage are added to the corpus, and those that crash or hang with new
+// coverage are saved. Runs for the configured number of iterations, or
+// forever if 0.
+//
+// -------------------------------------------------------------------------
+
+int lm32fuzz_run (lm32_cpu* cpu, const lm32_config_t* p_cfg, FILE* lfp)
+{
+    uint8_t*    buf;
+    uint8_t*    cov_map;
+    FILE*       fp;
+    int         len;
+    int         status;
+    uint64_t    num_execs   = 0;
+    uint64_t    num_crashes = 0;
+    uint64_t    num_hangs   = 0;
+    time_t      start_time  = time(NULL);
+    time_t      report_time = start_time;
+
+    if (p_cfg->fuzz_input_addr == -1)
+    {
+        fprintf(stderr, "***ERROR: no fuzz input buffer address specified\n");
+        return LM32_USER_ERROR;
+    }
+
+    if ((buf = (uint8_t*)malloc(p_cfg->fuzz_max_input_bytes + 1)) == NULL || (cov_map = cpu->lm32_set_coverage(true)) == NULL)
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        return LM32_INTERNAL_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    // Read the seed input
+    if ((fp = fopen(p_cfg->fuzz_seed_fname, "rb")) == NULL)
+    {
+        fprintf(stderr, "***ERROR: could not open fuzz seed file %s for reading\n", p_cfg->fuzz_seed_fname);
+        return LM32_USER_ERROR;
+    }
+    len = (int)fread(buf, 1, p_cfg->fuzz_max_input_bytes, fp);
+    fclose(fp);
+
+    // Load the program, and run it to the harness entry point, if specified
+    // (a run of zero cycles just loads the program)
+    status = cpu->lm32_run_program(p_cfg->filename, (p_cfg->harness_entry_addr == -1) ? 0 : LM32_FOREVER,
+                                   p_cfg->harness_entry_addr, LM32_RUN_FROM_RESET, true);
+
+    while (p_cfg->harness_entry_addr != -1 && status != LM32_USER_BREAK)
+    {
+        if (status == LM32_LOCK_BREAK || status == LM32_DISASSEMBLE_BREAK)
+        {
+            fprintf(stderr, "***ERROR: program did not reach fuzz harness entry address 0x%08x\n", p_cfg->harness_entry_addr);
+            return LM32_USER_ERROR;
+        }
+        status = cpu->lm32_run_program(NULL, LM32_FOREVER, p_cfg->harness_entry_addr, LM32_RUN_CONTINUE, false);
+    }
+
+    if (!cpu->lm32_set_restore_point())
+    {
+        fprintf(stderr, "***ERROR: could not set fuzz restore point\n");                //LCOV_EXCL_LINE
+        return LM32_INTERNAL_ERROR;                                                     //LCOV_EXCL_LINE
+    }
+
+    lm32_time_t cycle_limit = cpu->lm32_get_cpu_state().cycle_count +
+                              ((p_cfg->num_run_instructions > 0) ? p_cfg->num_run_instructions : LM32FUZZ_DEFAULT_MAX_CYCLES);
+
+    // Execute the seed as is, and then mutations of the corpus
+    for (num_execs = 0; p_cfg->fuzz_iterations == 0 || num_execs < (uint64_t)p_cfg->fuzz_iterations; num_execs++)
+    {
+        if (num_execs && corpus_size)
+        {
+            lm32fuzz_input_t* p_input = &corpus[lm32fuzz_rand(corpus_size)];
+            memcpy(buf, p_input->data, p_input->len);
+            len = lm32fuzz_mutate(buf, p_input->len, p_cfg->fuzz_max_input_bytes);
+        }
+        else if (num_execs)
+        {
+            len = lm32fuzz_mutate(buf, len, p_cfg->fuzz_max_input_bytes);
+        }
+
+        status = lm32fuzz_exec(cpu, p_cfg, buf, len, cycle_limit);
+
+        if (lm32fuzz_new_coverage(cov_map))
+        {
+            if (status == LM32FUZZ_RUN_CRASH)
+            {
+                lm32fuzz_save(p_cfg, "crash", (int)num_crashes++, buf, len);
+            }
+            else if (status == LM32FUZZ_RUN_HANG)
+            {
+                lm32fuzz_save(p_cfg, "hang", (int)num_hangs++, buf, len);
+            }
+            else
+            {
+                lm32fuzz_add_corpus(p_cfg, buf, len);
+            }
+        }
+
+        // Periodically report progress
+        if ((num_execs % LM32FUZZ_REPORT_CHECK) == 0 && time(NULL) >= report_time + LM32FUZZ_REPORT_SECS)
+        {
+            report_time = time(NULL);
+            fprintf(stderr, "FUZZ: execs %lld (%lld/s), corpus %d, crashes %lld, hangs %lld\n",
+                    (long long)num_execs, (long long)(num_execs / (report_time - start_time)), corpus_size,
+                    (long long)num_crashes, (long long)num_hangs);
+        }
+    }
+
+    double secs = difftime(time(NULL), start_time);
+
+    fprintf(lfp, "\nFuzzing: %lld executions in %.0f seconds, corpus %d, unique crashes %lld, unique hangs %lld\n",
+            (long long)num_execs, secs, corpus_size, (long long)num_crashes, (long long)num_hangs);
+
+    free(buf);
+
+    return LM32_NO_ERROR;
+}
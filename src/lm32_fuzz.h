@@ -0,0 +1,70 @@
+//=============================================================
+//
+// Copyright (c) 2017 Simon Southwell. All rights reserved.
+//
+// Snapshot based, coverage guided fuzzing of guest firmware
+//
+// This file is part of the cpumico32 instruction set simulator.
+//
+// cpumico32 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// cpumico32 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with cpumico32. If not, see <http://www.gnu.org/licenses/>.
+//
+//=============================================================
+
+#ifndef _LM32_FUZZ_H_
+#define _LM32_FUZZ_H_
+
+// -------------------------------------------------------------------------
+// INCLUDES
+// -------------------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "lm32_cpu.h"
+
+// -------------------------------------------------------------------------
+// DEFINES
+// -------------------------------------------------------------------------
+
+// Default cycle limit of each execution, beyond which it is a hang
+#define LM32FUZZ_DEFAULT_MAX_CYCLES   1000000
+
+// Maximum number of inputs kept in the corpus
+#define LM32FUZZ_MAX_CORPUS           4096
+
+// Maximum number of mutations stacked on an input for each execution, and
+// the maximum size of an inserted block
+#define LM32FUZZ_MAX_STACKED          16
+#define LM32FUZZ_MAX_BLOCK            32
+
+// Number of executions between checks for a progress report, and the
+// host seconds between reports
+#define LM32FUZZ_REPORT_CHECK         256
+#define LM32FUZZ_REPORT_SECS          2
+
+// Seed for the mutation random number generator, so that campaigns are
+// repeatable
+#define LM32FUZZ_RNG_SEED             0x2545f4914f6cdd1dULL
+
+// Outcome of executing an input
+#define LM32FUZZ_RUN_OK               0
+#define LM32FUZZ_RUN_CRASH            1
+#define LM32FUZZ_RUN_HANG             2
+
+// -------------------------------------------------------------------------
+// PUBLIC PROTOTYPES
+// -------------------------------------------------------------------------
+
+extern int lm32fuzz_run (lm32_cpu* cpu, const lm32_config_t* p_cfg, FILE* lfp);
+
+#endif
@@ -33,6 +33,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 
 // For Windows, need to link with Ws2_32.lib
 #if defined (_WIN32) || defined (_WIN64)
@@ -76,6 +77,12 @@ static char hexchars[]     = HEX_CHAR_MAP;
 static char ip_buf[IP_BUFFER_SIZE];
 static char op_buf[OP_BUFFER_SIZE];
 
+// Reverse execution history of in memory snapshots (which share unchanged
+// pages with each other), oldest first, with their instruction counts
+static lm32_snapshot_t* rev_snap[LM32GDB_MAX_REV_SNAPS];
+static uint64_t         rev_snap_instr[LM32GDB_MAX_REV_SNAPS];
+static int              num_rev_snaps = 0;
+
 // -------------------------------------------------------------------------
 // lm32gdb_skt_init()
 //
@@ -231,7 +238,7 @@ static int lm32gdb_gen_register_reply(lm32_cpu* cpu, const char* cmd, char *buf,
     unsigned val;
 
     bool single_reg = cmd[0] == 'p';
-    bool stop_reply = cmd[0] == '?' || cmd[0] == 'c' || cmd[0] == 's';
+    bool stop_reply = cmd[0] == '?' || cmd[0] == 'c' || cmd[0] == 's' || cmd[0] == 'b';
 
     // Retrieve the current CPU state
     lm32_cpu::lm32_state cpu_state = cpu->lm32_get_cpu_state();
@@ -859,6 +866,224 @@ static int lm32gdb_clear_hw_wp (lm32_cpu* cpu, const char *cmd)
     return LM32GDB_OK;
 }
 
+// -------------------------------------------------------------------------
+// lm32gdb_rev_discard()
+//
+// Discard the reverse execution history from snapshot number start onwards.
+// Called with 0 when the state is modified by the debugger, as execution
+// from an earlier snapshot would no longer reproduce the current state.
+//
+// -------------------------------------------------------------------------
+
+static void lm32gdb_rev_discard (lm32_cpu* cpu, const int start = 0)
+{
+    while (num_rev_snaps > start)
+    {
+        cpu->lm32_free_snapshot(rev_snap[--num_rev_snaps]);
+    }
+}
+
+// -------------------------------------------------------------------------
+// lm32gdb_rev_snapshot()
+//
+// Add an in memory snapshot of the current state to the reverse execution
+// history. Each only holds copies of the pages changed since the previous
+// one, sharing the rest. When the history is full, the oldest snapshot is
+// dropped. If a snapshot can't be taken, a warning is given, and the
+// history continues without it (with a longer interval to re-execute).
+//
+// -------------------------------------------------------------------------
+
+static void lm32gdb_rev_snapshot (lm32_cpu* cpu)
+{
+    lm32_snapshot_t* p_snap;
+
+    // Start the periodic snapshots with the history
+    if (num_rev_snaps == 0)
+    {
+        cpu->lm32_set_checkpoint_interval(LM32GDB_REV_INTERVAL, 0);
+    }
+
+    if ((p_snap = cpu->lm32_take_snapshot()) == NULL)
+    {
+        fprintf(stderr, "Warning: unable to take reverse execution snapshot at instruction %lld\n",
+                        (long long)cpu->lm32_get_cpu_state().instr_count);
+        return;
+    }
+
+    if (num_rev_snaps == LM32GDB_MAX_REV_SNAPS)
+    {
+        cpu->lm32_free_snapshot(rev_snap[0]);
+
+        memmove(&rev_snap[0],       &rev_snap[1],       (LM32GDB_MAX_REV_SNAPS - 1) * sizeof(rev_snap[0]));
+        memmove(&rev_snap_instr[0], &rev_snap_instr[1], (LM32GDB_MAX_REV_SNAPS - 1) * sizeof(rev_snap_instr[0]));
+        num_rev_snaps--;
+    }
+
+    rev_snap[num_rev_snaps]       = p_snap;
+    rev_snap_instr[num_rev_snaps] = cpu->lm32_get_cpu_state().instr_count;
+    num_rev_snaps++;
+}
+
+// -------------------------------------------------------------------------
+// lm32gdb_rev_restore()
+//
+// Restore the state at history snapshot number snum, copying back only
+// the memory pages that differ from it, and discard the history after it.
+// The current break- and watchpoints are kept.
+//
+// -------------------------------------------------------------------------
+
+static bool lm32gdb_rev_restore (lm32_cpu* cpu, const int snum)
+{
+    lm32_cpu::lm32_state dbg_state = cpu->lm32_get_cpu_state();
+
+    if (!cpu->lm32_restore_snapshot(rev_snap[snum]))
+    {
+        fprintf(stderr, "Warning: unable to restore reverse execution snapshot. History discarded\n");
+        lm32gdb_rev_discard(cpu);
+        return false;
+    }
+
+    lm32_cpu::lm32_state cpu_state = cpu->lm32_get_cpu_state();
+    cpu_state.dc  = dbg_state.dc;
+    cpu_state.bp0 = dbg_state.bp0;
+    cpu_state.bp1 = dbg_state.bp1;
+    cpu_state.bp2 = dbg_state.bp2;
+    cpu_state.bp3 = dbg_state.bp3;
+    cpu_state.wp0 = dbg_state.wp0;
+    cpu_state.wp1 = dbg_state.wp1;
+    cpu_state.wp2 = dbg_state.wp2;
+    cpu_state.wp3 = dbg_state.wp3;
+    cpu->lm32_set_cpu_state(cpu_state);
+
+    lm32gdb_rev_discard(cpu, snum + 1);
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// lm32gdb_rev_run_to()
+//
+// Re-execute forwards up to the target instruction count, passing over
+// any break- and watchpoints, but stopping at one hit at the target. The
+// instruction count of the last break- or watchpoint hit before the target
+// is returned in *p_last_hit (if not NULL). Returns the status of the
+// last run.
+//
+// -------------------------------------------------------------------------
+
+static int lm32gdb_rev_run_to (lm32_cpu* cpu, const uint64_t target, uint64_t* p_last_hit)
+{
+    int      status = LM32_CHECKPOINT_BREAK;
+    uint64_t instr_count;
+
+    while ((instr_count = cpu->lm32_get_cpu_state().instr_count) < target)
+    {
+        cpu->lm32_set_checkpoint_interval(target - instr_count, 0);
+
+        status = cpu->lm32_run_program(NULL, LM32_FOREVER, LM32_NO_BREAK_ADDR, LM32_RUN_CONTINUE, false);
+
+        if (status == LM32_HW_BREAKPOINT_BREAK || status == LM32_HW_WATCHPOINT_BREAK)
+        {
+            lm32_cpu::lm32_state cpu_state = cpu->lm32_get_cpu_state();
+            cpu_state.int_flags &= ~((1 << INT_ID_BREAKPOINT) | (1 << INT_ID_WATCHPOINT));
+            cpu->lm32_set_cpu_state(cpu_state);
+
+            if (cpu_state.instr_count >= target)
+            {
+                break;
+            }
+            else if (p_last_hit != NULL)
+            {
+                *p_last_hit = cpu_state.instr_count;
+            }
+        }
+        else if (status != LM32_CHECKPOINT_BREAK)
+        {
+            break;
+        }
+    }
+
+    // Resume periodic snapshots from here
+    cpu->lm32_set_checkpoint_interval(LM32GDB_REV_INTERVAL, 0);
+
+    return status;
+}
+
+// -------------------------------------------------------------------------
+// lm32gdb_rev_cpu()
+//
+// Execute in reverse, for the bs (reverse step) and bc (reverse continue)
+// commands, by restoring the nearest earlier snapshot from the history and
+// re-executing forwards deterministically, with the instruction count as
+// the clock. A reverse step goes back one instruction. A reverse continue
+// goes back to the last break- or watchpoint hit, by re-executing each
+// interval in turn, latest first, until one with a hit is found. If the
+// start of the history is reached, *p_at_begin is set. Returns the signal
+// for the stop reply.
+//
+// Note that reverse execution is only deterministic if the external
+// callbacks are (e.g. if replaying recorded inputs).
+//
+// -------------------------------------------------------------------------
+
+static int lm32gdb_rev_cpu (lm32_cpu* cpu, const bool step, bool &at_begin)
+{
+    uint64_t current = cpu->lm32_get_cpu_state().instr_count;
+    int      snum    = num_rev_snaps - 1;
+
+    // Find the latest snapshot before the current point
+    while (snum >= 0 && rev_snap_instr[snum] >= current)
+    {
+        snum--;
+    }
+
+    at_begin = snum < 0;
+
+    if (at_begin)
+    {
+        return SIGTRAP;
+    }
+
+    if (step)
+    {
+        if (lm32gdb_rev_restore(cpu, snum))
+        {
+            lm32gdb_rev_run_to(cpu, current - 1, NULL);
+        }
+        return SIGTRAP;
+    }
+
+    // Search back through the intervals for the last break- or watchpoint hit
+    for (; snum >= 0; snum--)
+    {
+        uint64_t end      = (snum + 1 < num_rev_snaps && rev_snap_instr[snum + 1] < current) ? rev_snap_instr[snum + 1] : current;
+        uint64_t last_hit = 0;
+
+        if (!lm32gdb_rev_restore(cpu, snum))
+        {
+            break;
+        }
+
+        lm32gdb_rev_run_to(cpu, end, &last_hit);
+
+        if (last_hit)
+        {
+            lm32gdb_rev_restore(cpu, snum);
+            lm32gdb_rev_run_to(cpu, last_hit, NULL);
+            return SIGTRAP;
+        }
+
+        // Go back to the start of the interval, to search the one before
+        lm32gdb_rev_restore(cpu, snum);
+    }
+
+    at_begin = true;
+
+    return SIGTRAP;
+}
+
 // -------------------------------------------------------------------------
 // lm32gdb_run_cpu()
 //
@@ -904,10 +1129,29 @@ static int lm32gdb_run_cpu (lm32_cpu* cpu, const char* cmd, const int cmdlen, co
         }
         // Write back the updated CPU state
         cpu->lm32_set_cpu_state(cpu_state);
+
+        // Execution no longer follows on from the history
+        lm32gdb_rev_discard(cpu);
+    }
+
+    // Start the reverse execution history, if none
+    if (num_rev_snaps == 0)
+    {
+        lm32gdb_rev_snapshot(cpu);
     }
 
-    // Continue execution
-    status = cpu->lm32_run_program(NULL, LM32_FOREVER, LM32_NO_BREAK_ADDR, type, false);
+    // Continue execution, adding to the history periodically
+    while ((status = cpu->lm32_run_program(NULL, LM32_FOREVER, LM32_NO_BREAK_ADDR, type, false)) == LM32_CHECKPOINT_BREAK)
+    {
+        lm32gdb_rev_snapshot(cpu);
+
+        // A single step's instruction has executed
+        if (type == LM32_RUN_SINGLE_STEP)
+        {
+            status = LM32_SINGLE_STEP_BREAK;
+            break;
+        }
+    }
     
     // Inspect the returned status, and process accordingly 
     switch(status)
@@ -1064,6 +1308,7 @@ static bool lm32gdb_proc_gdb_cmd (lm32_cpu* cpu, const char* cmd, const int cmdl
     case 'G':
         // Update registers from command
         op_idx += lm32gdb_set_regs(cpu, cmd, cmdlen, &op_buf[op_idx], checksum);
+        lm32gdb_rev_discard(cpu);
         break;
 
     // Read memory 
@@ -1074,11 +1319,13 @@ static bool lm32gdb_proc_gdb_cmd (lm32_cpu* cpu, const char* cmd, const int cmdl
     // Write memory (binary)
     case 'X':
         op_idx += lm32gdb_write_mem(fd, cpu, cmd, cmdlen, &op_buf[op_idx], checksum, tcp_connection, true);
+        lm32gdb_rev_discard(cpu);
         break;
 
     // Write memory
     case 'M':
         op_idx += lm32gdb_write_mem(fd, cpu, cmd, cmdlen, &op_buf[op_idx], checksum, tcp_connection, false);
+        lm32gdb_rev_discard(cpu);
         break;
 
     // Continue
@@ -1098,6 +1345,36 @@ static bool lm32gdb_proc_gdb_cmd (lm32_cpu* cpu, const char* cmd, const int cmdl
         op_idx += lm32gdb_gen_register_reply(cpu, cmd, &op_buf[op_idx], checksum, reason);
         break;
 
+    // Reverse step (bs) and reverse continue (bc)
+    case 'b':
+        if (cmd[1] == 's' || cmd[1] == 'c')
+        {
+            bool at_begin;
+            reason  = lm32gdb_rev_cpu(cpu, cmd[1] == 's', at_begin);
+            op_idx += lm32gdb_gen_register_reply(cpu, cmd, &op_buf[op_idx], checksum, reason);
+
+            // Flag when stopped at the start of the history
+            if (at_begin)
+            {
+                for (const char* p = GDB_REPLAY_BEGIN_STR; *p; p++)
+                {
+                    checksum += op_buf[op_idx++] = *p;
+                }
+            }
+        }
+        break;
+
+    // Report support for reverse execution
+    case 'q':
+        if (!strncmp(cmd, "qSupported", strlen("qSupported")))
+        {
+            for (const char* p = GDB_SUPPORTED_STR; *p; p++)
+            {
+                checksum += op_buf[op_idx++] = *p;
+            }
+        }
+        break;
+
     case 'D':
         detached = true;
         BUFOK(op_buf, op_idx, checksum);
@@ -1109,6 +1386,7 @@ static bool lm32gdb_proc_gdb_cmd (lm32_cpu* cpu, const char* cmd, const int cmdl
 
     case 'P':
         op_idx += lm32gdb_set_regs(cpu, cmd, cmdlen, &op_buf[op_idx], checksum);
+        lm32gdb_rev_discard(cpu);
         break;
 
     case 'z':
@@ -106,6 +106,14 @@ typedef long lm32gdb_skt_t;
 
 #define MAXBACKLOG            5
 
+// Reverse execution history: a snapshot every LM32GDB_REV_INTERVAL instructions,
+// keeping the latest LM32GDB_MAX_REV_SNAPS intervals
+#define LM32GDB_REV_INTERVAL  100000
+#define LM32GDB_MAX_REV_SNAPS 1024
+
+#define GDB_SUPPORTED_STR     "ReverseStep+;ReverseContinue+"
+#define GDB_REPLAY_BEGIN_STR  "replaylog:begin;"
+
 // -------------------------------------------------------------------------
 // MACRO DEFINITIONS
 // -------------------------------------------------------------------------                               
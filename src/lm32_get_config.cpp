@@ -47,16 +47,21 @@ extern int optind;
 
 #include "lm32_cpu_hdr.h"
 
+#ifdef LNXMICO32
+#include "lnxmico32.h"
+#endif
+
 // -------------------------------------------------------------------------
 // DEFINES
 // -------------------------------------------------------------------------
 
 // Define the getopt sub-strings for the different groups of arguments
-#define LM32_COMMON_ARGS               "f:hl:r:R:DIc:i:"
-#define LM32_CPUMICO32_ARGS            "m:o:e:T"
-#define LM32_LNXMICO32_ARGS            "s:SL"
+#define LM32_COMMON_ARGS               "f:hl:r:R:DIc:i:Pm:o:q@:"
+#define LM32_CPUMICO32_ARGS            "e:TF"
+#define LM32_LNXMICO32_ARGS            "s:SLZMa:C:k:K:y:BXN:E:Y:"
 #define LM32_NON_FAST_ARGS             "n:vxb:dw:H"
 #define LM32_LNX_NON_FAST_ARGS         "V:"
+#define LM32_CPU_NON_FAST_ARGS         "p:z:u:U:j:A:J:O:Q:"
 #define LM32_DBG_ARGS                  "gtG:"
 
 // Construct the getopt arguments specification string based on the compile options
@@ -70,18 +75,20 @@ extern int optind;
 #  ifdef LM32_FAST_COMPILE
 #   define LM32_GETOPT_ARG_STR LM32_COMMON_ARGS LM32_CPUMICO32_ARGS
 #  else
-#   define LM32_GETOPT_ARG_STR LM32_COMMON_ARGS LM32_CPUMICO32_ARGS LM32_NON_FAST_ARGS LM32_DBG_ARGS
+#   define LM32_GETOPT_ARG_STR LM32_COMMON_ARGS LM32_CPUMICO32_ARGS LM32_NON_FAST_ARGS LM32_DBG_ARGS LM32_CPU_NON_FAST_ARGS
 #  endif
 #endif
 
 #define MAX_SECT_STR_SIZE  50
 #define MAX_ENTRY_STR_SIZE 50
-#define MAX_VALUE_STR_SIZE 50
-#define MAXLINESIZE        150
-#define MAX_CFG_ENTRIES    50
+#define MAX_VALUE_STR_SIZE 256
+#define MAXLINESIZE        300
+#define MAX_CFG_ENTRIES    200
 
 #define LM32_SAVE_FILE_NAME "lnxmico32.sav"
 
+#define LM32_MEM_REGION_SECT_STR "mem_region"
+
 #define LM32_CFG_INI_PARAM_WARNING   {fprintf(stderr, "Warning: unrecognised parameter %s in section %s of INI file.\n", \
                                                     cfg_entries[cdx].entry, cfg_entries[cdx].section);}
 
@@ -106,6 +113,52 @@ static ini_entry_t   cfg_entries[MAX_CFG_ENTRIES];
 static int           ini_entry_idx = 0;
 static lm32_config_t lm32_cpu_cfg;
 
+// -------------------------------------------------------------------------
+// lm32_parse_profile()
+//
+// Function to parse a profile selection, as a comma separated list of
+// profile types, each with an optional sampling interval
+// (<type>[=<interval>]), and enable the selected profiles
+//
+// -------------------------------------------------------------------------
+
+static void lm32_parse_profile(char* spec)
+{
+    for (char* type = strtok(spec, ","); type != NULL; type = strtok(NULL, ","))
+    {
+        char* interval = strchr(type, '=');
+
+        if (interval != NULL)
+        {
+            *interval++ = '\0';
+        }
+
+        if (!strcmp(type, "cycles"))
+        {
+            lm32_cpu_cfg.prof_cycle_interval = (interval != NULL) ? (uint32_t)strtoul(interval, NULL, 0) : LM32_PROF_DEFAULT_INTERVAL;
+        }
+        else if (!strcmp(type, "host") || !strcmp(type, "host_ra"))
+        {
+            lm32_cpu_cfg.prof_host_usecs = (interval != NULL) ? (uint32_t)strtoul(interval, NULL, 0) : LM32_PROF_DEFAULT_HOST_USECS;
+            lm32_cpu_cfg.prof_host_ra    = !strcmp(type, "host_ra");
+        }
+        else if (!strcmp(type, "calls"))
+        {
+#ifdef LM32_FAST_COMPILE
+            fprintf(stderr, "***ERROR: profile type calls not supported in this build\n");
+            exit(LM32_USER_ERROR);
+#else
+            lm32_cpu_cfg.prof_call_graph = true;
+#endif
+        }
+        else
+        {
+            fprintf(stderr, "***ERROR: unknown profile type %s\n", type);
+            exit(LM32_USER_ERROR);
+        }
+    }
+}
+
 // -------------------------------------------------------------------------
 // lm32_parse_ini_file()
 //
@@ -139,26 +192,26 @@ static void lm32_parse_ini_file(const char *ini_fname, ini_entry_t* p_cfg_entrie
 
     while (fgets(line, MAXLINESIZE, ini_fp) != NULL)
     {    
-        // Strip white space
+        // Strip white space and any trailing comments, except within double
+        // quotes (which are removed), so that values may contain spaces
+        bool in_quotes = false;
         for (idx=0,wdx=0; (c = line[idx]) != 0; idx++)
         {
-            if (!isspace(c))
+            if (c == '"')
+            {
+                in_quotes = !in_quotes;
+            }
+            else if (in_quotes || (!isspace(c) && c != ';'))
             {
                 line[wdx++] = line[idx];
             }
+            else if (c == ';')
+            {
+                break;
+            }
         }
         line[wdx] = 0;
 
-        // Strip any trailing comments
-        for (idx = 0; idx < wdx; idx++)
-        {
-           if (line[idx] == ';')
-           {
-               break;
-           }
-        }
-        line[idx] = 0;
-
         // If section, make current section
         if (line[0] == '[')
         {
@@ -225,14 +278,47 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
     lm32_cpu_cfg.disable_hw_break                = 0;
     lm32_cpu_cfg.disable_int_break               = 1;
     lm32_cpu_cfg.disable_lock_break              = 0;
+#ifndef LNXMICO32
     lm32_cpu_cfg.mem_size                        = LM32_DEFAULT_MEM_SIZE;
     lm32_cpu_cfg.mem_offset                      = 0; 
+#else
+    lm32_cpu_cfg.mem_size                        = LM32_RAM_SIZE;
+    lm32_cpu_cfg.mem_offset                      = LM32_RAM_BASE_ADDR;
+    lm32_cpu_cfg.initrd_addr                     = 0;
+    lm32_cpu_cfg.cmdline                         = (char*)LM32_CMDLINE_STR;
+#endif
     lm32_cpu_cfg.mem_wait_states                 = 0;
+    lm32_cpu_cfg.num_mem_regions                 = 0;
     lm32_cpu_cfg.disassemble_start               = 0;
     lm32_cpu_cfg.cfg_word                        = LM32_DEFAULT_CONFIG;
     lm32_cpu_cfg.save_fname                      = (char*)LM32_SAVE_FILE_NAME;
     lm32_cpu_cfg.save_state_file                 = false;
     lm32_cpu_cfg.load_state_file                 = false;
+    lm32_cpu_cfg.compress_state                  = false;
+    lm32_cpu_cfg.checkpoint_instr                = 0;
+    lm32_cpu_cfg.checkpoint_secs                 = 0;
+    lm32_cpu_cfg.checkpoint_keep                 = LM32_CKPT_DEFAULT_KEEP;
+    lm32_cpu_cfg.background_checkpoints          = false;
+    lm32_cpu_cfg.mappable_state                  = false;
+    lm32_cpu_cfg.num_instances                   = 0;
+    lm32_cpu_cfg.record_fname                    = NULL;
+    lm32_cpu_cfg.replay_fname                    = NULL;
+    lm32_cpu_cfg.restore_checkpoint              = LM32_CKPT_NONE;
+    lm32_cpu_cfg.fork_server                     = false;
+    lm32_cpu_cfg.fork_server_start_addr          = -1;
+    lm32_cpu_cfg.fuzz_seed_fname                 = NULL;
+    lm32_cpu_cfg.harness_entry_addr              = -1;
+    lm32_cpu_cfg.fuzz_input_addr                 = -1;
+    lm32_cpu_cfg.fuzz_max_input_bytes            = LM32_FUZZ_DEFAULT_MAX_INPUT;
+    lm32_cpu_cfg.fuzz_iterations                 = 0;
+    lm32_cpu_cfg.fuzz_out_prefix                 = (char*)LM32_FUZZ_DEFAULT_PREFIX;
+    lm32_cpu_cfg.fault_runs                      = 0;
+    lm32_cpu_cfg.fault_jobs                      = 0;
+    lm32_cpu_cfg.fault_targets                   = (char*)LM32_FAULT_DEFAULT_TARGETS;
+    lm32_cpu_cfg.fault_mem_start_addr            = 0;
+    lm32_cpu_cfg.fault_mem_end_addr              = 0;
+    lm32_cpu_cfg.fault_seed                      = LM32_FAULT_DEFAULT_SEED;
+    lm32_cpu_cfg.fault_results_fname             = NULL;
     lm32_cpu_cfg.gdb_run                         = false;
 #if !(defined _WIN32) && !(defined _WIN64)    
     lm32_cpu_cfg.com_port_num                    = LM32_DEFAULT_TCP_PORT;
@@ -240,6 +326,15 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
     lm32_cpu_cfg.com_port_num                    = LM32_DEFAULT_COM_PORT;
 #endif    
     lm32_cpu_cfg.use_tcp_skt                     = false;
+    lm32_cpu_cfg.map_images                      = false;
+    lm32_cpu_cfg.huge_pages                      = false;
+    lm32_cpu_cfg.startup_stats                   = false;
+    lm32_cpu_cfg.prof_cycle_interval             = 0;
+    lm32_cpu_cfg.prof_call_graph                 = false;
+    lm32_cpu_cfg.prof_host_usecs                 = 0;
+    lm32_cpu_cfg.prof_host_ra                    = false;
+    lm32_cpu_cfg.prof_out_prefix                 = (char*)LM32_PROF_DEFAULT_PREFIX;
+    lm32_cpu_cfg.line_cache_dir                  = NULL;
 
     lm32_cpu_cfg.dcache_cfg.cache_base_addr      = LM32_CACHE_DEFAULT_BASE;
     lm32_cpu_cfg.dcache_cfg.cache_limit          = LM32_CACHE_DEFAULT_DLIMIT;
@@ -253,6 +348,17 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
     lm32_cpu_cfg.icache_cfg.cache_num_ways       = LM32_CACHE_DEFAULT_WAYS;
     lm32_cpu_cfg.icache_cfg.cache_bytes_per_line = LM32_CACHE_DEFAULT_LINE;
 
+    // Memory latency map regions default to empty (base above limit)
+    for (int rdx = 0; rdx < LM32_MAX_MEM_REGIONS; rdx++)
+    {
+        lm32_cpu_cfg.mem_regions[rdx].base_addr             = 0xffffffff;
+        lm32_cpu_cfg.mem_regions[rdx].limit                 = 0;
+        lm32_cpu_cfg.mem_regions[rdx].rd_wait_states        = 0;
+        lm32_cpu_cfg.mem_regions[rdx].wr_wait_states        = 0;
+        lm32_cpu_cfg.mem_regions[rdx].burst_wait_states     = 0;
+        lm32_cpu_cfg.mem_regions[rdx].page_bytes            = 0;
+        lm32_cpu_cfg.mem_regions[rdx].page_miss_wait_states = 0;
+    }
 
     // Process the command line options *only* for the INI filename, as we
     // want the command line options to override the INI options
@@ -283,20 +389,28 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                     " [-R <num>] [-f <filename>] "
 #ifndef LNXMICO32
                     " [-m <num>] [-o < addr>] [-e <addr>]"
+#else
+                    " [-m <num>] [-o <addr>]"
 #endif
                     "\n"
                     "         [-l <filename>] [-c <num>] "
 #ifndef LM32_FAST_COMPILE
                     "[-w <wait states>] "
 #endif
-                    "[-i <filename>]"
+                    "[-i <filename>] [-P] [-q] [-@ <profile>]"
 #ifndef LNXMICO32
-                    " [-T]"
+                    " [-T] [-F]"
+# ifndef LM32_FAST_COMPILE
+                    " [-p <addr>]"
+                    "\n         [-z <filename>] [-u <addr>] [-U <addr>] [-j <num>]"
+                    "\n         [-A <num>] [-J <num>] [-O <targets>] [-Q <filename>]"
+# endif
 #else
 # ifndef LM32_FAST_COMPILE
                     " [-V <num>]"
 # endif
-                    " [-s <filename>] [-S] [-L]"
+                    " [-s <filename>] [-S] [-L] [-Z] [-M]"
+                    "\n         [-a <addr>] [-C <string>] [-k <num>] [-K <secs>] [-y <num>]"
 #endif
                     "\n\n"
                     "    -h Display this help message\n"
@@ -317,6 +431,9 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                     "    -m Specify size of internal memory in bytes (default: %d)\n"
                     "    -o Internal memory offset (default 0x00000000)\n"
                     "    -e specify an entry point address (default 0x00000000)\n"
+#else
+                    "    -m Specify size of RAM in bytes, as a power of 2 (default: %d)\n"
+                    "    -o Specify RAM base address, aligned to its size (default 0x%08x)\n"
 #endif
 #ifndef LM32_FAST_COMPILE
                     "    -v Specify verbose output (default: off)\n"
@@ -333,8 +450,23 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                     "    -w Set the number of wait states for internal memory (default 0)\n"
 #endif
                     "    -i Specify a .ini filename to use for configuration (default none)\n"
+                    "    -P Allocate internal memory with huge pages, where available (default off)\n"
+                    "    -q Report startup phase host times at the first instruction (default off)\n"
+                    "    -@ Profile the run, with <profile> of cycles[=<interval>], calls or host[_ra][=<usecs>] (default no profiling)\n"
 #ifndef LNXMICO32
                     "    -T Enable internal callback functions for test (default disabled)\n"
+                    "    -F Run as a fork server for jobs read from stdin (default disabled)\n"
+# ifndef LM32_FAST_COMPILE
+                    "    -p Fork server runs program to <addr> before the first job (default none)\n"
+                    "    -z Fuzz program, with seed input from <filename> (default no fuzzing)\n"
+                    "    -u Specify fuzzing/fault injection entry address, from where each run starts (default reset)\n"
+                    "    -U Specify address of fuzzing input buffer (length word, then data)\n"
+                    "    -j Specify number of fuzzing executions (default run forever)\n"
+                    "    -A Run a fault injection campaign of <num> runs (default no campaign)\n"
+                    "    -J Specify number of parallel fault injection processes (default host cores)\n"
+                    "    -O Specify fault targets, of r (registers), m (memory) and i (instructions) (default rmi)\n"
+                    "    -Q Write fault injection run results to <filename> (default none)\n"
+# endif
 #else
 # ifndef LM32_FAST_COMPILE
                     "    -V Enable verbose output from cycle specified (default disabled)\n"
@@ -342,6 +474,18 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                     "    -s Specify .sav filename (default lnxmico32.sav)\n"
                     "    -S Save state on exit (default no save)\n"
                     "    -L Load saved state before execution (default no load)\n"
+                    "    -Z Compress memory in saved state (default no compression)\n"
+                    "    -X Save all memory, mappable for instant restore (default written pages)\n"
+                    "    -k Write a checkpoint every <num> instructions (default none)\n"
+                    "    -K Write a checkpoint every <secs> host seconds (default none)\n"
+                    "    -y Restart from checkpoint <num>, or latest if -1 (default none)\n"
+                    "    -B Write checkpoints in the background (default foreground)\n"
+                    "    -N Run <num> cloned instances from the loaded state (default none)\n"
+                    "    -E Record external inputs to <file> (default no recording)\n"
+                    "    -Y Replay external inputs from <file> (default no replay)\n"
+                    "    -M Map kernel and file system images copy-on-write (default load)\n"
+                    "    -a Specify initial ramdisk load address (default RAM base + 0x%08x)\n"
+                    "    -C Specify kernel command line (default \"%s\")\n"
 #endif
                     "\n"
                     , argv[0]
@@ -355,6 +499,11 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                     , LM32_DEFAULT_FNAME ? LM32_DEFAULT_FNAME : "none --- GDB debug mode only"
 #ifndef LNXMICO32
                     , LM32_DEFAULT_MEM_SIZE
+#else
+                    , LM32_RAM_SIZE
+                    , LM32_RAM_BASE_ADDR
+                    , LM32_INIT_RD_OFFSET
+                    , LM32_CMDLINE_STR
 #endif
                         );
             exit(LM32_NO_ERROR);
@@ -379,11 +528,93 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             {
                 lm32_cpu_cfg.entry_point_addr = strtol(cfg_entries[cdx].value, NULL, 0);
             }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"fork_server"))
+            {
+                lm32_cpu_cfg.fork_server = (!strcmp(cfg_entries[cdx].value, "true")) ? true : false;
+            }
+#ifndef LM32_FAST_COMPILE
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"fork_server_start_addr"))
+            {
+                lm32_cpu_cfg.fork_server_start_addr = (int32_t)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+#endif
+            else
+            {
+                LM32_CFG_INI_PARAM_WARNING;
+            }
+        }
+#ifndef LM32_FAST_COMPILE
+        else if (!strcmp(cfg_entries[cdx].section, (char*)"fuzz"))
+        {
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"seed_file"))
+            {
+                lm32_cpu_cfg.fuzz_seed_fname = cfg_entries[cdx].value;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"entry_addr"))
+            {
+                lm32_cpu_cfg.harness_entry_addr = (int32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"input_addr"))
+            {
+                lm32_cpu_cfg.fuzz_input_addr = (int32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"max_input_bytes"))
+            {
+                lm32_cpu_cfg.fuzz_max_input_bytes = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"iterations"))
+            {
+                lm32_cpu_cfg.fuzz_iterations = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"output_prefix"))
+            {
+                lm32_cpu_cfg.fuzz_out_prefix = cfg_entries[cdx].value;
+            }
+            else
+            {
+                LM32_CFG_INI_PARAM_WARNING;
+            }
+        }
+        else if (!strcmp(cfg_entries[cdx].section, (char*)"fault"))
+        {
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"runs"))
+            {
+                lm32_cpu_cfg.fault_runs = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"jobs"))
+            {
+                lm32_cpu_cfg.fault_jobs = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"targets"))
+            {
+                lm32_cpu_cfg.fault_targets = cfg_entries[cdx].value;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"entry_addr"))
+            {
+                lm32_cpu_cfg.harness_entry_addr = (int32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"mem_start_addr"))
+            {
+                lm32_cpu_cfg.fault_mem_start_addr = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"mem_end_addr"))
+            {
+                lm32_cpu_cfg.fault_mem_end_addr = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"seed"))
+            {
+                lm32_cpu_cfg.fault_seed = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"results_file"))
+            {
+                lm32_cpu_cfg.fault_results_fname = cfg_entries[cdx].value;
+            }
             else
             {
                 LM32_CFG_INI_PARAM_WARNING;
             }
         }
+#endif
         else
 #endif
         if (!strcmp(cfg_entries[cdx].section, (char*)"configuration"))
@@ -397,6 +628,37 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                 LM32_CFG_INI_PARAM_WARNING;
             }
         }
+        else if (!strcmp(cfg_entries[cdx].section, (char*)"profile"))
+        {
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"cycles"))
+            {
+                lm32_cpu_cfg.prof_cycle_interval = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"host"))
+            {
+                lm32_cpu_cfg.prof_host_usecs = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"host_ra"))
+            {
+                lm32_cpu_cfg.prof_host_ra = (!strcmp(cfg_entries[cdx].value, "true")) ? true : false;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"calls"))
+            {
+#ifdef LM32_FAST_COMPILE
+                fprintf(stderr, "Warning: call graph profile not supported in this build\n");
+#else
+                lm32_cpu_cfg.prof_call_graph = (!strcmp(cfg_entries[cdx].value, "true")) ? true : false;
+#endif
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"output_prefix"))
+            {
+                lm32_cpu_cfg.prof_out_prefix = cfg_entries[cdx].value;
+            }
+            else
+            {
+                LM32_CFG_INI_PARAM_WARNING;
+            }
+        }
         else if (!strcmp(cfg_entries[cdx].section, (char*)"debug"))
         {
             if (!strcmp(cfg_entries[cdx].entry, (char*)"log_fname"))
@@ -431,6 +693,14 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             {
                 lm32_cpu_cfg.dump_num_exec_instr = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
             }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"startup_stats"))
+            {
+                lm32_cpu_cfg.startup_stats = (!strcmp(cfg_entries[cdx].value, "true")) ? true : false;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"line_cache_dir"))
+            {
+                lm32_cpu_cfg.line_cache_dir = cfg_entries[cdx].value;
+            }
 #ifndef LM32_FAST_COMPILE
             else if (!strcmp(cfg_entries[cdx].entry, (char*)"disassemble_run"))
             {
@@ -480,17 +750,27 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             }
             else
 #endif
-#ifndef LNXMICO32
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"huge_pages"))
+            {
+                lm32_cpu_cfg.huge_pages = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
+            }
+            else
+#ifdef LNXMICO32
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"map_images"))
+            {
+                lm32_cpu_cfg.map_images = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
+            }
+            else
+#endif
             if (!strcmp(cfg_entries[cdx].entry, (char*)"mem_size"))
             {
-                lm32_cpu_cfg.mem_size = (uint32_t)strtol(cfg_entries[cdx].value, NULL, 0);
+                lm32_cpu_cfg.mem_size = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
             }
             else if (!strcmp(cfg_entries[cdx].entry, (char*)"mem_offset"))
             {
-                lm32_cpu_cfg.mem_offset = (uint32_t)strtol(cfg_entries[cdx].value, NULL, 0);
+                lm32_cpu_cfg.mem_offset = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
             }
             else
-#endif
             {
                 LM32_CFG_INI_PARAM_WARNING;
             }
@@ -551,8 +831,69 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
                 LM32_CFG_INI_PARAM_WARNING;
             }
         }
+        // Memory latency map regions, in sections mem_region0 to mem_region<LM32_MAX_MEM_REGIONS-1>
+        else if (!strncmp(cfg_entries[cdx].section, LM32_MEM_REGION_SECT_STR, strlen(LM32_MEM_REGION_SECT_STR)) &&
+                 isdigit(cfg_entries[cdx].section[strlen(LM32_MEM_REGION_SECT_STR)]) &&
+                 atoi(&cfg_entries[cdx].section[strlen(LM32_MEM_REGION_SECT_STR)]) < LM32_MAX_MEM_REGIONS)
+        {
+            int rdx = atoi(&cfg_entries[cdx].section[strlen(LM32_MEM_REGION_SECT_STR)]);
+            lm32_mem_region_cfg_t* p_region = &lm32_cpu_cfg.mem_regions[rdx];
+
+            if (rdx >= lm32_cpu_cfg.num_mem_regions)
+            {
+                lm32_cpu_cfg.num_mem_regions = rdx + 1;
+            }
+
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"base_addr"))
+            {
+                p_region->base_addr = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"limit"))
+            {
+                p_region->limit = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"rd_wait_states"))
+            {
+                p_region->rd_wait_states = strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"wr_wait_states"))
+            {
+                p_region->wr_wait_states = strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"burst_wait_states"))
+            {
+                p_region->burst_wait_states = strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"page_bytes"))
+            {
+                p_region->page_bytes = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"page_miss_wait_states"))
+            {
+                p_region->page_miss_wait_states = strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else
+            {
+                LM32_CFG_INI_PARAM_WARNING;
+            }
+        }
 #endif
 #ifdef LNXMICO32
+        else if (!strcmp(cfg_entries[cdx].section, (char*)"boot"))
+        {
+            if (!strcmp(cfg_entries[cdx].entry, (char*)"initrd_addr"))
+            {
+                lm32_cpu_cfg.initrd_addr = (uint32_t)strtoul(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"cmdline"))
+            {
+                lm32_cpu_cfg.cmdline = cfg_entries[cdx].value;
+            }
+            else
+            {
+                LM32_CFG_INI_PARAM_WARNING;
+            }
+        }
         else if (!strcmp(cfg_entries[cdx].section, (char*)"state"))
         {
             if (!strcmp(cfg_entries[cdx].entry, (char*)"save_file_name"))
@@ -567,6 +908,47 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             {
                 lm32_cpu_cfg.save_state_file = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
             }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"compress_state"))
+            {
+                lm32_cpu_cfg.compress_state = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"mappable_state"))
+            {
+                lm32_cpu_cfg.mappable_state = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"checkpoint_instr"))
+            {
+                lm32_cpu_cfg.checkpoint_instr = strtoll(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"checkpoint_secs"))
+            {
+                lm32_cpu_cfg.checkpoint_secs = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"checkpoint_keep"))
+            {
+                lm32_cpu_cfg.checkpoint_keep = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"background_checkpoints"))
+            {
+                lm32_cpu_cfg.background_checkpoints = (!strcmp(cfg_entries[cdx].value, "true")) ? 1 : 0;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"record_file"))
+            {
+                lm32_cpu_cfg.record_fname = cfg_entries[cdx].value;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"replay_file"))
+            {
+                lm32_cpu_cfg.replay_fname = cfg_entries[cdx].value;
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"num_instances"))
+            {
+                lm32_cpu_cfg.num_instances = (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
+            else if (!strcmp(cfg_entries[cdx].entry, (char*)"restore_checkpoint"))
+            {
+                lm32_cpu_cfg.restore_checkpoint = !strcmp(cfg_entries[cdx].value, "latest") ? LM32_CKPT_LATEST :
+                                                                                            (int)strtol(cfg_entries[cdx].value, NULL, 0);
+            }
             else
             {
                 LM32_CFG_INI_PARAM_WARNING;
@@ -600,10 +982,22 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             lm32_cpu_cfg.dump_num_exec_instr = 1;
             break;
 
+        case 'q':
+            lm32_cpu_cfg.startup_stats = true;
+            break;
+
+        case '@':
+            lm32_parse_profile(optarg);
+            break;
+
         case 'D':
             lm32_cpu_cfg.dump_registers = 1;
             break;
 
+        case 'P':
+            lm32_cpu_cfg.huge_pages = true;
+            break;
+
 #ifndef LM32_FAST_COMPILE
         case 'g':
             lm32_cpu_cfg.gdb_run = true;
@@ -677,19 +1071,61 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
             lm32_cpu_cfg.test_mode = 1;
             break;
 
-#ifndef LNXMICO32              
         case 'm':
-            lm32_cpu_cfg.mem_size = strtol(optarg, NULL, 0);
+            lm32_cpu_cfg.mem_size = strtoul(optarg, NULL, 0);
             break;
 
         case 'o':
-            lm32_cpu_cfg.mem_offset = strtol(optarg, NULL, 0);
+            lm32_cpu_cfg.mem_offset = strtoul(optarg, NULL, 0);
             break;
 
+#ifndef LNXMICO32              
         case 'e':
             // Silently word align the user specified entry point address
             lm32_cpu_cfg.entry_point_addr = (uint32_t)strtol(optarg, NULL, 0) & 0xfffffffc;
             break;
+
+        case 'F':
+            lm32_cpu_cfg.fork_server = true;
+            break;
+
+# ifndef LM32_FAST_COMPILE
+        case 'p':
+            lm32_cpu_cfg.fork_server_start_addr = (int32_t)strtol(optarg, NULL, 0);
+            break;
+
+        case 'z':
+            lm32_cpu_cfg.fuzz_seed_fname = optarg;
+            break;
+
+        case 'u':
+            lm32_cpu_cfg.harness_entry_addr = (int32_t)strtoul(optarg, NULL, 0);
+            break;
+
+        case 'U':
+            lm32_cpu_cfg.fuzz_input_addr = (int32_t)strtoul(optarg, NULL, 0);
+            break;
+
+        case 'j':
+            lm32_cpu_cfg.fuzz_iterations = (int)strtol(optarg, NULL, 0);
+            break;
+
+        case 'A':
+            lm32_cpu_cfg.fault_runs = (int)strtol(optarg, NULL, 0);
+            break;
+
+        case 'J':
+            lm32_cpu_cfg.fault_jobs = (int)strtol(optarg, NULL, 0);
+            break;
+
+        case 'O':
+            lm32_cpu_cfg.fault_targets = optarg;
+            break;
+
+        case 'Q':
+            lm32_cpu_cfg.fault_results_fname = optarg;
+            break;
+# endif
 #else                    
         case 's':
             lm32_cpu_cfg.save_fname = optarg;
@@ -700,6 +1136,42 @@ extern "C" lm32_config_t* lm32_get_config(int argc, char** argv, const char* def
         case 'L':
             lm32_cpu_cfg.load_state_file = true;
             break;
+        case 'Z':
+            lm32_cpu_cfg.compress_state = true;
+            break;
+        case 'X':
+            lm32_cpu_cfg.mappable_state = true;
+            break;
+        case 'k':
+            lm32_cpu_cfg.checkpoint_instr = strtoll(optarg, NULL, 0);
+            break;
+        case 'K':
+            lm32_cpu_cfg.checkpoint_secs = (int)strtol(optarg, NULL, 0);
+            break;
+        case 'y':
+            lm32_cpu_cfg.restore_checkpoint = (int)strtol(optarg, NULL, 0);
+            break;
+        case 'B':
+            lm32_cpu_cfg.background_checkpoints = true;
+            break;
+        case 'N':
+            lm32_cpu_cfg.num_instances = (int)strtol(optarg, NULL, 0);
+            break;
+        case 'E':
+            lm32_cpu_cfg.record_fname = optarg;
+            break;
+        case 'Y':
+            lm32_cpu_cfg.replay_fname = optarg;
+            break;
+        case 'M':
+            lm32_cpu_cfg.map_images = true;
+            break;
+        case 'a':
+            lm32_cpu_cfg.initrd_addr = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            lm32_cpu_cfg.cmdline = optarg;
+            break;
 # ifndef LM32_FAST_COMPILE
         case 'V':
             lm32_cpu_cfg.disassemble_start = (int)strtol(optarg, NULL, 0);
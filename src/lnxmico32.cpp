@@ -58,15 +58,15 @@ extern char* optarg;
 // DEFINES
 // -------------------------------------------------------------------------
 
-#define LM32_MEM_WR_PAGE_BITS 10
-#define LM32_MEM_WR_BUF_SIZE (LM32_RAM_SIZE/(1 << LM32_MEM_WR_PAGE_BITS))
-
 #if !(defined _WIN32) && !(defined _WIN64)
 #define LM32_TIME_PRINT_STR "%ld"
 #else
 #define LM32_TIME_PRINT_STR "%lld"
 #endif
 
+// Page size of the RAM blocks in the original raw .sav format
+#define LM32_LEGACY_PAGE_BITS 10
+
 // -------------------------------------------------------------------------
 // LOCAL STATICS
 // -------------------------------------------------------------------------
@@ -75,7 +75,6 @@ extern char* optarg;
 // callbacks as well main().
 static lm32_cpu* cpu;
 
-static bool mem_wr [LM32_MEM_WR_BUF_SIZE];
 
 static lm32_time_t wakeup_time_save = 0;
 static lm32_config_t* p_cfg         = NULL;
@@ -98,7 +97,9 @@ static const uint8_t cpu_config[LM32_CPU_CONFIG_LEN] = {
     (LM32_CPU_FREQUENCY_HZ >>  0) & 0xff
 };
 
-static const uint8_t ddr_config[LM32_DDR_CONFIG_LEN] = {
+// DDR setup, with default RAM base address and size (updated to the configured
+// values by load_hwsetup_to_mem())
+static uint8_t ddr_config[LM32_DDR_CONFIG_LEN] = {
      0, 0, 0, LM32_DDR_CONFIG_LEN,
      0, 0, 0, LM32_HW_TAG_DDR_SDRAM,
     'd', 'd', 'r', '_', 's', 'd', 'r', 'a',
@@ -182,6 +183,10 @@ static struct timeval tv_start, tv_stop;
 LARGE_INTEGER freq, start, stop;
 #endif
 
+// Host time spent loading the images and boot data to memory, and the bytes loaded
+static double   load_usecs = 0;
+static uint64_t load_bytes = 0;
+
 // -------------------------------------------------------------------------
 // Terminal control utility functions for enabling/diabling input echoing
 // -------------------------------------------------------------------------
@@ -224,154 +229,424 @@ static void post_run_setup()
 #endif 
 }
 
+// -------------------------------------------------------------------------
+// load_legacy_state()
+//
+// Load a .sav file in the original raw format, as written by earlier
+// versions: the CPU, timer and UART state structures, followed by 4 byte
+// (MSB first) page addresses, each followed by the bytes of the page.
+//
+// -------------------------------------------------------------------------
+
+static void load_legacy_state(FILE* sfp)
+{
+    // Load the CPU state
+    lm32_cpu::lm32_state saved_state;
+    lm32_timer_state_t   timer_state;
+    lm32_uart_state_t    uart_state;
+
+    if (fread(&saved_state, sizeof(lm32_cpu::lm32_state), 1, sfp) != 1 ||
+        fread(&timer_state, sizeof(lm32_timer_state_t),   1, sfp) != 1 ||
+        fread(&uart_state,  sizeof(lm32_uart_state_t),    1, sfp) != 1)
+    {
+        fprintf(stderr, "\n***ERROR: truncated state in %s\n", p_cfg->save_fname);
+        exit(LM32_USER_ERROR);
+    }
+
+    cpu->lm32_set_cpu_state(saved_state);
+    lm32_set_timer_state(timer_state);
+    lm32_set_uart_state(uart_state);
+
+    int c;
+    while ((c = getc(sfp)) != EOF)
+    {
+        // Load the address (MSB)
+        uint32_t addr = 0;
+        addr |= (c         & 0xff) << 24;
+        addr |= (getc(sfp) & 0xff) << 16;
+        addr |= (getc(sfp) & 0xff) <<  8;
+        addr |= (getc(sfp) & 0xff) <<  0;
+
+        // Load the bytes of the page
+        for (int idx = 0; idx < (1 << LM32_LEGACY_PAGE_BITS); idx++)
+        {
+            uint32_t data = getc(sfp) & 0xff;
+            cpu->lm32_write_mem(addr++, data, LM32_MEM_WR_ACCESS_BYTE, true);
+        }
+    }
+}
+
 // -------------------------------------------------------------------------
 // load_system_state()
 //
-// Load the state previously stored in a .sav file (if the specified file
-// exists). The function expects the state to be in the order CPU, Timers,
-// Uarts, and a set of RAM pages.
+// Load the state previously stored in a .sav snapshot file (if the specified
+// file exists). The snapshot holds the CPU state, with the timer and UART
+// states as user sections, and the RAM pages written since the images were
+// loaded. Files in the original raw format are still accepted.
 //
 // -------------------------------------------------------------------------
 
 static void load_system_state()
 {
+    lm32_timer_state_t  timer_state;
+    lm32_uart_state_t   uart_state;
+    lm32_snap_section_t sections[2] = {
+        {LM32_SNAP_SECT_TIMER, 1, &timer_state, sizeof(lm32_timer_state_t)},
+        {LM32_SNAP_SECT_UART,  1, &uart_state,  sizeof(lm32_uart_state_t)}
+    };
+
     FILE* sfp;
 
     // Attempt to open a .sav file for reading
-    sfp = fopen(p_cfg->save_fname, "rb");
-
-    if (sfp != NULL)
+    if ((sfp = fopen(p_cfg->save_fname, "rb")) != NULL)
     {
         fprintf(stdout, "Loading %s...", p_cfg->save_fname);
 
-        // Load the CPU state
-        lm32_cpu::lm32_state saved_state;
-        uint8_t* p_saved_state_byte = (uint8_t*) &saved_state;
+        char magic[LM32_SNAP_MAGIC_LEN];
 
-        for (int idx = 0; idx < sizeof(lm32_cpu::lm32_state); idx++)
+        if (fread(magic, LM32_SNAP_MAGIC_LEN, 1, sfp) != 1 || memcmp(magic, LM32_SNAP_MAGIC, LM32_SNAP_MAGIC_LEN))
         {
-            p_saved_state_byte[idx] = getc(sfp) & 0xff;
+            rewind(sfp);
+            load_legacy_state(sfp);
+            fclose(sfp);
+            fprintf(stdout, "Done.\n");
+            return;
         }
-        cpu->lm32_set_cpu_state(saved_state);
 
-        // Load the timer state
-        lm32_timer_state_t timer_state;
-        p_saved_state_byte = (uint8_t*)&timer_state;
+        rewind(sfp);
 
-        for(int idx = 0; idx < sizeof(lm32_timer_state_t); idx++)
+        int status = cpu->lm32_read_snapshot(sfp, sections, 2);
+
+        fclose(sfp);
+
+        if (status != LM32_SNAP_OK)
         {
-            p_saved_state_byte[idx] = getc(sfp) & 0xff;
+            fprintf(stderr, "\n***ERROR: failed to load state from %s (%d)\n", p_cfg->save_fname, status);
+            exit(LM32_USER_ERROR);
         }
-        lm32_set_timer_state(timer_state);
-
-        // Load the uart state
-        lm32_uart_state_t uart_state;
-        p_saved_state_byte = (uint8_t*)&uart_state;
 
-        for(int idx = 0; idx < sizeof(lm32_uart_state_t); idx++)
+        if (sections[0].version)
         {
-            p_saved_state_byte[idx] = getc(sfp) & 0xff;
+            lm32_set_timer_state(timer_state);
         }
-        lm32_set_uart_state(uart_state);
 
-        int c;
-        while ((c = getc(sfp)) != EOF)
+        if (sections[1].version)
         {
-            // Load the address (MSB)
-            unsigned addr = 0;
-            addr |= (c         & 0xff) << 24;
-            addr |= (getc(sfp) & 0xff) << 16;
-            addr |= (getc(sfp) & 0xff) <<  8;
-            addr |= (getc(sfp) & 0xff) <<  0;
-            
-            // Load the bytes of the page
-            for(int idx = 0; idx < (1 << LM32_MEM_WR_PAGE_BITS); idx++)
-            {
-                uint32_t data = getc(sfp) & 0xff;
-                cpu->lm32_write_mem(addr++, data, LM32_MEM_WR_ACCESS_BYTE, true);
-            }
+            lm32_set_uart_state(uart_state);
         }
-        
+
         fprintf(stdout, "Done.\n");
-        
-        // Close the file
-        fclose(sfp);
     }
 }
 
 // -------------------------------------------------------------------------
 // save_system_state()
 //
-// Save the systems's state to a .sav file. The function will save the state 
-// to be in the order CPU, Timers, Uarts, and a set of RAM pages.
+// Save the systems's state to a .sav snapshot file, with the timer and UART
+// states as user sections, and only the RAM pages written since the images
+// were loaded (or, if mappable, all of RAM as an image that can be mapped
+// when loaded).
 //
 // -------------------------------------------------------------------------
 
 static void save_system_state()
 {
-    // Save updated memory
-    FILE* sfp;
-    
-    if ((sfp = fopen(p_cfg->save_fname, "wb")) != NULL)
+    lm32_timer_state_t  timer_state = lm32_get_timer_state();
+    lm32_uart_state_t   uart_state  = lm32_get_uart_state();
+    lm32_snap_section_t sections[2] = {
+        {LM32_SNAP_SECT_TIMER, 1, &timer_state, sizeof(lm32_timer_state_t)},
+        {LM32_SNAP_SECT_UART,  1, &uart_state,  sizeof(lm32_uart_state_t)}
+    };
+
+    // Save the state with the external interrupt callback restarted after the
+    // terminating call, leaving the live CPU state untouched
+    lm32_cpu::lm32_state live_state = cpu->lm32_get_cpu_state();
+    lm32_cpu::lm32_state save_state = live_state;
+    save_state.wakeup_time_ext_int  = wakeup_time_save;
+    cpu->lm32_set_cpu_state(save_state);
+
+    fprintf(stdout, "\nSaving %s...", p_cfg->save_fname);
+
+    int status = cpu->lm32_save_snapshot(p_cfg->save_fname,
+                                         (p_cfg->mappable_state ? LM32_SNAP_MAPPABLE : LM32_SNAP_DIRTY_PAGES) |
+                                         (p_cfg->compress_state ? LM32_SNAP_COMPRESS : 0),
+                                         sections, 2);
+
+    cpu->lm32_set_cpu_state(live_state);
+
+    if (status == LM32_SNAP_OK)
+    {
+        fprintf(stdout, "Done.\n");
+    }
+    else if (status == LM32_SNAP_OPEN_ERROR)
+    {
+        fprintf(stderr, "Warning: unable to open %s for writing. State will not be saved\n", p_cfg->save_fname);
+    }
+    else
+    {
+        fprintf(stderr, "Warning: error writing %s (%d). State not saved\n", p_cfg->save_fname, status);
+    }
+}
+
+// -------------------------------------------------------------------------
+// write_checkpoint()
+//
+// Write a periodic checkpoint, with the timer and UART states, named after
+// the .sav filename.
+//
+// -------------------------------------------------------------------------
+
+static void write_checkpoint()
+{
+    lm32_timer_state_t  timer_state = lm32_get_timer_state();
+    lm32_uart_state_t   uart_state  = lm32_get_uart_state();
+    lm32_snap_section_t sections[2] = {
+        {LM32_SNAP_SECT_TIMER, 1, &timer_state, sizeof(lm32_timer_state_t)},
+        {LM32_SNAP_SECT_UART,  1, &uart_state,  sizeof(lm32_uart_state_t)}
+    };
+
+    int status = cpu->lm32_write_checkpoint(p_cfg->save_fname, p_cfg->checkpoint_keep,
+                                            (p_cfg->compress_state         ? LM32_SNAP_COMPRESS   : 0) |
+                                            (p_cfg->mappable_state         ? LM32_SNAP_MAPPABLE   : 0) |
+                                            (p_cfg->background_checkpoints ? LM32_SNAP_BACKGROUND : 0),
+                                            sections, 2);
+
+    if (status != LM32_SNAP_OK)
     {
-        fprintf(stdout, "\nSaving %s...", p_cfg->save_fname);
+        fprintf(stderr, "Warning: failed to write checkpoint for %s (%d)\n", p_cfg->save_fname, status);
+    }
+}
 
-        // Save the CPU state
-        lm32_cpu::lm32_state state = cpu->lm32_get_cpu_state();
+// -------------------------------------------------------------------------
+// restore_checkpoint()
+//
+// Restart from the configured checkpoint (or the latest), restoring the CPU,
+// timer, UART and RAM state.
+//
+// -------------------------------------------------------------------------
 
-        state.wakeup_time_ext_int = wakeup_time_save;
+static void restore_checkpoint()
+{
+    lm32_timer_state_t  timer_state;
+    lm32_uart_state_t   uart_state;
+    lm32_snap_section_t sections[2] = {
+        {LM32_SNAP_SECT_TIMER, 1, &timer_state, sizeof(lm32_timer_state_t)},
+        {LM32_SNAP_SECT_UART,  1, &uart_state,  sizeof(lm32_uart_state_t)}
+    };
+
+    fprintf(stdout, "Restoring checkpoint for %s...", p_cfg->save_fname);
 
-        uint8_t* p_state_byte = (uint8_t*)&state;
+    int status = cpu->lm32_restore_checkpoint(p_cfg->save_fname, p_cfg->restore_checkpoint, sections, 2);
+
+    if (status != LM32_SNAP_OK)
+    {
+        fprintf(stderr, "\n***ERROR: failed to restore checkpoint %d for %s (%d)\n", p_cfg->restore_checkpoint, p_cfg->save_fname, status);
+        exit(LM32_USER_ERROR);
+    }
 
-        for(int idx = 0; idx < sizeof(lm32_cpu::lm32_state); idx++)
+    if (sections[0].version)
+    {
+        lm32_set_timer_state(timer_state);
+    }
+
+    if (sections[1].version)
+    {
+        lm32_set_uart_state(uart_state);
+    }
+
+    fprintf(stdout, "Done.\n");
+}
+
+// -------------------------------------------------------------------------
+// clone_instances()
+//
+// Clone the loaded system into the configured number of instances. Each
+// clone returns to run with its own console, logged to <sav>.<n>.log, with
+// input from <sav>.<n>.in (if it exists), with <sav>.<n> as its state
+// and checkpoint filename, and <prefix>.<n> as its profile prefix. The
+// original waits for all the clones to exit, and then exits itself.
+//
+// -------------------------------------------------------------------------
+
+static void clone_instances()
+{
+    static char inst_fname[FILENAME_MAX];
+    static char inst_prof_prefix[FILENAME_MAX];
+    char        fname[FILENAME_MAX];
+    FILE*       fp;
+    int         status;
+
+    int inst = cpu->lm32_clone_instances(p_cfg->num_instances);
+
+    if (inst > 0)
+    {
+        snprintf(inst_fname, FILENAME_MAX, "%s.%d", p_cfg->save_fname, inst);
+        p_cfg->save_fname = inst_fname;
+
+        snprintf(inst_prof_prefix, FILENAME_MAX, "%s.%d", p_cfg->prof_out_prefix, inst);
+        p_cfg->prof_out_prefix = inst_prof_prefix;
+
+        snprintf(fname, FILENAME_MAX, "%s.log", inst_fname);
+        if (freopen(fname, "w", stdout) == NULL)
         {
-            putc(p_state_byte[idx], sfp);
+            fprintf(stderr, "***ERROR: unable to open %s for writing\n", fname);
+            exit(LM32_USER_ERROR);
         }
 
-        // Save the timer(s) state
-        lm32_timer_state_t timer_state = lm32_get_timer_state();
-        p_state_byte = (uint8_t*)&timer_state;
-        for(int idx = 0; idx < sizeof(lm32_timer_state_t); idx++)
+        snprintf(fname, FILENAME_MAX, "%s.in", inst_fname);
+        if ((fp = fopen(fname, "r")) != NULL)
         {
-            putc(p_state_byte[idx], sfp);
+            fclose(fp);
+        }
+        else
+        {
+            strcpy(fname, LM32_NULL_DEV);
         }
 
-        // Save the UART(s) state
-        lm32_uart_state_t uart_state = lm32_get_uart_state();
-        p_state_byte = (uint8_t*)&uart_state;
-        for(int idx = 0; idx < sizeof(lm32_uart_state_t); idx++)
+        if (freopen(fname, "r", stdin) == NULL)
         {
-            putc(p_state_byte[idx], sfp);
+            fprintf(stderr, "***ERROR: unable to open %s for reading\n", fname);
+            exit(LM32_USER_ERROR);
         }
 
-        // Save the memory blocks that have been written to
-        for (int idx = 0; idx < (LM32_MEM_WR_BUF_SIZE); idx++)
+        return;
+    }
+
+    if (inst < 0)
+    {
+        fprintf(stderr, "Warning: unable to create all %d instances\n", p_cfg->num_instances);
+    }
+
+    while ((inst = cpu->lm32_wait_instance(&status)) > 0)
+    {
+        fprintf(stdout, "Instance %d exited with status %d\n", inst, status);
+    }
+
+    exit(0);
+}
+
+// -------------------------------------------------------------------------
+// write_profiles()
+//
+// Write the cycle sampling profile, if enabled, in callgrind format (to
+// <prefix>.cycles.callgrind) and as folded stacks (to <prefix>.cycles.folded),
+// the call graph profile, if enabled, in callgrind format (to
+// <prefix>.calls.callgrind), and the host sampling profile, if enabled, in
+// callgrind format (to <prefix>.host.callgrind) and as folded stacks (to
+// <prefix>.host.folded)
+//
+// -------------------------------------------------------------------------
+
+static void write_profiles (const lm32_config_t* p_cfg)
+{
+    char fname[FILENAME_MAX];
+
+    if (p_cfg->prof_cycle_interval)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.cycles.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_profile(fname, LM32_PROF_FMT_CALLGRIND))
         {
-            if (mem_wr[idx])
-            {
-                // Save the page address (MSB)
-                uint32_t addr = LM32_RAM_BASE_ADDR + (idx << LM32_MEM_WR_PAGE_BITS);
-                putc((addr >> 24) & 0xff, sfp);
-                putc((addr >> 16) & 0xff, sfp);
-                putc((addr >>  8) & 0xff, sfp);
-                putc((addr >>  0) & 0xff, sfp);
-        
-                // Store the bytes from the accessed page
-                for (int sdx = 0; sdx < (1 << LM32_MEM_WR_PAGE_BITS); sdx++)
-                {
-                    unsigned data = cpu->lm32_read_mem(addr++, LM32_MEM_RD_ACCESS_BYTE);
-                    putc(data, sfp);
-                }
-            }
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
         }
 
-        fprintf(stdout, "Done.\n");
-        
-        fclose(sfp);
+        snprintf(fname, FILENAME_MAX, "%s.cycles.folded", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_profile(fname, LM32_PROF_FMT_FOLDED))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
     }
-    else
+
+    if (p_cfg->prof_call_graph)
     {
-        fprintf(stderr, "Warning: unable to open %s for writing. State will not be saved\n", p_cfg->save_fname);
+        snprintf(fname, FILENAME_MAX, "%s.calls.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_call_graph(fname))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+    }
+
+    if (p_cfg->prof_host_usecs)
+    {
+        snprintf(fname, FILENAME_MAX, "%s.host.callgrind", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_host_profile(fname, LM32_PROF_FMT_CALLGRIND))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+
+        snprintf(fname, FILENAME_MAX, "%s.host.folded", p_cfg->prof_out_prefix);
+        if (!cpu->lm32_write_host_profile(fname, LM32_PROF_FMT_FOLDED))
+        {
+            fprintf(stderr, "Warning: failed to write profile %s\n", fname);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// uart_input()
+//
+// UART keyboard input function. When replaying, input comes from the replay
+// log, else from the console, and is logged if recording.
+//
+// -------------------------------------------------------------------------
+
+static int uart_input(const lm32_time_t time)
+{
+    uint32_t data;
+    int      input;
+
+    if (cpu->lm32_get_replay_mode() == LM32_REPLAY_PLAY)
+    {
+        return cpu->lm32_replay_input(LM32_REPLAY_CHAN_UART, time, &data) ? (int)data : -1;
+    }
+
+    if ((input = lm32_uart_console_input(time)) >= 0)
+    {
+        cpu->lm32_record_input(LM32_REPLAY_CHAN_UART, time, (uint32_t)input);
+    }
+
+    return input;
+}
+
+// -------------------------------------------------------------------------
+// start_replay()
+//
+// Start recording or replaying the external inputs, if configured.
+//
+// -------------------------------------------------------------------------
+
+static void start_replay()
+{
+    const char* fname = p_cfg->replay_fname ? p_cfg->replay_fname : p_cfg->record_fname;
+
+    if (fname == NULL)
+    {
+        return;
+    }
+
+    if (!cpu->lm32_open_replay(fname, p_cfg->replay_fname ? LM32_REPLAY_PLAY : LM32_REPLAY_RECORD))
+    {
+        fprintf(stderr, "***ERROR: unable to open %s for %s\n", fname, p_cfg->replay_fname ? "replay" : "recording");
+        exit(LM32_USER_ERROR);
+    }
+
+    lm32_uart_register_input(uart_input);
+}
+
+// -------------------------------------------------------------------------
+// finish_replay()
+//
+// Finish any recording or replay, warning of replayed inputs that diverged
+// from the log.
+//
+// -------------------------------------------------------------------------
+
+static void finish_replay()
+{
+    uint64_t num_diverged = cpu->lm32_close_replay();
+
+    if (num_diverged)
+    {
+        fprintf(stderr, "Warning: %lld replayed inputs diverged from %s\n", (long long)num_diverged, p_cfg->replay_fname);
     }
 }
 
@@ -415,11 +690,6 @@ static int ext_mem_access (const uint32_t byte_addr, uint32_t *data, const int t
         }
     default:
         processing_time = LM32_EXT_MEM_NOT_PROCESSED;
-        if (byte_addr >=0x08000000 && byte_addr < 0x0c000000 &&
-            (type == LM32_MEM_WR_ACCESS_WORD || type == LM32_MEM_WR_ACCESS_HWORD || type == LM32_MEM_WR_ACCESS_BYTE))
-        {
-            mem_wr[(byte_addr & 0x07ffffff) >> LM32_MEM_WR_PAGE_BITS] = true;
-        }
         break;
     }
 
@@ -484,27 +754,42 @@ static uint32_t ext_interrupt (const lm32_time_t time, lm32_time_t *wakeup_time)
 
 static int load_binary_data(const char *fname, const uint32_t address)
 {
-    FILE     *fp;
+    int length;
 
-    // Open file for reading
-    if ((fp = fopen(fname, "rb")) == NULL) 
+    if ((length = cpu->lm32_load_file_to_mem(fname, address)) == LM32_LOAD_FAILED)
     {
         fprintf(stderr, "***ERROR: could not open file %s for reading\n", fname);
         exit(LM32_USER_ERROR);
     }
 
-    uint32_t byte_addr = address;
+    // Return length
+    return length;
+}
+
+// -------------------------------------------------------------------------
+// load_image()
+//
+// Load a read-only image file to memory. If configured to do so, the file
+// is mapped copy-on-write into memory, rather than copied, falling back to
+// loading the data if it can't be mapped.
+//
+// -------------------------------------------------------------------------
+
+static int load_image(const char *fname, const uint32_t address)
+{
+    int length;
 
-    // Load data to memory
-    for (int c; (c = fgetc(fp)) != EOF;)
+    if (p_cfg->map_images)
     {
-        cpu->lm32_write_mem(byte_addr++, c & 0xff, LM32_MEM_WR_ACCESS_BYTE, true);
-    }
+        if ((length = cpu->lm32_map_file_to_mem(fname, address)) != LM32_MAP_FAILED)
+        {
+            return length;
+        }
 
-    fclose(fp);
+        fprintf(stderr, "Warning: could not map file %s to memory. Loading instead.\n", fname);
+    }
 
-    // Return length
-    return byte_addr - address;
+    return load_binary_data(fname, address);
 }
 
 // -------------------------------------------------------------------------
@@ -516,64 +801,40 @@ static int load_binary_data(const char *fname, const uint32_t address)
 
 static void load_string_to_mem(const char *str, const uint32_t address)
 {
-    unsigned len = strlen(str);
-    unsigned byte_addr, idx;
-
-    for (byte_addr = address, idx = 0; idx < len; byte_addr++, idx++)
-    {
-        cpu->lm32_write_mem(byte_addr, str[idx], LM32_MEM_WR_ACCESS_BYTE, true);
-    }
-
-    // Terminate string
-    cpu->lm32_write_mem(byte_addr, 0, LM32_MEM_WR_ACCESS_BYTE, true);
+    // Load the string with its terminating zero
+    cpu->lm32_load_buf_to_mem(str, (uint32_t)strlen(str) + 1, address);
 }
 
 // -------------------------------------------------------------------------
 // load_hwsetup_to_mem()
 //
-// Load hardware setup date (in the defined const arrays) to memory.
+// Load hardware setup date (in the defined arrays) to memory, with the DDR
+// setup updated to match the configured RAM.
 //
 // -------------------------------------------------------------------------
 
 static void load_hwsetup_to_mem(const uint32_t address)
 {
-    uint32_t wr_addr = address;
-
-    // Load CPU setup
-    for (int idx = 0; idx < LM32_CPU_CONFIG_LEN; idx++)
-    {
-        cpu->lm32_write_mem(wr_addr++, cpu_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
-    }
-
-    // Load DDR setup
-    for (int idx = 0; idx < LM32_DDR_CONFIG_LEN; idx++)
+    // Set the DDR base address and size (MSB first)
+    for (int idx = 0; idx < 4; idx++)
     {
-        cpu->lm32_write_mem(wr_addr++, ddr_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
+        ddr_config[LM32_DDR_CONFIG_BASE_IDX + idx] = (p_cfg->mem_offset >> (24 - 8*idx)) & 0xff;
+        ddr_config[LM32_DDR_CONFIG_SIZE_IDX + idx] = (p_cfg->mem_size   >> (24 - 8*idx)) & 0xff;
     }
 
-    // Load timer0 setup
-    for (int idx = 0; idx < LM32_TIM_CONFIG_LEN; idx++)
-    {
-        cpu->lm32_write_mem(wr_addr++, tim0_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
-    }
+    // Assemble the CPU, DDR, timer0, uart0 and uart1 setups, and the trailer, and load them
+    // in one go. UART1 isn't used, but the kernel crashes if UART1 is missing from the setup.
+    uint8_t  hwsetup[LM32_HWSETUP_LEN];
+    uint8_t* p = hwsetup;
 
-    // Load uart0 setup
-    for (int idx = 0; idx < LM32_URT_CONFIG_LEN; idx++)
-    {
-        cpu->lm32_write_mem(wr_addr++, uart0_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
-    }
-    
-    // load uart1 setup---this UART isn't used, but the kernel crashes if UART1 is missing from the setup
-    for (int idx = 0; idx < LM32_URT_CONFIG_LEN; idx++)
-    {
-       cpu->lm32_write_mem(wr_addr++, uart1_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
-    }
+    memcpy(p, cpu_config,   LM32_CPU_CONFIG_LEN); p += LM32_CPU_CONFIG_LEN;
+    memcpy(p, ddr_config,   LM32_DDR_CONFIG_LEN); p += LM32_DDR_CONFIG_LEN;
+    memcpy(p, tim0_config,  LM32_TIM_CONFIG_LEN); p += LM32_TIM_CONFIG_LEN;
+    memcpy(p, uart0_config, LM32_URT_CONFIG_LEN); p += LM32_URT_CONFIG_LEN;
+    memcpy(p, uart1_config, LM32_URT_CONFIG_LEN); p += LM32_URT_CONFIG_LEN;
+    memcpy(p, trail_config, LM32_TRL_CONFIG_LEN);
 
-    // load trailer
-    for (int idx = 0; idx < LM32_TRL_CONFIG_LEN; idx++)
-    {
-        cpu->lm32_write_mem(wr_addr++, trail_config[idx], LM32_MEM_WR_ACCESS_BYTE, LM32_MEM_DISABLE_CYCLE_COUNT);
-    }
+    cpu->lm32_load_buf_to_mem(hwsetup, sizeof(hwsetup), address);
 }
 
 // -------------------------------------------------------------------------
@@ -586,10 +847,12 @@ static void load_hwsetup_to_mem(const uint32_t address)
 int main (int argc, char** argv)
 {
 
-    FILE*          lfp = stdout;
+    FILE*          lfp         = stdout;
+    double         start_usecs = lm32_cpu::lm32_host_usecs();
 
     // Process command line and .ini file options
     p_cfg = lm32_get_config(argc, argv, (const char *)"");
+    double config_usecs = lm32_cpu::lm32_host_usecs() - start_usecs;
 
     // Open the logfile, if "stdout" not specified as the filename
     if (strcmp(p_cfg->log_fname, (char *)"stdout"))
@@ -601,10 +864,29 @@ int main (int argc, char** argv)
         }
     }
 
-    // Override some CPU defaults that need to be specific to lnxmico32, and invariant
-    p_cfg->mem_size         = LM32_RAM_SIZE;
-    p_cfg->mem_offset       = LM32_RAM_BASE_ADDR;
-    p_cfg->entry_point_addr = LM32_RAM_BASE_ADDR;
+    // The RAM must be a power of 2 in size, aligned to its size, and below the peripherals
+    if (p_cfg->mem_size < LM32_MIN_RAM_SIZE || (p_cfg->mem_size & (p_cfg->mem_size - 1)) ||
+        (p_cfg->mem_offset & (p_cfg->mem_size - 1)) || (p_cfg->mem_offset + (uint64_t)p_cfg->mem_size) > LM32_PERIPH_BASE_ADDR)
+    {
+        fprintf(stderr, "***ERROR: invalid RAM size (0x%08x) or base address (0x%08x)\n", p_cfg->mem_size, p_cfg->mem_offset);
+        exit(LM32_USER_ERROR);
+    }
+
+    if (strlen(p_cfg->cmdline) > LM32_MAX_CMDLINE_LEN)
+    {
+        fprintf(stderr, "***ERROR: kernel command line too long (max %d characters)\n", LM32_MAX_CMDLINE_LEN);
+        exit(LM32_USER_ERROR);
+    }
+
+    // The kernel is loaded at the start of RAM, with the command line and hardware setup in the top pages
+    uint32_t kernel_addr  = p_cfg->mem_offset;
+    uint32_t initrd_addr  = p_cfg->initrd_addr ? p_cfg->initrd_addr : p_cfg->mem_offset + LM32_INIT_RD_OFFSET;
+    uint32_t cmdline_addr = p_cfg->mem_offset + p_cfg->mem_size - LM32_CMDLINE_OFFSET_FROM_TOP;
+    uint32_t hwsetup_addr = p_cfg->mem_offset + p_cfg->mem_size - LM32_HWSETUP_OFFSET_FROM_TOP;
+
+    // The CPU starts executing the kernel from the start of RAM
+    p_cfg->entry_point_addr = kernel_addr;
+
 
     // Generate a CPU object
     cpu = new lm32_cpu(p_cfg->verbose, 
@@ -623,48 +905,131 @@ int main (int argc, char** argv)
                        &p_cfg->icache_cfg,
                        p_cfg->disassemble_start);
 
-    // Register the memory and the interrupt callback functions
-    cpu->lm32_register_ext_mem_callback(ext_mem_access);
+    // Time the startup from program entry, including the configuration processing
+    cpu->lm32_set_startup_origin(start_usecs);
+    cpu->lm32_add_startup_usecs(LM32_STARTUP_CONFIG, config_usecs);
+    cpu->lm32_set_startup_stats(p_cfg->startup_stats);
+
+    // Select huge page backed memory, if configured
+    cpu->lm32_set_huge_pages(p_cfg->huge_pages);
+
+#ifndef LM32_FAST_COMPILE
+    // Configure any memory latency map
+    cpu->lm32_set_mem_regions(p_cfg->mem_regions, p_cfg->num_mem_regions);
+#endif
+
+    // Start any cycle sampling profile
+    if (p_cfg->prof_cycle_interval && !cpu->lm32_set_profile(p_cfg->prof_cycle_interval))
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    // Start any call graph profile
+    if (p_cfg->prof_call_graph && !cpu->lm32_set_call_graph(true))
+    {
+        fprintf(stderr, "***ERROR: memory allocation failure\n");                       //LCOV_EXCL_LINE
+        exit(LM32_INTERNAL_ERROR);                                                      //LCOV_EXCL_LINE
+    }
+
+    // Start any host sampling profile
+    if (p_cfg->prof_host_usecs && !cpu->lm32_set_host_profile(p_cfg->prof_host_usecs, p_cfg->prof_host_ra))
+    {
+        fprintf(stderr, "***ERROR: host profile not supported on this platform\n");
+        exit(LM32_USER_ERROR);
+    }
+
+    // Register the memory callback function, for peripheral accesses only, and the interrupt callback function
+    cpu->lm32_register_ext_mem_callback(ext_mem_access, LM32_PERIPH_BASE_ADDR, LM32_MEM_CB_END_ADDR, LM32_MEM_CB_DATA);
     cpu->lm32_register_int_callback(ext_interrupt);
 
+    // Index the kernel's symbols, if its System.map is present (a debug run's ELF file
+    // replaces these with its own)
+    cpu->lm32_load_symbols(LM32_SYSTEM_MAP_FNAME);
+
     // Not a debug run , so run the Linux boot
     if (!p_cfg->gdb_run)
     {
+        int    prev_phase = cpu->lm32_enter_startup_phase(LM32_STARTUP_LOAD);
+        double load_start = lm32_cpu::lm32_host_usecs();
+
         // Load vmlinux.bin
-        int rd_length = load_binary_data(LM32_VM_LINUX_FNAME, LM32_KERNEL_BASE_ADDR);
+        int kernel_length = load_image(LM32_VM_LINUX_FNAME, kernel_addr);
     
         // Load romfs.ext2
-        rd_length     = load_binary_data(LM32_FILE_SYS_FNAME, LM32_INIT_RD_BASE_ADDR);
-    
-        // Initialise memory tags *after* loading code, so as not to count instructions
-        for(int idx = 0; idx < (LM32_MEM_WR_BUF_SIZE); idx++)
+        int rd_length     = load_image(LM32_FILE_SYS_FNAME, initrd_addr);
+
+        // Check the images didn't overlap each other, or the hardware setup
+        if (initrd_addr < kernel_addr + kernel_length || initrd_addr + rd_length > hwsetup_addr)
         {
-            mem_wr[idx] = false;
+            fprintf(stderr, "***ERROR: initial ramdisk at 0x%08x overlaps the kernel or hardware setup\n", initrd_addr);
+            exit(LM32_USER_ERROR);
         }
     
+        // Clear the dirty pages *after* loading the images, so they're not saved with the state
+        cpu->lm32_clear_dirty_pages();
+    
         // Put command line into memory
-        load_string_to_mem(LM32_CMDLINE_STR, LM32_CMDLINE_BASE_ADDR);
+        load_string_to_mem(p_cfg->cmdline, cmdline_addr);
     
         // Write the hardware setup values to memory
-        load_hwsetup_to_mem(LM32_HWSETUP_BASE_ADDR);
+        load_hwsetup_to_mem(hwsetup_addr);
+
+        load_usecs = lm32_cpu::lm32_host_usecs() - load_start;
+        load_bytes = (uint64_t)kernel_length + rd_length + strlen(p_cfg->cmdline) + 1 + LM32_HWSETUP_LEN;
     
         // Pre-charge the GP regs 1 to 4 with locations
-        cpu->lm32_set_gp_reg(1, LM32_HWSETUP_BASE_ADDR);
-        cpu->lm32_set_gp_reg(2, LM32_CMDLINE_BASE_ADDR);
-        cpu->lm32_set_gp_reg(3, LM32_INIT_RD_BASE_ADDR);
-        cpu->lm32_set_gp_reg(4, LM32_INIT_RD_BASE_ADDR + rd_length);
+        cpu->lm32_set_gp_reg(1, hwsetup_addr);
+        cpu->lm32_set_gp_reg(2, cmdline_addr);
+        cpu->lm32_set_gp_reg(3, initrd_addr);
+        cpu->lm32_set_gp_reg(4, initrd_addr + rd_length);
     
-        // If enabled, and a state file exists, load state
-        if (p_cfg->load_state_file)
+        // If configured, restart from a checkpoint, else if enabled, and a state file exists, load state
+        if (p_cfg->restore_checkpoint != LM32_CKPT_NONE)
+        {
+            restore_checkpoint();
+        }
+        else if (p_cfg->load_state_file)
         {
             load_system_state();
         }
+
+        cpu->lm32_leave_startup_phase(prev_phase);
+
+        // Enable periodic checkpoints, if configured
+        if (p_cfg->checkpoint_instr > 0 || p_cfg->checkpoint_secs > 0)
+        {
+            cpu->lm32_set_checkpoint_interval(p_cfg->checkpoint_instr > 0 ? (uint64_t)p_cfg->checkpoint_instr : 0, p_cfg->checkpoint_secs);
+        }
+
+        // Run as cloned instances of the loaded system, if configured (only returning in a clone)
+        if (p_cfg->num_instances > 0)
+        {
+            clone_instances();
+        }
+
+        // Record or replay external inputs from here, if configured
+        start_replay();
     
         // Turn off key input echoing, as the running OS software will do this
         pre_run_setup();
     
-        // Run the CPU.
-        (void)cpu->lm32_run_program(NULL, p_cfg->num_run_instructions, p_cfg->user_break_addr, LM32_RUN_FROM_RESET, false);
+        // Run the CPU, writing a checkpoint whenever one is due
+        int exec_type = LM32_RUN_FROM_RESET;
+        while (cpu->lm32_run_program(NULL, p_cfg->num_run_instructions, p_cfg->user_break_addr, exec_type, false) == LM32_CHECKPOINT_BREAK)
+        {
+            write_checkpoint();
+            exec_type = LM32_RUN_CONTINUE;
+        }
+
+        // Let any background checkpoint complete
+        if (cpu->lm32_wait_snapshot() != LM32_SNAP_OK)
+        {
+            fprintf(stderr, "Warning: failed to write background checkpoint for %s\n", p_cfg->save_fname);
+        }
+
+        // Finish any recording or replay
+        finish_replay();
     
         // Turn key input echoing back on
         post_run_setup();
@@ -678,12 +1043,18 @@ int main (int argc, char** argv)
             cpu->read_elf(p_cfg->filename);
         }
 
+        // Record or replay external inputs from here, if configured
+        start_replay();
+
         // Start procssing commands from GDB
         if (lm32gdb_process_gdb(cpu, p_cfg->com_port_num, p_cfg->use_tcp_skt))
         {
             fprintf(stderr, "***ERROR in opening PTY\n");
             return -1;
         }
+
+        // Finish any recording or replay
+        finish_replay();
     }
 
 #ifndef LM32_FAST_COMPILE
@@ -692,6 +1063,12 @@ int main (int argc, char** argv)
     {
         cpu->lm32_dump_op_stats();
     }
+
+    // Dump memory latency map statistics, if a map was configured
+    if (p_cfg->num_mem_regions)
+    {
+        cpu->lm32_dump_mem_region_stats();
+    }
 #endif
 
     // Dump registers after completion, if specified to do so
@@ -707,6 +1084,19 @@ int main (int argc, char** argv)
 
         fprintf(lfp, "\nNumber of executed instructions = %.1f million (%.1f MIPS)\n",  
 	              (float)instr_count/1e6, (float)instr_count/tv_diff);
+
+        if (load_bytes)
+        {
+            fprintf(lfp, "Image load time = %.1f ms (%.1f MB)\n", load_usecs/1e3, (double)load_bytes/1e6);
+        }
+
+        if (p_cfg->huge_pages)
+        {
+            int page_type = cpu->lm32_get_mem_page_type();
+
+            fprintf(lfp, "Memory host pages = %s\n", (page_type == LM32_MEM_PAGES_HUGETLB)     ? "huge (hugetlb)" :
+                                                   (page_type == LM32_MEM_PAGES_TRANSPARENT) ? "huge (transparent)" : "normal");
+        }
     }
 
     // Dump RAM, if specified to do so and within range
@@ -756,5 +1146,7 @@ int main (int argc, char** argv)
         save_system_state();
     }
 
+    write_profiles(p_cfg);
+
     return 0;
 }
@@ -37,19 +37,23 @@
 #define LM32_UART0_BASE_ADDR            0x80000000U
 #define LM32_UART1_BASE_ADDR            0x81000000U
 #define LM32_TIMER0_BASE_ADDR           0x80002000U
+#define LM32_PERIPH_BASE_ADDR           LM32_UART0_BASE_ADDR
 
 #define LM32_PAGE_SIZE                  0x00001000U
 #define LM32_PAGE_MASK                  (LM32_PAGE_SIZE - 1)
 
-#define LM32_INIT_RD_BASE_ADDR          0x08400000U
-#define LM32_CMDLINE_BASE_ADDR          0x0BFFF000U
-#define LM32_HWSETUP_BASE_ADDR          0x0BFFE000U
+// Default RAM layout. The RAM base address and size, initial ramdisk address
+// and command line are run time configurable, with the kernel loaded at the
+// RAM base, and the command line and hardware setup in the top two pages.
+#define LM32_RAM_SIZE                   (64 * 1024 * 1024)
 
-#define LM32_KERNEL_BASE_ADDR           LM32_RAM_BASE_ADDR
+#define LM32_INIT_RD_OFFSET             0x00400000U
+#define LM32_INIT_RD_BASE_ADDR          (LM32_RAM_BASE_ADDR + LM32_INIT_RD_OFFSET)
+#define LM32_CMDLINE_OFFSET_FROM_TOP    (1 * LM32_PAGE_SIZE)
+#define LM32_HWSETUP_OFFSET_FROM_TOP    (2 * LM32_PAGE_SIZE)
 
-#define LM32_RAM_SIZE                   (64 * 1024 * 1024)
-#define LM32_RAM_MASK                   (LM32_RAM_SIZE - 1)
-#define LM32_PERIPH_MASK                0xf0000000
+#define LM32_MIN_RAM_SIZE               (8 * 1024 * 1024)
+#define LM32_MAX_CMDLINE_LEN            (LM32_PAGE_SIZE - 1)
 
 #define LM32_CPU_FREQUENCY_MHZ          10
 #define LM32_CPU_FREQUENCY_HZ           (LM32_CPU_FREQUENCY_MHZ * 1000 * 1000)
@@ -59,6 +63,16 @@
 #define LM32_CMDLINE_STR                "root=/dev/ram0 console=ttyS0,115200 ramdisk_size=16384"
 #define LM32_VM_LINUX_FNAME             "vmlinux.bin"
 #define LM32_FILE_SYS_FNAME             "romfs.ext2"
+#define LM32_SYSTEM_MAP_FNAME           "System.map"
+
+// Replay log channel for UART keyboard input
+#define LM32_REPLAY_CHAN_UART           (LM32_REPLAY_CHAN_USER + 0)
+
+#if !(defined _WIN32) && !(defined _WIN64)
+#define LM32_NULL_DEV                   "/dev/null"
+#else
+#define LM32_NULL_DEV                   "NUL"
+#endif
 
 #define LM32_UART_BAUD_RATE             115200
 #ifndef LM32_FAST_COMPILE
@@ -83,9 +97,20 @@
 #define LM32_URT_CONFIG_LEN            56
 #define LM32_TRL_CONFIG_LEN             8
 
+// Total length of the hardware setup (with two UARTs)
+#define LM32_HWSETUP_LEN               (LM32_CPU_CONFIG_LEN + LM32_DDR_CONFIG_LEN + LM32_TIM_CONFIG_LEN + \
+                                        2*LM32_URT_CONFIG_LEN + LM32_TRL_CONFIG_LEN)
+
+#define LM32_DDR_CONFIG_BASE_IDX       40
+#define LM32_DDR_CONFIG_SIZE_IDX       44
+
 #define LM32_UART0_CNTX                 0
 #define LM32_UART1_CNTX                 1
 
+// Peripheral snapshot sections saved with the CPU's state
+#define LM32_SNAP_SECT_TIMER            (LM32_SNAP_SECT_USER + 0)
+#define LM32_SNAP_SECT_UART             (LM32_SNAP_SECT_USER + 1)
+
 #define LM32_KEYBOARD_CONNECTED         true
 #define LM32_KEYBOARD_NOT_CONNECTED     false
 
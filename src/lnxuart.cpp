@@ -114,6 +114,9 @@ lm32_uart_state_t uart_state = {
      LM32_UART_REGS_RST_VALS}
 };
 
+// Keyboard input function, which can be replaced (e.g. to record or replay input)
+static p_lm32_uart_input_t uart_input = lm32_uart_console_input;
+
 #if !(defined _WIN32) && !defined(_WIN64)
 // -------------------------------------------------------------------------
 // Keyboard input LINUX/CYGWIN emulation functions
@@ -154,6 +157,31 @@ int _kbhit(void)
 
 #endif
 
+// -------------------------------------------------------------------------
+// lm32_uart_console_input()
+//
+// Default keyboard input function, returning the next character from the
+// console, or -1 if none is waiting.
+//
+// -------------------------------------------------------------------------
+
+int lm32_uart_console_input(const lm32_time_t time)
+{
+    return LM32_INPUT_RDY_TTY() ? (LM32_GET_INPUT_TTY() & 0xff) : -1;
+}
+
+// -------------------------------------------------------------------------
+// lm32_uart_register_input()
+//
+// Replace the keyboard input function.
+//
+// -------------------------------------------------------------------------
+
+void lm32_uart_register_input(p_lm32_uart_input_t input_func)
+{
+    uart_input = input_func;
+}
+
 // -------------------------------------------------------------------------
 // lm32_uart_write()
 //
@@ -259,13 +287,14 @@ bool lm32_uart_tick(const lm32_time_t time, bool &terminate, const bool kbd_conn
 
     // When UART with keyboard connected, and input is waiting, get the value and put in RBR register,
     // then flag data ready status
-    if (kbd_connected && LM32_INPUT_RDY_TTY())
+    int input;
+    if (kbd_connected && (input = uart_input(time)) >= 0)
     {
         // Since only one UART can be the input, only need one terminate index state
         static int term_idx = 0;
 
-        // Get the input character and put in the RBR register
-        uint32_t  cur = LM32_GET_INPUT_TTY() & 0xffU;
+        // Put the input character in the RBR register
+        uint32_t  cur = (uint32_t)input & 0xffU;
         uart_state.lm32_uart_regs[cntx][LM32_UART_RBR_REG >> 2] = cur;
 
         // Set the data received flag in the LSR register
@@ -56,6 +56,9 @@ typedef struct
     uint32_t    lm32_uart_regs[LM32_MAX_NUM_UARTS][LM32_UART_NUM_REGS];
 } lm32_uart_state_t;
 
+// Keyboard input function, returning the next input character, or -1 if none
+typedef int (*p_lm32_uart_input_t) (const lm32_time_t time);
+
 // -------------------------------------------------------------------------
 // PUBLIC TYPE DEFINITIONS
 // -------------------------------------------------------------------------
@@ -65,4 +68,6 @@ extern void              lm32_uart_read      (const uint32_t address, uint32_t*
 extern bool              lm32_uart_tick      (const lm32_time_t time, bool &terminate, const bool kbd_connected = false, const int cntx = 0);
 extern lm32_uart_state_t lm32_get_uart_state (void);
 extern void              lm32_set_uart_state (const lm32_uart_state_t state);
+extern int               lm32_uart_console_input (const lm32_time_t time);
+extern void              lm32_uart_register_input (p_lm32_uart_input_t input_func);
 #endif
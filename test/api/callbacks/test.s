@@ -0,0 +1,87 @@
+# ----------------------------------------------------------------
+# Tests the memory callback API of the MICO32 processor model,
+# adding a probe callback over a small address range, for data
+# writes only, and checking it is only called for matching
+# accesses, until removed
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ PROBE_START, 0x8000
+        .equ PROBE_END,   0x80ff
+        .equ TEST_VALUE,  0x1234
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_PROBE_OFFSET,        0x00000050
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Add the probe callback, and check its count starts at 0
+        ori      r2, r0, 1
+        sw       (r1+COMMS_PROBE_OFFSET), r2
+        lw       r3, (r1+COMMS_PROBE_OFFSET)
+        bne      r3, r0, _finish
+
+        # Write just outside the probe's range, either side, and read
+        # from within it. None of these should call the probe.
+        ori      r10, r0, TEST_VALUE
+        ori      r11, r0, PROBE_START
+        ori      r12, r0, PROBE_END
+        sw       (r11-4), r10
+        sb       (r12+1), r10
+        lw       r4, (r11+0)
+        lbu      r4, (r12+0)
+        lw       r3, (r1+COMMS_PROBE_OFFSET)
+        bne      r3, r0, _finish
+
+        # Write to the first and last bytes of the probe's range, which
+        # should both call it
+        sw       (r11+0), r10
+        sb       (r12+0), r10
+        lw       r3, (r1+COMMS_PROBE_OFFSET)
+        ori      r5, r0, 2
+        bne      r3, r5, _finish
+
+        # The probe should not intercept the writes, which go to memory
+        lw       r4, (r11+0)
+        bne      r4, r10, _finish
+        lbu      r4, (r12+0)
+        andi     r6, r10, 0xff
+        bne      r4, r6, _finish
+
+        # Remove the probe, and check writes in its range no longer call it
+        sw       (r1+COMMS_PROBE_OFFSET), r0
+        sw       (r11+0), r10
+        lw       r3, (r1+COMMS_PROBE_OFFSET)
+        bne      r3, r5, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
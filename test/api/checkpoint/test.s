@@ -0,0 +1,115 @@
+# ----------------------------------------------------------------
+# Tests the checkpoint API of the MICO32 processor model, writing
+# a full checkpoint and then an incremental one, and restoring
+# the latest and then the first
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ DATA_A_ADDR, 0x8000
+        .equ DATA_B_ADDR, 0x9000
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_CKPT_OFFSET,         0x00000064
+
+        .equ CKPT_DELETE,               0
+        .equ CKPT_WRITE,                1
+        .equ CKPT_RESTORE,              2
+        .equ CKPT_RESTORE_FIRST,        3
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Set two memory words, on different pages, to 1
+        ori      r10, r0, 1
+        ori      r11, r0, DATA_A_ADDR
+        ori      r12, r0, DATA_B_ADDR
+        sw       (r11+0), r10
+        sw       (r12+0), r10
+
+        # Write the first (full) checkpoint, from the next instruction
+        ori      r2, r0, CKPT_WRITE
+        sw       (r1+COMMS_CKPT_OFFSET), r2
+
+        # Execution resumes here after restoring the first checkpoint. Get
+        # the number of restores
+_ckpt_first:
+        lw       r3, (r1+COMMS_CKPT_OFFSET)
+        be       r3, r0, _second
+
+        # After the second restore, both words should be back to 1
+        ori      r5, r0, 2
+        bne      r3, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r10, _finish
+        lw       r4, (r12+0)
+        bne      r4, r10, _finish
+        be       r0, r0, _good
+
+        # Change only the second word to 2, and write the second checkpoint,
+        # with only its page
+_second:
+        ori      r13, r0, 2
+        sw       (r12+0), r13
+        sw       (r1+COMMS_CKPT_OFFSET), r2
+
+        # Execution resumes here after restoring the latest checkpoint
+_ckpt_latest:
+        lw       r3, (r1+COMMS_CKPT_OFFSET)
+        be       r3, r0, _change
+
+        # After the first restore, the words should be 1 and 2, then restore the first checkpoint
+        ori      r5, r0, 1
+        bne      r3, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r10, _finish
+        lw       r4, (r12+0)
+        bne      r4, r13, _finish
+        ori      r2, r0, CKPT_RESTORE_FIRST
+        sw       (r1+COMMS_CKPT_OFFSET), r2
+
+        # Not reached, as the restore is before the next instruction
+        be       r0, r0, _finish
+
+        # Change both words, and restore the latest checkpoint
+_change:
+        ori      r14, r0, 3
+        sw       (r11+0), r14
+        sw       (r12+0), r14
+        ori      r2, r0, CKPT_RESTORE
+        sw       (r1+COMMS_CKPT_OFFSET), r2
+
+        # Not reached, as the restore is before the next instruction
+        be       r0, r0, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        # Remove the checkpoint files
+        sw       (r1+COMMS_CKPT_OFFSET), r0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -0,0 +1,91 @@
+# ----------------------------------------------------------------
+# Tests the mappable snapshot files of the MICO32 processor model,
+# saving one and loading it twice, with memory written in between,
+# which must not change the (possibly mapped) file
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ DATA_ADDR,   0x8000
+        .equ ORIG_VALUE,  0x1234
+        .equ NEW_VALUE,   0x5678
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_SNAP_OFFSET,         0x00000038
+
+        .equ SNAP_SAVE,                 4
+        .equ SNAP_LOAD,                 5
+        .equ SNAP_DELETE,               6
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Set a register, and a memory word, to their original values
+        ori      r10, r0, ORIG_VALUE
+        ori      r11, r0, DATA_ADDR
+        sw       (r11+0), r10
+
+        # Save a mappable snapshot file, from the next instruction
+        ori      r2, r0, SNAP_SAVE
+        sw       (r1+COMMS_SNAP_OFFSET), r2
+
+        # Execution resumes here after each load. Get the number of loads
+_snap_point:
+        lw       r3, (r1+COMMS_SNAP_OFFSET)
+        be       r3, r0, _change
+
+        # Check the register and memory word have their original values
+        ori      r5, r0, ORIG_VALUE
+        bne      r10, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r5, _finish
+
+        # After the first load, change the loaded memory and load again, else finish
+        ori      r5, r0, 1
+        be       r3, r5, _change
+        ori      r5, r0, 2
+        be       r3, r5, _good
+        be       r0, r0, _finish
+
+        # Change the register and memory word, and load the snapshot
+_change:
+        ori      r2, r0, SNAP_LOAD
+        ori      r10, r0, NEW_VALUE
+        sw       (r11+0), r10
+        sw       (r1+COMMS_SNAP_OFFSET), r2
+
+        # Not reached, as the load is before the next instruction
+        be       r0, r0, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        # Remove the snapshot file
+        ori      r2, r0, SNAP_DELETE
+        sw       (r1+COMMS_SNAP_OFFSET), r2
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
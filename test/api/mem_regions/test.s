@@ -0,0 +1,118 @@
+# ----------------------------------------------------------------
+# Tests the memory latency map of the MICO32 processor model,
+# configuring a static RAM-like and an SDRAM-like region, and
+# checking the per-region write and wait cycle totals, and page
+# misses, for writes to each region and to neither
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ SRAM_ADDR,   0x8000
+        .equ SDRAM_ADDR,  0x9000
+        .equ OTHER_ADDR,  0xa000
+        .equ TEST_VALUE,  0x1234
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_REGIONS_OFFSET,      0x00000054
+        .equ COMMS_REGION_OFFSET,       0x00000058
+        .equ COMMS_WAIT_OFFSET,         0x0000005c
+        .equ COMMS_PAGE_MISS_OFFSET,    0x00000060
+
+        .equ NUM_REGIONS,               2
+        .equ REGION_DEFAULT,            8
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Configure the latency map
+        ori      r2, r0, NUM_REGIONS
+        sw       (r1+COMMS_REGIONS_OFFSET), r2
+
+        # Write three times to the SRAM-like region, taking 5 wait states each
+        ori      r10, r0, TEST_VALUE
+        ori      r11, r0, SRAM_ADDR
+        sw       (r11+0), r10
+        sw       (r11+4), r10
+        sh       (r11+8), r10
+
+        # Write four times to the SDRAM-like region, taking 2 wait states each,
+        # over two pages, each opened for an extra 10 wait states
+        ori      r12, r0, SDRAM_ADDR
+        sw       (r12+0), r10
+        sw       (r12+4), r10
+        sw       (r12+0x100), r10
+        sw       (r12+0x104), r10
+
+        # Write once outside of the regions
+        ori      r13, r0, OTHER_ADDR
+        sw       (r13+0), r10
+
+        # Check the SRAM-like region's totals
+        sw       (r1+COMMS_REGION_OFFSET), r0
+        lw       r3, (r1+COMMS_REGION_OFFSET)
+        ori      r5, r0, 3
+        bne      r3, r5, _finish
+        lw       r3, (r1+COMMS_WAIT_OFFSET)
+        ori      r5, r0, 15
+        bne      r3, r5, _finish
+        lw       r3, (r1+COMMS_PAGE_MISS_OFFSET)
+        bne      r3, r0, _finish
+
+        # Check the SDRAM-like region's totals
+        ori      r2, r0, 1
+        sw       (r1+COMMS_REGION_OFFSET), r2
+        lw       r3, (r1+COMMS_REGION_OFFSET)
+        ori      r5, r0, 4
+        bne      r3, r5, _finish
+        lw       r3, (r1+COMMS_WAIT_OFFSET)
+        ori      r5, r0, 28
+        bne      r3, r5, _finish
+        lw       r3, (r1+COMMS_PAGE_MISS_OFFSET)
+        ori      r5, r0, 2
+        bne      r3, r5, _finish
+
+        # Check the write outside of the regions was counted against the default,
+        # with no wait states
+        ori      r2, r0, REGION_DEFAULT
+        sw       (r1+COMMS_REGION_OFFSET), r2
+        lw       r3, (r1+COMMS_REGION_OFFSET)
+        ori      r5, r0, 1
+        bne      r3, r5, _finish
+        lw       r3, (r1+COMMS_WAIT_OFFSET)
+        bne      r3, r0, _finish
+
+        # Remove the map, and check the statistics are cleared
+        sw       (r1+COMMS_REGIONS_OFFSET), r0
+        sw       (r1+COMMS_REGION_OFFSET), r0
+        lw       r3, (r1+COMMS_REGION_OFFSET)
+        bne      r3, r0, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -0,0 +1,64 @@
+# ----------------------------------------------------------------
+# Program for testing the profile outputs of the MICO32 processor
+# model, calling a function a known number of times
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ STACK_ADDR,  0xfff0
+        .equ NUM_CALLS,   10
+        .equ WORK_LOOPS,  8
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        ori      sp, r0, STACK_ADDR
+
+        # Call _work NUM_CALLS times, accumulating a count in r2
+        ori      r2, r0, 0
+        ori      r10, r0, NUM_CALLS
+_loop:
+        calli    _work
+        addi     r10, r10, -1
+        bne      r10, r0, _loop
+
+        # Check the count
+        ori      r3, r0, NUM_CALLS*WORK_LOOPS
+        bne      r2, r3, _finish
+        be       r0, r0, _good
+
+        # Add WORK_LOOPS to r2, one at a time
+_work:
+        ori      r1, r0, WORK_LOOPS
+_work_loop:
+        addi     r2, r2, 1
+        addi     r1, r1, -1
+        bne      r1, r0, _work_loop
+        ret
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -0,0 +1,83 @@
+# ----------------------------------------------------------------
+# Tests reloading the program ELF file on the MICO32 processor
+# model, checking initialised data is loaded again, and that .bss
+# memory beyond the file data is zeroed
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ DATA_VALUE,  0x1234
+        .equ NEW_VALUE,   0x5678
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_RELOAD_OFFSET,       0x00000068
+
+        .data
+val1:   .word DATA_VALUE
+
+        .bss
+bss1:   .skip 4
+bss2:   .skip 4
+
+        .text
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Check the data word and .bss words as loaded
+        ori      r10, r0, val1
+        ori      r11, r0, bss1
+        ori      r12, r0, bss2
+        ori      r5, r0, DATA_VALUE
+        lw       r4, (r10+0)
+        bne      r4, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r0, _finish
+        lw       r4, (r12+0)
+        bne      r4, r0, _finish
+
+        # Overwrite the data word and .bss words
+        ori      r6, r0, NEW_VALUE
+        sw       (r10+0), r6
+        sw       (r11+0), r6
+        sw       (r12+0), r6
+
+        # Reload the program, before the next instruction
+        sw       (r1+COMMS_RELOAD_OFFSET), r0
+
+        # Check the data word is back to its initial value, and the .bss words zero
+        lw       r4, (r10+0)
+        bne      r4, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r0, _finish
+        lw       r4, (r12+0)
+        bne      r4, r0, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
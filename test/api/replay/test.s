@@ -0,0 +1,174 @@
+# ----------------------------------------------------------------
+# Tests the record and replay API of the MICO32 processor model,
+# recording an external interrupt, and replaying it from the
+# snapshot taken as recording started
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ INT_DELAY,   20
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_PATTERN_OFFSET,      0x00000000
+        .equ COMMS_TIME_OFFSET,         0x00000004
+        .equ COMMS_REPLAY_OFFSET,       0x0000003c
+        .equ COMMS_DIVERGED_OFFSET,     0x00000040
+
+        .equ REPLAY_STOP,               0
+        .equ REPLAY_RECORD,             1
+        .equ REPLAY_PLAY,               2
+
+/* Exception handlers */
+_reset_handler:
+        xor r0, r0, r0
+        bi  main
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_breakpoint_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_instruction_bus_error_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_watchpoint_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_data_bus_error_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_divide_by_zero_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+_interrupt_handler:
+        # Count the interrupt, and clear it
+        addi r20, r20, 1
+        wcsr IP, r3
+        eret
+        nop
+        nop
+        nop
+        nop
+        nop
+_system_call_handler:
+        bi  _finish
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+        nop
+
+main:
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Unmask and enable interrupt 0 (r3), with no interrupts yet (r20)
+        ori      r3, r0, 1
+        wcsr     IM, r3
+        ori      r20, r0, 0
+        wcsr     IE, r3
+
+        # Take a snapshot, and start recording, from the next instruction
+        ori      r2, r0, REPLAY_RECORD
+        sw       (r1+COMMS_REPLAY_OFFSET), r2
+
+        # Execution resumes here, replaying, after the snapshot is restored.
+        # Recording (or replaying) starts from the next instruction. Both passes
+        # must execute the same instructions, so that the inputs line up, with
+        # only the values used differing.
+_replay_point:
+        ori      r4, r0, 100
+        lw       r5, (r1+COMMS_REPLAY_OFFSET)
+
+        # Generate an interrupt when recording (r6 = 1), but not when replaying
+        # (r6 = 0), where it comes from the recording
+        cmpei    r6, r5, REPLAY_RECORD
+        sw       (r1+COMMS_PATTERN_OFFSET), r6
+        ori      r7, r0, INT_DELAY
+        sw       (r1+COMMS_TIME_OFFSET), r7
+
+        # Wait for the interrupt (or time out if r4 reaches 0)
+_wait:
+        addi     r4, r4, -1
+        be       r4, r0, _finish
+        be       r20, r0, _wait
+
+        # Check there was just the one interrupt
+        bne      r20, r3, _finish
+
+        # When recording, restore the snapshot and replay (r8 = 2), else stop
+        # replaying (r8 = 0)
+        sli      r8, r5, 1
+        ori      r9, r0, 4
+        sub      r8, r9, r8
+        sw       (r1+COMMS_REPLAY_OFFSET), r8
+
+        # Only reached after replaying, as the restore is before the next instruction
+        ori      r9, r0, REPLAY_PLAY
+        bne      r5, r9, _finish
+
+        # The interrupt callback's own result, of no interrupt, should be the
+        # only input that differed from the recording
+        lw       r9, (r1+COMMS_DIVERGED_OFFSET)
+        bne      r9, r3, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -0,0 +1,90 @@
+# ----------------------------------------------------------------
+# Tests the snapshot API of the MICO32 processor model, restoring
+# a snapshot, and then its serialised copy
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+        .equ DATA_ADDR,   0x8000
+        .equ ORIG_VALUE,  0x1234
+        .equ NEW_VALUE,   0x5678
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_SNAP_OFFSET,         0x00000038
+
+        .equ SNAP_TAKE,                 1
+        .equ SNAP_RESTORE,              2
+        .equ SNAP_RESTORE_COPY,         3
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Set a register, and a memory word, to their original values
+        ori      r10, r0, ORIG_VALUE
+        ori      r11, r0, DATA_ADDR
+        sw       (r11+0), r10
+
+        # Take a snapshot, from the next instruction
+        ori      r2, r0, SNAP_TAKE
+        sw       (r1+COMMS_SNAP_OFFSET), r2
+
+        # Execution resumes here after each restore. Get the number of restores
+_snap_point:
+        lw       r3, (r1+COMMS_SNAP_OFFSET)
+        be       r3, r0, _first
+
+        # Check the register and memory word have their original values
+        ori      r5, r0, ORIG_VALUE
+        bne      r10, r5, _finish
+        lw       r4, (r11+0)
+        bne      r4, r5, _finish
+
+        # After restoring the snapshot, restore its serialised copy, and then finish
+        ori      r2, r0, SNAP_RESTORE_COPY
+        ori      r5, r0, 1
+        be       r3, r5, _change
+        ori      r5, r0, 2
+        be       r3, r5, _good
+        be       r0, r0, _finish
+
+_first:
+        ori      r2, r0, SNAP_RESTORE
+
+        # Change the register and memory word, and restore (as set in r2)
+_change:
+        ori      r10, r0, NEW_VALUE
+        sw       (r11+0), r10
+        sw       (r1+COMMS_SNAP_OFFSET), r2
+
+        # Not reached, as the restore is before the next instruction
+        be       r0, r0, _finish
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -0,0 +1,77 @@
+# ----------------------------------------------------------------
+# Tests the symbol and source line lookups of the MICO32 processor
+# model, for the program's own labels and lines
+# ----------------------------------------------------------------
+
+        .file   "test.s"
+        .text
+        .align 4
+_start: .global _start
+        .global main
+
+        .equ FAIL_VALUE,  0x0bad 
+        .equ PASS_VALUE,  0x0900d
+        .equ RESULT_ADDR, 0xfffc
+
+        .equ COMMS_BASE_ADDRESS,        0x20000000
+        .equ COMMS_LOOKUP_OFFSET,       0x00000044
+        .equ COMMS_LINE_OFFSET,         0x00000048
+        .equ COMMS_MAIN_OFFSET,         0x0000004c
+
+
+main:
+        xor      r0, r0, r0
+
+        # By default, set the result to bad
+        ori      r30, r0, 0
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+
+        # Set r1 to be the comms peripheral base address
+        orhi     r1, r0, (COMMS_BASE_ADDRESS>>16) & 0xffff
+
+        # Check main is found by name
+        mvhi     r2, hi(main)
+        ori      r2, r2, lo(main)
+        lw       r3, (r1+COMMS_MAIN_OFFSET)
+        bne      r3, r2, _finish
+
+        # Check an address within _lookup has the _lookup symbol
+        mvhi     r2, hi(_lookup)
+        ori      r2, r2, lo(_lookup)
+        addi     r4, r2, 8
+        sw       (r1+COMMS_LOOKUP_OFFSET), r4
+        lw       r3, (r1+COMMS_LOOKUP_OFFSET)
+        bne      r3, r2, _finish
+
+        # Check the line of _lookup's first instruction is followed by that of
+        # the next instruction, on the next line
+        sw       (r1+COMMS_LOOKUP_OFFSET), r2
+        lw       r5, (r1+COMMS_LINE_OFFSET)
+        be       r5, r0, _finish
+        addi     r4, r2, 4
+        sw       (r1+COMMS_LOOKUP_OFFSET), r4
+        lw       r6, (r1+COMMS_LINE_OFFSET)
+        addi     r5, r5, 1
+        bne      r6, r5, _finish
+        be       r0, r0, _good
+
+_lookup:
+        nop
+        nop
+        nop
+        nop
+
+_good:
+        ori      r30, r0, PASS_VALUE
+        be       r0, r0, _store_result
+
+_finish:
+        ori      r30, r0, FAIL_VALUE
+_store_result:
+        ori      r31, r0, RESULT_ADDR
+        sw       (r31+0), r30
+_end:
+        be       r0, r0, _end
+        
+        .end
@@ -38,6 +38,7 @@ def processCmdLine () :
   parser.add_argument('-e', '--execFile',   dest='execFile',  default='cpumico32', action='store',      help='Execution file')
   parser.add_argument('-s', '--sim_tests',  dest='simTests',  default=False,       action='store_true', help='Run simulation tests')
   parser.add_argument('-H', '--hw_tests',   dest='hwTests',   default=False,       action='store_true', help='Run H/W platform tests')
+  parser.add_argument('-F', '--fork_server', dest='forkServer', default=False,     action='store_true', help='Run model tests as jobs on a fork server')
   
   # Examples of options with other types of arguments
   # parser.add_argument('-t', '--test',       dest='testVar',   default='UNSET', action='store',  help='Test argument')
@@ -85,13 +86,21 @@ def shellCmd (cmd_str, curr_dir = None, print_only=False, cd=True, background=Fa
     
 
 # --------------------------------------------------------------
-# Run the test on the model
+# Write the test's temporary .ini file, with the cache configuration
+# for this test
 
-def runTestsModel(execfile, userargs, inifile, tmpinifile, setsize, linesize, testfile, lm32_test, printonly) :
+def writeTmpIni(inifile, tmpinifile, setsize, linesize, lm32_test) :
 
   shellCmd('cat ' + inifile + '| sed -e "s/cache_num_sets=.*$/cache_num_sets=' + str(setsize) + '/" | ' +
                                 'sed -e "s/cache_bytes_per_line=.*$/cache_bytes_per_line=' +  str(linesize) + '/" > ' +
                                  lm32_test + '/' + tmpinifile)
+
+# --------------------------------------------------------------
+# Run the test on the model
+
+def runTestsModel(execfile, userargs, inifile, tmpinifile, setsize, linesize, testfile, lm32_test, printonly) :
+
+  writeTmpIni(inifile, tmpinifile, setsize, linesize, lm32_test)
                                  
   # Run the test and get the result
   result_str = shellCmd(execfile + ' ' + userargs + ' -i ' + tmpinifile + ' -T -r 0xfffc -n10000 -f ' + testfile, 
@@ -103,6 +112,83 @@ def runTestsModel(execfile, userargs, inifile, tmpinifile, setsize, linesize, te
   
   return int(result_str[1], 16)
 
+# --------------------------------------------------------------
+# Start a fork server for running a test on the model, from the test's
+# directory with its temporary .ini file, as for runTestsModel()
+
+def startForkServer(execfile, userargs, tmpinifile, testfile, lm32_test, printonly) :
+
+  cmd_str = execfile + ' ' + userargs + ' -F -T -i ' + tmpinifile + ' -f ' + testfile
+
+  if printonly :
+    print ('cd ' + lm32_test)
+    print (cmd_str)
+    return None
+
+  return subprocess.Popen(cmd_str, shell=True, cwd=lm32_test, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+# --------------------------------------------------------------
+# Run a test as a job on a fork server
+
+def runTestsForkServer(execfile, userargs, inifile, tmpinifile, setsize, linesize, testfile, lm32_test, printonly) :
+
+  writeTmpIni(inifile, tmpinifile, setsize, linesize, lm32_test)
+
+  server  = startForkServer(execfile, userargs, tmpinifile, testfile, lm32_test, printonly)
+  job_str = '-r 0xfffc -n10000\n'
+
+  if printonly :
+    print (job_str)
+    return 0
+
+  server.stdin.write(job_str.encode('UTF-8'))
+  server.stdin.flush()
+
+  # Read the job's output, up to its end line, and extract the relevant field
+  result = 0
+  while True :
+    result_str = server.stdout.readline().decode('UTF-8')
+    if result_str == '' or result_str.startswith('#END') :
+      break
+    if result_str.startswith('RAM') :
+      result = int(result_str.split('=')[1], 16)
+
+  # Shut down the server
+  server.stdin.close()
+  server.wait()
+
+  return result
+
+# --------------------------------------------------------------
+# Check the profile outputs of a test run with cycle and call graph
+# profiling, and remove them. All the cycles sampled must be attributed,
+# by line and by function, including to the test's _work function, and
+# the call graph must have the test's 10 calls to _work.
+
+def checkProfiles(lm32_test, printonly) :
+
+  fnames = ['profile.cycles.callgrind', 'profile.cycles.folded', 'profile.calls.callgrind']
+
+  if printonly :
+    return True
+
+  try :
+    cycles, folded, calls = [open(lm32_test + '/' + f).read().split('\n') for f in fnames]
+  except IOError :
+    return False
+
+  summary = [int(s.split()[1]) for s in cycles if s.startswith('summary:')]
+  by_line = sum([int(s.split()[2]) for s in cycles if s.startswith('0x')])
+  by_fn   = sum([int(s.split()[-1]) for s in folded if s != ''])
+
+  ok = summary != [0] and summary == [by_line] and summary == [by_fn] and 'fn=_work_loop' in cycles
+  ok = ok and 'cfn=_work' in calls and calls[calls.index('cfn=_work') + 1].startswith('calls=10 ')
+
+  for f in fnames :
+    os.remove(lm32_test + '/' + f)
+
+  return ok
+
 # --------------------------------------------------------------
 # Run tests on simulator
 
@@ -215,7 +301,20 @@ def runtest() :
              'exceptions/ibus_errors',
              'exceptions/dbus_errors',
              'exceptions/hw_debug',
-             'api/num_instr']
+             'api/num_instr',
+             'api/snapshot',
+             'api/replay',
+             'api/symbols',
+             'api/profile',
+             'api/callbacks',
+             'api/mem_regions',
+             'api/checkpoint',
+             'api/mappable',
+             'api/reload']
+
+  # Model tests run with profiling, with their profile arguments, and their
+  # profile outputs checked when passing
+  proflist = {'api/profile' : '-@ cycles=1,calls'}
 
   # If the C model is to be run (and not the simulation or platform), add the model specific tests
   if not args.simTests and not args.hwTests:
@@ -232,7 +331,7 @@ def runtest() :
   #
   # Test result for a pass
   #
-  passresult = 0x900d
+  passresult = 0x900d
 
   #
   # Statistics variables
@@ -267,7 +366,7 @@ def runtest() :
 
     # Compile the test code
     shellCmd('lm32-elf-cpp ' + srcfile + ' ' + srcfile + '.tmp',  lm32_test, args.printOnly, True)
-    shellCmd('lm32-elf-as '  + srcfile + '.tmp -o ' + objfile,  lm32_test, args.printOnly, True)
+    shellCmd('lm32-elf-as -g ' + srcfile + '.tmp -o ' + objfile,  lm32_test, args.printOnly, True)
     shellCmd('lm32-elf-ld '  + objfile + ' -o ' + testfile, lm32_test, args.printOnly, False)
     
     # Run the test and get the result
@@ -275,6 +374,12 @@ def runtest() :
       result = runTestsSim(lm32_test, is_windows, args.printOnly)
     elif  args.hwTests :
       result = runTestsHw (lm32_test, testfile, is_windows, args.printOnly)
+    elif args.forkServer :
+      result = runTestsForkServer(execfile, userargs, inifile, tmpinifile, setsize, linesize, testfile, lm32_test, args.printOnly)
+    elif lm32_test in proflist :
+      result = runTestsModel(execfile, userargs + ' ' + proflist[lm32_test], inifile, tmpinifile, setsize, linesize, testfile, lm32_test, args.printOnly)
+      if result == passresult and not checkProfiles(lm32_test, args.printOnly) :
+        result = 0
     else :
       result = runTestsModel(execfile, userargs, inifile, tmpinifile, setsize, linesize, testfile, lm32_test, args.printOnly)
  
@@ -38,6 +38,15 @@ dirlist="instructions/add \
          exceptions/dbus_errors \
          exceptions/hw_debug \
          api/num_instr \
+         api/snapshot \
+         api/replay \
+         api/symbols \
+         api/profile \
+         api/callbacks \
+         api/mem_regions \
+         api/checkpoint \
+         api/mappable \
+         api/reload \
          mmu/tlb \
 "
 
@@ -101,7 +110,7 @@ do
     cd $lm32_test
 
     # Compile the test code
-    lm32-elf-as $srcfile -o $objfile
+    lm32-elf-as -g $srcfile -o $objfile
     lm32-elf-ld $objfile -o $testfile
 
     # Run the test and get the result